@@ -1,41 +1,175 @@
 #include <M5Core2.h>
+#include <SD.h>
 #include <Adafruit_seesaw.h>
 #include <BLEDevice.h>
 #include <BLE2902.h>
+#include <Preferences.h>
+#include <GameCore.h>
+#include <GameProtocol.h>
+#include <RemoteState.h>
+#include <PositionCodec.h>
+#include <WorldState.h>
+#include <SendQueue.h>
+#include <ClientSession.h>
+#include <LinkProfile.h>
+#include <Reconnector.h>
+#include <BleTransport.h>
+#include <InputSnapshot.h>
+#include <SeesawGamepad.h>
+#include <SpscRing.h>
+#include <SeqlockCell.h>
+#include <FrameScheduler.h>
+#include <FrameProfiler.h>
+#include <Telemetry.h>
+#include <SessionLog.h>
+#include <M5LcdSurface.h>
+#include <M5SpriteSurface.h>
+#include <ProfileOverlay.h>
 
 ///////////////////////////////////////////////////////////////
 // Variables
 ///////////////////////////////////////////////////////////////
-static BLERemoteCharacteristic *bleRemoteCharacteristic;
-static BLEAdvertisedDevice *bleRemoteServer;
-static boolean doConnect = false;
-static boolean doScan = false;
+static BLEClient *bleClient = NULL;
 bool deviceConnected = false;
-bool gameOverFlag = false;  // Flag to track if the game is over
 
 // Gamepad Variables
-Adafruit_seesaw gamepad;
-#define BUTTON_START 16
-#define BUTTON_SELECT 0
+SeesawGamepad gamepad;
+InputSampler<SeesawGamepad> inputSampler(gamepad);  // One bulk button read + joystick per frame
+
+// Set to true when the gamepad's INT pin is wired to GAMEPAD_INT_PIN (Port B):
+// buttons are then only read after an interrupt and the joystick every JOYSTICK_POLL_MS
+bool interruptInput = false;
+#define GAMEPAD_INT_PIN 26
+#define JOYSTICK_POLL_MS 30
+InterruptSampler<SeesawGamepad> interruptSampler(gamepad, JOYSTICK_POLL_MS);
+
+// The gamepad is only touched by inputTask, which hands snapshots to loop() through inputQueue
+#define INPUT_PERIOD_MS 10
+#define INPUT_TASK_CORE 0
+SpscRing<InputSnapshot, 16> inputQueue;
+InputSnapshot latestInput = {0, {JOYSTICK_CENTER, JOYSTICK_CENTER, 0}, 0, 0};  // What loop() last saw
 
-// Button state tracking
-bool startButtonPressed = false;
-bool selectButtonPressed = false;
-
-// Client's Blue Dot (Local)
-int blueX = 150, blueY = 100, blueSpeed = 1;
 bool showGameScreen = false;  // Flag to control screen transition
 
-// Server's Red Dot (Remote)
-int redX = -1, redY = -1;  // Red dot starts as invalid
-bool redDotInitialized = false;  // Flag to track if we've received valid data for red dot
-
-// Game timing
-unsigned long gameStartTime = 0;
-float gameTimeElapsed = 0.0;
+// Game state: our dot is local, the server's Red Dot is remote; other clients are extra dots
+GameState game;
+
+// Server packets: linkListener publishes them into remoteCell/worldCell, loop() picks them up once per frame
+RemoteState receivedRemote = {};  // Only touched by the BLE callback
+RemoteWorld receivedWorld = {};   // Only touched by the BLE callback
+SeqlockCell<RemoteState> remoteCell;
+SeqlockCell<RemoteWorld> worldCell;
+
+// Every other player's dot is drawn REMOTE_DELAY_MS in the past, interpolated between received
+// positions (and extrapolated for at most RemoteTrack's default 100 ms)
+#define REMOTE_DELAY_MS 150
+
+// Rendering: only what changed since last frame is redrawn
+M5LcdSurface lcdSurface;
+DirtyRenderer renderer(lcdSurface);
+RenderFrame renderFrame;
+
+// Set to true to compose frames in an off-screen sprite and flush them with DMA
+bool spriteMode = false;
+M5SpriteSurface spriteSurface;
+FrameCompositor compositor(spriteSurface);
+
+// Game timing: fixed simulation steps, with rendering and sends on their own rates
+#define SIM_STEP_MS 30
+#define RENDER_PERIOD_MS 30
+#define NETWORK_PERIOD_MS 100  // 10 Hz is enough with RemoteTrack smoothing the other side
+ArduinoClock frameClock;
+FrameScheduler<ArduinoClock> scheduler(frameClock);
+
+// Profiling: p50/p99/max of each stage, dumped in binary with the frame stats when
+// profileDump is set and drawn on screen while the overlay is on (A + B toggles it)
+bool profileDump = false;
+bool profilerOverlay = false;
+#define OVERLAY_REFRESH_MS 500
+FrameProfiler<ArduinoClock> profiler(frameClock);       // Only touched by loop()
+FrameProfiler<ArduinoClock> inputProfiler(frameClock);  // Only touched by inputTask
+volatile bool inputProfileReset = false;                // loop() asks inputTask to clear inputProfiler
+ProfileSummary overlayRows[PROFILE_STAGE_COUNT];
+
+// Telemetry: the BLE callbacks log notifications into bleTelemetry instead of printing
+// them; while telemetryStream is set, serialTask streams the events to Serial in binary
+// (decode with tools/telemetry_csv)
+bool telemetryStream = false;
+#define SERIAL_TASK_PERIOD_MS 20
+#define SERIAL_TASK_CORE 1
+TelemetryChannel<ArduinoClock> bleTelemetry(frameClock);  // Only logged to by the BLE task
+
+// Session recording for tools/session_replay: each round's seed, every simulate tick's input and
+// what was done with the other players' positions. Goes to SESSION_FILE on the SD card, or if
+// there's no card through sessionSerial, which serialTask drains to Serial off the frame path.
+bool sessionRecord = false;
+#define SESSION_FILE "/session.bin"
+File sessionFile;
+struct SessionSink {
+    size_t write(const uint8_t *data, size_t length);
+};
+SessionSink sessionSink;
+SessionRecorder<SessionSink> sessionRecorder(sessionSink);
+SessionChannel<> sessionSerial;  // Only written to by loop()
+
+// Positions go out only when they change: small moves as deltas, with a keyframe every KEYFRAME_MS
+#define KEYFRAME_MS 1000
+
+// Uploads are written without response through gameSession's SendQueue, which keeps at most
+// MAX_WRITES_IN_FLIGHT writes queued in the BLE stack and drops stale positions
+#define MAX_WRITES_IN_FLIGHT 2
+
+// The server link: bleTransport hands linkListener the link state, the server's notifications
+// and our finished writes (BLE task)
+struct ClientLinkListener : public TransportListener {
+    void onConnect(uint16_t link);
+    void onDisconnect(uint16_t link);
+    void onMtu(uint16_t link, uint16_t mtu);
+    void onReceive(uint16_t link, const uint8_t *data, size_t length);
+    void onSent(uint16_t link);
+};
+BleClientTransport bleTransport;
+ClientLinkListener linkListener;
+
+// Everything the game does with the server: round starts and ends, the other dots' tracks, our
+// uploads (and clock offset, for the server's lag compensation). gameEvents is what the sketch
+// does on top.
+struct ClientEvents : public ClientSessionListener {
+    void onRoundStart(uint8_t id);
+    void onGameOver();
+    void onWorld(const RemoteWorld &world);
+    void onRemoteMoved(int x, int y);
+};
+ClientEvents gameEvents;
+ClientSession gameSession(game, bleTransport, gameEvents, REMOTE_DELAY_MS, KEYFRAME_MS, MAX_WRITES_IN_FLIGHT);
 
-// Collision threshold
-const int COLLISION_DISTANCE = 10;
+// Connection parameters: low latency while playing, battery profile in the lobby and on game over
+struct ClientLink {
+    bool requestConnectionParams(const ConnectionProfile &profile);
+    bool requestMtu(uint16_t mtu);
+};
+ClientLink clientLink;
+LinkProfileManager<ClientLink> linkProfile(clientLink);
+
+// Finding the server: direct connect to the address saved in NVS, then short
+// high-duty passive scans (SCAN_INTERVAL = SCAN_WINDOW, 0.625 ms units) filtered on SERVICE_UUID
+#define SCAN_INTERVAL 0x30
+#define SCAN_WINDOW 0x30
+#define SCAN_WINDOW_MS 1500
+#define SCAN_PAUSE_MS 500
+struct ClientStack {
+    bool connect(const PeerAddress &address);
+    void startScan();
+    void stopScan();
+};
+struct ServerAddressStore {
+    bool load(PeerAddress &address);
+    void save(const PeerAddress &address);
+};
+ClientStack clientStack;
+ServerAddressStore serverAddressStore;
+Preferences preferences;
+Reconnector<ClientStack, ServerAddressStore> *reconnector = NULL;  // Created once BLE is up
 
 // Debug flags
 bool debugMode = false;  // Set to true to display debug info
@@ -46,330 +180,549 @@ bool debugMode = false;  // Set to true to display debug info
 static BLEUUID SERVICE_UUID("4fafc201-1fb5-459e-8fcc-c5c9c331914b"); 
 static BLEUUID CHARACTERISTIC_UUID("beb5483e-36e1-4688-b7f5-ea07361b26a8");
 
-// BLE Broadcast Name
-static String BLE_BROADCAST_NAME = "Mckaylas M5Core2024";
-
 ///////////////////////////////////////////////////////////////
 // Forward Declarations
 ///////////////////////////////////////////////////////////////
 void drawScreenTextWithBackground(String text, int backgroundColor);
-void sendGamepadData();
-void gameOver(float timeElapsed = -1.0);  // Game Over function
-void checkCollision();
-
-///////////////////////////////////////////////////////////////
-// BLE Client Callback Methods (Handles Server Notifications)
-///////////////////////////////////////////////////////////////
-static void notifyCallback(BLERemoteCharacteristic *pBLERemoteCharacteristic, uint8_t *pData, size_t length, bool isNotify) {
-    Serial.printf("Notify callback for characteristic %s of data length %d\n", 
-                  pBLERemoteCharacteristic->getUUID().toString().c_str(), length);
-    Serial.printf("\tData: %s\n", (char *)pData);
-
-    String receivedData = String((char *)pData);
-
-    if (receivedData == "CONNECTED") {
-        showGameScreen = true;
-        gameStartTime = millis(); // Start timing when connection is established
-        Serial.println("Switching to game screen.");
-    } 
-    else if (receivedData.startsWith("GAMEOVER")) {
-        // Parse server's game over time if available
-        int dashIndex = receivedData.indexOf('-');
-        if (dashIndex > 0) {
-            float serverTime = receivedData.substring(dashIndex + 1).toFloat();
-            gameOver(serverTime);
-        } else {
-            gameOver();
+bool connectToServer(const PeerAddress &address);
+void runFrame();
+void reportFrameStats();
+void profileSummaries(ProfileSummary *summaries);
+void drawOverlay(DrawSurface &surface);
+void flushSendQueue();
+void gameOver();
+void newRound();
+void applyRemoteState();
+InputSnapshot readInput();
+void IRAM_ATTR onGamepadInterrupt();
+void inputTask(void *parameter);
+void serialTask(void *parameter);
+void beginSessionRecording(SessionRole role);
+
+///////////////////////////////////////////////////////////////
+// Server link (BLE task): notifications, write completions and
+// the link coming and going, from bleTransport
+///////////////////////////////////////////////////////////////
+void ClientLinkListener::onReceive(uint16_t link, const uint8_t *data, size_t length) {
+    GamePacket packet;
+    
+    // Everyone's positions come in one WORLD frame
+    if (length > 0 && data[0] == PACKET_TYPE_WORLD) {
+        WorldState world;
+        if (!decodeWorld(data, length, world)) {
+            bleTelemetry.log(TELEMETRY_BAD_WORLD, length);
+            return;
         }
+        bleTelemetry.log(TELEMETRY_WORLD, world.seq, world.count, length);
+        applyWorld(receivedWorld, world, millis());
+        worldCell.write(receivedWorld);
+        return;
     }
-    else {
-        int dashIndex = receivedData.indexOf('-');
-        if (dashIndex > 0) {
-            // Parse the position data
-            int newRedX = receivedData.substring(0, dashIndex).toInt();
-            int newRedY = receivedData.substring(dashIndex + 1).toInt();
-            
-            // Only update if values are valid (non-negative and within screen bounds)
-            if (newRedX >= 0 && newRedY >= 0 && newRedX < 320 && newRedY < 240) {
-                redX = newRedX;
-                redY = newRedY;
-                
-                // Mark that we have valid data for the red dot
-                if (!redDotInitialized) {
-                    redDotInitialized = true;
-                    
-                    // Initialize blue dot in a different area to avoid immediate collision
-                    if (abs(blueX - redX) < 50 && abs(blueY - redY) < 50) {
-                        blueX = (redX < 160) ? random(200, 300) : random(20, 120);
-                        blueY = (redY < 120) ? random(150, 220) : random(20, 90);
-                    }
-                }
-                
-                // Check for collision after updating position, but only if we've had valid data for a while
-                // This prevents instant game over due to random positions or data initialization
-                static unsigned long firstDataTime = 0;
-                if (!firstDataTime) firstDataTime = millis();
-                
-                // Wait 2 seconds after first receiving data before allowing collisions
-                if (!gameOverFlag && redDotInitialized && (millis() - firstDataTime > 2000)) {
-                    checkCollision();
-                }
-            }
-        }
+
+    // decodePacket() rejects malformed frames and off-screen positions
+    if (!decodePacket(data, length, packet)) {
+        bleTelemetry.log(TELEMETRY_BAD_PACKET, length);
+        return;
     }
+    bleTelemetry.log(TELEMETRY_NOTIFY, packet.seq, packet.type, packet.x, packet.y);
+
+    // Runs on the BLE task: only publish the packet, the game loop does the rest
+    applyPacket(receivedRemote, packet, millis());
+    remoteCell.write(receivedRemote);
+}
+
+// A finished write frees a send queue slot
+void ClientLinkListener::onSent(uint16_t link) {
+    gameSession.onSent();
+}
+
+void ClientLinkListener::onMtu(uint16_t link, uint16_t mtu) {
+    Serial.printf("MTU negotiated: %u\n", mtu);
+}
+
+void ClientLinkListener::onConnect(uint16_t link) {
+    deviceConnected = true;  // The round starts with the server's CONNECTED packet
+}
+
+void ClientLinkListener::onDisconnect(uint16_t link) {
+    deviceConnected = false;
+    Serial.println("Device disconnected...");
+    showGameScreen = true; // Ensure game screen still shows even if disconnected
 }
 
 ///////////////////////////////////////////////////////////////
-// Check for collision between dots
+// Raw GATT client events (BLE task), for bleTransport
 ///////////////////////////////////////////////////////////////
-void checkCollision() {
-    // Only check collision if we have valid coordinates for red dot
-    if (redX >= 0 && redY >= 0 && !gameOverFlag && redDotInitialized) {
-        int dx = abs(blueX - redX);
-        int dy = abs(blueY - redY);
-        
-        if (debugMode) {
-            Serial.printf("Distance: dx=%d, dy=%d, threshold=%d\n", dx, dy, COLLISION_DISTANCE);
-        }
-        
-        // Only trigger collision if dots are very close
-        if (dx < COLLISION_DISTANCE && dy < COLLISION_DISTANCE) {
-            if (debugMode) {
-                Serial.println("COLLISION DETECTED");
-            }
-            gameOver();
+static void gattcEventHandler(esp_gattc_cb_event_t event, esp_gatt_if_t gattcIf, esp_ble_gattc_cb_param_t *param) {
+    bleTransport.onGattcEvent(event, gattcIf, param);
+}
+
+///////////////////////////////////////////////////////////////
+// GAP events (BLE task): report the connection parameters the
+// server and we actually agreed on
+///////////////////////////////////////////////////////////////
+static void gapEventHandler(esp_gap_ble_cb_event_t event, esp_ble_gap_cb_param_t *param) {
+    if (event == ESP_GAP_BLE_SCAN_RESULT_EVT) {
+        // Raw scan results: matched on the AD bytes, nothing is allocated per result
+        if (param->scan_rst.search_evt == ESP_GAP_SEARCH_INQ_RES_EVT && reconnector) {
+            PeerAddress address;
+            memcpy(address.bytes, param->scan_rst.bda, sizeof(address.bytes));
+            address.type = param->scan_rst.ble_addr_type;
+            reconnector->onAdvertisement(address, param->scan_rst.ble_adv,
+                                         param->scan_rst.adv_data_len + param->scan_rst.scan_rsp_len);
         }
+    } else if (event == ESP_GAP_BLE_UPDATE_CONN_PARAMS_EVT) {
+        Serial.printf("Connection params: status %d, interval %.2f ms, latency %u, timeout %u ms\n",
+                      param->update_conn_params.status,
+                      intervalMicros(param->update_conn_params.conn_int) / 1000.0,
+                      param->update_conn_params.latency, param->update_conn_params.timeout * 10);
     }
 }
 
+bool ClientLink::requestConnectionParams(const ConnectionProfile &profile) {
+    if (!bleClient) return false;
+
+    esp_ble_conn_update_params_t params;
+    memcpy(params.bda, *bleClient->getPeerAddress().getNative(), sizeof(esp_bd_addr_t));
+    params.min_int = profile.minInterval;
+    params.max_int = profile.maxInterval;
+    params.latency = profile.latency;
+    params.timeout = profile.timeout;
+    Serial.printf("Requesting %s connection profile\n", profile.name);
+    return esp_ble_gap_update_conn_params(&params) == ESP_OK;
+}
+
+bool ClientLink::requestMtu(uint16_t mtu) {
+    return bleClient && bleClient->setMTU(mtu);
+}
+
+bool ClientStack::connect(const PeerAddress &address) {
+    return connectToServer(address);
+}
+
+// Scans are driven through the GAP API directly: BLEScan builds a
+// BLEAdvertisedDevice (with Strings) for every result
+void ClientStack::startScan() {
+    esp_ble_scan_params_t params = {};
+    params.scan_type = BLE_SCAN_TYPE_PASSIVE;  // SERVICE_UUID is in the advertisement itself
+    params.own_addr_type = BLE_ADDR_TYPE_PUBLIC;
+    params.scan_filter_policy = BLE_SCAN_FILTER_ALLOW_ALL;
+    params.scan_interval = SCAN_INTERVAL;
+    params.scan_window = SCAN_WINDOW;
+    params.scan_duplicate = BLE_SCAN_DUPLICATE_DISABLE;
+    esp_ble_gap_set_scan_params(&params);
+    esp_ble_gap_start_scanning(0);  // Until stopScan()
+}
+
+void ClientStack::stopScan() {
+    esp_ble_gap_stop_scanning();
+}
+
+bool ServerAddressStore::load(PeerAddress &address) {
+    return preferences.getBytes("server", &address, sizeof(address)) == sizeof(address);
+}
+
+void ServerAddressStore::save(const PeerAddress &address) {
+    preferences.putBytes("server", &address, sizeof(address));
+}
+
 ///////////////////////////////////////////////////////////////
 // BLE Server Callback Methods (Handles Connection/Disconnection)
 ///////////////////////////////////////////////////////////////
 class MyClientCallback : public BLEClientCallbacks {
     void onConnect(BLEClient *pclient) {
-        deviceConnected = true;
-        gameOverFlag = false;
-        redDotInitialized = false;  // Reset this flag on new connection
-        gameStartTime = millis();
-        Serial.println("Device connected...");
+        Serial.println("Device connected...");  // The link opens once the characteristic is found
     }
 
     void onDisconnect(BLEClient *pclient) {
-        deviceConnected = false;
-        Serial.println("Device disconnected...");
-        showGameScreen = true; // Ensure game screen still shows even if disconnected
+        bleTransport.detach();
     }
 };
 
 ///////////////////////////////////////////////////////////////
 // Connect to BLE Server
 ///////////////////////////////////////////////////////////////
-bool connectToServer() {
-    Serial.printf("Forming a connection to %s\n", bleRemoteServer->getName().c_str());
-    BLEClient *bleClient = BLEDevice::createClient();
-    bleClient->setClientCallbacks(new MyClientCallback());
+bool connectToServer(const PeerAddress &address) {
+    BLEAddress serverAddress((uint8_t *)address.bytes);
+    Serial.printf("Forming a connection to %s\n", serverAddress.toString().c_str());
+    if (!bleClient) {
+        bleClient = BLEDevice::createClient();
+        bleClient->setClientCallbacks(new MyClientCallback());
+    }
 
-    if (!bleClient->connect(bleRemoteServer)) {
-        Serial.printf("FAILED to connect to server (%s)\n", bleRemoteServer->getName().c_str());
-        showGameScreen = true;
+    if (!bleClient->connect(serverAddress, (esp_ble_addr_type_t)address.type)) {
+        Serial.printf("FAILED to connect to server (%s)\n", serverAddress.toString().c_str());
         return false;
     }
     
-    Serial.printf("Connected to server (%s)\n", bleRemoteServer->getName().c_str());
+    Serial.printf("Connected to server (%s)\n", serverAddress.toString().c_str());
 
     BLERemoteService *bleRemoteService = bleClient->getService(SERVICE_UUID);
     if (bleRemoteService == nullptr) {
         Serial.printf("Failed to find our service UUID: %s\n", SERVICE_UUID.toString().c_str());
         bleClient->disconnect();
-        showGameScreen = true;
         return false;
     }
 
     Serial.printf("Found our service UUID: %s\n", SERVICE_UUID.toString().c_str());
 
-    bleRemoteCharacteristic = bleRemoteService->getCharacteristic(CHARACTERISTIC_UUID);
+    BLERemoteCharacteristic *bleRemoteCharacteristic = bleRemoteService->getCharacteristic(CHARACTERISTIC_UUID);
     if (bleRemoteCharacteristic == nullptr) {
         Serial.printf("Failed to find our characteristic UUID: %s\n", CHARACTERISTIC_UUID.toString().c_str());
         bleClient->disconnect();
-        showGameScreen = true;
         return false;
     }
 
     Serial.printf("Found our characteristic UUID: %s\n", CHARACTERISTIC_UUID.toString().c_str());
 
-    if (bleRemoteCharacteristic->canNotify())
-        bleRemoteCharacteristic->registerForNotify(notifyCallback);
+    gameSession.onConnect();
+    linkProfile.onConnect(millis());
+    bleTransport.attach(bleClient, bleRemoteCharacteristic);  // Notifications start here
 
     showGameScreen = true;
     return true;
 }
 
-///////////////////////////////////////////////////////////////
-// Scan for BLE servers and find the first one that advertises
-// the service we are looking for.
-///////////////////////////////////////////////////////////////
-class MyAdvertisedDeviceCallbacks : public BLEAdvertisedDeviceCallbacks {
-    void onResult(BLEAdvertisedDevice advertisedDevice) {
-        Serial.print("BLE Advertised Device found:");
-        Serial.printf("\tName: %s\n", advertisedDevice.getName().c_str());
-
-        if (advertisedDevice.haveServiceUUID() && 
-            advertisedDevice.isAdvertisingService(SERVICE_UUID) && 
-            advertisedDevice.getName() == BLE_BROADCAST_NAME.c_str()) {
-            BLEDevice::getScan()->stop();
-            bleRemoteServer = new BLEAdvertisedDevice(advertisedDevice);
-            doConnect = true;
-            doScan = true;
-        }
-    }
-};
-
 ///////////////////////////////////////////////////////////////
 // Setup Function
 ///////////////////////////////////////////////////////////////
 void setup() {
     M5.begin();
+    scheduler.setStage(STAGE_SIMULATE, SIM_STEP_MS * 1000UL);
+    scheduler.setStage(STAGE_RENDER, RENDER_PERIOD_MS * 1000UL);
+    scheduler.setStage(STAGE_NETWORK, NETWORK_PERIOD_MS * 1000UL);
     M5.Lcd.setTextSize(3);
-    drawScreenTextWithBackground("Scanning for BLE server...", TFT_BLUE);
+    if (spriteMode && !spriteSurface.begin()) {
+        Serial.println("Not enough memory for the frame sprite, drawing directly.");
+        spriteMode = false;
+    }
+    drawScreenTextWithBackground("Looking for BLE server...", TFT_BLUE);
 
-    // Assign random positions for the blue dot
-    blueX = random(50, 250);
-    blueY = random(50, 200);
+    // Initialize random seed and assign a random position for the blue dot
+    randomSeed(analogRead(0));
+    resetGame(game, random(1, 0x7FFFFFFF));
+    game.detectCollisions = false;  // The server owns collisions
+    beginSessionRecording(SESSION_ROLE_CLIENT);
 
     BLEDevice::init("");
+    bleTransport.setListener(&linkListener);
+    BLEDevice::setCustomGattcHandler(gattcEventHandler);
+    BLEDevice::setCustomGapHandler(gapEventHandler);
 
-    BLEScan *pBLEScan = BLEDevice::getScan();
-    pBLEScan->setAdvertisedDeviceCallbacks(new MyAdvertisedDeviceCallbacks());
-    pBLEScan->setInterval(1349);
-    pBLEScan->setWindow(449);
-    pBLEScan->setActiveScan(true);
-    pBLEScan->start(0, false);
+    preferences.begin("game", false);
+    reconnector = new Reconnector<ClientStack, ServerAddressStore>(
+        clientStack, serverAddressStore, SERVICE_UUID.getNative()->uuid.uuid128, SCAN_WINDOW_MS, SCAN_PAUSE_MS);
+    reconnector->start(millis());
 
     // Initialize Gamepad
     if (!gamepad.begin(0x50)) {
         Serial.println("ERROR! Gamepad not found.");
         while (1);
     }
-    gamepad.pinMode(BUTTON_START, INPUT_PULLUP);
-    gamepad.pinMode(BUTTON_SELECT, INPUT_PULLUP);
+    gamepad.pinModeBulk(GAMEPAD_BUTTON_MASK, INPUT_PULLUP);
+    if (interruptInput) {
+        gamepad.setGPIOInterrupts(GAMEPAD_BUTTON_MASK, 1);
+        pinMode(GAMEPAD_INT_PIN, INPUT_PULLUP);
+        attachInterrupt(digitalPinToInterrupt(GAMEPAD_INT_PIN), onGamepadInterrupt, FALLING);
+    }
+    xTaskCreatePinnedToCore(inputTask, "input", 4096, NULL, 1, NULL, INPUT_TASK_CORE);
+    if (telemetryStream || (sessionRecord && !sessionFile)) {
+        xTaskCreatePinnedToCore(serialTask, "serial", 2048, NULL, tskIDLE_PRIORITY, NULL, SERIAL_TASK_CORE);
+    }
 }
 
 ///////////////////////////////////////////////////////////////
 // Main Loop
 ///////////////////////////////////////////////////////////////
 void loop() {
-    if (gameOverFlag) return; // Stop the game loop if game over
+    applyRemoteState();
+    if (deviceConnected) {
+        LinkPhase phase = gameSession.isGameOver() ? LINK_GAME_OVER : (showGameScreen ? LINK_PLAYING : LINK_LOBBY);
+        linkProfile.update(phase, millis());
+    }
+    if (gameSession.isGameOver()) {
+        delay(30);
+        return; // Wait for the server to start a new round
+    }
+
+    if (deviceConnected && showGameScreen) {
+        runFrame();
+        return;
+    }
 
-    if (doConnect) {
-        if (connectToServer()) {
-            Serial.println("Connected to BLE Server.");
+    if (!deviceConnected) {
+        // Link dropped: look for the server again
+        if (reconnector->connected()) {
+            drawScreenTextWithBackground("Disconnected... reconnecting to BLE server...", TFT_ORANGE);
+            reconnector->start(millis());
+        }
+        if (reconnector->update(millis())) {
+            Serial.printf("Connected to BLE Server in %lu ms.\n", millis() - reconnector->startedAt());
             drawScreenTextWithBackground("Connected to BLE server!", TFT_GREEN);
-            doConnect = false;
-            delay(1000);
+            return;
+        }
+    }
+
+    delay(30);
+}
+
+///////////////////////////////////////////////////////////////
+// Run whichever stages are due: simulate, draw, send to server
+///////////////////////////////////////////////////////////////
+void runFrame() {
+    if (gameSession.isGameOver()) return;
+    scheduler.update();
+    bool busy = scheduler.isDue(STAGE_SIMULATE) || scheduler.isDue(STAGE_RENDER) ||
+                scheduler.isDue(STAGE_NETWORK);
+    if (busy) profiler.begin(PROFILE_FRAME);
+
+    // Move the blue dot in fixed steps (the server decides collisions)
+    if (scheduler.isDue(STAGE_SIMULATE)) {
+        ProfileScope<ArduinoClock> profile(profiler, PROFILE_SIMULATE);
+        InputSnapshot snapshot = readInput();
+        if (comboPressed(snapshot, GAME_COMBO_PROFILER)) {
+            profilerOverlay = !profilerOverlay;
+            if (!profilerOverlay) renderer.invalidate();  // Clear it off the screen
+        }
+
+        uint8_t events = 0;
+        for (uint32_t i = 0; i < scheduler.dueCount(STAGE_SIMULATE); i++) {
+            scheduler.begin(STAGE_SIMULATE);
+            events |= step(game, snapshot, scheduler.stepMs(), i == 0);
+            scheduler.end(STAGE_SIMULATE);
+        }
+        sessionRecorder.tick(millis(), snapshot, scheduler.stepMs(), scheduler.dueCount(STAGE_SIMULATE), game);
+        gameSession.simulated(events);
+    }
+
+    // Draw game screen
+    if (scheduler.isDue(STAGE_RENDER)) {
+        ProfileScope<ArduinoClock> profile(profiler, PROFILE_RENDER);
+        scheduler.begin(STAGE_RENDER);
+        buildGameFrame(game, playerColor(gameSession.playerId()), RED, renderFrame);
+        int dot = 2;  // After ours and the server's
+        for (uint8_t id = SERVER_PLAYER_ID + 1; id < WORLD_MAX_PLAYERS; id++) {
+            if (id == gameSession.playerId()) continue;
+            int x = 0, y = 0;
+            bool visible = gameSession.trackedPosition(id, millis(), x, y);
+            setFrameDot(renderFrame, dot++, x, y, playerColor(id), visible);
+        }
+        if (spriteMode) {
+            compositor.composeGame(renderFrame);
+            drawOverlay(spriteSurface);
+            compositor.flush();
         } else {
-            Serial.println("Failed to connect to server.");
-            drawScreenTextWithBackground("FAILED to connect to BLE server.", TFT_RED);
-            delay(1000);
+            renderer.render(renderFrame);
+            drawOverlay(lcdSurface);
         }
+        scheduler.end(STAGE_RENDER);
     }
 
-    if (deviceConnected && showGameScreen && !gameOverFlag) {
-        sendGamepadData();
-        
-        // Update game time
-        gameTimeElapsed = (millis() - gameStartTime) / 1000.0;
-    } else if (doScan && !gameOverFlag) {
-        drawScreenTextWithBackground("Disconnected... re-scanning for BLE server...", TFT_ORANGE);
-        BLEDevice::getScan()->start(0);
+    // Send position to server (writes go out in flushSendQueue(), which the profile counts too)
+    bool sending = scheduler.isDue(STAGE_NETWORK);
+    if (sending) {
+        profiler.begin(PROFILE_NETWORK);
+        scheduler.begin(STAGE_NETWORK);
+        gameSession.queueUploads(millis());
+        scheduler.end(STAGE_NETWORK);
     }
+    flushSendQueue();
+    if (sending) profiler.end(PROFILE_NETWORK);
+    if (busy) profiler.end(PROFILE_FRAME);
 
-    delay(30); // Smooth movement update rate
+    reportFrameStats();
+
+    // Sleep until the next stage is due
+    uint32_t waitUs = scheduler.untilNextUs();
+    if (waitUs >= 1000) delay(waitUs / 1000);
 }
 
 ///////////////////////////////////////////////////////////////
-// Send Gamepad Data to BLE Server
+// Hand queued packets to the BLE stack without waiting for it.
+// Completions come back through linkListener.onSent().
 ///////////////////////////////////////////////////////////////
-void sendGamepadData() {
-    if (gameOverFlag) return;
+void flushSendQueue() {
+    if (!deviceConnected) return;
+    int failed = gameSession.flush(millis());
+    if (failed && debugMode) Serial.printf("%d writes failed\n", failed);
+}
 
-    uint32_t buttons = gamepad.digitalReadBulk(0xFFFF);
-    int joyX = 1023 - gamepad.analogRead(14);
-    int joyY = 1023 - gamepad.analogRead(15);
+///////////////////////////////////////////////////////////////
+// Print stage timings every few seconds if anything ran late
+// (always in debug mode), and the profile dump if enabled
+///////////////////////////////////////////////////////////////
+void reportFrameStats() {
+    static unsigned long lastReport = 0;
+    if (millis() - lastReport < 5000) return;
+    lastReport = millis();
+
+    bool late = false;
+    for (int i = 0; i < STAGE_COUNT; i++) {
+        const StageStats &stats = scheduler.stageStats((SchedulerStage)i);
+        late |= stats.overruns > 0 || stats.dropped > 0;
+    }
+    if (late || debugMode) {
+        for (int i = 0; i < STAGE_COUNT; i++) {
+            const StageStats &stats = scheduler.stageStats((SchedulerStage)i);
+            Serial.printf("%-8s %4u runs %3u dropped %3u over %u us budget, worst %u us\n",
+                          stageName((SchedulerStage)i), stats.runs, stats.dropped,
+                          stats.overruns, stats.budgetUs, stats.worstUs);
+        }
+    }
+    scheduler.resetStats();
 
-    // Check Start button - Increase speed, wrap around from 5 to 1
-    // Note: Using digitalRead() directly for buttons since it's more reliable for edge detection
-    bool startCurrent = !gamepad.digitalRead(BUTTON_START); // Button is active LOW (pressed = 0)
-    if (startCurrent && !startButtonPressed) {
-        // Start button was just pressed (rising edge)
-        blueSpeed++;
-        if (blueSpeed > 5) blueSpeed = 1;
-        
-        // Display speed briefly
-        M5.Lcd.fillRect(0, 0, 100, 30, BLACK);
-        M5.Lcd.setCursor(5, 5);
-        M5.Lcd.setTextSize(2);
-        M5.Lcd.printf("Speed: %d", blueSpeed);
-        M5.Lcd.setTextSize(3);
+    if (profileDump) {
+        ProfileSummary summaries[PROFILE_STAGE_COUNT];
+        profileSummaries(summaries);
+        uint8_t dump[PROFILE_DUMP_MAX_SIZE];
+        Serial.write(dump, encodeProfileDump(summaries, PROFILE_STAGE_COUNT, dump));
     }
-    startButtonPressed = startCurrent;
-
-    // Check Select button - Warp to random position
-    bool selectCurrent = !gamepad.digitalRead(BUTTON_SELECT); // Button is active LOW
-    if (selectCurrent && !selectButtonPressed) {
-        // Select button was just pressed (rising edge)
-        blueX = random(10, 310);
-        blueY = random(10, 230);
+    profiler.reset();
+    inputProfileReset = true;
+}
+
+// One summary per stage; the input stage comes from the input task's profiler
+void profileSummaries(ProfileSummary *summaries) {
+    for (int i = 0; i < PROFILE_STAGE_COUNT; i++) {
+        const FrameProfiler<ArduinoClock> &source = i == PROFILE_INPUT ? inputProfiler : profiler;
+        summaries[i] = summarize((ProfileStage)i, source.histogram((ProfileStage)i));
     }
-    selectButtonPressed = selectCurrent;
+}
 
-    float normX = (joyX - 512) / 512.0;
-    float normY = (joyY - 512) / 512.0;
+// Profiler overlay on top of the frame, with numbers refreshed every OVERLAY_REFRESH_MS
+void drawOverlay(DrawSurface &surface) {
+    static unsigned long lastRefresh = 0;
+    if (!profilerOverlay) return;
+    if (millis() - lastRefresh >= OVERLAY_REFRESH_MS) {
+        lastRefresh = millis();
+        profileSummaries(overlayRows);
+    }
+    drawProfileOverlay(surface, overlayRows, PROFILE_STAGE_COUNT);
+}
 
-    if (abs(normX) > 0.2) blueX += (normX > 0 ? blueSpeed : -blueSpeed);
-    if (abs(normY) > 0.2) blueY -= (normY > 0 ? blueSpeed : -blueSpeed);
+///////////////////////////////////////////////////////////////
+// Session recording
+///////////////////////////////////////////////////////////////
+void beginSessionRecording(SessionRole role) {
+    if (!sessionRecord) return;
+    if (SD.begin()) sessionFile = SD.open(SESSION_FILE, FILE_WRITE);
+    if (!sessionFile) Serial.println("No SD card, recording the session to Serial.");
+    sessionRecorder.begin(role);
+}
 
-    blueX = constrain(blueX, 0, 315);
-    blueY = constrain(blueY, 0, 235);
+size_t SessionSink::write(const uint8_t *data, size_t length) {
+    return sessionFile ? sessionFile.write(data, length) : sessionSerial.write(data, length);
+}
 
-    // Check for collision
-    checkCollision();
+///////////////////////////////////////////////////////////////
+// Gamepad Input
+///////////////////////////////////////////////////////////////
+void IRAM_ATTR onGamepadInterrupt() {
+    interruptSampler.onInterrupt();
+}
 
-    // Draw game screen
-    M5.Lcd.fillScreen(BLACK);
-    M5.Lcd.fillRect(blueX, blueY, 5, 5, BLUE);
-    
-    // Only draw red dot if valid coordinates received
-    if (redX >= 0 && redY >= 0) {
-        M5.Lcd.fillRect(redX, redY, 5, 5, RED);
+// Samples the gamepad every INPUT_PERIOD_MS so I2C stalls never hold up a frame
+void inputTask(void *parameter) {
+    uint32_t missedPressed = 0, missedReleased = 0;  // Edges from snapshots dropped on a full queue
+    TickType_t lastWake = xTaskGetTickCount();
+    for (;;) {
+        if (inputProfileReset) {
+            inputProfiler.reset();
+            inputProfileReset = false;
+        }
+        inputProfiler.begin(PROFILE_INPUT);
+        InputSnapshot snapshot = interruptInput ? interruptSampler.poll(millis())
+                                                : inputSampler.sample(millis());
+        inputProfiler.end(PROFILE_INPUT);
+        snapshot.pressed |= missedPressed;
+        snapshot.released |= missedReleased;
+        if (inputQueue.push(snapshot)) {
+            missedPressed = missedReleased = 0;
+        } else {
+            missedPressed = snapshot.pressed;
+            missedReleased = snapshot.released;
+        }
+        vTaskDelayUntil(&lastWake, pdMS_TO_TICKS(INPUT_PERIOD_MS));
     }
-    
-    // Show game time and current speed
-    M5.Lcd.setCursor(5, 5);
-    M5.Lcd.setTextSize(1);
-    M5.Lcd.printf("Time: %.2fs  Speed: %d", gameTimeElapsed, blueSpeed);
-    M5.Lcd.setTextSize(3);
+}
 
-    // Send position to server
-    String position = String(blueX) + "-" + String(blueY);
-    if (bleRemoteCharacteristic && bleRemoteCharacteristic->canWrite()) {
-        bleRemoteCharacteristic->writeValue(position.c_str(), position.length());
+// Streams bleTelemetry and a session recording without an SD card to Serial when nothing
+// else on its core wants to run, only writing whole frames that fit in the UART's buffer
+void serialTask(void *parameter) {
+    for (;;) {
+        if (telemetryStream) bleTelemetry.drain(Serial);
+        sessionSerial.drain(Serial);
+        vTaskDelay(pdMS_TO_TICKS(SERIAL_TASK_PERIOD_MS));
     }
 }
 
+// Everything the input task sampled since the last call, folded into one snapshot
+InputSnapshot readInput() {
+    drainInput(inputQueue, latestInput);
+    return latestInput;
+}
+
 ///////////////////////////////////////////////////////////////
-// Game Over Function
+// Act on whatever the server sent since the last frame
 ///////////////////////////////////////////////////////////////
-void gameOver(float serverTime) {
-    gameOverFlag = true;
+void applyRemoteState() {
+    RemoteState remote;
+    remoteCell.read(remote);
+    RemoteWorld world;
+    worldCell.read(world);
+    gameSession.applyRemoteState(remote, world, millis());
+}
+
+// Start timing when connection is established or the server restarts
+void ClientEvents::onRoundStart(uint8_t id) {
+    showGameScreen = true;
+    newRound();
+    Serial.printf("Switching to game screen as player %u.\n", id);
+}
+
+void ClientEvents::onGameOver() {
+    gameOver();
+}
+
+void ClientEvents::onWorld(const RemoteWorld &world) {
+    if (!sessionRecorder.active()) return;
+    uint8_t frame[WORLD_PACKET_MAX_SIZE];
+    sessionRecorder.packet(world.receivedMs, SERVER_PLAYER_ID, frame, encodeWorld(world.world, frame));
+}
+
+// The red dot is drawn only; the server checks collisions
+void ClientEvents::onRemoteMoved(int x, int y) {
+    sessionRecorder.remote(x, y);
+}
+
+///////////////////////////////////////////////////////////////
+// Start a new round with a fresh blue dot and no red dot
+///////////////////////////////////////////////////////////////
+void newRound() {
+    uint32_t seed = random(1, 0x7FFFFFFF);
+    resetGame(game, seed);
+    game.detectCollisions = false;  // The server owns collisions
+    sessionRecorder.round(seed, game);
+    gameSession.newRound();
+    scheduler.restart();
+    renderer.invalidate();
+}
+
+///////////////////////////////////////////////////////////////
+// Game Over Function (gameSession already set the server's time,
+// the official one)
+///////////////////////////////////////////////////////////////
+void gameOver() {
+    sessionRecorder.gameOver(game);
+    if (sessionFile) sessionFile.flush();
     
-    // Calculate time if not provided by server
-    if (serverTime < 0) {
-        gameTimeElapsed = (millis() - gameStartTime) / 1000.0;
-    } else {
-        // Use server's time if provided (for consistency)
-        gameTimeElapsed = serverTime;
+    if (spriteMode) {
+        compositor.composeGameOver(game.elapsedMs, false);
+        compositor.flush();
+        return;
     }
-    
+
+    renderer.invalidate();
     M5.Lcd.fillScreen(RED);
     M5.Lcd.setTextColor(WHITE);
     M5.Lcd.setTextSize(3);
@@ -379,14 +732,18 @@ void gameOver(float serverTime) {
     
     M5.Lcd.setCursor(50, 150);
     M5.Lcd.setTextSize(2);
-    M5.Lcd.printf("Time: %.2f seconds", gameTimeElapsed);
+    M5.Lcd.printf("Time: %.2f seconds", game.elapsedMs / 1000.0);
 }
 
 ///////////////////////////////////////////////////////////////
 // Screen Display Function
 ///////////////////////////////////////////////////////////////
 void drawScreenTextWithBackground(String text, int backgroundColor) {
+    spriteSurface.waitForFlush();
+    renderer.invalidate();
     M5.Lcd.fillScreen(backgroundColor);
+    M5.Lcd.setTextColor(WHITE);
+    M5.Lcd.setTextSize(3);
     M5.Lcd.setCursor(0, 0);
     M5.Lcd.println(text);
 }
\ No newline at end of file
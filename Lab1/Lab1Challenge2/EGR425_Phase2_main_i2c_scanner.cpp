@@ -1,5 +1,6 @@
 #include <M5Unified.h>
 #include <Adafruit_seesaw.h>
+#include <GameCore.h>
 
 // Create the Gamepad Object
 Adafruit_seesaw gamepad;
@@ -23,13 +24,9 @@ uint32_t button_mask = (1UL << BUTTON_X) | (1UL << BUTTON_Y) | (1UL << BUTTON_ST
 //////////////////////////////////////
 //  Gamepad Variables
 //////////////////////////////////////
-const int SCREEN_WIDTH = 320;
-const int SCREEN_HEIGHT = 240;
-
 int blueX = 50, blueY = 50, blueSpeed = 1; // Blue dot (joystick)
 int redX = 250, redY = 150, redSpeed = 1; // Red dot (D-pad)
 unsigned long startTime;
-const int COLLISION_DISTANCE = 10;
 
 //////////////////////////////////////
 //  Setup Function
@@ -83,11 +80,8 @@ void loop() {
     int joyX = 1023 - gamepad.analogRead(14);
     int joyY = 1023 - gamepad.analogRead(15);
 
-    float normX = (joyX - 512) / 512.0;
-    float normY = (joyY - 512) / 512.0;
-
-    if (abs(normX) > 0.2) blueX += (normX > 0 ? blueSpeed : -blueSpeed);
-    if (abs(normY) > 0.2) blueY += (normY > 0 ? blueSpeed : -blueSpeed);
+    blueX += joystickAxis(joyX) * blueSpeed;
+    blueY += joystickAxis(joyY) * blueSpeed;
 
     if (!(buttons & (1UL << BUTTON_X))) redY -= redSpeed; // Up
     if (!(buttons & (1UL << BUTTON_B))) redY += redSpeed; // Down
@@ -99,20 +93,16 @@ void loop() {
         delay(200);
     }
 
-    blueX = constrain(blueX, 0, SCREEN_WIDTH -2);
-    blueX = constrain(blueY, 0, SCREEN_WIDTH -2);
-    blueX = constrain(redX, 0, SCREEN_WIDTH -2);
-    blueX = constrain(redY, 0, SCREEN_WIDTH -2);
-
-    int dotSize = 5;
+    blueX = clampInt(blueX, 0, FIELD_MAX_X);
+    blueY = clampInt(blueY, 0, FIELD_MAX_Y);
+    redX = clampInt(redX, 0, FIELD_MAX_X);
+    redY = clampInt(redY, 0, FIELD_MAX_Y);
 
     M5.Lcd.fillScreen(BLACK);
-    M5.Lcd.fillRect(blueX, blueY, dotSize, dotSize, BLUE);
-    M5.Lcd.fillRect(redX, redY, dotSize, dotSize, RED);
+    M5.Lcd.fillRect(blueX, blueY, DOT_SIZE, DOT_SIZE, BLUE);
+    M5.Lcd.fillRect(redX, redY, DOT_SIZE, DOT_SIZE, RED);
 
-    int dx = abs(blueX - redX);
-    int dy = abs(blueY - redY);
-    if (dx < COLLISION_DISTANCE && dy < COLLISION_DISTANCE) {
+    if (dotsCollide(blueX, blueY, redX, redY)) {
         gameOver();
     }
 }
@@ -1,5 +1,6 @@
 #include <M5Core2.h>
 #include <Adafruit_seesaw.h>
+#include <GameCore.h>
 #include <BLEDevice.h>
 #include <BLE2902.h>
 
@@ -198,11 +199,8 @@ void sendGamepadData() {
     int joyX = 1023 - gamepad.analogRead(14);
     int joyY = 1023 - gamepad.analogRead(15);
 
-    float normX = (joyX - 512) / 512.0;
-    float normY = (joyY - 512) / 512.0;
-
-    if (abs(normX) > 0.2) blueX += (normX > 0 ? blueSpeed : -blueSpeed);
-    if (abs(normY) > 0.2) blueY -= (normY > 0 ? blueSpeed : -blueSpeed);
+    blueX += joystickAxis(joyX) * blueSpeed;
+    blueY -= joystickAxis(joyY) * blueSpeed;
 
     if (!(buttons & (1UL << BUTTON_START))) {
         blueSpeed = (blueSpeed % 5) + 1;
@@ -217,13 +215,13 @@ void sendGamepadData() {
         delay(300);
     }
 
-    blueX = constrain(blueX, 0, 315);
-    blueY = constrain(blueY, 0, 235);
+    blueX = clampInt(blueX, 0, FIELD_MAX_X);
+    blueY = clampInt(blueY, 0, FIELD_MAX_Y);
 
     // Draw both dots
     M5.Lcd.fillScreen(BLACK);
-    M5.Lcd.fillRect(blueX, blueY, 5, 5, BLUE);  // Local Blue Dot
-    M5.Lcd.fillRect(lastReceivedRedX, lastReceivedRedY, 5, 5, RED);  // Opponent's Red Dot
+    M5.Lcd.fillRect(blueX, blueY, DOT_SIZE, DOT_SIZE, BLUE);  // Local Blue Dot
+    M5.Lcd.fillRect(lastReceivedRedX, lastReceivedRedY, DOT_SIZE, DOT_SIZE, RED);  // Opponent's Red Dot
 
     // Send blue dot position to the server
     String position = String(blueX) + "-" + String(blueY);
@@ -3,6 +3,7 @@
 #include <BLEServer.h>
 #include <BLE2902.h>
 #include <Adafruit_seesaw.h>
+#include <GameCore.h>
 
 ///////////////////////////////////////////////////////////////
 // Variables
@@ -96,14 +97,11 @@ void loop() {
         int joyX = 1023 - gamepad.analogRead(14);
         int joyY = 1023 - gamepad.analogRead(15);
 
-        float normX = (joyX - 512) / 512.0;
-        float normY = (joyY - 512) / 512.0;
+        dotX += joystickAxis(joyX) * dotSpeed;
+        dotY -= joystickAxis(joyY) * dotSpeed;
 
-        if (abs(normX) > 0.2) dotX += (normX > 0 ? dotSpeed : -dotSpeed);
-        if (abs(normY) > 0.2) dotY -= (normY > 0 ? dotSpeed : -dotSpeed);
-
-        dotX = constrain(dotX, 0, 315);
-        dotY = constrain(dotY, 0, 235);
+        dotX = clampInt(dotX, 0, FIELD_MAX_X);
+        dotY = clampInt(dotY, 0, FIELD_MAX_Y);
 
         // ✅ Read opponent's position from BLE
         std::string readValue = bleCharacteristic->getValue();
@@ -120,12 +118,12 @@ void loop() {
                 }
             }
         }
-        redX = constrain(redX, 0, 315);
-        redY = constrain(redY, 0, 235);
+        redX = clampInt(redX, 0, FIELD_MAX_X);
+        redY = clampInt(redY, 0, FIELD_MAX_Y);
 
         M5.Lcd.fillScreen(BLACK);
-        M5.Lcd.fillRect(dotX, dotY, 5, 5, BLUE); // Local Server Blue Dot
-        M5.Lcd.fillRect(redX, redY, 5, 5, RED);  // Opponent's Red Dot
+        M5.Lcd.fillRect(dotX, dotY, DOT_SIZE, DOT_SIZE, BLUE); // Local Server Blue Dot
+        M5.Lcd.fillRect(redX, redY, DOT_SIZE, DOT_SIZE, RED);  // Opponent's Red Dot
 
         String positionUpdate = String(dotX) + "-" + String(dotY);
         bleCharacteristic->setValue(positionUpdate.c_str());
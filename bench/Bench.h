@@ -0,0 +1,63 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+///////////////////////////////////////////////////////////////
+// Tiny microbenchmark harness for the native env.
+//
+// Define a benchmark with BENCH(name) and loop `iterations`
+// times over the code being measured:
+//
+//   BENCH(packet_encode) {
+//       for (uint32_t i = 0; i < iterations; i++) { ... }
+//   }
+//
+// The runner picks an iteration count that takes ~100 ms and
+// reports ns/op and heap allocations/op for each benchmark.
+///////////////////////////////////////////////////////////////
+typedef void (*BenchFunction)(uint32_t iterations);
+
+struct BenchEntry {
+    const char *name;
+    BenchFunction function;
+    BenchEntry *next;
+};
+
+// Linked list of every BENCH() in the program, in registration order
+BenchEntry *&benchRegistry();
+
+struct BenchRegistrar {
+    BenchEntry entry;
+    BenchRegistrar(const char *name, BenchFunction function) {
+        entry.name = name;
+        entry.function = function;
+        entry.next = NULL;
+
+        BenchEntry **tail = &benchRegistry();
+        while (*tail) tail = &(*tail)->next;
+        *tail = &entry;
+    }
+};
+
+#define BENCH(name)                                              \
+    static void bench_##name(uint32_t iterations);               \
+    static BenchRegistrar bench_##name##_registrar(#name, bench_##name); \
+    static void bench_##name(uint32_t iterations)
+
+// Number of operator new calls since the program started
+uint64_t benchAllocations();
+
+// Report an extra per-op figure (e.g. pixels pushed per frame) for the
+// current benchmark; printed under its timing row. Correctness
+// checks are TEST()s (see Test.h), not metrics.
+void benchMetric(const char *label, double perOp);
+
+// Keep the compiler from optimizing a result away
+template <typename T>
+inline void doNotOptimize(const T &value) {
+    asm volatile("" : : "r,m"(value) : "memory");
+}
+
+#endif
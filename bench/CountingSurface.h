@@ -0,0 +1,39 @@
+#ifndef COUNTING_SURFACE_H
+#define COUNTING_SURFACE_H
+
+#include <GameRender.h>
+
+///////////////////////////////////////////////////////////////
+// Mock LCD that only counts the pixels that would have been
+// pushed over SPI, so renderer savings can be measured on host
+///////////////////////////////////////////////////////////////
+class CountingSurface : public DrawSurface {
+public:
+    CountingSurface() : pixels(0), calls(0), textCalls(0) {}
+
+    void fillRect(int x, int y, int w, int h, uint16_t color) {
+        (void)x; (void)y; (void)color;
+        pixels += (uint64_t)w * h;
+        calls++;
+    }
+
+    void drawText(int x, int y, const char *text, int length, uint8_t size,
+                  uint16_t color, uint16_t background) {
+        (void)x; (void)y; (void)text; (void)color; (void)background;
+        pixels += (uint64_t)length * FONT_CHAR_WIDTH * size * FONT_CHAR_HEIGHT * size;
+        calls++;
+        textCalls++;
+    }
+
+    void pushImage(int x, int y, int w, int h, const uint16_t *image) {
+        (void)x; (void)y; (void)image;
+        pixels += (uint64_t)w * h;
+        calls++;
+    }
+
+    uint64_t pixels;
+    uint64_t calls;
+    uint64_t textCalls;  // drawText() calls, which rasterize glyphs on the LCD
+};
+
+#endif
@@ -0,0 +1,79 @@
+#ifndef FAKE_SEESAW_H
+#define FAKE_SEESAW_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+class FakeSeesaw;
+
+// Runs before every transaction, so a script can press buttons (and
+// fire the INT line) in the middle of a sample
+class FakeSeesawScript {
+public:
+    virtual ~FakeSeesawScript() {}
+    virtual void beforeTransaction(FakeSeesaw &gamepad) = 0;
+};
+
+///////////////////////////////////////////////////////////////
+// Stand-in for Adafruit_seesaw that counts I2C transactions.
+// Buttons and joystick values are set directly by the caller
+// (or a FakeSeesawScript); button changes latch GPIO interrupt
+// flags like the real chip, and reading the flags clears them.
+///////////////////////////////////////////////////////////////
+class FakeSeesaw {
+public:
+    FakeSeesaw()
+        : gpio(0xFFFFFFFF), joyX(512), joyY(512), transactions(0), bulkReads(0), analogReads(0),
+          interruptFlags(0), script(NULL) {}
+
+    uint32_t digitalReadBulk(uint32_t pins) {
+        transaction();
+        bulkReads++;
+        return gpio & pins;
+    }
+
+    bool digitalRead(uint8_t pin) {
+        transaction();
+        return (gpio >> pin) & 1;
+    }
+
+    uint16_t analogRead(uint8_t pin) {
+        transaction();
+        analogReads++;
+        return pin == 14 ? joyX : joyY;
+    }
+
+    uint32_t readGPIOInterruptFlags() {
+        transaction();
+        uint32_t flags = interruptFlags;
+        interruptFlags = 0;
+        return flags;
+    }
+
+    // Hold or release a button (active LOW like the real gamepad).
+    // Returns true if the INT line would have fired.
+    bool setButton(uint32_t mask, bool held) {
+        uint32_t before = gpio;
+        if (held) gpio &= ~mask;
+        else gpio |= mask;
+        interruptFlags |= before ^ gpio;
+        return before != gpio;
+    }
+
+    uint32_t gpio;
+    uint16_t joyX;
+    uint16_t joyY;
+    uint64_t transactions;
+    uint64_t bulkReads;
+    uint64_t analogReads;
+    uint32_t interruptFlags;
+    FakeSeesawScript *script;
+
+private:
+    void transaction() {
+        if (script) script->beforeTransaction(*this);
+        transactions++;
+    }
+};
+
+#endif
@@ -0,0 +1,63 @@
+#ifndef TEST_H
+#define TEST_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+///////////////////////////////////////////////////////////////
+// Checks for the native env, next to the benchmarks.
+//
+// Define a test with TEST(name); it runs once. CHECK() a
+// condition, or CHECKF() it with printf-style context that
+// names the failing case:
+//
+//   TEST(packet_round_trip) {
+//       for (int x = 0; x < 320; x++) {
+//           CHECKF(decode(encode(x)) == x, "x %d", x);
+//       }
+//   }
+//
+// Both return the condition, so a test can stop early with
+// if (!CHECK(...)) return. `program test` runs every test,
+// prints the first failures of each with file, line and
+// context, and exits with 1 if any failed.
+///////////////////////////////////////////////////////////////
+typedef void (*TestFunction)();
+
+struct TestEntry {
+    const char *name;
+    TestFunction function;
+    TestEntry *next;
+};
+
+// Linked list of every TEST() in the program, in registration order
+TestEntry *&testRegistry();
+
+struct TestRegistrar {
+    TestEntry entry;
+    TestRegistrar(const char *name, TestFunction function) {
+        entry.name = name;
+        entry.function = function;
+        entry.next = NULL;
+
+        TestEntry **tail = &testRegistry();
+        while (*tail) tail = &(*tail)->next;
+        *tail = &entry;
+    }
+};
+
+#define TEST(name)                                                \
+    static void test_##name();                                    \
+    static TestRegistrar test_##name##_registrar(#name, test_##name); \
+    static void test_##name()
+
+// Record a check of the running test; only call from the test's own thread.
+// Outside a test (a BENCH sharing the helper) checks do nothing.
+bool testCheck(bool ok, const char *file, int line, const char *condition);
+bool testCheckf(bool ok, const char *file, int line, const char *condition, const char *format, ...)
+    __attribute__((format(printf, 5, 6)));
+
+#define CHECK(condition) testCheck((condition), __FILE__, __LINE__, #condition)
+#define CHECKF(condition, ...) testCheckf((condition), __FILE__, __LINE__, #condition, __VA_ARGS__)
+
+#endif
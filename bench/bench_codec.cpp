@@ -0,0 +1,114 @@
+#include "Bench.h"
+#include "Test.h"
+
+#include <GameCore.h>
+#include <GameProtocol.h>
+#include <PositionCodec.h>
+
+///////////////////////////////////////////////////////////////
+// Change-only position stream over a lossy link. A scripted
+// player wanders, stops for a while and sometimes warps; every
+// 100 ms tick goes through PositionEncoder, encodePacket(),
+// a link that drops 10% of frames, decodePacket() and
+// PositionDecoder.
+//
+// position_stream checks the receiver never decodes a position
+// other than the one sent.
+///////////////////////////////////////////////////////////////
+static const uint32_t TICK_MS = 100;
+
+class ScriptedPlayer {
+public:
+    ScriptedPlayer() : rng(777), x(160), y(120), dx(0), dy(0), ticksLeft(0), warped(false) {}
+
+    void tick() {
+        warped = false;
+        if (ticksLeft-- <= 0) {
+            int mode = randomBetween(rng, 0, 10);
+            dx = mode < 4 ? 0 : randomBetween(rng, -15, 16);  // 40% of the time standing still
+            dy = mode < 4 ? 0 : randomBetween(rng, -15, 16);
+            ticksLeft = randomBetween(rng, 5, 40);
+            if (mode == 9) {
+                x = randomBetween(rng, 10, 310);
+                y = randomBetween(rng, 10, 230);
+                warped = true;
+            }
+        }
+        x = clampInt(x + dx, 0, FIELD_MAX_X);
+        y = clampInt(y + dy, 0, FIELD_MAX_Y);
+    }
+
+    uint32_t rng;
+    int x, y, dx, dy, ticksLeft;
+    bool warped;
+};
+
+struct StreamResult {
+    uint64_t bytes;
+    uint64_t errors;        // Decoded positions that differ from what was sent
+    uint32_t firstErrorTick;
+    uint64_t staleMs;       // Total time the receiver showed a wrong position
+    uint32_t staleRuns;     // How many times it went wrong
+};
+
+static StreamResult runStream(uint32_t ticks) {
+    ScriptedPlayer player;
+    PositionEncoder encoder(1000);
+    PositionDecoder decoder;
+    uint32_t linkRng = 4242;
+    uint8_t seq = 0;
+
+    StreamResult result = { 0, 0, 0, 0, 0 };
+    int shownX = -1, shownY = -1;
+    bool wrong = false;
+
+    for (uint32_t i = 0; i < ticks; i++) {
+        uint32_t now = i * TICK_MS;
+        player.tick();
+
+        GamePacket packet;
+        if (encoder.encode(seq, player.x, player.y, player.warped ? PACKET_FLAG_WARPED : 0, now, packet)) {
+            seq++;
+            uint8_t frame[GAME_PACKET_SIZE];
+            size_t length = encodePacket(packet, frame);
+            result.bytes += length;
+
+            GamePacket received;
+            if (randomBetween(linkRng, 0, 100) >= 10 && decodePacket(frame, length, received) &&
+                decoder.decode(received, received)) {
+                if ((received.x != player.x || received.y != player.y) && result.errors++ == 0) {
+                    result.firstErrorTick = i;
+                }
+                shownX = received.x;
+                shownY = received.y;
+            }
+        }
+
+        if (shownX == player.x && shownY == player.y) {
+            wrong = false;
+        } else {
+            if (!wrong) result.staleRuns++;
+            wrong = true;
+            result.staleMs += TICK_MS;
+        }
+    }
+    return result;
+}
+
+TEST(position_stream) {
+    const uint32_t TICKS = 100000;
+    StreamResult result = runStream(TICKS);
+    CHECKF(result.errors == 0, "%llu of %u ticks decoded wrong, first at tick %u",
+           (unsigned long long)result.errors, TICKS, result.firstErrorTick);
+}
+
+BENCH(position_stream_bytes) {
+    StreamResult result = runStream(iterations);
+    benchMetric("bytes/tick (was 9)", (double)result.bytes / iterations);
+}
+
+// How long the receiver stays wrong after a drop (a lost keyframe costs up to a second)
+BENCH(position_stream_recovery) {
+    StreamResult result = runStream(iterations);
+    benchMetric("ms out of sync per drop", result.staleRuns ? (double)result.staleMs / result.staleRuns : 0);
+}
@@ -0,0 +1,229 @@
+#include "Bench.h"
+
+#include <GameCore.h>
+#include <GameProtocol.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+///////////////////////////////////////////////////////////////
+// Per-frame game loop benchmarks. Inputs come from a fixed
+// pseudo-random table so results are stable run to run.
+///////////////////////////////////////////////////////////////
+static const int INPUT_COUNT = 256;  // Power of two, indexed with & (INPUT_COUNT - 1)
+
+static const GameInput *benchInputs() {
+    static GameInput inputs[INPUT_COUNT];
+    static bool filled = false;
+    if (!filled) {
+        uint32_t rng = 12345;
+        for (int i = 0; i < INPUT_COUNT; i++) {
+            inputs[i].joyX = randomBetween(rng, 0, 1024);
+            inputs[i].joyY = randomBetween(rng, 0, 1024);
+            inputs[i].buttons = (nextRandom(rng) % 16 == 0) ? GAME_BUTTON_START : 0;
+        }
+        filled = true;
+    }
+    return inputs;
+}
+
+static GameState benchState(bool withRemote) {
+    GameState state;
+    resetGame(state, 42);
+    if (withRemote) {
+        setRemotePosition(state, 20, 20);
+        state.elapsedMs = COLLISION_GRACE_MS + 1;  // Collisions armed
+    }
+    return state;
+}
+
+///////////////////////////////////////////////////////////////
+// Input normalization
+///////////////////////////////////////////////////////////////
+
+// The original sketch code: double math, then a float compare
+BENCH(input_normalize_float) {
+    const GameInput *inputs = benchInputs();
+    for (uint32_t i = 0; i < iterations; i++) {
+        const GameInput &input = inputs[i & (INPUT_COUNT - 1)];
+        float normX = (input.joyX - 512) / 512.0;
+        float normY = (input.joyY - 512) / 512.0;
+        int moveX = fabsf(normX) > 0.2 ? (normX > 0 ? 1 : -1) : 0;
+        int moveY = fabsf(normY) > 0.2 ? (normY > 0 ? 1 : -1) : 0;
+        doNotOptimize(moveX);
+        doNotOptimize(moveY);
+    }
+}
+
+BENCH(input_normalize) {
+    const GameInput *inputs = benchInputs();
+    for (uint32_t i = 0; i < iterations; i++) {
+        const GameInput &input = inputs[i & (INPUT_COUNT - 1)];
+        int moveX = joystickAxis(input.joyX);
+        int moveY = joystickAxis(input.joyY);
+        doNotOptimize(moveX);
+        doNotOptimize(moveY);
+    }
+}
+
+///////////////////////////////////////////////////////////////
+// Simulation
+///////////////////////////////////////////////////////////////
+BENCH(movement_step) {
+    const GameInput *inputs = benchInputs();
+    GameState state = benchState(false);
+    for (uint32_t i = 0; i < iterations; i++) {
+        uint8_t events = step(state, inputs[i & (INPUT_COUNT - 1)], 30);
+        doNotOptimize(events);
+    }
+    doNotOptimize(state);
+}
+
+BENCH(collision_check) {
+    const GameInput *inputs = benchInputs();
+    for (uint32_t i = 0; i < iterations; i++) {
+        const GameInput &a = inputs[i & (INPUT_COUNT - 1)];
+        const GameInput &b = inputs[(i + 1) & (INPUT_COUNT - 1)];
+        bool hit = dotsCollide(a.joyX >> 2, a.joyY >> 2, b.joyX >> 2, b.joyY >> 2);
+        doNotOptimize(hit);
+    }
+}
+
+BENCH(frame_step_with_remote) {
+    const GameInput *inputs = benchInputs();
+    GameState state = benchState(true);
+    for (uint32_t i = 0; i < iterations; i++) {
+        const GameInput &input = inputs[i & (INPUT_COUNT - 1)];
+        setRemotePosition(state, input.joyY >> 2, input.joyX >> 2);
+        uint8_t events = step(state, input, 30);
+        state.gameOver = false;  // Keep playing through collisions
+        doNotOptimize(events);
+    }
+    doNotOptimize(state);
+}
+
+///////////////////////////////////////////////////////////////
+// Packets
+///////////////////////////////////////////////////////////////
+BENCH(packet_encode) {
+    uint8_t frame[GAME_PACKET_SIZE];
+    for (uint32_t i = 0; i < iterations; i++) {
+        size_t length = encodePacket(makePositionPacket(i, i % 320, i % 240), frame);
+        doNotOptimize(length);
+        doNotOptimize(frame);
+    }
+}
+
+BENCH(packet_decode) {
+    uint8_t frames[INPUT_COUNT][GAME_PACKET_SIZE];
+    for (int i = 0; i < INPUT_COUNT; i++) {
+        encodePacket(makePositionPacket(i, i % 320, i % 240), frames[i]);
+    }
+    for (uint32_t i = 0; i < iterations; i++) {
+        GamePacket packet;
+        bool ok = decodePacket(frames[i & (INPUT_COUNT - 1)], GAME_PACKET_SIZE, packet);
+        doNotOptimize(ok);
+        doNotOptimize(packet);
+    }
+}
+
+// Arduino's String as the sketches used it: every String owns a heap
+// buffer, sized exactly and grown on concat (WString has no small-string
+// buffer, unlike std::string, which keeps these short strings inline)
+class LegacyString {
+public:
+    LegacyString(const char *text) : buffer(NULL), length(0) {
+        assign(text, strlen(text));
+    }
+    explicit LegacyString(int value) : buffer(NULL), length(0) {
+        char digits[12];
+        assign(digits, snprintf(digits, sizeof(digits), "%d", value));
+    }
+    LegacyString(const LegacyString &other) : buffer(NULL), length(0) {
+        assign(other.buffer, other.length);
+    }
+    ~LegacyString() {
+        delete[] buffer;
+    }
+
+    LegacyString &operator+=(const LegacyString &other) {
+        return concat(other.buffer, other.length);
+    }
+    LegacyString &operator+=(const char *text) {
+        return concat(text, strlen(text));
+    }
+    int indexOf(char c) const {
+        const char *found = strchr(buffer, c);
+        return found ? (int)(found - buffer) : -1;
+    }
+    LegacyString substring(int from, int to) const {
+        return LegacyString(buffer + from, to - from);
+    }
+    LegacyString substring(int from) const {
+        return substring(from, (int)length);
+    }
+    long toInt() const {
+        return atol(buffer);
+    }
+
+private:
+    LegacyString(const char *text, size_t textLength) : buffer(NULL), length(0) {
+        assign(text, textLength);
+    }
+    LegacyString &operator=(const LegacyString &);
+    LegacyString &concat(const char *text, size_t textLength) {
+        char *grown = new char[length + textLength + 1];  // realloc()
+        memcpy(grown, buffer, length);
+        memcpy(grown + length, text, textLength);
+        grown[length + textLength] = 0;
+        delete[] buffer;
+        buffer = grown;
+        length += textLength;
+        return *this;
+    }
+    void assign(const char *text, size_t textLength) {
+        char *copy = new char[textLength + 1];
+        memcpy(copy, text, textLength);
+        copy[textLength] = 0;
+        delete[] buffer;
+        buffer = copy;
+        length = textLength;
+    }
+    char *buffer;
+    size_t length;
+};
+
+// String + ..., which copies the left side into a temporary first (StringSumHelper)
+template <typename Right>
+inline LegacyString operator+(const LegacyString &left, const Right &right) {
+    LegacyString sum(left);
+    sum += right;
+    return sum;
+}
+
+// The old "X-Y" String protocol: String(x) + "-" + String(y), then indexOf/substring/toInt
+BENCH(packet_legacy_ascii) {
+    for (uint32_t i = 0; i < iterations; i++) {
+        LegacyString position = LegacyString((int)(i % 320)) + "-" + LegacyString((int)(i % 240));
+        int dashIndex = position.indexOf('-');
+        long x = position.substring(0, dashIndex).toInt();
+        long y = position.substring(dashIndex + 1).toInt();
+        doNotOptimize(x);
+        doNotOptimize(y);
+    }
+}
+
+///////////////////////////////////////////////////////////////
+// Render command generation
+///////////////////////////////////////////////////////////////
+
+// What M5.Lcd.printf() formats for the HUD every frame
+BENCH(render_hud_printf) {
+    char text[48];
+    for (uint32_t i = 0; i < iterations; i++) {
+        int length = snprintf(text, sizeof(text), "Time: %.2fs  Speed: %d", (i * 30) / 1000.0, (int)(i % 5) + 1);
+        doNotOptimize(length);
+        doNotOptimize(text);
+    }
+}
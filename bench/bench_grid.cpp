@@ -0,0 +1,118 @@
+#include "Bench.h"
+#include "Test.h"
+
+#include <GameCore.h>
+#include <SpatialGrid.h>
+
+///////////////////////////////////////////////////////////////
+// N-dot collision detection: all pairs with dotsCollide()
+// against the spatial grid, at 2, 16, 64 and 256 dots. One op
+// is one frame: every dot takes a small random step, then all
+// colliding pairs are found. grid_pairs checks that the grid
+// finds exactly the pairs brute force does.
+///////////////////////////////////////////////////////////////
+static const int GRID_BENCH_MAX = 256;
+
+struct Swarm {
+    int x[GRID_BENCH_MAX];
+    int y[GRID_BENCH_MAX];
+    int count;
+    uint32_t rng;
+
+    Swarm(int count) : count(count), rng(8675309) {
+        for (int i = 0; i < count; i++) {
+            x[i] = randomBetween(rng, 0, FIELD_MAX_X + 1);
+            y[i] = randomBetween(rng, 0, FIELD_MAX_Y + 1);
+        }
+    }
+
+    void move() {
+        for (int i = 0; i < count; i++) {
+            x[i] = clampInt(x[i] + randomBetween(rng, -MAX_SPEED, MAX_SPEED + 1), 0, FIELD_MAX_X);
+            y[i] = clampInt(y[i] + randomBetween(rng, -MAX_SPEED, MAX_SPEED + 1), 0, FIELD_MAX_Y);
+        }
+    }
+};
+
+// Order-independent fingerprint of a pair, summed over all pairs
+static uint64_t pairKey(int a, int b) {
+    uint32_t low = a < b ? a : b;
+    uint32_t high = a < b ? b : a;
+    return ((uint64_t)low << 32 | high) * 0x9E3779B97F4A7C15ULL;
+}
+
+static uint64_t brutePairs(const Swarm &swarm, uint32_t &pairs) {
+    uint64_t sum = 0;
+    for (int a = 0; a < swarm.count; a++) {
+        for (int b = a + 1; b < swarm.count; b++) {
+            if (dotsCollide(swarm.x[a], swarm.y[a], swarm.x[b], swarm.y[b])) {
+                pairs++;
+                sum += pairKey(a, b);
+            }
+        }
+    }
+    return sum;
+}
+
+struct PairCounter {
+    uint32_t *pairs;
+    uint64_t *sum;
+    bool operator()(uint16_t a, uint16_t b) {
+        (*pairs)++;
+        *sum += pairKey(a, b);
+        return false;
+    }
+};
+
+static uint64_t gridPairs(SpatialGrid<GRID_BENCH_MAX> &grid, const Swarm &swarm, uint32_t &pairs) {
+    grid.clear();
+    for (int i = 0; i < swarm.count; i++) grid.insert((uint16_t)i, swarm.x[i], swarm.y[i]);
+    uint64_t sum = 0;
+    PairCounter counter = { &pairs, &sum };
+    grid.forEachPair(counter);
+    return sum;
+}
+
+static void runBrute(int count, uint32_t iterations) {
+    Swarm swarm(count);
+    uint32_t pairs = 0;
+    for (uint32_t i = 0; i < iterations; i++) {
+        swarm.move();
+        doNotOptimize(brutePairs(swarm, pairs));
+    }
+    benchMetric("pairs/frame", (double)pairs / iterations);
+}
+
+static void runGrid(int count, uint32_t iterations) {
+    static SpatialGrid<GRID_BENCH_MAX> grid;
+    Swarm swarm(count);
+    uint32_t pairs = 0;
+    for (uint32_t i = 0; i < iterations; i++) {
+        swarm.move();
+        doNotOptimize(gridPairs(grid, swarm, pairs));
+    }
+    benchMetric("pairs/frame", (double)pairs / iterations);
+}
+
+BENCH(collide_brute_2) { runBrute(2, iterations); }
+BENCH(collide_grid_2) { runGrid(2, iterations); }
+BENCH(collide_brute_16) { runBrute(16, iterations); }
+BENCH(collide_grid_16) { runGrid(16, iterations); }
+BENCH(collide_brute_64) { runBrute(64, iterations); }
+BENCH(collide_grid_64) { runGrid(64, iterations); }
+BENCH(collide_brute_256) { runBrute(256, iterations); }
+BENCH(collide_grid_256) { runGrid(256, iterations); }
+
+TEST(grid_pairs) {
+    static SpatialGrid<GRID_BENCH_MAX> grid;
+    static const int COUNTS[] = { 2, 16, 64, 256 };
+    for (int c = 0; c < 4; c++) {
+        Swarm swarm(COUNTS[c]);
+        for (uint32_t i = 0; i < 2000; i++) {
+            swarm.move();
+            uint32_t brute = 0, gridded = 0;
+            bool same = brutePairs(swarm, brute) == gridPairs(grid, swarm, gridded) && brute == gridded;
+            CHECKF(same, "%d dots, frame %u: brute force %u pairs, grid %u", COUNTS[c], i, brute, gridded);
+        }
+    }
+}
@@ -0,0 +1,169 @@
+#include "Bench.h"
+#include "Test.h"
+
+#include <GameCore.h>
+#include <GameProtocol.h>
+#include <PositionHistory.h>
+#include <RemoteState.h>
+#include <RemoteTrack.h>
+
+#include <vector>
+
+///////////////////////////////////////////////////////////////
+// Lag-compensation history. history_rewind checks every answer
+// against the step that should have been returned.
+// history_rewind_latency runs a server and a client with skewed
+// clocks over fixed, uneven trips up and down, and checks that
+// the server rewinds to the very step the client had on screen
+// when it sent each position.
+///////////////////////////////////////////////////////////////
+BENCH(history_record) {
+    PositionHistory history;
+    GameState state;
+    resetGame(state, 3);
+    for (uint32_t i = 0; i < iterations; i++) {
+        state.local.x = i % 320;
+        history.record(i * 30, state);
+    }
+    doNotOptimize(history);
+}
+
+// Step n is recorded at 1000 + 30n with local.x = n
+static const int REWIND_STEPS = 100;
+
+static void recordSteps(PositionHistory &history) {
+    GameState state;
+    resetGame(state, 3);
+    for (int n = 0; n < REWIND_STEPS; n++) {
+        state.local.x = n;
+        history.record(1000 + 30 * n, state);
+    }
+}
+
+BENCH(history_rewind) {
+    PositionHistory history;
+    recordSteps(history);
+    uint32_t rng = 99;
+    for (uint32_t i = 0; i < iterations; i++) {
+        PositionRecord record;
+        bool found = history.rewind(1000 + randomBetween(rng, 0, 30 * REWIND_STEPS), record);
+        doNotOptimize(found);
+        doNotOptimize(record);
+    }
+}
+
+TEST(history_rewind) {
+    PositionHistory history;
+    recordSteps(history);
+    for (uint32_t timeMs = 900; timeMs < 1000 + 30 * REWIND_STEPS + 100; timeMs++) {
+        PositionRecord record = {};
+        if (!CHECKF(history.rewind(timeMs, record), "at %u ms", timeMs)) continue;
+
+        // Only the last POSITION_HISTORY_SIZE steps are kept
+        int expected = timeMs < 1000 ? 0 : (int)(timeMs - 1000) / 30;
+        if (expected < REWIND_STEPS - POSITION_HISTORY_SIZE) expected = REWIND_STEPS - POSITION_HISTORY_SIZE;
+        if (expected >= REWIND_STEPS) expected = REWIND_STEPS - 1;
+        CHECKF(record.localX == expected && record.timeMs == 1000 + 30 * (uint32_t)expected,
+               "at %u ms: step %d (%u ms), expected step %d", timeMs, record.localX, record.timeMs, expected);
+    }
+
+    PositionHistory empty;
+    PositionRecord record;
+    CHECK(!empty.rewind(1000, record));
+}
+
+// A frame on its way, due at arrivalMs on the receiver's clock
+struct LatencyFrame {
+    uint32_t arrivalMs;
+    uint8_t bytes[GAME_PACKET_SIZE];
+    size_t length;
+    int renderedX;  // Client positions: the server dot's x on the client's screen when sent
+};
+
+static void checkRewindLatency(uint32_t upMs, uint32_t downMs) {
+    const uint32_t START_MS = 65000;  // The 16-bit timestamps wrap early on
+    const uint32_t SKEW_MS = 123457;  // Client clock minus server clock
+    const uint32_t DELAY_MS = 150;    // Both sides' render delay
+    // Client frames land where its render time falls on a server step
+    const uint32_t phase = (downMs + DELAY_MS) % 30;
+
+    PositionHistory history;
+    GameState game;
+    resetGame(game, 5);
+    RemoteTrack clientView(DELAY_MS), serverView(DELAY_MS);
+    RemoteState clientState = {};
+    std::vector<LatencyFrame> down, up;
+    uint32_t lastClockMs = 0;
+    int checked = 0;
+
+    for (uint32_t t = START_MS; t < START_MS + 6000; t++) {
+        uint32_t clientMs = t + SKEW_MS;
+
+        // Server: step, record, send a WORLD-like frame with our dot
+        if ((t - START_MS) % 30 == 0) {
+            game.local.x = (int)(t - START_MS) / 30;
+            history.record(t, game);
+            LatencyFrame frame = { clientMs + downMs, {}, 0, 0 };
+            frame.length = encodePacket(makePositionPacket(0, (uint16_t)game.local.x, 0, 0, (uint16_t)t), frame.bytes);
+            down.push_back(frame);
+        }
+
+        // Client: take what arrived, draw, send what it drew and now and then its clock offset
+        for (size_t i = 0; i < down.size();) {
+            GamePacket packet;
+            if (down[i].arrivalMs > clientMs) {
+                i++;
+                continue;
+            }
+            if (decodePacket(down[i].bytes, down[i].length, packet)) {
+                clientView.add(packet.timeMs, clientMs, packet.x, packet.y, false);
+            }
+            down.erase(down.begin() + i);
+        }
+        int x, y;
+        if ((t - START_MS) % 30 == phase && clientView.position(clientMs, x, y)) {
+            LatencyFrame frame = { t + upMs, {}, 0, x };
+            frame.length = encodePacket(makePositionPacket(0, 100, 100, 0, (uint16_t)clientMs), frame.bytes);
+            up.push_back(frame);
+            if (clientMs - lastClockMs >= 1000) {
+                lastClockMs = clientMs;
+                LatencyFrame clock = { t + upMs, {}, 0, 0 };
+                clock.length = encodePacket(makeClockPacket(1, clientView.clockOffset()), clock.bytes);
+                up.push_back(clock);
+            }
+        }
+
+        // Server: rewind each position to where our dot was on the client's screen
+        for (size_t i = 0; i < up.size();) {
+            GamePacket packet;
+            if (up[i].arrivalMs > t) {
+                i++;
+                continue;
+            }
+            if (decodePacket(up[i].bytes, up[i].length, packet)) {
+                applyPacket(clientState, packet, t);
+                if (packet.type == PACKET_TYPE_POSITION) {
+                    serverView.add(packet.timeMs, t, packet.x, packet.y, false);
+                }
+                PositionRecord seen = {};
+                if (packet.type == PACKET_TYPE_POSITION && clientState.clockCount > 0) {
+                    uint32_t roundTrip = roundTripMs(serverView.clockOffset(), clientState.clockOffsetMs);
+                    CHECKF(roundTrip == upMs + downMs, "up %u, down %u: round trip %u", upMs, downMs, roundTrip);
+                    history.rewind(rewindTimeMs(serverView.toLocalMs(packet.timeMs), roundTrip, DELAY_MS), seen);
+                    CHECKF(seen.localX == up[i].renderedX, "up %u, down %u, at %u ms: rewound to %d, client drew %d",
+                           upMs, downMs, t, seen.localX, up[i].renderedX);
+                    checked++;
+                }
+            }
+            up.erase(up.begin() + i);
+        }
+    }
+    CHECKF(checked > 100, "up %u, down %u: %d positions checked", upMs, downMs, checked);
+}
+
+TEST(history_rewind_latency) {
+    checkRewindLatency(20, 70);
+    checkRewindLatency(70, 20);
+    checkRewindLatency(5, 120);
+    checkRewindLatency(45, 45);
+}
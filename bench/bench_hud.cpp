@@ -0,0 +1,122 @@
+#include "Bench.h"
+#include "Test.h"
+#include "CountingSurface.h"
+
+#include <FrameCompositor.h>
+#include <GameRender.h>
+#include <HudText.h>
+#include <stdio.h>
+
+///////////////////////////////////////////////////////////////
+// HUD text: integer formatting against snprintf, and the
+// renderer's per-character redraw with cached digit glyphs.
+//
+// hud_format checks formatGameHud() matches "%.2f" (away from
+// exact .xx5 halves, where the double rounding of ms / 1000.0
+// differs from ours). hud_redraw checks that drawing the HUD
+// frame by frame leaves the same pixels as redrawing all of it
+// and that each digit is rendered once; hud_cost that a frame
+// where only the hundredths change pushes one glyph and no
+// text.
+///////////////////////////////////////////////////////////////
+static void hudFrame(RenderFrame &frame, uint32_t elapsedMs, int speed) {
+    frame.dotCount = 0;
+    frame.hudX = 5;
+    frame.hudY = 5;
+    frame.hudSize = 1;
+    formatGameHud(frame.hud, elapsedMs, speed);
+}
+
+TEST(hud_format) {
+    static const uint32_t STARTS[] = { 0, 9990, 99990, 4294967000UL };
+    for (int s = 0; s < 4; s++) {
+        for (uint32_t i = 0; i < 20000; i++) {
+            uint32_t ms = STARTS[s] + i;
+            if (ms < STARTS[s] || ms % 10 == 5) continue;
+            char expected[HUD_MAX_CHARS + 1];
+            char actual[HUD_MAX_CHARS + 1];
+            int speed = (int)(i % 7);
+            snprintf(expected, sizeof(expected), "Time: %.2fs  Speed: %d", ms / 1000.0, speed);
+            formatGameHud(actual, ms, speed);
+            CHECKF(strcmp(expected, actual) == 0, "\"%s\", expected \"%s\"", actual, expected);
+        }
+    }
+}
+
+static bool sameHudPixels(const MemorySurface &a, const MemorySurface &b) {
+    for (int y = 0; y < 5 + FONT_CHAR_HEIGHT; y++) {
+        for (int x = 0; x < 5 + HUD_MAX_CHARS * FONT_CHAR_WIDTH; x++) {
+            if (a.pixelAt(x, y) != b.pixelAt(x, y)) return false;
+        }
+    }
+    return true;
+}
+
+TEST(hud_redraw) {
+    MemorySurface incremental, full;
+    if (!CHECK(incremental.begin() && full.begin())) return;
+    DirtyRenderer renderer(incremental);
+    DirtyRenderer reference(full);
+
+    RenderFrame frame;
+    uint32_t ms = 9000;
+    int speed = 1;
+    for (uint32_t i = 0; i < 2000; i++) {
+        // Through 9.99 -> 10.00 (the text grows), speed changes and new rounds
+        ms += 30;
+        if (i % 50 == 49) speed = speed % MAX_SPEED + 1;
+        if (i % 200 == 199) ms = 0;
+
+        hudFrame(frame, ms, speed);
+        renderer.render(frame);
+        reference.invalidate();
+        reference.render(frame);
+        CHECKF(sameHudPixels(incremental, full), "frame %u: \"%s\"", i, frame.hud);
+    }
+    CHECKF(renderer.glyphCache().renders() <= 10, "%u glyph renders", (unsigned)renderer.glyphCache().renders());
+}
+
+TEST(hud_cost) {
+    CountingSurface lcd;
+    DirtyRenderer renderer(lcd);
+    RenderFrame frame;
+    hudFrame(frame, 1230, 1);
+    renderer.render(frame);
+
+    uint64_t pixels = lcd.pixels, textCalls = lcd.textCalls;
+    hudFrame(frame, 1240, 1);  // "1.23" -> "1.24"
+    renderer.render(frame);
+    CHECKF(lcd.pixels - pixels == (uint64_t)(FONT_CHAR_WIDTH * FONT_CHAR_HEIGHT), "%llu pixels",
+           (unsigned long long)(lcd.pixels - pixels));
+    CHECK(lcd.textCalls == textCalls);
+
+    pixels = lcd.pixels;
+    renderer.render(frame);  // Nothing changed
+    CHECK(lcd.pixels == pixels);
+}
+
+///////////////////////////////////////////////////////////////
+// Cost per frame
+///////////////////////////////////////////////////////////////
+// Against render_hud_printf (bench_game.cpp)
+BENCH(render_hud_format) {
+    char text[HUD_MAX_CHARS + 1];
+    for (uint32_t i = 0; i < iterations; i++) {
+        formatGameHud(text, i * 30, (int)(i % 5) + 1);
+        doNotOptimize(text);
+    }
+}
+
+// A HUD-only frame every 30 ms through DirtyRenderer. Digits are
+// pushed from the glyph cache; drawText() is only left for the
+// rare frames where the text shifts (9.99 -> 10.00).
+BENCH(hud_redraw) {
+    CountingSurface lcd;
+    DirtyRenderer renderer(lcd);
+    RenderFrame frame;
+    for (uint32_t i = 0; i < iterations; i++) {
+        hudFrame(frame, i * 30, 3);
+        renderer.render(frame);
+    }
+    benchMetric("drawText calls/frame", (double)lcd.textCalls / iterations);
+}
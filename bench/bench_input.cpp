@@ -0,0 +1,243 @@
+#include "Bench.h"
+#include "Test.h"
+#include "FakeSeesaw.h"
+
+#include <GameCore.h>
+#include <InputSnapshot.h>
+#include <SpscRing.h>
+
+///////////////////////////////////////////////////////////////
+// Gamepad sampling benchmarks against a transaction-counting
+// fake seesaw. Each reports seesaw transactions per frame.
+//
+// The input_interrupt tests script the INT line and the
+// buttons around InterruptSampler and check the edges every
+// poll reports: nothing and no button reads while idle, a press
+// and a release, a tap that bounced back before the poll
+// (pressed and released), a release + press of a held button, a
+// press that lands in the middle of a sample (reported once, on
+// this poll or the next, never lost and never doubled) and the
+// joystick read only every joystickPeriodMs.
+// input_interrupt_tap_step runs a bounced START tap from the
+// sampler through the input ring and step(), and checks the
+// speed goes up once.
+///////////////////////////////////////////////////////////////
+static void wiggle(FakeSeesaw &gamepad, uint32_t frameIndex) {
+    gamepad.joyX = (frameIndex * 37) & 1023;
+    gamepad.joyY = (frameIndex * 91) & 1023;
+    gamepad.setButton(GAME_BUTTON_START, frameIndex % 20 < 3);
+    gamepad.setButton(GAME_BUTTON_SELECT, frameIndex % 50 < 2);
+}
+
+// The original sketches: an unused bulk read, two ADC reads and two digitalRead()s
+BENCH(input_sample_legacy) {
+    FakeSeesaw gamepad;
+    for (uint32_t i = 0; i < iterations; i++) {
+        wiggle(gamepad, i);
+        uint32_t buttons = gamepad.digitalReadBulk(0xFFFF);
+        int joyX = 1023 - gamepad.analogRead(JOYSTICK_X_PIN);
+        int joyY = 1023 - gamepad.analogRead(JOYSTICK_Y_PIN);
+        bool start = !gamepad.digitalRead(16);
+        bool select = !gamepad.digitalRead(0);
+        doNotOptimize(buttons);
+        doNotOptimize(joyX + joyY + start + select);
+    }
+    benchMetric("transactions/frame", (double)gamepad.transactions / iterations);
+}
+
+BENCH(input_sample_snapshot) {
+    FakeSeesaw gamepad;
+    InputSampler<FakeSeesaw> sampler(gamepad);
+    for (uint32_t i = 0; i < iterations; i++) {
+        wiggle(gamepad, i);
+        InputSnapshot snapshot = sampler.sample(i * 30);
+        doNotOptimize(snapshot);
+    }
+    benchMetric("transactions/frame", (double)gamepad.transactions / iterations);
+}
+
+typedef InterruptSampler<FakeSeesaw> FakeInterruptSampler;
+
+// Holds or releases mask between polls, firing INT if it changed
+static void change(FakeSeesaw &gamepad, FakeInterruptSampler &sampler, uint32_t mask, bool held) {
+    if (gamepad.setButton(mask, held)) sampler.onInterrupt();
+}
+
+// The same, right before the gamepad's transaction number `at` (in the middle of a poll)
+struct MidSampleChange : public FakeSeesawScript {
+    MidSampleChange(FakeInterruptSampler &sampler, uint64_t at, uint32_t mask, bool held)
+        : sampler(sampler), at(at), mask(mask), held(held) {}
+    void beforeTransaction(FakeSeesaw &gamepad) {
+        if (gamepad.transactions == at) change(gamepad, sampler, mask, held);
+    }
+    FakeInterruptSampler &sampler;
+    uint64_t at;
+    uint32_t mask;
+    bool held;
+};
+
+static void expectPoll(FakeInterruptSampler &sampler, uint32_t nowMs, uint32_t pressed, uint32_t released,
+                       uint32_t held) {
+    InputSnapshot snapshot = sampler.poll(nowMs);
+    CHECKF(snapshot.pressed == pressed && snapshot.released == released && snapshot.input.buttons == held,
+           "poll at %u ms: pressed 0x%x released 0x%x held 0x%x, expected 0x%x 0x%x 0x%x", nowMs, snapshot.pressed,
+           snapshot.released, snapshot.input.buttons, pressed, released, held);
+}
+
+// A poll reads the INT flags, then the buttons, then the joystick
+static const uint64_t FLAGS_READ = 0, BUTTONS_READ = 1, JOYSTICK_READ = 2;
+
+// A change between `step` of one poll and the same step of the next is reported once
+static void checkMidSample(uint64_t step, bool pressing) {
+    const uint32_t START = GAME_BUTTON_START, SELECT = GAME_BUTTON_SELECT;
+    FakeSeesaw gamepad;
+    FakeInterruptSampler sampler(gamepad, 30);
+    if (!pressing) change(gamepad, sampler, START, true);
+    expectPoll(sampler, 0, pressing ? 0 : START, 0, pressing ? 0 : START);
+
+    // SELECT fires INT, START changes during the poll that handles it
+    change(gamepad, sampler, SELECT, true);
+    MidSampleChange script(sampler, gamepad.transactions + step, START, pressing);
+    gamepad.script = &script;
+    InputSnapshot first = sampler.poll(30);
+    InputSnapshot second = sampler.poll(60);
+    gamepad.script = NULL;
+    uint32_t startHeld = pressing ? START : 0;
+
+    const char *what = pressing ? "press" : "release";
+    CHECKF((first.pressed & SELECT) != 0 && (first.input.buttons & SELECT) != 0, "%s at step %u",
+           what, (unsigned)step);
+    uint32_t edges = pressing ? (first.pressed | second.pressed) : (first.released | second.released);
+    uint32_t wrongEdges = pressing ? (first.released | second.released) : (first.pressed | second.pressed);
+    CHECKF((edges & START) != 0, "%s at step %u lost", what, (unsigned)step);
+    CHECKF((wrongEdges & START) == 0, "%s at step %u: opposite edge", what, (unsigned)step);
+    CHECKF(((first.pressed | first.released) & (second.pressed | second.released) & START) == 0,
+           "%s at step %u reported twice", what, (unsigned)step);
+    CHECKF((second.input.buttons & START) == startHeld, "%s at step %u", what, (unsigned)step);
+    expectPoll(sampler, 90, 0, 0, SELECT | startHeld);
+}
+
+// Idle: the first poll reads the buttons, later ones only the joystick
+TEST(input_interrupt_idle) {
+    FakeSeesaw gamepad;
+    FakeInterruptSampler sampler(gamepad, 30);
+    for (uint32_t i = 0; i < 10; i++) expectPoll(sampler, i * 30, 0, 0, 0);
+    CHECKF(gamepad.bulkReads == 1 && gamepad.analogReads == 20, "%llu button reads, %llu joystick reads",
+           (unsigned long long)gamepad.bulkReads, (unsigned long long)gamepad.analogReads);
+}
+
+TEST(input_interrupt_edges) {
+    const uint32_t START = GAME_BUTTON_START, SELECT = GAME_BUTTON_SELECT;
+
+    // Press, hold, release
+    {
+        FakeSeesaw gamepad;
+        FakeInterruptSampler sampler(gamepad, 30);
+        expectPoll(sampler, 0, 0, 0, 0);
+        change(gamepad, sampler, START, true);
+        expectPoll(sampler, 30, START, 0, START);
+        expectPoll(sampler, 60, 0, 0, START);
+        change(gamepad, sampler, START, false);
+        expectPoll(sampler, 90, 0, START, 0);
+        CHECK(gamepad.bulkReads == 3);
+    }
+
+    // A tap that is over before the poll, and a held button let go and pressed again
+    {
+        FakeSeesaw gamepad;
+        FakeInterruptSampler sampler(gamepad, 30);
+        expectPoll(sampler, 0, 0, 0, 0);
+        change(gamepad, sampler, START, true);
+        change(gamepad, sampler, START, false);
+        expectPoll(sampler, 30, START, START, 0);
+        expectPoll(sampler, 60, 0, 0, 0);
+
+        change(gamepad, sampler, SELECT, true);
+        expectPoll(sampler, 90, SELECT, 0, SELECT);
+        change(gamepad, sampler, SELECT, false);
+        change(gamepad, sampler, SELECT, true);
+        change(gamepad, sampler, START, true);
+        expectPoll(sampler, 120, START | SELECT, SELECT, START | SELECT);
+        expectPoll(sampler, 150, 0, 0, START | SELECT);
+    }
+}
+
+// INT firing in the middle of a sample, before and after each read
+TEST(input_interrupt_mid_sample) {
+    for (uint64_t step = FLAGS_READ; step <= JOYSTICK_READ + 1; step++) {
+        checkMidSample(step, true);
+        checkMidSample(step, false);
+    }
+}
+
+// The joystick every joystickPeriodMs (and on the first poll), not every poll
+TEST(input_interrupt_joystick) {
+    FakeSeesaw gamepad;
+    FakeInterruptSampler sampler(gamepad, 90);
+    for (uint32_t i = 0; i < 30; i++) {
+        gamepad.joyX = (uint16_t)(i * 10);
+        InputSnapshot snapshot = sampler.poll(i * 30);
+        CHECKF(snapshot.input.joyX == 1023 - (int)(i / 3) * 30, "poll %u: joyX %d", i, snapshot.input.joyX);
+    }
+    CHECK(gamepad.analogReads == 2 * 10);
+}
+
+// The sketches' input path: poll every 10 ms into the ring, drain and step every 30 ms
+TEST(input_interrupt_tap_step) {
+    FakeSeesaw gamepad;
+    FakeInterruptSampler sampler(gamepad, 30);
+    SpscRing<InputSnapshot, 16> ring;
+    InputSnapshot latest = {};
+    GameState game;
+    resetGame(game, 1);
+    int speed = game.local.speed;
+
+    uint8_t events = 0;
+    for (uint32_t nowMs = 0; nowMs < 300; nowMs += 10) {
+        if (nowMs == 120) {
+            // Pressed and bounced back up before the next poll
+            change(gamepad, sampler, GAME_BUTTON_START, true);
+            change(gamepad, sampler, GAME_BUTTON_START, false);
+        }
+        ring.push(sampler.poll(nowMs));
+        if (nowMs % 30 == 20) {
+            drainInput(ring, latest);
+            events |= step(game, latest, 30);
+            CHECKF(latest.input.buttons == 0, "%u ms: held 0x%x", nowMs, latest.input.buttons);
+        }
+    }
+    CHECK(events & STEP_SPEED_CHANGED);
+    CHECKF(game.local.speed == speed % MAX_SPEED + 1, "speed %d -> %d", speed, game.local.speed);
+}
+
+// Scripted interrupt source: the INT line fires only when wiggle() changes a button
+BENCH(input_sample_interrupt) {
+    FakeSeesaw gamepad;
+    InterruptSampler<FakeSeesaw> sampler(gamepad, 30);
+    for (uint32_t i = 0; i < iterations; i++) {
+        gamepad.joyX = (i * 37) & 1023;
+        gamepad.joyY = (i * 91) & 1023;
+        bool fired = gamepad.setButton(GAME_BUTTON_START, i % 20 < 3);
+        fired |= gamepad.setButton(GAME_BUTTON_SELECT, i % 50 < 2);
+        if (fired) sampler.onInterrupt();
+
+        InputSnapshot snapshot = sampler.poll(i * 30);
+        doNotOptimize(snapshot);
+    }
+    benchMetric("transactions/frame", (double)gamepad.transactions / iterations);
+}
+
+// Same, but the joystick is only read every third frame
+BENCH(input_sample_interrupt_slow_joystick) {
+    FakeSeesaw gamepad;
+    InterruptSampler<FakeSeesaw> sampler(gamepad, 90);
+    for (uint32_t i = 0; i < iterations; i++) {
+        gamepad.joyX = (i * 37) & 1023;
+        bool fired = gamepad.setButton(GAME_BUTTON_START, i % 20 < 3);
+        if (fired) sampler.onInterrupt();
+
+        InputSnapshot snapshot = sampler.poll(i * 30);
+        doNotOptimize(snapshot);
+    }
+    benchMetric("transactions/frame", (double)gamepad.transactions / iterations);
+}
@@ -0,0 +1,80 @@
+#include "Bench.h"
+#include "Test.h"
+
+#include <GameCore.h>
+#include <LinkProfile.h>
+
+///////////////////////////////////////////////////////////////
+// Connection profile switching against a fake BLE stack. A
+// scripted session connects, waits in the lobby, then plays
+// rounds separated by game over screens of random length (some
+// shorter than the settle time), reconnecting every 20 rounds.
+// link_profile checks it is on low latency while playing, never
+// asks for the battery profile during a quick restart and asks
+// for the MTU once per connection.
+///////////////////////////////////////////////////////////////
+struct FakeLinkStack {
+    FakeLinkStack() : current(NULL), paramRequests(0), mtuRequests(0) {}
+
+    bool requestConnectionParams(const ConnectionProfile &profile) {
+        current = &profile;
+        paramRequests++;
+        return true;
+    }
+
+    bool requestMtu(uint16_t mtu) {
+        mtuRequests++;
+        return mtu == LINK_MTU;
+    }
+
+    const ConnectionProfile *current;
+    uint32_t paramRequests;
+    uint32_t mtuRequests;
+};
+
+static const uint32_t LINK_SETTLE_MS = 1000;
+
+// Returns the connection parameter requests made
+static uint32_t runSession(uint32_t rounds) {
+    FakeLinkStack stack;
+    LinkProfileManager<FakeLinkStack> manager(stack, LINK_SETTLE_MS);
+    uint32_t rng = 4242;
+    uint32_t now = 0;
+    uint32_t connectionMtuRequests = 0;
+
+    for (uint32_t round = 0; round < rounds; round++) {
+        if (round % 20 == 0) {
+            if (round > 0) {
+                CHECKF(stack.mtuRequests - connectionMtuRequests == 1, "round %u: %u MTU requests", round,
+                       stack.mtuRequests - connectionMtuRequests);
+            }
+            connectionMtuRequests = stack.mtuRequests;
+            manager.onConnect(now);
+            for (uint32_t end = now + 500; now < end; now += 30) manager.update(LINK_LOBBY, now);
+        }
+
+        for (uint32_t end = now + 3000; now < end; now += 30) {
+            manager.update(LINK_PLAYING, now);
+            // The MTU request takes the first update after connecting
+            if (manager.requestedProfile()) {
+                CHECKF(stack.current == &PROFILE_LOW_LATENCY, "round %u at %u ms: not low latency", round, now);
+            }
+        }
+
+        uint32_t gameOverMs = randomBetween(rng, 200, 3000);
+        uint32_t before = stack.paramRequests;
+        for (uint32_t end = now + gameOverMs; now < end; now += 30) manager.update(LINK_GAME_OVER, now);
+        if (gameOverMs + 30 < LINK_SETTLE_MS) {
+            CHECKF(stack.paramRequests == before, "round %u: %u ms game over changed the profile", round, gameOverMs);
+        }
+    }
+    return stack.paramRequests;
+}
+
+TEST(link_profile) {
+    runSession(2000);
+}
+
+BENCH(link_profile_requests) {
+    benchMetric("param requests/round", (double)runSession(iterations) / iterations);
+}
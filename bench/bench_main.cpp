@@ -0,0 +1,177 @@
+#include "Bench.h"
+#include "Test.h"
+
+#include <chrono>
+#include <new>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+///////////////////////////////////////////////////////////////
+// Allocation counting
+///////////////////////////////////////////////////////////////
+static uint64_t allocationCount = 0;
+
+void *operator new(size_t size) {
+    allocationCount++;
+    void *ptr = malloc(size ? size : 1);
+    if (!ptr) throw std::bad_alloc();
+    return ptr;
+}
+
+void *operator new[](size_t size) {
+    allocationCount++;
+    void *ptr = malloc(size ? size : 1);
+    if (!ptr) throw std::bad_alloc();
+    return ptr;
+}
+
+void operator delete(void *ptr) noexcept { free(ptr); }
+void operator delete[](void *ptr) noexcept { free(ptr); }
+void operator delete(void *ptr, size_t) noexcept { free(ptr); }
+void operator delete[](void *ptr, size_t) noexcept { free(ptr); }
+
+uint64_t benchAllocations() {
+    return allocationCount;
+}
+
+static const char *metricLabel = NULL;
+static double metricValue = 0;
+
+void benchMetric(const char *label, double perOp) {
+    metricLabel = label;
+    metricValue = perOp;
+}
+
+BenchEntry *&benchRegistry() {
+    static BenchEntry *head = NULL;
+    return head;
+}
+
+///////////////////////////////////////////////////////////////
+// Runner
+///////////////////////////////////////////////////////////////
+static const double TARGET_NS = 100e6;  // Aim for ~100 ms per benchmark
+
+static double timeRun(BenchFunction function, uint32_t iterations) {
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    function(iterations);
+    std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+    return (double)std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+}
+
+static void runBenchmark(const BenchEntry &bench) {
+    // Warm up, then grow the iteration count until a run is long enough to trust
+    uint32_t iterations = 1;
+    double elapsedNs = timeRun(bench.function, iterations);
+    while (elapsedNs < TARGET_NS / 10 && iterations < (1u << 30)) {
+        iterations *= 10;
+        elapsedNs = timeRun(bench.function, iterations);
+    }
+    if (elapsedNs > 0 && elapsedNs < TARGET_NS) {
+        double scaled = iterations * (TARGET_NS / elapsedNs);
+        iterations = scaled > (1u << 30) ? (1u << 30) : (uint32_t)scaled;
+    }
+
+    metricLabel = NULL;
+    uint64_t allocationsBefore = benchAllocations();
+    elapsedNs = timeRun(bench.function, iterations);
+    uint64_t allocations = benchAllocations() - allocationsBefore;
+
+    printf("%-36s %12u %12.2f %12.3f\n", bench.name, iterations,
+           elapsedNs / iterations, (double)allocations / iterations);
+    if (metricLabel) printf("    %s: %.1f\n", metricLabel, metricValue);
+}
+
+///////////////////////////////////////////////////////////////
+// Test runner
+///////////////////////////////////////////////////////////////
+static const int TEST_PRINTED_FAILURES = 10;  // Per test; the rest are only counted
+
+static const TestEntry *currentTest = NULL;
+static uint32_t testFailures = 0;
+
+TestEntry *&testRegistry() {
+    static TestEntry *head = NULL;
+    return head;
+}
+
+static const char *baseName(const char *path) {
+    const char *slash = strrchr(path, '/');
+    return slash ? slash + 1 : path;
+}
+
+// Counts a failed check; true if it is one of the few printed in full
+static bool printFailure(const char *file, int line, const char *condition) {
+    if (!currentTest) return false;
+    if (testFailures++ == 0) printf("%-36s FAILED\n", currentTest->name);
+    if (testFailures > (uint32_t)TEST_PRINTED_FAILURES) return false;
+    printf("    %s:%d: %s", baseName(file), line, condition);
+    return true;
+}
+
+bool testCheck(bool ok, const char *file, int line, const char *condition) {
+    if (!ok && printFailure(file, line, condition)) printf("\n");
+    return ok;
+}
+
+bool testCheckf(bool ok, const char *file, int line, const char *condition, const char *format, ...) {
+    if (!ok && printFailure(file, line, condition)) {
+        va_list args;
+        va_start(args, format);
+        printf(" [");
+        vprintf(format, args);
+        printf("]\n");
+        va_end(args);
+    }
+    return ok;
+}
+
+// False if any check failed
+static bool runTest(const TestEntry &test) {
+    currentTest = &test;
+    testFailures = 0;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    test.function();
+    std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+    currentTest = NULL;
+
+    if (testFailures == 0) {
+        printf("%-36s ok %8.1f ms\n", test.name,
+               std::chrono::duration_cast<std::chrono::microseconds>(end - start).count() / 1000.0);
+        return true;
+    }
+    if (testFailures > (uint32_t)TEST_PRINTED_FAILURES) {
+        printf("    ... %u more\n", testFailures - TEST_PRINTED_FAILURES);
+    }
+    return false;
+}
+
+///////////////////////////////////////////////////////////////
+// Usage: program [filter]       benchmarks (timing only)
+//        program test [filter]  tests, each run once
+// Runs every benchmark or test whose name contains filter (all
+// if none). The test run exits with 1 if any test failed.
+///////////////////////////////////////////////////////////////
+int main(int argc, char **argv) {
+    if (argc > 1 && strcmp(argv[1], "test") == 0) {
+        const char *filter = argc > 2 ? argv[2] : NULL;
+        int ran = 0, failed = 0;
+        for (TestEntry *test = testRegistry(); test; test = test->next) {
+            if (filter && !strstr(test->name, filter)) continue;
+            ran++;
+            if (!runTest(*test)) failed++;
+        }
+        printf("%d test(s), %d failed\n", ran, failed);
+        return failed ? 1 : 0;
+    }
+
+    const char *filter = argc > 1 ? argv[1] : NULL;
+    printf("%-36s %12s %12s %12s\n", "benchmark", "iterations", "ns/op", "allocs/op");
+    for (BenchEntry *bench = benchRegistry(); bench; bench = bench->next) {
+        if (filter && !strstr(bench->name, filter)) continue;
+        runBenchmark(*bench);
+    }
+    return 0;
+}
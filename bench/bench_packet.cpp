@@ -0,0 +1,172 @@
+#include "Test.h"
+
+#include <GameCore.h>
+#include <GameProtocol.h>
+#include <string.h>
+
+///////////////////////////////////////////////////////////////
+// The GamePacket codec on its own.
+//
+// packet_round_trip round-trips every on-screen POSITION,
+// every seq/flags pair, CONNECTED, GAMEOVER and CLOCK words
+// across their whole range and every DELTA move. packet_rejects checks
+// the frames decode rejects (NULL, wrong lengths, unknown types,
+// positions off the field) leave the packet untouched.
+// packet_fuzz feeds decode random bytes of random lengths and
+// compares its verdict with the format spelled out in
+// GameProtocol.h; anything accepted must encode back to the
+// same bytes.
+///////////////////////////////////////////////////////////////
+static bool samePacket(const GamePacket &a, const GamePacket &b) {
+    return a.type == b.type && a.seq == b.seq && a.x == b.x && a.y == b.y && a.flags == b.flags &&
+           a.timeMs == b.timeMs;
+}
+
+// Encode, decode, and compare both the packet and the frame length
+static void checkRoundTrip(const GamePacket &packet, size_t expectedLength) {
+    uint8_t frame[GAME_PACKET_SIZE];
+    size_t length = encodePacket(packet, frame);
+    GamePacket decoded;
+    bool ok = length == expectedLength && decodePacket(frame, length, decoded) && samePacket(decoded, packet);
+    CHECKF(ok, "type %u seq %u x %u y %u flags %u time %u", packet.type, packet.seq, packet.x, packet.y,
+           packet.flags, packet.timeMs);
+}
+
+static const GamePacket UNTOUCHED = { 0xEE, 0xEE, 0xEEEE, 0xEEEE, 0xEE, 0xEEEE };
+
+// Decode must say no and leave the packet alone
+static void checkRejected(const uint8_t *frame, size_t length) {
+    GamePacket packet = UNTOUCHED;
+    bool accepted = decodePacket(frame, length, packet);
+    CHECKF(!accepted && samePacket(packet, UNTOUCHED), "type 0x%02x length %u", length ? frame[0] : 0,
+           (unsigned)length);
+}
+
+TEST(packet_round_trip) {
+    // Every on-screen position, and every seq/flags pair
+    for (uint16_t y = 0; y < PACKET_MAX_Y; y++) {
+        for (uint16_t x = 0; x < PACKET_MAX_X; x++) {
+            checkRoundTrip(makePositionPacket(x ^ y, x, y, y, x * 205 + y), GAME_PACKET_SIZE);
+        }
+    }
+    for (int seq = 0; seq < 256; seq++) {
+        for (int flags = 0; flags < 256; flags++) {
+            checkRoundTrip(makePositionPacket(seq, PACKET_MAX_X - 1, PACKET_MAX_Y - 1, flags, 0xFFFF),
+                           GAME_PACKET_SIZE);
+        }
+    }
+
+    // CONNECTED and GAMEOVER use the whole words
+    for (uint32_t word = 0; word <= 0xFFFF; word += 0xFF) {
+        GamePacket connected = makeConnectedPacket(word, word & 0xFF);
+        connected.y = word;
+        connected.timeMs = ~word;
+        checkRoundTrip(connected, GAME_PACKET_SIZE);
+        GamePacket gameOver = makeGameOverPacket(word, word * 0x10001UL);
+        checkRoundTrip(gameOver, GAME_PACKET_SIZE);
+        CHECKF(packetElapsedMs(gameOver) == word * 0x10001UL, "word 0x%04x", word);
+        GamePacket clock = makeClockPacket(word, (int32_t)(word * 0x10001UL));
+        checkRoundTrip(clock, GAME_PACKET_SIZE);
+        CHECKF(packetClockOffsetMs(clock) == (int32_t)(word * 0x10001UL), "word 0x%04x", word);
+    }
+
+    // Every DELTA move, against every keyframe
+    for (int dx = -128; dx < 128; dx++) {
+        for (int dy = -128; dy < 128; dy++) {
+            GamePacket delta = makeDeltaPacket(dx + dy, dx ^ dy, dx, dy, dx * 256 + dy);
+            checkRoundTrip(delta, GAME_DELTA_PACKET_SIZE);
+            CHECKF(packetDeltaX(delta) == dx && packetDeltaY(delta) == dy &&
+                   packetDeltaBase(delta) == (uint8_t)(dx ^ dy), "dx %d dy %d", dx, dy);
+        }
+    }
+}
+
+TEST(packet_rejects) {
+    uint8_t frame[GAME_PACKET_SIZE + 4] = {};
+    GamePacket packet = UNTOUCHED;
+    CHECK(!decodePacket(NULL, GAME_PACKET_SIZE, packet) && samePacket(packet, UNTOUCHED));
+
+    // Wrong lengths for every type, short and long
+    const uint8_t types[] = { PACKET_TYPE_POSITION, PACKET_TYPE_CONNECTED, PACKET_TYPE_GAMEOVER, PACKET_TYPE_DELTA,
+                              PACKET_TYPE_CLOCK };
+    for (size_t t = 0; t < sizeof(types); t++) {
+        size_t valid = types[t] == PACKET_TYPE_DELTA ? GAME_DELTA_PACKET_SIZE : GAME_PACKET_SIZE;
+        encodePacket(makePositionPacket(1, 10, 20), frame);
+        frame[0] = types[t];
+        for (size_t length = 0; length < sizeof(frame); length++) {
+            if (length != valid) checkRejected(frame, length);
+        }
+    }
+
+    // Unknown types, WORLD included (it has its own codec)
+    for (int type = 0; type < 256; type++) {
+        if ((type >= PACKET_TYPE_POSITION && type <= PACKET_TYPE_DELTA) || type == PACKET_TYPE_CLOCK) continue;
+        encodePacket(makePositionPacket(1, 10, 20), frame);
+        frame[0] = (uint8_t)type;
+        checkRejected(frame, GAME_PACKET_SIZE);
+        checkRejected(frame, GAME_DELTA_PACKET_SIZE);
+    }
+
+    // Positions off the field, on either axis
+    const uint16_t offX[] = { PACKET_MAX_X, PACKET_MAX_X + 1, 0x7FFF, 0x8000, 0xFFFF };
+    const uint16_t offY[] = { PACKET_MAX_Y, PACKET_MAX_Y + 1, 0x7FFF, 0x8000, 0xFFFF };
+    for (int i = 0; i < 5; i++) {
+        encodePacket(makePositionPacket(1, offX[i], 0), frame);
+        checkRejected(frame, GAME_PACKET_SIZE);
+        encodePacket(makePositionPacket(1, 0, offY[i]), frame);
+        checkRejected(frame, GAME_PACKET_SIZE);
+        encodePacket(makePositionPacket(1, offX[i], offY[i]), frame);
+        checkRejected(frame, GAME_PACKET_SIZE);
+    }
+}
+
+// What GameProtocol.h says decodePacket() should accept
+static bool formatAccepts(const uint8_t *frame, size_t length) {
+    if (length == 0) return false;
+    switch (frame[0]) {
+        case PACKET_TYPE_DELTA:
+            return length == GAME_DELTA_PACKET_SIZE;
+        case PACKET_TYPE_POSITION:
+            return length == GAME_PACKET_SIZE && getU16(frame + 2) < PACKET_MAX_X && getU16(frame + 4) < PACKET_MAX_Y;
+        case PACKET_TYPE_CONNECTED:
+        case PACKET_TYPE_GAMEOVER:
+        case PACKET_TYPE_CLOCK:
+            return length == GAME_PACKET_SIZE;
+        default:
+            return false;
+    }
+}
+
+TEST(packet_fuzz) {
+    const uint32_t FRAMES = 200000;
+    uint32_t rng = 77;
+    uint32_t acceptedByType[PACKET_TYPE_CLOCK + 1] = {};
+    uint8_t frame[GAME_PACKET_SIZE + 4];
+    for (uint32_t i = 0; i < FRAMES; i++) {
+        size_t length = (size_t)randomBetween(rng, 0, sizeof(frame) + 1);
+        for (size_t b = 0; b < length; b++) frame[b] = (uint8_t)nextRandom(rng);
+        // Most random frames are junk; steer some towards the known types and the field
+        if (length > 0 && i % 2 == 0) frame[0] = (uint8_t)randomBetween(rng, 0, PACKET_TYPE_WORLD + 2);
+        if (length > 5 && i % 4 == 0) {
+            frame[3] &= 0x01;
+            frame[5] = 0;
+        }
+
+        GamePacket packet = UNTOUCHED;
+        bool accepted = decodePacket(frame, length, packet);
+        CHECKF(accepted == formatAccepts(frame, length), "frame %u: type 0x%02x length %u", i,
+               length ? frame[0] : 0, (unsigned)length);
+        if (!accepted) {
+            CHECKF(samePacket(packet, UNTOUCHED), "frame %u", i);
+            continue;
+        }
+        acceptedByType[packet.type]++;
+        uint8_t again[GAME_PACKET_SIZE];
+        size_t againLength = encodePacket(packet, again);
+        CHECKF(againLength == length && memcmp(again, frame, length) == 0, "frame %u: type 0x%02x", i, frame[0]);
+    }
+    for (int type = PACKET_TYPE_POSITION; type <= PACKET_TYPE_CLOCK; type++) {
+        if (type == PACKET_TYPE_WORLD) continue;
+        CHECKF(acceptedByType[type] > 0, "the fuzz never reached type 0x%02x's accept path", type);
+    }
+}
@@ -0,0 +1,214 @@
+#include "Bench.h"
+#include "Test.h"
+
+#include <GameCore.h>
+#include <GameProtocol.h>
+#include <LinkProfile.h>
+#include <PlayerTable.h>
+#include <WorldState.h>
+
+///////////////////////////////////////////////////////////////
+// Multi-client server: the player table and the aggregated
+// WORLD frame, driven with simulated connections.
+//
+// player_table runs a random script of connects (more clients
+// than slots), subscriptions, MTU exchanges, position writes
+// (some duplicated or out of order) and disconnects, and checks
+// every slot against a model of what each connection did.
+// world_frames builds the per-tick WORLD frame from the table
+// like the server does, sends it through the codec and checks
+// every receiver sees every other player where they are.
+///////////////////////////////////////////////////////////////
+static const int SIM_CONNECTIONS = 6;  // Twice MAX_CLIENTS, so the table fills up
+
+struct SimConnection {
+    bool up;           // Connected as far as the stack is concerned
+    int slot;          // Slot the table gave it, -1 if rejected
+    uint8_t seq;
+    uint16_t x;
+    uint16_t y;
+    uint32_t positions;
+};
+
+static void writePosition(PlayerTable &table, uint16_t connId, const GamePacket &packet, uint32_t nowMs) {
+    uint8_t frame[GAME_PACKET_SIZE];
+    size_t length = encodePacket(packet, frame);
+    table.onWrite(connId, frame, length, nowMs);
+}
+
+TEST(player_table) {
+    const uint32_t STEPS = 100000;
+    PlayerTable table;
+    SimConnection conns[SIM_CONNECTIONS] = {};
+    uint32_t joins[MAX_CLIENTS] = {};
+    uint32_t rng = 2024;
+
+    for (uint32_t i = 0; i < STEPS; i++) {
+        uint16_t connId = (uint16_t)randomBetween(rng, 0, SIM_CONNECTIONS);
+        SimConnection &conn = conns[connId];
+        int action = randomBetween(rng, 0, 100);
+        uint32_t now = i * 10;
+
+        if (!conn.up) {
+            if (action < 30) {
+                bool hadRoom = !table.full();
+                conn.up = true;
+                conn.slot = table.onConnect(connId);
+                conn.positions = 0;
+                CHECKF(hadRoom == (conn.slot >= 0), "step %u: connection %u got slot %d", i, connId, conn.slot);
+                if (conn.slot >= 0) joins[conn.slot]++;
+            }
+        } else if (conn.slot < 0 || action < 5) {
+            // Rejected links are dropped by the server; others leave now and then
+            int slot = table.onDisconnect(connId);
+            CHECKF(slot == conn.slot, "step %u: connection %u left slot %d, held %d", i, connId, slot, conn.slot);
+            conn.up = false;
+        } else if (action < 15) {
+            table.onSubscribe(connId, true);
+        } else if (action < 20) {
+            table.onMtu(connId, LINK_MTU);
+        } else if (action < 90) {
+            conn.seq++;
+            conn.x = (uint16_t)randomBetween(rng, 0, PACKET_MAX_X);
+            conn.y = (uint16_t)randomBetween(rng, 0, PACKET_MAX_Y);
+            conn.positions++;
+            writePosition(table, connId, makePositionPacket(conn.seq, conn.x, conn.y, 0, (uint16_t)now), now);
+        } else if (conn.positions > 0) {
+            // A late copy of an older position must not win
+            writePosition(table, connId, makePositionPacket((uint8_t)(conn.seq - 3), 1, 1), now);
+        }
+
+        // Every slot must match the connection that holds it
+        int used = 0;
+        for (int slot = 0; slot < MAX_CLIENTS; slot++) {
+            PlayerView view;
+            table.read(slot, view);
+            CHECKF(view.joinCount == joins[slot], "step %u: slot %d joined %u times, expected %u", i, slot,
+                   view.joinCount, joins[slot]);
+            if (!view.connected) continue;
+
+            used++;
+            const SimConnection &owner = conns[view.connId];
+            if (!CHECKF(owner.up && owner.slot == slot, "step %u: slot %d held by connection %u", i, slot,
+                        view.connId)) {
+                continue;
+            }
+            CHECKF(view.remote.positionCount == owner.positions, "step %u: slot %d has %u positions, expected %u", i,
+                   slot, view.remote.positionCount, owner.positions);
+            if (owner.positions > 0) {
+                CHECKF(view.remote.x == owner.x && view.remote.y == owner.y, "step %u: slot %d at %u,%u, expected %u,%u",
+                       i, slot, view.remote.x, view.remote.y, owner.x, owner.y);
+            }
+        }
+        CHECKF(used == table.connectedCount(), "step %u: %d slots used, table says %d", i, used,
+               table.connectedCount());
+    }
+}
+
+///////////////////////////////////////////////////////////////
+// WORLD frames: aggregation, codec and change-only sends
+///////////////////////////////////////////////////////////////
+static void buildWorld(const PlayerTable &table, int serverX, int serverY, WorldState &world) {
+    clearWorld(world);
+    addWorldEntry(world, SERVER_PLAYER_ID, (uint16_t)serverX, (uint16_t)serverY);
+    for (int slot = 0; slot < MAX_CLIENTS; slot++) {
+        PlayerView view;
+        table.read(slot, view);
+        if (!view.connected || view.remote.positionCount == 0) continue;
+        addWorldEntry(world, playerIdForSlot(slot), view.remote.x, view.remote.y);
+    }
+}
+
+TEST(world_frames) {
+    PlayerTable table;
+    uint16_t x[MAX_CLIENTS], y[MAX_CLIENTS];
+    uint8_t seq[MAX_CLIENTS] = {};
+    for (int c = 0; c < MAX_CLIENTS; c++) {
+        table.onConnect((uint16_t)c);
+        table.onMtu((uint16_t)c, LINK_MTU);
+        table.onSubscribe((uint16_t)c, true);
+        x[c] = y[c] = 0;
+    }
+
+    WorldEncoder encoder(1000);
+    uint32_t rng = 77;
+    uint32_t sends = 0;
+    uint8_t txSeq = 0;
+    int serverX = 100, serverY = 100;
+
+    for (uint32_t i = 0; i < 20000; i++) {
+        uint32_t now = i * 100;
+
+        // Each tick one client moves (or nobody does)
+        int mover = randomBetween(rng, -1, MAX_CLIENTS);
+        if (mover >= 0) {
+            x[mover] = (uint16_t)randomBetween(rng, 0, PACKET_MAX_X);
+            y[mover] = (uint16_t)randomBetween(rng, 0, PACKET_MAX_Y);
+            writePosition(table, (uint16_t)mover,
+                          makePositionPacket(++seq[mover], x[mover], y[mover], 0, (uint16_t)now), now);
+        }
+
+        WorldState world;
+        buildWorld(table, serverX, serverY, world);
+        if (!encoder.encode(txSeq, world, now)) continue;
+        txSeq++;
+        sends++;
+
+        uint8_t frame[WORLD_PACKET_MAX_SIZE];
+        size_t length = encodeWorld(world, frame);
+        CHECKF(fitsMtu(length, LINK_MTU), "tick %u: %u bytes", i, (unsigned)length);
+
+        WorldState received = {};
+        if (!CHECKF(decodeWorld(frame, length, received) && received.seq == world.seq, "tick %u", i)) continue;
+
+        // Every receiver finds every player it doesn't own at the right spot
+        const WorldEntry *server = findWorldEntry(received, SERVER_PLAYER_ID);
+        CHECKF(server && server->x == serverX && server->y == serverY, "tick %u: server's dot", i);
+        for (int c = 0; c < MAX_CLIENTS; c++) {
+            if (seq[c] == 0) continue;
+            const WorldEntry *entry = findWorldEntry(received, playerIdForSlot(c));
+            CHECKF(entry && entry->x == x[c] && entry->y == y[c], "tick %u: client %d", i, c);
+        }
+    }
+    CHECK(sends > 0);
+}
+
+BENCH(world_encode) {
+    WorldState world;
+    clearWorld(world);
+    for (int id = 0; id < WORLD_MAX_PLAYERS; id++) addWorldEntry(world, (uint8_t)id, 0, 0);
+    uint8_t frame[WORLD_PACKET_MAX_SIZE];
+    for (uint32_t i = 0; i < iterations; i++) {
+        world.seq = (uint8_t)i;
+        world.entries[i & (WORLD_MAX_PLAYERS - 1)].x = (uint16_t)(i % PACKET_MAX_X);
+        size_t length = encodeWorld(world, frame);
+        doNotOptimize(length);
+        doNotOptimize(frame);
+    }
+}
+
+BENCH(world_decode) {
+    WorldState world;
+    clearWorld(world);
+    for (int id = 0; id < WORLD_MAX_PLAYERS; id++) addWorldEntry(world, (uint8_t)id, id * 50, id * 40);
+    uint8_t frame[WORLD_PACKET_MAX_SIZE];
+    size_t length = encodeWorld(world, frame);
+    for (uint32_t i = 0; i < iterations; i++) {
+        WorldState decoded;
+        bool ok = decodeWorld(frame, length, decoded);
+        doNotOptimize(ok);
+        doNotOptimize(decoded);
+    }
+}
+
+// What the world broadcast replaces: one position notify per player per tick
+BENCH(world_per_player_notifies) {
+    uint8_t frame[GAME_PACKET_SIZE];
+    for (uint32_t i = 0; i < iterations; i++) {
+        for (int id = 0; id < WORLD_MAX_PLAYERS; id++) {
+            size_t length = encodePacket(makePositionPacket((uint8_t)i, (uint16_t)(i % PACKET_MAX_X), 0), frame);
+            doNotOptimize(length);
+            doNotOptimize(frame);
+        }
+    }
+}
@@ -0,0 +1,164 @@
+#include "Bench.h"
+#include "Test.h"
+#include "CountingSurface.h"
+
+#include <FrameProfiler.h>
+#include <GameCore.h>
+#include <ProfileOverlay.h>
+#include <algorithm>
+#include <vector>
+
+///////////////////////////////////////////////////////////////
+// Frame profiler: histogram accuracy, the Serial dump and the
+// overlay text, then the cost of timing a stage.
+//
+// profiler_histogram feeds random stage durations (from a few
+// us to ~100 ms) through a FrameProfiler on a fake clock and
+// checks p50 / p99 against the exact sorted values (within one
+// bucket, 1/8 of an octave) and max exactly. profiler_dump
+// round-trips the dump, makes sure damaged dumps are rejected,
+// and checks every overlay line has the same width.
+///////////////////////////////////////////////////////////////
+struct StepClock {
+    StepClock() : us(0) {}
+    uint32_t nowUs() {
+        return us;
+    }
+    uint32_t us;
+};
+
+// Random duration with a long tail, like real frames
+static uint32_t randomDuration(uint32_t &rng) {
+    uint32_t shape = nextRandom(rng) % 100;
+    if (shape < 80) return 200 + nextRandom(rng) % 800;
+    if (shape < 98) return 1000 + nextRandom(rng) % 9000;
+    return 10000 + nextRandom(rng) % 90000;
+}
+
+static bool withinBucket(uint32_t actual, uint32_t expected) {
+    uint32_t slack = expected / HISTOGRAM_SUB + 1;
+    return actual + slack >= expected && actual <= expected + slack;
+}
+
+TEST(profiler_histogram) {
+    StepClock clock;
+    FrameProfiler<StepClock> profiler(clock);
+    std::vector<uint32_t> durations[PROFILE_STAGE_COUNT];
+    uint32_t rng = 31337;
+
+    for (uint32_t i = 0; i < 100000; i++) {
+        ProfileStage stage = (ProfileStage)(i % PROFILE_STAGE_COUNT);
+        uint32_t us = randomDuration(rng);
+        {
+            ProfileScope<StepClock> scope(profiler, stage);
+            clock.us += us;
+        }
+        durations[stage].push_back(us);
+    }
+
+    for (int s = 0; s < PROFILE_STAGE_COUNT; s++) {
+        std::vector<uint32_t> &sorted = durations[s];
+        const StageHistogram &histogram = profiler.histogram((ProfileStage)s);
+        CHECKF(histogram.count() == sorted.size(), "stage %d", s);
+        if (sorted.empty()) continue;
+
+        std::sort(sorted.begin(), sorted.end());
+        uint32_t p50 = sorted[(sorted.size() * 500 + 999) / 1000 - 1];
+        uint32_t p99 = sorted[(sorted.size() * 990 + 999) / 1000 - 1];
+        CHECKF(withinBucket(histogram.percentile(500), p50), "stage %d: p50 %u us, exact %u", s,
+               histogram.percentile(500), p50);
+        CHECKF(withinBucket(histogram.percentile(990), p99), "stage %d: p99 %u us, exact %u", s,
+               histogram.percentile(990), p99);
+        CHECKF(histogram.maxUs() == sorted.back(), "stage %d: max %u us, exact %u", s, histogram.maxUs(),
+               sorted.back());
+    }
+
+    // Every value lands in the bucket that starts at or below it
+    for (uint32_t us = 0; us < 1u << 20; us += 1 + us / 64) {
+        int bucket = histogramBucket(us);
+        CHECKF(histogramBucketLow(bucket) <= us && histogramBucketLow(bucket + 1) > us, "%u us in bucket %d", us,
+               bucket);
+    }
+}
+
+TEST(profiler_dump) {
+    StepClock clock;
+    FrameProfiler<StepClock> profiler(clock);
+    uint32_t rng = 5;
+    for (int i = 0; i < 500; i++) {
+        ProfileStage stage = (ProfileStage)(i % PROFILE_STAGE_COUNT);
+        profiler.begin(stage);
+        clock.us += randomDuration(rng);
+        profiler.end(stage);
+    }
+
+    ProfileSummary summaries[PROFILE_STAGE_COUNT];
+    for (int s = 0; s < PROFILE_STAGE_COUNT; s++) {
+        summaries[s] = summarize((ProfileStage)s, profiler.histogram((ProfileStage)s));
+    }
+
+    uint8_t dump[PROFILE_DUMP_MAX_SIZE];
+    size_t length = encodeProfileDump(summaries, PROFILE_STAGE_COUNT, dump);
+    CHECK(length == PROFILE_DUMP_MAX_SIZE);
+
+    ProfileSummary decoded[PROFILE_STAGE_COUNT];
+    if (CHECK(decodeProfileDump(dump, length, decoded, PROFILE_STAGE_COUNT) == PROFILE_STAGE_COUNT)) {
+        for (int s = 0; s < PROFILE_STAGE_COUNT; s++) {
+            CHECKF(memcmp(&decoded[s].count, &summaries[s].count, 4 * sizeof(uint16_t)) == 0 &&
+                   decoded[s].stage == summaries[s].stage, "stage %d", s);
+        }
+    }
+
+    // Any flipped byte or a short read is caught
+    for (size_t i = 0; i < length; i++) {
+        dump[i] ^= 0x10;
+        CHECKF(decodeProfileDump(dump, length, decoded, PROFILE_STAGE_COUNT) < 0, "byte %u flipped", (unsigned)i);
+        dump[i] ^= 0x10;
+    }
+    CHECK(decodeProfileDump(dump, length - 1, decoded, PROFILE_STAGE_COUNT) < 0);
+
+    // Overlay lines are all the same width, whatever the numbers
+    CountingSurface lcd;
+    drawProfileOverlay(lcd, summaries, PROFILE_STAGE_COUNT);
+    uint64_t lineArea = (uint64_t)PROFILE_OVERLAY_CHARS * FONT_CHAR_WIDTH * FONT_CHAR_HEIGHT;
+    CHECK(lcd.pixels == lineArea * PROFILE_STAGE_COUNT && lcd.textCalls == PROFILE_STAGE_COUNT);
+    ProfileSummary extreme = { PROFILE_SIMULATE, 0xFFFF, 0xFFFF, 0xFFFF, 0xFFFF };
+    char line[PROFILE_OVERLAY_CHARS + 1];
+    line[PROFILE_OVERLAY_CHARS] = '#';
+    formatProfileLine(line, extreme);
+    CHECKF(line[PROFILE_OVERLAY_CHARS] == '#' && line[PROFILE_OVERLAY_CHARS - 1] == '5', "\"%.*s\"",
+           PROFILE_OVERLAY_CHARS, line);
+}
+
+///////////////////////////////////////////////////////////////
+// Cost of timing one stage, and of a summary + dump
+///////////////////////////////////////////////////////////////
+BENCH(profile_scope) {
+    StepClock clock;
+    FrameProfiler<StepClock> profiler(clock);
+    for (uint32_t i = 0; i < iterations; i++) {
+        ProfileScope<StepClock> scope(profiler, PROFILE_RENDER);
+        clock.us += 300 + (i & 1023);
+    }
+    doNotOptimize(profiler.histogram(PROFILE_RENDER).count());
+}
+
+BENCH(profile_dump) {
+    StepClock clock;
+    FrameProfiler<StepClock> profiler(clock);
+    uint32_t rng = 9;
+    for (int i = 0; i < 1000; i++) {
+        ProfileScope<StepClock> scope(profiler, (ProfileStage)(i % PROFILE_STAGE_COUNT));
+        clock.us += randomDuration(rng);
+    }
+    uint8_t dump[PROFILE_DUMP_MAX_SIZE];
+    for (uint32_t i = 0; i < iterations; i++) {
+        ProfileSummary summaries[PROFILE_STAGE_COUNT];
+        for (int s = 0; s < PROFILE_STAGE_COUNT; s++) {
+            summaries[s] = summarize((ProfileStage)s, profiler.histogram((ProfileStage)s));
+        }
+        size_t length = encodeProfileDump(summaries, PROFILE_STAGE_COUNT, dump);
+        doNotOptimize(length);
+        doNotOptimize(dump);
+    }
+}
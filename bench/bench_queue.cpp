@@ -0,0 +1,122 @@
+#include "Bench.h"
+#include "Test.h"
+
+#include <GameCore.h>
+#include <InputSnapshot.h>
+#include <SpscRing.h>
+
+#include <atomic>
+#include <thread>
+
+///////////////////////////////////////////////////////////////
+// SPSC ring benchmarks. spsc_threaded is the stress test: a
+// producer thread pushes a numbered sequence while this thread
+// pops it, and checks nothing is lost, repeated, reordered or
+// torn. input_drain_tap checks that a START tap shorter than a
+// simulate tick, drained from the ring, still changes speed, and
+// only once over a frame's catch-up steps.
+///////////////////////////////////////////////////////////////
+BENCH(spsc_push_pop) {
+    SpscRing<InputSnapshot, 16> ring;
+    InputSnapshot snapshot = {};
+    for (uint32_t i = 0; i < iterations; i++) {
+        snapshot.timeMs = i;
+        ring.push(snapshot);
+        ring.pop(snapshot);
+        doNotOptimize(snapshot);
+    }
+}
+
+// Producer on its own thread, consumer here; returns the items popped
+static uint32_t runThreaded(uint32_t items) {
+    SpscRing<InputSnapshot, 16> ring;
+    std::atomic<bool> producerDone(false);
+
+    std::thread producer([&]() {
+        InputSnapshot snapshot = {};
+        for (uint32_t i = 0; i < items; i++) {
+            // Every field carries the sequence number so torn copies show up too
+            snapshot.timeMs = i;
+            snapshot.input.joyX = (int)i;
+            snapshot.input.joyY = -(int)i;
+            snapshot.input.buttons = ~i;
+            snapshot.pressed = i * 3;
+            snapshot.released = i * 7;
+            while (!ring.push(snapshot)) std::this_thread::yield();
+        }
+        producerDone = true;
+    });
+
+    uint32_t expected = 0, popped = 0;
+    InputSnapshot snapshot;
+    while (expected < items) {
+        if (!ring.pop(snapshot)) {
+            if (producerDone && ring.empty()) break;
+            std::this_thread::yield();
+            continue;
+        }
+        uint32_t i = snapshot.timeMs;
+        CHECKF(i == expected, "item %u after %u", i, expected - 1);
+        CHECKF(snapshot.input.joyX == (int)i && snapshot.input.joyY == -(int)i && snapshot.input.buttons == ~i &&
+               snapshot.pressed == i * 3 && snapshot.released == i * 7, "item %u torn", i);
+        expected = i + 1;
+        popped++;
+    }
+    producer.join();
+    CHECKF(expected == items, "stopped at item %u of %u", expected, items);
+    return popped;
+}
+
+BENCH(spsc_threaded_stress) {
+    doNotOptimize(runThreaded(iterations));
+}
+
+TEST(spsc_threaded) {
+    runThreaded(2000000);
+}
+
+// The game loop folding a frame's worth of 10 ms samples
+BENCH(input_drain_queue) {
+    SpscRing<InputSnapshot, 16> ring;
+    InputSnapshot latest = {};
+    InputSnapshot snapshot = {};
+    for (uint32_t i = 0; i < iterations; i++) {
+        for (int sample = 0; sample < 3; sample++) {
+            snapshot.timeMs = i * 30 + sample * 10;
+            snapshot.pressed = (i + sample) % 20 == 0 ? GAME_BUTTON_START : 0;
+            ring.push(snapshot);
+        }
+        drainInput(ring, latest);
+        doNotOptimize(latest);
+    }
+}
+
+TEST(input_drain_tap) {
+    SpscRing<InputSnapshot, 16> ring;
+    InputSnapshot snapshot = {};
+    snapshot.input.joyX = snapshot.input.joyY = JOYSTICK_CENTER;
+    GameState game;
+    resetGame(game, 1);
+    int speed = game.local.speed;
+
+    // Down on one 10 ms sample, up again on the next, both before the frame reads the ring
+    snapshot.timeMs = 10;
+    snapshot.input.buttons = snapshot.pressed = GAME_BUTTON_START;
+    ring.push(snapshot);
+    snapshot.timeMs = 20;
+    snapshot.input.buttons = snapshot.pressed = 0;
+    snapshot.released = GAME_BUTTON_START;
+    ring.push(snapshot);
+
+    InputSnapshot latest = {};
+    CHECK(drainInput(ring, latest) == 2);
+    CHECK(latest.input.buttons == 0);
+    uint8_t events = 0;
+    for (int i = 0; i < 3; i++) events |= step(game, latest, 30, i == 0);
+    CHECK(events & STEP_SPEED_CHANGED);
+    CHECKF(game.local.speed == speed % MAX_SPEED + 1, "speed %d -> %d", speed, game.local.speed);
+
+    // Nothing new on the next frame
+    drainInput(ring, latest);
+    CHECK(!(step(game, latest, 30) & STEP_SPEED_CHANGED));
+}
@@ -0,0 +1,303 @@
+#include "Bench.h"
+#include "Test.h"
+
+#include <GameCore.h>
+#include <Reconnector.h>
+
+///////////////////////////////////////////////////////////////
+// Reconnect time against a scripted fake BLE scanner. The link
+// drops at t = 0 and the server comes back 0-2 s later (a
+// reboot), advertising every 20-40 ms like BLEAdvertising's
+// defaults, among five other devices; 10% of advertisements are
+// missed. Times are ms from the server advertising again to
+// being connected, averaged per reconnect:
+//   cached   - Reconnector with the server's address saved
+//   uncached - Reconnector on first boot (scan only)
+//   stale    - Reconnector with another board's address saved,
+//              so the direct connect runs into its timeout
+//   legacy   - the old continuous 843 ms interval / 280 ms
+//              window active scan matched on the name
+// reconnect checks there are no connects to the wrong device,
+// that a stale saved address is replaced, that there are no
+// needless NVS writes, and that a stale address is tried once
+// while the server stays away longer than the connect timeout.
+///////////////////////////////////////////////////////////////
+static const uint32_t LOOP_MS = 30;             // The client's loop() delay while disconnected
+static const uint32_t CONNECT_COST_MS = 80;     // Connect + service discovery
+static const uint32_t CONNECT_TIMEOUT_MS = 30000;  // Bluedroid's direct connect timeout
+static const uint32_t LEGACY_INTERVAL_MS = 843; // 1349 * 0.625 ms
+static const uint32_t LEGACY_WINDOW_MS = 280;   // 449 * 0.625 ms
+
+static const uint8_t GAME_UUID[16] = {0x4b, 0x91, 0x31, 0xc3, 0xc9, 0xc5, 0xcc, 0x8f,
+                                      0x9e, 0x45, 0xb5, 0x1f, 0x01, 0xc2, 0xaf, 0x4f};
+
+struct FakeDevice {
+    PeerAddress address;
+    uint8_t adv[31];
+    size_t advLength;
+    uint32_t onlineMs;
+    uint32_t nextAdvMs;
+    bool isServer;
+};
+
+static size_t buildAdvertisement(uint8_t *adv, const uint8_t *uuid, uint8_t variant) {
+    size_t length = 0;
+    adv[length++] = 2;  // Flags
+    adv[length++] = 0x01;
+    adv[length++] = 0x06;
+    if (uuid) {
+        adv[length++] = 17;
+        adv[length++] = AD_TYPE_UUID128_COMPLETE;
+        for (int i = 0; i < 16; i++) adv[length++] = uuid[i];
+    } else if (variant == 1) {
+        adv[length++] = 3;  // 16-bit UUID list
+        adv[length++] = 0x03;
+        adv[length++] = 0x0F;
+        adv[length++] = 0x18;
+    } else if (variant == 2) {
+        adv[length++] = 30;  // Malformed: runs past the end
+        adv[length++] = AD_TYPE_UUID128_COMPLETE;
+    }
+    return length;
+}
+
+///////////////////////////////////////////////////////////////
+// The radio around the client: devices advertise on their own
+// schedule, scan results are delivered while scanning and
+// connect() blocks until the device answers or times out.
+///////////////////////////////////////////////////////////////
+class FakeScanner {
+public:
+    FakeScanner(uint32_t seed, uint32_t serverBackMs, uint8_t serverId)
+        : now(0), rng(seed), scanning(false), scanStartMs(0), legacyWindows(false),
+          connectedTo(NULL), wrongConnects(0), timeouts(0) {
+        uint8_t otherUuid[16];
+        for (int i = 0; i < 16; i++) otherUuid[i] = GAME_UUID[i] ^ 0x5a;
+
+        for (int i = 0; i < DEVICE_COUNT; i++) {
+            FakeDevice &device = devices[i];
+            device.isServer = i == 0;
+            for (int b = 0; b < 6; b++) device.address.bytes[b] = (uint8_t)(0x30 + i * 7 + b);
+            device.address.bytes[5] = device.isServer ? serverId : (uint8_t)i;
+            device.address.type = 0;
+            device.advLength = buildAdvertisement(device.adv, device.isServer ? GAME_UUID :
+                                                  (i == 1 ? otherUuid : NULL), (uint8_t)(i % 3));
+            device.onlineMs = device.isServer ? serverBackMs : 0;
+            device.nextAdvMs = device.onlineMs + randomBetween(rng, 0, 40);
+        }
+    }
+
+    const PeerAddress &serverAddress() const {
+        return devices[0].address;
+    }
+
+    uint32_t serverBackMs() const {
+        return devices[0].onlineMs;
+    }
+
+    // Advance to t, delivering what the scanner hears on the way
+    template <typename Listener>
+    void advance(uint32_t t, Listener &listener) {
+        for (int i = 0; i < DEVICE_COUNT; i++) {
+            FakeDevice &device = devices[i];
+            while (device.nextAdvMs <= t) {
+                if (scanning && device.nextAdvMs >= scanStartMs && inWindow(device.nextAdvMs) &&
+                    randomBetween(rng, 0, 10) != 0) {
+                    listener.heard(device);
+                }
+                device.nextAdvMs += randomBetween(rng, 20, 41);
+            }
+        }
+        now = t;
+    }
+
+    // Blocking connect, as BLEClient::connect(): done once the device advertises
+    bool connectTo(const PeerAddress &address) {
+        for (int i = 0; i < DEVICE_COUNT; i++) {
+            FakeDevice &device = devices[i];
+            if (!sameAddress(device.address, address)) continue;
+
+            uint32_t advMs = device.nextAdvMs > now ? device.nextAdvMs : now;
+            if (advMs - now > CONNECT_TIMEOUT_MS) break;
+            skipTo(advMs + CONNECT_COST_MS);
+            connectedTo = &device;
+            if (!device.isServer) {
+                wrongConnects++;
+                return false;  // No game service
+            }
+            return true;
+        }
+        skipTo(now + CONNECT_TIMEOUT_MS);
+        timeouts++;
+        return false;
+    }
+
+    void startScan() {
+        scanning = true;
+        scanStartMs = now;
+    }
+
+    void stopScan() {
+        scanning = false;
+    }
+
+    uint32_t now;
+    uint32_t rng;
+    bool scanning;
+    uint32_t scanStartMs;
+    bool legacyWindows;
+    FakeDevice *connectedTo;
+    uint32_t wrongConnects;
+    uint32_t timeouts;  // Direct connects to an address nobody answers
+
+private:
+    static const int DEVICE_COUNT = 6;
+
+    bool inWindow(uint32_t t) const {
+        return !legacyWindows || (t - scanStartMs) % LEGACY_INTERVAL_MS < LEGACY_WINDOW_MS;
+    }
+
+    // Time passes without listening (blocked in connect)
+    void skipTo(uint32_t t) {
+        for (int i = 0; i < DEVICE_COUNT; i++) {
+            while (devices[i].nextAdvMs <= t) devices[i].nextAdvMs += randomBetween(rng, 20, 41);
+        }
+        now = t;
+    }
+
+    FakeDevice devices[DEVICE_COUNT];
+};
+
+struct FakeStack {
+    FakeStack(FakeScanner &scanner) : scanner(scanner) {}
+    bool connect(const PeerAddress &address) { return scanner.connectTo(address); }
+    void startScan() { scanner.startScan(); }
+    void stopScan() { scanner.stopScan(); }
+    FakeScanner &scanner;
+};
+
+struct FakeStore {
+    FakeStore() : have(false), saves(0) {}
+    bool load(PeerAddress &out) {
+        if (have) out = address;
+        return have;
+    }
+    void save(const PeerAddress &in) {
+        address = in;
+        have = true;
+        saves++;
+    }
+    PeerAddress address;
+    bool have;
+    uint32_t saves;
+};
+
+struct ReconnectListener {
+    ReconnectListener(Reconnector<FakeStack, FakeStore> &reconnector) : reconnector(reconnector) {}
+    void heard(const FakeDevice &device) {
+        reconnector.onAdvertisement(device.address, device.adv, device.advLength);
+    }
+    Reconnector<FakeStack, FakeStore> &reconnector;
+};
+
+// Reconnect with Reconnector; returns the scanner time when connected
+static uint32_t reconnect(FakeScanner &scanner, FakeStore &store) {
+    FakeStack stack(scanner);
+    Reconnector<FakeStack, FakeStore> reconnector(stack, store, GAME_UUID);
+    ReconnectListener listener(reconnector);
+
+    reconnector.start(scanner.now);
+    while (!reconnector.update(scanner.now)) scanner.advance(scanner.now + LOOP_MS, listener);
+    return scanner.now;
+}
+
+// The old client: scan until the named server shows up, then connect
+struct LegacyListener {
+    LegacyListener() : found(false) {}
+    void heard(const FakeDevice &device) {
+        if (device.isServer) found = true;  // Name compare in onResult()
+    }
+    bool found;
+};
+
+static uint32_t legacyReconnect(FakeScanner &scanner) {
+    LegacyListener listener;
+    scanner.legacyWindows = true;
+    scanner.startScan();
+    while (!listener.found) scanner.advance(scanner.now + LOOP_MS, listener);
+    scanner.stopScan();
+    scanner.connectTo(scanner.serverAddress());
+    return scanner.now;
+}
+
+enum ReconnectCase { CASE_CACHED, CASE_UNCACHED, CASE_STALE, CASE_LEGACY };
+
+static double averageReconnectMs(uint32_t iterations, ReconnectCase which) {
+    uint64_t totalMs = 0;
+    for (uint32_t i = 0; i < iterations; i++) {
+        uint32_t seed = 1000 + i;
+        FakeScanner scanner(seed, randomBetween(seed, 0, 2000), 0x42);
+        FakeStore store;
+        uint32_t doneMs;
+        if (which == CASE_LEGACY) {
+            doneMs = legacyReconnect(scanner);
+        } else {
+            if (which == CASE_CACHED) store.save(scanner.serverAddress());
+            if (which == CASE_STALE) store.save(FakeScanner(seed, 0, 0x41).serverAddress());
+            doneMs = reconnect(scanner, store);
+        }
+        totalMs += doneMs - scanner.serverBackMs();
+    }
+    return (double)totalMs / iterations;
+}
+
+BENCH(reconnect_cached) {
+    benchMetric("ms after server is back", averageReconnectMs(iterations, CASE_CACHED));
+}
+
+BENCH(reconnect_uncached) {
+    benchMetric("ms after server is back", averageReconnectMs(iterations, CASE_UNCACHED));
+}
+
+BENCH(reconnect_stale) {
+    benchMetric("ms after server is back", averageReconnectMs(iterations, CASE_STALE));
+}
+
+BENCH(reconnect_legacy) {
+    benchMetric("ms after server is back", averageReconnectMs(iterations, CASE_LEGACY));
+}
+
+TEST(reconnect) {
+    for (uint32_t i = 0; i < 500; i++) {
+        uint32_t seed = 5000 + i;
+        uint32_t backMs = randomBetween(seed, 0, 2000);
+
+        // Same server again: no NVS write
+        FakeScanner same(seed, backMs, 0x42);
+        FakeStore store;
+        store.save(same.serverAddress());
+        store.saves = 0;
+        reconnect(same, store);
+        CHECKF(same.connectedTo && same.connectedTo->isServer, "seed %u: same server", seed);
+        CHECKF(store.saves == 0, "seed %u: %u saves for the same server", seed, store.saves);
+
+        // A different server board: the stale address is replaced
+        FakeScanner replaced(seed, backMs, 0x43);
+        reconnect(replaced, store);
+        CHECKF(replaced.connectedTo && replaced.connectedTo->isServer, "seed %u: new board", seed);
+        CHECKF(store.saves == 1 && sameAddress(store.address, replaced.serverAddress()),
+               "seed %u: %u saves for a new board", seed, store.saves);
+
+        // The old board's address again, with the server off for longer than
+        // the connect timeout: one direct connect, then scanning only
+        FakeScanner late(seed, CONNECT_TIMEOUT_MS + 5000 + backMs, 0x42);
+        uint32_t doneMs = reconnect(late, store);
+        CHECKF(late.connectedTo && late.connectedTo->isServer, "seed %u: late server", seed);
+        CHECKF(late.timeouts == 1 && doneMs - late.serverBackMs() <= 5000,
+               "seed %u: %u direct connect timeouts, connected %u ms after the server was back", seed, late.timeouts,
+               doneMs - late.serverBackMs());
+
+        CHECKF(same.wrongConnects + replaced.wrongConnects + late.wrongConnects == 0,
+               "seed %u: connected to another device", seed);
+    }
+}
@@ -0,0 +1,178 @@
+#include "Bench.h"
+#include "Test.h"
+
+#include <GameProtocol.h>
+#include <RemoteState.h>
+#include <SeqlockCell.h>
+
+#include <atomic>
+#include <thread>
+
+///////////////////////////////////////////////////////////////
+// Remote state handoff benchmarks. remote_cell_threaded is the
+// torn read stress test: a writer thread (the BLE callback)
+// keeps publishing states whose fields all derive from one
+// counter while this thread (the game loop) reads them and
+// checks no copy is mixed up or older than the one before.
+//
+// remote_round_order feeds CONNECTED and GAMEOVER packets in the
+// orders the server sends them (a join during a game over, a
+// restart, both landing in one frame) through roundChange() the
+// way the client applies them, and checks the client ends up in
+// game over exactly when the server is.
+///////////////////////////////////////////////////////////////
+static RemoteState numberedState(uint32_t n) {
+    RemoteState state;
+    state.positionCount = n;
+    state.x = (uint16_t)(n * 3);
+    state.y = (uint16_t)(n * 5);
+    state.seq = (uint8_t)n;
+    state.flags = (uint8_t)(n >> 8);
+    state.sentMs = (uint16_t)(n * 11);
+    state.receivedMs = n * 30;
+    state.connectedCount = ~n;
+    state.playerId = (uint8_t)(n >> 16);
+    state.gameOverCount = n ^ 0x5A5A5A5A;
+    state.gameOverMs = n * 7;
+    state.lastRoundPacket = (uint8_t)(n >> 24);
+    state.clockCount = n * 13;
+    state.clockOffsetMs = -(int32_t)n;
+    return state;
+}
+
+static bool consistent(const RemoteState &state) {
+    RemoteState expected = numberedState(state.positionCount);
+    return state.x == expected.x && state.y == expected.y && state.seq == expected.seq &&
+           state.flags == expected.flags && state.sentMs == expected.sentMs &&
+           state.receivedMs == expected.receivedMs &&
+           state.connectedCount == expected.connectedCount && state.playerId == expected.playerId &&
+           state.gameOverCount == expected.gameOverCount && state.gameOverMs == expected.gameOverMs &&
+           state.lastRoundPacket == expected.lastRoundPacket && state.clockCount == expected.clockCount &&
+           state.clockOffsetMs == expected.clockOffsetMs;
+}
+
+BENCH(remote_cell_publish) {
+    SeqlockCell<RemoteState> cell;
+    RemoteState state = {};
+    GamePacket packet = makePositionPacket(0, 100, 100);
+    for (uint32_t i = 0; i < iterations; i++) {
+        packet.seq = (uint8_t)i;
+        applyPacket(state, packet, i);
+        cell.write(state);
+    }
+    doNotOptimize(state);
+}
+
+BENCH(remote_cell_read) {
+    SeqlockCell<RemoteState> cell;
+    cell.write(numberedState(1));
+    RemoteState state;
+    for (uint32_t i = 0; i < iterations; i++) {
+        cell.read(state);
+        doNotOptimize(state);
+    }
+}
+
+// Writer on its own thread, reads here
+static void runThreaded(uint32_t reads) {
+    SeqlockCell<RemoteState> cell;
+    cell.write(numberedState(0));
+    std::atomic<bool> stop(false);
+
+    std::thread writer([&]() {
+        for (uint32_t n = 1; !stop; n++) cell.write(numberedState(n));
+    });
+
+    uint32_t lastCount = 0;
+    RemoteState state;
+    for (uint32_t i = 0; i < reads; i++) {
+        cell.read(state);
+        CHECKF(consistent(state), "read %u: torn copy of state %u", i, state.positionCount);
+        CHECKF(state.positionCount >= lastCount, "read %u: state %u after %u", i, state.positionCount, lastCount);
+        lastCount = state.positionCount;
+    }
+    stop = true;
+    writer.join();
+}
+
+BENCH(remote_cell_threaded_stress) {
+    runThreaded(iterations);
+}
+
+TEST(remote_cell_threaded) {
+    runThreaded(2000000);
+}
+
+// The client's side of roundChange(): a frame reads whatever arrived since the last one
+struct RoundClient {
+    RemoteState remote;
+    RemoteState seen;
+    bool over;
+    int rounds;
+
+    RoundClient() : remote(), seen(), over(false), rounds(0) {}
+
+    void frame() {
+        RoundChange change = roundChange(seen, remote);
+        if (change.ended && !change.endedLast) over = true;
+        if (change.started) {
+            over = false;
+            rounds++;
+        }
+        if (change.endedLast) over = true;
+        seen = remote;
+    }
+};
+
+TEST(remote_round_order) {
+    uint8_t seq = 0;
+    const GamePacket CONNECTED = makeConnectedPacket(seq++, 1);
+    const GamePacket GAMEOVER = makeGameOverPacket(seq++, 12345);
+
+    // Joining during a game over: the welcome and the game over in one frame
+    {
+        RoundClient client;
+        applyPacket(client.remote, CONNECTED, 0);
+        applyPacket(client.remote, GAMEOVER, 0);
+        client.frame();
+        CHECKF(client.over && client.rounds == 1, "over %d, %d rounds", client.over, client.rounds);
+        CHECK(client.remote.gameOverMs == 12345);
+
+        // The server's next round
+        applyPacket(client.remote, CONNECTED, 0);
+        client.frame();
+        CHECKF(!client.over && client.rounds == 2, "over %d, %d rounds", client.over, client.rounds);
+    }
+
+    // The same two packets a frame apart
+    {
+        RoundClient client;
+        applyPacket(client.remote, CONNECTED, 0);
+        client.frame();
+        CHECK(!client.over);
+        applyPacket(client.remote, GAMEOVER, 0);
+        client.frame();
+        CHECK(client.over);
+    }
+
+    // A game over and the restart right behind it, in one frame
+    {
+        RoundClient client;
+        applyPacket(client.remote, CONNECTED, 0);
+        client.frame();
+        applyPacket(client.remote, GAMEOVER, 0);
+        applyPacket(client.remote, CONNECTED, 0);
+        client.frame();
+        CHECKF(!client.over && client.rounds == 2, "over %d, %d rounds", client.over, client.rounds);
+    }
+
+    // Positions in between change nothing
+    {
+        RoundClient client;
+        applyPacket(client.remote, CONNECTED, 0);
+        applyPacket(client.remote, GAMEOVER, 0);
+        applyPacket(client.remote, makePositionPacket(seq++, 100, 100), 0);
+        client.frame();
+        CHECK(client.over);
+    }
+}
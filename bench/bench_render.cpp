@@ -0,0 +1,149 @@
+#include "Bench.h"
+#include "Test.h"
+#include "CountingSurface.h"
+
+#include <GameCore.h>
+#include <FrameCompositor.h>
+#include <GameRender.h>
+
+///////////////////////////////////////////////////////////////
+// Rendering benchmarks: a round of play drawn the old way
+// (fillScreen + dots + HUD every frame) and with DirtyRenderer.
+// Both report the pixels pushed to the LCD per frame.
+//
+// render_dirty plays the same round, with the remote dot
+// coming and going and the screen now and then drawn over (a
+// game over), and checks the dirty renderer leaves exactly the
+// pixels a full redraw does after every frame, pushes under 1%
+// of the old way's pixels, nothing for an unchanged frame and
+// the whole screen after invalidate().
+///////////////////////////////////////////////////////////////
+static void playFrame(GameState &state, uint32_t frameIndex) {
+    // Sweep the joystick so the local dot keeps moving
+    GameInput input;
+    input.joyX = (frameIndex / 64) % 2 ? 1023 : 0;
+    input.joyY = (frameIndex / 48) % 2 ? 1023 : 0;
+    input.buttons = 0;
+    step(state, input, 30);
+    state.gameOver = false;  // Keep playing through collisions
+    if (frameIndex % 3 == 0) setRemotePosition(state, 160 + (frameIndex % 40), 120);
+}
+
+// The frame the round shows at frameIndex (remote dot hidden now and then)
+static void roundFrame(GameState &state, uint32_t frameIndex, RenderFrame &frame) {
+    playFrame(state, frameIndex);
+    buildGameFrame(state, COLOR_RED, COLOR_BLUE, frame);
+    if ((frameIndex / 100) % 5 == 4) frame.dots[1].visible = false;
+}
+
+static bool sameScreen(const MemorySurface &a, const MemorySurface &b) {
+    return memcmp(a.pixels, b.pixels, FIELD_WIDTH * FIELD_HEIGHT * sizeof(uint16_t)) == 0;
+}
+
+TEST(render_dirty) {
+    const uint32_t FRAMES = 3000;
+    MemorySurface dirty, full;
+    if (!CHECK(dirty.begin() && full.begin())) return;
+    DirtyRenderer renderer(dirty);
+    DirtyRenderer reference(full);
+    CountingSurface lcd;
+    DirtyRenderer counted(lcd);
+    GameState state;
+    resetGame(state, 7);
+    RenderFrame frame;
+    uint64_t pushed = 0;
+
+    for (uint32_t i = 0; i < FRAMES; i++) {
+        roundFrame(state, i, frame);
+        if (i % 300 == 299) {
+            // Something else drew over the screen
+            dirty.fillRect(0, 0, FIELD_WIDTH, FIELD_HEIGHT, COLOR_WHITE);
+            renderer.invalidate();
+            counted.invalidate();
+        }
+        renderer.render(frame);
+        reference.invalidate();
+        reference.render(frame);
+        CHECKF(sameScreen(dirty, full), "frame %u: dots at %d,%d and %d,%d", i, frame.dots[0].x, frame.dots[0].y,
+               frame.dots[1].x, frame.dots[1].y);
+
+        uint64_t before = lcd.pixels;
+        counted.render(frame);
+        uint64_t pixels = lcd.pixels - before;
+        if (i % 300 == 299) {
+            CHECKF(pixels >= (uint64_t)FIELD_WIDTH * FIELD_HEIGHT, "frame %u: %llu pixels after invalidate()", i,
+                   (unsigned long long)pixels);
+        }
+        if (i > 0 && i % 300 != 299) pushed += pixels;
+
+        before = lcd.pixels;
+        counted.render(frame);  // Same frame again
+        CHECKF(lcd.pixels == before, "frame %u repeated: %llu pixels", i, (unsigned long long)(lcd.pixels - before));
+    }
+    // The old way pushes at least the whole field every frame
+    CHECKF(pushed * 100 < (uint64_t)(FRAMES - 1) * FIELD_WIDTH * FIELD_HEIGHT, "%.0f pixels/frame",
+           (double)pushed / (FRAMES - 1));
+}
+
+BENCH(render_full_screen) {
+    CountingSurface lcd;
+    GameState state;
+    resetGame(state, 7);
+    RenderFrame frame;
+    for (uint32_t i = 0; i < iterations; i++) {
+        playFrame(state, i);
+        buildGameFrame(state, COLOR_RED, COLOR_BLUE, frame);
+
+        lcd.fillRect(0, 0, FIELD_WIDTH, FIELD_HEIGHT, COLOR_BLACK);
+        for (int d = 0; d < frame.dotCount; d++) {
+            const RenderDot &dot = frame.dots[d];
+            if (dot.visible) lcd.fillRect(dot.x, dot.y, DOT_SIZE, DOT_SIZE, dot.color);
+        }
+        lcd.drawText(frame.hudX, frame.hudY, frame.hud, (int)strlen(frame.hud), frame.hudSize,
+                     COLOR_WHITE, COLOR_BLACK);
+    }
+    benchMetric("pixels/frame", (double)lcd.pixels / iterations);
+}
+
+BENCH(render_dirty_rect) {
+    CountingSurface lcd;
+    DirtyRenderer renderer(lcd);
+    GameState state;
+    resetGame(state, 7);
+    RenderFrame frame;
+    for (uint32_t i = 0; i < iterations; i++) {
+        playFrame(state, i);
+        buildGameFrame(state, COLOR_RED, COLOR_BLUE, frame);
+        renderer.render(frame);
+    }
+    benchMetric("pixels/frame", (double)lcd.pixels / iterations);
+}
+
+// Off-screen mode: compose the whole frame into a RAM framebuffer
+BENCH(render_composite_memory) {
+    MemorySurface surface;
+    if (!surface.begin()) return;
+    FrameCompositor compositor(surface);
+    GameState state;
+    resetGame(state, 7);
+    RenderFrame frame;
+    for (uint32_t i = 0; i < iterations; i++) {
+        playFrame(state, i);
+        buildGameFrame(state, COLOR_RED, COLOR_BLUE, frame);
+        compositor.composeGame(frame);
+        compositor.flush();
+    }
+    doNotOptimize(surface.pixelAt(state.local.x, state.local.y));
+    benchMetric("bytes flushed/frame", (double)surface.flushedBytes / iterations);
+}
+
+BENCH(render_composite_game_over) {
+    MemorySurface surface;
+    if (!surface.begin()) return;
+    FrameCompositor compositor(surface);
+    for (uint32_t i = 0; i < iterations; i++) {
+        compositor.composeGameOver(i * 30, true);
+        compositor.flush();
+    }
+    doNotOptimize(surface.pixelAt(50, 100));
+}
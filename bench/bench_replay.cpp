@@ -0,0 +1,322 @@
+#include "Bench.h"
+#include "Test.h"
+
+#include <GameCore.h>
+#include <SessionLog.h>
+#include <vector>
+
+///////////////////////////////////////////////////////////////
+// Session record / replay.
+//
+// recordSession() plays rounds the way the sketches do (random
+// stick walk, START / SELECT presses, a remote dot, a spawn
+// overlap, ticks that catch up with two steps, game over on a
+// hit) while a SessionRecorder writes to memory.
+//
+// replay_session replays that recording and expects every
+// tick's state hash to match, the same tick / round / packet
+// counts and nothing skipped, and checks that a damaged tick
+// frame or a different stick curve makes the replay report a
+// mismatch. replay_codec round-trips each record type.
+// replay_serial records through a SessionChannel drained a
+// little each tick into a UART shared with other text, and
+// checks the capture replays in full; with a ring too small for
+// the UART it checks the recording stops cleanly and replays up
+// to there.
+///////////////////////////////////////////////////////////////
+struct VectorSink {
+    size_t write(const uint8_t *data, size_t length) {
+        bytes.insert(bytes.end(), data, data + length);
+        return length;
+    }
+    std::vector<uint8_t> bytes;
+};
+
+struct RecordedSession {
+    std::vector<uint8_t> bytes;
+    uint32_t ticks;
+    uint32_t rounds;
+    uint32_t packets;
+    uint32_t finalHash;
+};
+
+static int walk(uint32_t &rng, int value, int step, int low, int high) {
+    return clampInt(value + randomBetween(rng, -step, step + 1), low, high);
+}
+
+// Plays ticks into sink; afterTick() runs after each one
+template <typename Sink, typename AfterTick>
+static RecordedSession playSession(uint32_t ticks, Sink &sink, AfterTick afterTick) {
+    SessionRecorder<Sink> recorder(sink);
+    recorder.begin(SESSION_ROLE_SERVER);
+
+    RecordedSession session = { std::vector<uint8_t>(), 0, 0, 0, 0 };
+    GameState game;
+    uint32_t rng = 77, nowMs = 0;
+    int joyX = JOYSTICK_CENTER, joyY = JOYSTICK_CENTER;
+    int remoteX = 160, remoteY = 120;
+    uint32_t roundTick = 0;
+    InputSnapshot snapshot = {};
+
+    for (uint32_t t = 0; t < ticks; t++, roundTick++) {
+        if (t == 0 || game.gameOver || roundTick == 2000) {
+            uint32_t seed = nextRandom(rng) | 1;
+            resetGame(game, seed);
+            game.buttonsHeld = snapshot.input.buttons;  // Like the server's START restart
+            recorder.round(seed, game);
+            session.rounds++;
+            roundTick = 0;
+        }
+
+        nowMs += 30;
+        uint32_t held = snapshot.input.buttons;
+        joyX = walk(rng, joyX, 120, 0, 1023);
+        joyY = walk(rng, joyY, 120, 0, 1023);
+        uint32_t buttons = 0;
+        if (nextRandom(rng) % 40 == 0) buttons |= GAME_BUTTON_START;
+        if (nextRandom(rng) % 150 == 0) buttons |= GAME_BUTTON_SELECT;
+        snapshot.timeMs = nowMs - 4;
+        snapshot.input.joyX = joyX;
+        snapshot.input.joyY = joyY;
+        snapshot.input.buttons = buttons;
+        snapshot.pressed = buttons & ~held;
+        snapshot.released = held & ~buttons;
+
+        if (roundTick == 10) {
+            recorder.spawn(game.local.x + 5, game.local.y - 5);
+            avoidSpawnOverlap(game, game.local.x + 5, game.local.y - 5);
+        }
+        if (roundTick % 3 == 0) {
+            remoteX = walk(rng, remoteX, 6, 0, FIELD_MAX_X);
+            remoteY = walk(rng, remoteY, 6, 0, FIELD_MAX_Y);
+            recorder.remote(remoteX, remoteY);
+            setRemotePosition(game, remoteX, remoteY);
+
+            uint8_t packet[9] = { 1, (uint8_t)t, (uint8_t)remoteX, (uint8_t)(remoteX >> 8),
+                                  (uint8_t)remoteY, (uint8_t)(remoteY >> 8), 0, 0, 0 };
+            recorder.packet(nowMs - 12, 1, packet, sizeof(packet));
+            session.packets++;
+        }
+
+        uint32_t steps = t % 7 == 0 ? 2 : 1;
+        for (uint32_t s = 0; s < steps; s++) step(game, snapshot, 30, s == 0);
+        recorder.tick(nowMs, snapshot, 30, steps, game);
+        session.ticks++;
+
+        if (game.gameOver) recorder.gameOver(game);
+        afterTick();
+    }
+
+    session.finalHash = gameStateHash(game);
+    return session;
+}
+
+static RecordedSession recordSession(uint32_t ticks) {
+    VectorSink sink;
+    RecordedSession session = playSession(ticks, sink, []() {});
+    session.bytes.swap(sink.bytes);
+    return session;
+}
+
+TEST(replay_codec) {
+    for (int type = 0; type < SESSION_RECORD_TYPES; type++) {
+        SessionRecord record;
+        memset(&record, 0, sizeof(record));
+        record.type = (uint8_t)type;
+        record.version = SESSION_VERSION;
+        record.role = SESSION_ROLE_CLIENT;
+        record.seed = 0xDEADBEEF;
+        record.detectCollisions = true;
+        record.buttonsHeld = GAME_BUTTON_START;
+        record.nowMs = 0x01020304;
+        InputSnapshot snapshot = { 0xA0B0C0D0, { 1023, 3, GAME_BUTTON_START | GAME_BUTTON_A }, GAME_BUTTON_A,
+                                   GAME_BUTTON_SELECT };
+        record.snapshot = snapshot;
+        record.stepMs = 30;
+        record.steps = 3;
+        record.stateHash = 0x12345678;
+        record.x = -1;
+        record.y = 235;
+        record.elapsedMs = 654321;
+        record.source = 2;
+        record.length = 9;
+        for (int i = 0; i < 9; i++) record.bytes[i] = (uint8_t)(i * 29);
+
+        // Clear what this type doesn't carry, so a whole-record compare works
+        SessionRecord expected;
+        memset(&expected, 0, sizeof(expected));
+        expected.type = record.type;
+        switch (type) {
+        case SESSION_HEADER: expected.version = record.version; expected.role = record.role; break;
+        case SESSION_ROUND:
+            expected.seed = record.seed;
+            expected.detectCollisions = true;
+            expected.buttonsHeld = record.buttonsHeld;
+            break;
+        case SESSION_TICK:
+            expected.nowMs = record.nowMs;
+            expected.snapshot = record.snapshot;
+            expected.stepMs = record.stepMs;
+            expected.steps = record.steps;
+            expected.stateHash = record.stateHash;
+            break;
+        case SESSION_REMOTE:
+        case SESSION_SPAWN: expected.x = record.x; expected.y = record.y; break;
+        case SESSION_GAME_OVER: expected.elapsedMs = record.elapsedMs; break;
+        case SESSION_PACKET:
+            expected.nowMs = record.nowMs;
+            expected.source = record.source;
+            expected.length = record.length;
+            memcpy(expected.bytes, record.bytes, record.length);
+            break;
+        }
+
+        uint8_t frame[SESSION_FRAME_MAX_SIZE];
+        size_t length = encodeSessionRecord(record, frame);
+        SessionRecord decoded;
+        if (!CHECKF(decodeSessionRecord(frame, length, decoded) == (int)length, "type %d", type)) continue;
+        bool same = !(decoded.type != expected.type || decoded.version != expected.version || decoded.role != expected.role ||
+            decoded.seed != expected.seed || decoded.detectCollisions != expected.detectCollisions ||
+            decoded.buttonsHeld != expected.buttonsHeld ||
+            decoded.nowMs != expected.nowMs || decoded.snapshot.timeMs != expected.snapshot.timeMs ||
+            decoded.snapshot.input.joyX != expected.snapshot.input.joyX ||
+            decoded.snapshot.input.joyY != expected.snapshot.input.joyY ||
+            decoded.snapshot.input.buttons != expected.snapshot.input.buttons ||
+            decoded.snapshot.pressed != expected.snapshot.pressed ||
+            decoded.snapshot.released != expected.snapshot.released || decoded.stepMs != expected.stepMs ||
+            decoded.steps != expected.steps || decoded.stateHash != expected.stateHash ||
+            decoded.x != expected.x || decoded.y != expected.y || decoded.elapsedMs != expected.elapsedMs ||
+            decoded.source != expected.source || decoded.length != expected.length ||
+            memcmp(decoded.bytes, expected.bytes, sizeof(expected.bytes)) != 0);
+        CHECKF(same, "type %d", type);
+
+        for (size_t i = 0; i < length; i++) {
+            frame[i] ^= 0x08;
+            CHECKF(decodeSessionRecord(frame, length, decoded) <= 0, "type %d, byte %u flipped", type, (unsigned)i);
+            frame[i] ^= 0x08;
+        }
+        CHECKF(decodeSessionRecord(frame, length - 1, decoded) == 0, "type %d cut short", type);
+    }
+}
+
+// Offset of the nth frame of a type in a recording
+static size_t findFrame(const std::vector<uint8_t> &bytes, uint8_t type, int nth) {
+    size_t at = 0;
+    while (at < bytes.size()) {
+        SessionRecord record;
+        int result = decodeSessionRecord(&bytes[at], bytes.size() - at, record);
+        if (result <= 0) return bytes.size();
+        if (record.type == type && nth-- == 0) return at;
+        at += result;
+    }
+    return bytes.size();
+}
+
+TEST(replay_session) {
+    RecordedSession session = recordSession(20000);
+
+    SessionReplayer replayer;
+    size_t skipped = 0;
+    replaySession(replayer, &session.bytes[0], session.bytes.size(), &skipped);
+    CHECKF(replayer.mismatchTick() == -1 && skipped == 0, "mismatch at tick %d, %u bytes skipped",
+           (int)replayer.mismatchTick(), (unsigned)skipped);
+    CHECKF(replayer.ticks() == session.ticks && replayer.rounds() == session.rounds &&
+           replayer.packets() == session.packets && replayer.sessionRole() == SESSION_ROLE_SERVER,
+           "%u ticks, %u rounds, %u packets replayed; %u, %u, %u recorded", (unsigned)replayer.ticks(),
+           (unsigned)replayer.rounds(), (unsigned)replayer.packets(), session.ticks, session.rounds,
+           session.packets);
+    CHECK(gameStateHash(replayer.state()) == session.finalHash);
+
+    // A damaged tick is skipped, and the ticks after it no longer match
+    std::vector<uint8_t> damaged = session.bytes;
+    size_t tick = findFrame(damaged, SESSION_TICK, 5);
+    if (CHECK(tick < damaged.size())) {
+        damaged[tick + 9] ^= 0x40;  // Joystick X
+        SessionReplayer broken;
+        replaySession(broken, &damaged[0], damaged.size(), &skipped);
+        CHECK(skipped > 0 && broken.mismatchTick() >= 0);
+    }
+
+    // The stick curve isn't in the recording: the wrong one shows up
+    SessionReplayer linear(StickShaper(JOYSTICK_DEADZONE, STICK_CURVE_LINEAR));
+    replaySession(linear, &session.bytes[0], session.bytes.size());
+    CHECK(linear.mismatchTick() >= 0);
+}
+
+// A UART with room for `room` more bytes
+struct SerialSink {
+    int availableForWrite() const {
+        return room;
+    }
+    size_t write(const uint8_t *data, size_t length) {
+        room -= (int)length;
+        bytes.insert(bytes.end(), data, data + length);
+        return length;
+    }
+    int room;
+    std::vector<uint8_t> bytes;
+};
+
+// Records through channel, draining up to roomPerTick bytes after each tick between other text
+template <size_t Capacity>
+static RecordedSession recordSerial(SessionChannel<Capacity> &channel, int roomPerTick, SerialSink &uart,
+                                    size_t &textBytes) {
+    const char *text = "Player 1 connected\n";
+    textBytes = 0;
+    RecordedSession session = playSession(3000, channel, [&]() {
+        uart.room = roomPerTick;
+        channel.drain(uart);
+        uart.bytes.insert(uart.bytes.end(), text, text + strlen(text));
+        textBytes += strlen(text);
+    });
+    uart.room = 1 << 30;
+    channel.drain(uart);
+    return session;
+}
+
+TEST(replay_serial) {
+    // The UART keeps up: everything arrives, around the text
+    {
+        SessionChannel<64> channel;
+        SerialSink uart = { 0, std::vector<uint8_t>() };
+        size_t textBytes;
+        RecordedSession session = recordSerial(channel, 120, uart, textBytes);
+        CHECK(!channel.overflowed());
+        SessionReplayer replayer;
+        size_t skipped = 0;
+        replaySession(replayer, &uart.bytes[0], uart.bytes.size(), &skipped);
+        CHECKF(replayer.mismatchTick() == -1 && replayer.ticks() == session.ticks && skipped == textBytes,
+               "mismatch at tick %d, %u of %u ticks, %u bytes skipped for %u of text", (int)replayer.mismatchTick(),
+               (unsigned)replayer.ticks(), session.ticks, (unsigned)skipped, (unsigned)textBytes);
+        CHECK(gameStateHash(replayer.state()) == session.finalHash);
+    }
+
+    // It doesn't: the ring fills, recording stops, and what made it out still replays
+    {
+        SessionChannel<8> channel;
+        SerialSink uart = { 0, std::vector<uint8_t>() };
+        size_t textBytes;
+        RecordedSession session = recordSerial(channel, 40, uart, textBytes);
+        CHECK(channel.overflowed());
+        SessionReplayer replayer;
+        replaySession(replayer, &uart.bytes[0], uart.bytes.size());
+        CHECKF(replayer.mismatchTick() == -1 && replayer.ticks() > 0 && replayer.ticks() < session.ticks,
+               "mismatch at tick %d, %u of %u ticks", (int)replayer.mismatchTick(), (unsigned)replayer.ticks(),
+               session.ticks);
+    }
+}
+
+///////////////////////////////////////////////////////////////
+// Cost of replaying one tick (decode + step + hash)
+///////////////////////////////////////////////////////////////
+BENCH(session_replay) {
+    static RecordedSession session = recordSession(10000);
+    uint32_t replayed = 0;
+    while (replayed < iterations) {
+        SessionReplayer replayer;
+        replaySession(replayer, &session.bytes[0], session.bytes.size());
+        replayed += replayer.ticks();
+        doNotOptimize(replayer.state().local.x);
+    }
+    benchMetric("bytes/tick", (double)session.bytes.size() / session.ticks);
+}
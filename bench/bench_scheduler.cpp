@@ -0,0 +1,215 @@
+#include "Bench.h"
+#include "Test.h"
+
+#include <FrameScheduler.h>
+#include <GameCore.h>
+
+///////////////////////////////////////////////////////////////
+// Fixed-timestep scheduler benchmarks, driven by a fake clock.
+// Every frame "renders" for a varying, sometimes over-budget
+// time; the metric is simulated game time per wall-clock second,
+// which stays at 1.0 as long as the catch-up steps keep up (the
+// old delay(30) loop ran slower the longer a frame took).
+//
+// scheduler_script steps the fake clock through a script and
+// checks dueCount() after every update(): nothing on the first
+// call or after restart(), remainders carried to the next
+// period, catch-up capped at SCHEDULER_MAX_CATCHUP with the rest
+// counted as dropped, render and network running once and
+// skipping missed slots, untilNextUs(), the micros() wrap, and
+// lastUs / worstUs / overruns from begin() and end().
+// scheduler_accounting checks that over the benchmark's frame
+// pattern every simulation period that passed is either run or
+// dropped.
+///////////////////////////////////////////////////////////////
+struct FakeClock {
+    FakeClock() : us(0), totalUs(0) {}
+
+    uint32_t nowUs() {
+        return us;
+    }
+
+    void advance(uint32_t deltaUs) {
+        us += deltaUs;  // Wraps like micros()
+        totalUs += deltaUs;
+    }
+
+    uint32_t us;
+    uint64_t totalUs;
+};
+
+// Frame cost pattern: mostly cheap, sometimes a full-screen redraw, now and then a long stall
+static uint32_t renderCostUs(uint32_t frameIndex) {
+    if (frameIndex % 97 == 0) return 80000;
+    if (frameIndex % 10 == 0) return 25000;
+    return 3000;
+}
+
+typedef FrameScheduler<FakeClock> FakeScheduler;
+
+#define expectDue(scheduler, simulate, render, network) checkDue(scheduler, simulate, render, network, __LINE__)
+
+static void checkDue(FakeScheduler &scheduler, uint32_t simulate, uint32_t render, uint32_t network, int line) {
+    scheduler.update();
+    uint32_t s = scheduler.dueCount(STAGE_SIMULATE), r = scheduler.dueCount(STAGE_RENDER);
+    uint32_t n = scheduler.dueCount(STAGE_NETWORK);
+    CHECKF(s == simulate && r == render && n == network && scheduler.isDue(STAGE_RENDER) == (render > 0),
+           "line %d: due %u/%u/%u, expected %u/%u/%u", line, s, r, n, simulate, render, network);
+}
+
+static void configure(FakeScheduler &scheduler) {
+    scheduler.setStage(STAGE_SIMULATE, 30000);
+    scheduler.setStage(STAGE_RENDER, 50000, 20000);
+    scheduler.setStage(STAGE_NETWORK, 100000);
+}
+
+TEST(scheduler_script) {
+    FakeClock clock;
+    FakeScheduler scheduler(clock);
+    configure(scheduler);
+    CHECK(scheduler.stepMs() == 30);
+
+    // Accumulators: sim 0, render 0, network 0 after each line's update
+    expectDue(scheduler, 0, 0, 0);  // Only starts the clock
+    clock.advance(29999);
+    expectDue(scheduler, 0, 0, 0);  // 29999, 29999, 29999
+    clock.advance(1);
+    expectDue(scheduler, 1, 0, 0);  // 0, 30000, 30000
+    clock.advance(20000);
+    expectDue(scheduler, 0, 1, 0);  // 20000, 0, 50000
+    CHECK(scheduler.untilNextUs() == 10000);
+    clock.advance(4000);
+    CHECK(scheduler.untilNextUs() == 6000);
+    clock.advance(66000);
+    expectDue(scheduler, 3, 1, 1);  // 0, 20000, 20000
+    CHECK(scheduler.stageStats(STAGE_SIMULATE).dropped == 0 && scheduler.stageStats(STAGE_RENDER).dropped == 0);
+
+    // A 400 ms stall: 13 steps due, 4 run; 8 render slots, 1 run; 4 network slots, 1 run
+    clock.advance(400000);
+    expectDue(scheduler, SCHEDULER_MAX_CATCHUP, 1, 1);  // 10000, 20000, 20000
+    const StageStats &simulate = scheduler.stageStats(STAGE_SIMULATE);
+    const StageStats &render = scheduler.stageStats(STAGE_RENDER);
+    const StageStats &network = scheduler.stageStats(STAGE_NETWORK);
+    CHECKF(simulate.dropped == 13 - SCHEDULER_MAX_CATCHUP && render.dropped == 7 && network.dropped == 3,
+           "dropped %u/%u/%u", simulate.dropped, render.dropped, network.dropped);
+    CHECKF(simulate.runs == 4 + SCHEDULER_MAX_CATCHUP && render.runs == 3 && network.runs == 2, "runs %u/%u/%u",
+           simulate.runs, render.runs, network.runs);
+    CHECK(scheduler.untilNextUs() == 20000);
+
+    // Stage timing against the render budget (20 ms)
+    scheduler.begin(STAGE_RENDER);
+    clock.advance(25000);
+    scheduler.end(STAGE_RENDER);
+    scheduler.begin(STAGE_RENDER);
+    clock.advance(10000);
+    scheduler.end(STAGE_RENDER);
+    scheduler.begin(STAGE_SIMULATE);
+    clock.advance(30000);  // Exactly the budget is not an overrun
+    scheduler.end(STAGE_SIMULATE);
+    CHECKF(render.lastUs == 10000 && render.worstUs == 25000 && render.overruns == 1,
+           "render last %u us, worst %u us, %u overruns", render.lastUs, render.worstUs, render.overruns);
+    CHECKF(simulate.lastUs == 30000 && simulate.overruns == 0 && scheduler.totalOverruns() == 1,
+           "simulate last %u us, %u overruns", simulate.lastUs, simulate.overruns);
+    CHECK(scheduler.untilNextUs() == 0);  // 65 ms went by inside the stages
+    expectDue(scheduler, 2, 1, 0);      // 15000, 35000, 85000
+
+    // resetStats() keeps the periods, restart() forgets the time that passed
+    scheduler.resetStats();
+    CHECK(simulate.runs == 0 && render.worstUs == 0 && scheduler.totalOverruns() == 0 && scheduler.stepMs() == 30);
+    clock.advance(1000000);
+    scheduler.restart();
+    expectDue(scheduler, 0, 0, 0);
+    clock.advance(30000);
+    expectDue(scheduler, 1, 0, 0);
+    CHECK(simulate.dropped == 0);
+
+    // Across the micros() wrap
+    FakeClock wrapping;
+    wrapping.us = 0xFFFFFFFF - 10000;
+    FakeScheduler late(wrapping);
+    configure(late);
+    expectDue(late, 0, 0, 0);
+    wrapping.advance(30000);
+    expectDue(late, 1, 0, 0);
+    wrapping.advance(70000);
+    expectDue(late, 2, 1, 1);
+}
+
+// Every simulation period is run or dropped, whatever the frames cost
+TEST(scheduler_accounting) {
+    FakeClock clock;
+    FakeScheduler scheduler(clock);
+    configure(scheduler);
+    scheduler.update();
+    uint64_t runs = 0;
+    for (uint32_t i = 0; i < 100000; i++) {
+        clock.advance(renderCostUs(i));
+        scheduler.update();
+        runs += scheduler.dueCount(STAGE_SIMULATE);
+        if (!CHECKF(scheduler.dueCount(STAGE_SIMULATE) <= SCHEDULER_MAX_CATCHUP && scheduler.dueCount(STAGE_RENDER) <= 1,
+                    "frame %u: %u steps, %u renders due", i, scheduler.dueCount(STAGE_SIMULATE),
+                    scheduler.dueCount(STAGE_RENDER))) {
+            return;
+        }
+        clock.advance(scheduler.untilNextUs());
+    }
+    scheduler.update();
+    runs += scheduler.dueCount(STAGE_SIMULATE);
+    const StageStats &simulate = scheduler.stageStats(STAGE_SIMULATE);
+    CHECKF(runs == simulate.runs, "%llu steps due, %u counted as run", (unsigned long long)runs, simulate.runs);
+    CHECKF(simulate.runs + simulate.dropped == clock.totalUs / 30000, "%u run + %u dropped, %llu periods passed",
+           simulate.runs, simulate.dropped, (unsigned long long)(clock.totalUs / 30000));
+}
+
+BENCH(scheduler_fixed_step) {
+    FakeClock clock;
+    FrameScheduler<FakeClock> scheduler(clock);
+    scheduler.setStage(STAGE_SIMULATE, 30000);
+    scheduler.setStage(STAGE_RENDER, 30000);
+    scheduler.setStage(STAGE_NETWORK, 100000);
+
+    GameState state;
+    resetGame(state, 1);
+    GameInput input = {1023, 512, 0};
+    uint64_t steps = 0;
+    scheduler.update();
+
+    for (uint32_t i = 0; i < iterations; i++) {
+        scheduler.update();
+        for (uint32_t s = 0; s < scheduler.dueCount(STAGE_SIMULATE); s++) {
+            scheduler.begin(STAGE_SIMULATE);
+            step(state, input, scheduler.stepMs());
+            steps++;
+            clock.advance(50);
+            scheduler.end(STAGE_SIMULATE);
+        }
+        if (scheduler.isDue(STAGE_RENDER)) {
+            scheduler.begin(STAGE_RENDER);
+            clock.advance(renderCostUs(i));
+            scheduler.end(STAGE_RENDER);
+        }
+        clock.advance(scheduler.untilNextUs());
+        state.gameOver = false;
+    }
+    doNotOptimize(state);
+
+    // Dropped steps (stalls longer than the catch-up limit) are the only time lost
+    benchMetric("game time per real second", steps * 30000.0 / clock.totalUs);
+}
+
+// The same frames with the original "step by the time since last frame, then delay(30)"
+BENCH(scheduler_legacy_delay) {
+    uint64_t clockUs = 0, simulatedMs = 0;
+    GameState state;
+    resetGame(state, 1);
+    GameInput input = {1023, 512, 0};
+
+    for (uint32_t i = 0; i < iterations; i++) {
+        step(state, input, 30);
+        simulatedMs += 30;  // Movement is per step, so speed only depends on the step count
+        clockUs += 50 + renderCostUs(i) + 30000;
+        state.gameOver = false;
+    }
+    doNotOptimize(state);
+    benchMetric("game time per real second", simulatedMs * 1000.0 / clockUs);
+}
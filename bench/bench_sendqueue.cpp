@@ -0,0 +1,93 @@
+#include "Bench.h"
+#include "Test.h"
+
+#include <GameCore.h>
+#include <GameProtocol.h>
+#include <PositionCodec.h>
+#include <SendQueue.h>
+
+///////////////////////////////////////////////////////////////
+// Client upload path over a congested fake radio. Positions
+// are produced every 30 ms, writes take 10-150 ms to complete
+// (and 2% of completions are never reported), and at most two
+// writes may be in flight. sendqueue_upload checks that the
+// receiver never decodes a wrong position and that the
+// in-flight bound holds.
+///////////////////////////////////////////////////////////////
+struct FakeRadio {
+    FakeRadio() : rng(31337), count(0) {}
+
+    void write(uint32_t nowMs, const uint8_t *frame, size_t length) {
+        Write &w = writes[count++ % 8];
+        w.doneMs = nowMs + randomBetween(rng, 10, 150);
+        w.length = length;
+        w.lost = randomBetween(rng, 0, 100) < 2;
+        for (size_t i = 0; i < length; i++) w.frame[i] = frame[i];
+    }
+
+    uint32_t rng;
+    struct Write {
+        uint32_t doneMs;
+        size_t length;
+        bool lost;
+        uint8_t frame[GAME_PACKET_SIZE];
+    } writes[8];
+    uint32_t count;
+};
+
+// Returns the stale positions dropped per tick
+static double runUploads(uint32_t ticks) {
+    SendQueue queue(2, 250);
+    PositionEncoder encoder(1000);
+    PositionDecoder decoder;
+    FakeRadio radio;
+    uint32_t completed = 0;
+    uint8_t seq = 0;
+    int x = 20, y = 20, dx = 3;
+    int sentX[256], sentY[256];
+
+    for (uint32_t i = 0; i < ticks; i++) {
+        uint32_t now = i * 30;
+
+        // Radio delivers and completes writes in order
+        while (completed < radio.count && radio.writes[completed % 8].doneMs <= now) {
+            FakeRadio::Write &w = radio.writes[completed % 8];
+            GamePacket packet;
+            if (decodePacket(w.frame, w.length, packet) && decoder.decode(packet, packet)) {
+                CHECKF(packet.x == sentX[packet.seq] && packet.y == sentY[packet.seq],
+                       "tick %u: seq %u decoded at %u,%u, sent at %d,%d", i, packet.seq, packet.x, packet.y,
+                       sentX[packet.seq], sentY[packet.seq]);
+            }
+            if (!w.lost) queue.onSent();
+            completed++;
+        }
+
+        x += dx;
+        if (x < 10 || x > 300) dx = -dx;
+        y = 20 + (int)(i / 7 % 200);
+
+        GamePacket packet;
+        if (encoder.encode(seq, x, y, i % 500 == 0 ? PACKET_FLAG_WARPED : 0, now, packet)) {
+            sentX[seq] = x;
+            sentY[seq] = y;
+            seq++;
+            queue.push(packet);
+        }
+
+        while (queue.next(now, packet)) {
+            CHECKF(queue.inFlightCount() <= 2, "tick %u: %d writes in flight", i, (int)queue.inFlightCount());
+            uint8_t frame[GAME_PACKET_SIZE];
+            size_t length = encodePacket(packet, frame);
+            radio.write(now, frame, length);
+        }
+    }
+    return (double)queue.dropped / ticks;
+}
+
+TEST(sendqueue_upload) {
+    runUploads(100000);
+}
+
+BENCH(sendqueue_upload_dropped) {
+    benchMetric("stale positions dropped/tick", runUploads(iterations));
+}
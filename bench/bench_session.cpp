@@ -0,0 +1,343 @@
+#include "Bench.h"
+#include "Test.h"
+
+#include <ClientSession.h>
+#include <GameCore.h>
+#include <GameProtocol.h>
+#include <PlayerTable.h>
+#include <ServerSession.h>
+#include <Transport.h>
+#include <WorldState.h>
+
+#include <vector>
+
+///////////////////////////////////////////////////////////////
+// ServerSession and ClientSession, what both sketches and
+// tools/host_session run, over an in-memory transport.
+//
+// session_server_collisions drives the server with positions
+// written straight into its PlayerTable: two clients on top of
+// each other only end the round once both are past their grace
+// period, our dot jumping over a client between two steps is
+// caught by the swept check, and a client that hit our dot as
+// it saw it (drawn late, after the trip down) is caught by the
+// rewind, which needs the client's CLOCK to take the round trip
+// out. session_loopback plays a server and three clients:
+// everyone gets their id, tracks everyone else and uploads
+// positions and clock offsets, game over reaches every client
+// with the server's time, a client that joins during it sees
+// the round start and end in that order, and START restarts
+// them all.
+///////////////////////////////////////////////////////////////
+static const uint32_t SESSION_DELAY_MS = 150;
+static const uint32_t SESSION_STEP_MS = 30;
+
+// Keeps every frame sent, for the test to deliver
+struct FrameTransport : public Transport {
+    struct Frame {
+        uint16_t link;
+        size_t length;
+        uint8_t data[TRANSPORT_FRAME_MAX_SIZE];
+    };
+    bool send(uint16_t link, const uint8_t *data, size_t length) {
+        Frame frame;
+        frame.link = link;
+        frame.length = length;
+        memcpy(frame.data, data, length);
+        frames.push_back(frame);
+        return true;
+    }
+    void disconnect(uint16_t link) {}
+    std::vector<Frame> frames;
+};
+
+static void placeDot(GameState &game, int x, int y) {
+    game.local.x = x;
+    game.local.y = y;
+}
+
+struct SessionServer : public ServerSessionListener {
+    SessionServer()
+        : session(table, game, transport, *this, SESSION_DELAY_MS, 1000), nowMs(10000), hits(0), hitA(0),
+          hitB(0) {
+        resetGame(game, 5);
+    }
+    void onRoundStart() {
+        resetGame(game, 5);
+        placeDot(game, 250, 200);
+        session.newRound();
+    }
+    void onHit(uint8_t a, uint8_t b) {
+        hits++;
+        hitA = a;
+        hitB = b;
+    }
+
+    // A client on link connects and subscribes
+    void join(uint16_t link) {
+        table.onConnect(link);
+        table.onMtu(link, 185);
+        table.onSubscribe(link, true);
+        session.updatePlayers();
+    }
+    void write(uint16_t link, const GamePacket &packet) {
+        uint8_t frame[GAME_PACKET_SIZE];
+        table.onWrite(link, frame, encodePacket(packet, frame), nowMs);
+    }
+    // One loop() frame with a single step, our dot moving to x, y. True on a hit.
+    bool tick(int x, int y) {
+        bool hit = session.applyRemoteStates(nowMs);
+        int fromX = game.local.x, fromY = game.local.y;
+        placeDot(game, x, y);
+        hit |= session.checkCollisions(fromX, fromY);
+        session.simulated(nowMs, 0);
+        game.elapsedMs += SESSION_STEP_MS;
+        nowMs += SESSION_STEP_MS;
+        return hit;
+    }
+
+    PlayerTable table;
+    GameState game;
+    FrameTransport transport;
+    ServerSession session;
+    uint32_t nowMs;
+    int hits;
+    uint8_t hitA, hitB;
+};
+
+///////////////////////////////////////////////////////////////
+// Collisions: grace, pairs, swept and rewound
+///////////////////////////////////////////////////////////////
+
+// The rewound case with or without the client's CLOCK; true if the server called the hit
+static bool rewoundHit(bool sendClock) {
+    SessionServer server;
+    server.join(1);
+    uint8_t seq = 0;
+    const uint32_t upMs = 30, downMs = 30;  // Same clocks on both sides
+    if (sendClock) server.write(1, makeClockPacket(seq++, (int32_t)downMs));
+
+    // A client at 40,40 well past its grace period, our dot far away
+    for (int t = 0; t < 90; t++) {
+        if (t % 3 == 0) server.write(1, makePositionPacket(seq++, 40, 40, 0, (uint16_t)(server.nowMs - upMs)));
+        if (server.tick(250, 200)) return false;
+    }
+
+    // Our dot is at 100,100 for one step. The client draws that step downMs + SESSION_DELAY_MS
+    // later, and its position from then arrives upMs after that.
+    uint32_t atMs = server.nowMs;
+    server.tick(100, 100);
+    bool hit = false;
+    while (server.nowMs < atMs + downMs + SESSION_DELAY_MS + upMs) hit |= server.tick(250, 200);
+    server.write(1, makePositionPacket(seq++, 100, 100, 0, (uint16_t)(server.nowMs - upMs)));
+    hit |= server.tick(250, 200);
+    return hit && server.hitA == SERVER_PLAYER_ID && server.hitB == 1;
+}
+
+TEST(session_server_collisions) {
+    // Client 2 moves onto client 1 during the grace period; the hit only counts after it
+    {
+        SessionServer server;
+        server.join(1);
+        server.join(2);
+        uint8_t seq1 = 0, seq2 = 0;
+        uint32_t startMs = server.nowMs;
+        int hitAtMs = -1;
+        for (int t = 0; t < 120 && hitAtMs < 0; t++) {
+            uint32_t sinceMs = server.nowMs - startMs;
+            if (t % 3 == 0) {
+                server.write(1, makePositionPacket(seq1++, 100, 60, 0, (uint16_t)server.nowMs));
+                server.write(2, makePositionPacket(seq2++, sinceMs < 1000 ? 200 : 100, 60, 0, (uint16_t)server.nowMs));
+            }
+            if (server.tick(20, 200)) hitAtMs = sinceMs;
+        }
+        CHECKF(hitAtMs > (int)COLLISION_GRACE_MS && hitAtMs < (int)COLLISION_GRACE_MS + 300, "hit at %d ms",
+               hitAtMs);
+        CHECKF(server.hits == 1 && server.hitA + server.hitB == 3, "%d hits, last %u and %u", server.hits,
+               server.hitA, server.hitB);
+    }
+
+    // Our dot hops over a client between two steps (a move short of SWEEP_MAX_MOVE)
+    {
+        SessionServer server;
+        server.join(1);
+        uint8_t seq = 0;
+        bool early = false;
+        for (int t = 0; t < 90; t++) {
+            if (t % 3 == 0) server.write(1, makePositionPacket(seq++, 100, 100, 0, (uint16_t)server.nowMs));
+            early |= server.tick(85, 100);
+        }
+        CHECK(!early);
+        CHECK(!dotsCollide(85, 100, 100, 100) && !dotsCollide(115, 100, 100, 100));
+        CHECK(server.tick(115, 100));
+        CHECK(server.hits == 1 && server.hitA == SERVER_PLAYER_ID && server.hitB == 1);
+    }
+
+    // A client that reached our dot where it saw it; without its CLOCK the rewind lands a round trip late
+    CHECK(rewoundHit(true));
+    CHECK(!rewoundHit(false));
+}
+
+///////////////////////////////////////////////////////////////
+// A server and three clients
+///////////////////////////////////////////////////////////////
+struct SessionClient : public ClientSessionListener {
+    SessionClient()
+        : session(game, transport, *this, SESSION_DELAY_MS, 1000, 2), joined(false), rounds(0), gameOvers(0),
+          spotX(0), spotY(0) {
+        remote = RemoteState();
+        world = RemoteWorld();
+        resetGame(game, 9);
+        game.detectCollisions = false;
+    }
+    void onRoundStart(uint8_t id) {
+        resetGame(game, 9 + id);
+        game.detectCollisions = false;
+        session.newRound();
+        rounds++;
+    }
+    void onGameOver() {
+        gameOvers++;
+    }
+
+    GameState game;
+    FrameTransport transport;
+    ClientSession session;
+    RemoteState remote;
+    RemoteWorld world;
+    bool joined;
+    int rounds, gameOvers;
+    int spotX, spotY;  // Where its dot hovers
+};
+
+static const int LOOPBACK_CLIENTS = MAX_CLIENTS;
+static const int LOOPBACK_SERVER_X = 20, LOOPBACK_SERVER_Y = 20;
+
+struct Loopback {
+    Loopback() : ticks(0) {
+        for (int c = 0; c < LOOPBACK_CLIENTS; c++) {
+            clients[c].spotX = 100 + 60 * c;
+            clients[c].spotY = 150;
+        }
+    }
+    void join(int c) {
+        clients[c].joined = true;
+        server.join((uint16_t)(c + 1));  // Client c is link c + 1
+    }
+
+    // Everyone's loop() for ms, SESSION_STEP_MS at a time; frames arrive the next frame
+    void run(uint32_t ms) {
+        for (uint32_t end = server.nowMs + ms; server.nowMs < end; ticks++) {
+            uint32_t nowMs = server.nowMs;
+            bool network = ticks % 3 == 0;
+
+            deliverDown(nowMs);
+            for (int c = 0; c < LOOPBACK_CLIENTS; c++) {
+                SessionClient &client = clients[c];
+                if (!client.joined) continue;
+                client.session.applyRemoteState(client.remote, client.world, nowMs);
+                if (client.rounds == 0 || client.session.isGameOver()) continue;
+                placeDot(client.game, client.spotX + ticks % 4, client.spotY);
+                if (network) client.session.queueUploads(nowMs);
+                client.session.flush(nowMs);
+            }
+            deliverUp(nowMs);
+
+            server.session.updatePlayers();
+            if (!server.session.roundActive() || server.session.isGameOver()) {
+                server.nowMs += SESSION_STEP_MS;
+                continue;
+            }
+            if (server.tick(LOOPBACK_SERVER_X, LOOPBACK_SERVER_Y)) {
+                server.session.gameOver();
+                continue;
+            }
+            if (network) server.session.broadcastWorld(nowMs);
+        }
+    }
+
+    void deliverDown(uint32_t nowMs) {
+        for (size_t i = 0; i < server.transport.frames.size(); i++) {
+            const FrameTransport::Frame &frame = server.transport.frames[i];
+            SessionClient &client = clients[frame.link - 1];
+            WorldState world;
+            GamePacket packet;
+            if (decodeWorld(frame.data, frame.length, world)) {
+                applyWorld(client.world, world, nowMs);
+            } else if (decodePacket(frame.data, frame.length, packet)) {
+                applyPacket(client.remote, packet, nowMs);
+            }
+        }
+        server.transport.frames.clear();
+    }
+
+    void deliverUp(uint32_t nowMs) {
+        for (int c = 0; c < LOOPBACK_CLIENTS; c++) {
+            std::vector<FrameTransport::Frame> &frames = clients[c].transport.frames;
+            for (size_t i = 0; i < frames.size(); i++) {
+                server.table.onWrite((uint16_t)(c + 1), frames[i].data, frames[i].length, nowMs);
+                clients[c].session.onSent();
+            }
+            frames.clear();
+        }
+    }
+
+    SessionServer server;
+    SessionClient clients[LOOPBACK_CLIENTS];
+    uint32_t ticks;
+};
+
+TEST(session_loopback) {
+    Loopback loop;
+    loop.join(0);
+    loop.join(1);
+    loop.run(1500);
+
+    for (int c = 0; c < 2; c++) {
+        SessionClient &client = loop.clients[c];
+        int x = -1, y = -1, otherX = -1, otherY = -1;
+        uint8_t other = (uint8_t)(2 - c);
+        bool server = client.session.trackedPosition(SERVER_PLAYER_ID, loop.server.nowMs, x, y);
+        bool peer = client.session.trackedPosition(other, loop.server.nowMs, otherX, otherY);
+        CHECKF(client.session.playerId() == c + 1 && client.rounds == 1 && !client.session.isGameOver(),
+               "client %d: player %u, %d rounds", c, client.session.playerId(), client.rounds);
+        CHECKF(server && x == LOOPBACK_SERVER_X && y == LOOPBACK_SERVER_Y, "client %d sees the server at %d,%d", c,
+               x, y);
+        const SessionClient &seen = loop.clients[other - 1];
+        CHECKF(peer && otherX >= seen.spotX && otherX < seen.spotX + 4 && otherY == seen.spotY,
+               "client %d sees player %u at %d,%d", c, other, otherX, otherY);
+
+        PlayerView view;
+        loop.server.table.read(c, view);
+        const ServerPlayer &player = loop.server.session.player(c);
+        CHECKF(view.remote.positionCount > 0 && view.remote.clockCount > 0 && player.valid,
+               "slot %d: %u positions, %u clocks", c, view.remote.positionCount, view.remote.clockCount);
+    }
+
+    // Game over: every client stops with the server's time
+    loop.server.game.elapsedMs = 4321;
+    loop.server.session.gameOver();
+    loop.run(100);
+    for (int c = 0; c < 2; c++) {
+        const SessionClient &client = loop.clients[c];
+        CHECKF(client.session.isGameOver() && client.gameOvers == 1 && client.game.elapsedMs == 4321,
+               "client %d: %d game overs, %u ms", c, client.gameOvers, client.game.elapsedMs);
+    }
+
+    // Joining now, the round starts and ends
+    loop.join(2);
+    loop.run(100);
+    const SessionClient &late = loop.clients[2];
+    CHECKF(late.session.playerId() == 3 && late.rounds == 1 && late.gameOvers == 1 && late.session.isGameOver(),
+           "player %u, %d rounds, %d game overs", late.session.playerId(), late.rounds, late.gameOvers);
+
+    // START restarts everyone, and nobody is near anyone past the grace period
+    loop.server.onRoundStart();
+    loop.server.session.sendStart();
+    loop.run(COLLISION_GRACE_MS + 1000);
+    for (int c = 0; c < LOOPBACK_CLIENTS; c++) {
+        const SessionClient &client = loop.clients[c];
+        CHECKF(!client.session.isGameOver() && client.rounds == 2, "client %d: %d rounds", c, client.rounds);
+    }
+    CHECKF(loop.server.hits == 0 && !loop.server.session.isGameOver(), "%d hits", loop.server.hits);
+}
@@ -0,0 +1,143 @@
+#include "Bench.h"
+#include "Test.h"
+
+#include <GameCore.h>
+#include <StickShaper.h>
+#include <math.h>
+
+///////////////////////////////////////////////////////////////
+// Joystick pipeline: StickShaper against the same radial
+// deadzone, expo curve and direction split written in float.
+//
+// stick_float compares the two over every stick position on a
+// 4-count grid (at most 2/256 of full speed apart).
+// stick_properties checks what step() relies on: nothing inside
+// the deadzone, exactly full speed at full tilt along an axis,
+// mirror symmetry, speed never dropping as the stick goes
+// further out, and a held partial tilt covering the distance
+// its speed says over many frames, sub-pixels included.
+///////////////////////////////////////////////////////////////
+static const int STICK_BENCH_COUNT = 256;  // Power of two
+static const int STICK_TOLERANCE = 2;      // Q8 units
+
+static const GameInput *stickInputs() {
+    static GameInput inputs[STICK_BENCH_COUNT];
+    static bool filled = false;
+    if (!filled) {
+        uint32_t rng = 9001;
+        for (int i = 0; i < STICK_BENCH_COUNT; i++) {
+            inputs[i].joyX = randomBetween(rng, 0, 1024);
+            inputs[i].joyY = randomBetween(rng, 0, 1024);
+            inputs[i].buttons = 0;
+        }
+        filled = true;
+    }
+    return inputs;
+}
+
+// The pipeline as it would be written with floats, Q8 out like StickShaper
+static void shapeFloat(int offsetX, int offsetY, float deadzone, int &velocityX, int &velocityY) {
+    float x = offsetX < -STICK_MAX_OFFSET ? -STICK_MAX_OFFSET : (offsetX > STICK_MAX_OFFSET ? STICK_MAX_OFFSET : offsetX);
+    float y = offsetY < -STICK_MAX_OFFSET ? -STICK_MAX_OFFSET : (offsetY > STICK_MAX_OFFSET ? STICK_MAX_OFFSET : offsetY);
+    float distance = sqrtf(x * x + y * y);
+    if (distance <= deadzone) {
+        velocityX = velocityY = 0;
+        return;
+    }
+    float tilt = (distance - deadzone) / (STICK_MAX_OFFSET - deadzone);
+    if (tilt > 1.0f) tilt = 1.0f;
+    float speed = 0.5f * tilt + 0.5f * tilt * tilt * tilt;
+    velocityX = (int)lroundf(speed * x / distance * STICK_ONE);
+    velocityY = (int)lroundf(speed * y / distance * STICK_ONE);
+}
+
+static int absInt(int value) {
+    return value < 0 ? -value : value;
+}
+
+TEST(stick_properties) {
+    int vx, vy;
+
+    // Dead inside the circle, live just outside it on a diagonal
+    DEFAULT_STICK.shape(0, 0, vx, vy);
+    CHECK(vx == 0 && vy == 0);
+    DEFAULT_STICK.shape(JOYSTICK_DEADZONE, 0, vx, vy);
+    CHECKF(vx == 0 && vy == 0, "%d,%d", vx, vy);
+    DEFAULT_STICK.shape(72, 72, vx, vy);  // 101.8 counts out
+    CHECKF(vx == 0 && vy == 0, "%d,%d", vx, vy);
+
+    // Full tilt: exactly full speed on an axis, about that on a diagonal
+    DEFAULT_STICK.shape(1023 - JOYSTICK_CENTER, 0, vx, vy);
+    CHECKF(vx == STICK_ONE && vy == 0, "%d,%d", vx, vy);
+    DEFAULT_STICK.shape(0 - JOYSTICK_CENTER, 0, vx, vy);
+    CHECKF(vx == -STICK_ONE && vy == 0, "%d,%d", vx, vy);
+    DEFAULT_STICK.shape(STICK_MAX_OFFSET, STICK_MAX_OFFSET, vx, vy);
+    CHECKF(absInt(vx * vx + vy * vy - STICK_ONE * STICK_ONE) <= 2 * STICK_ONE, "%d,%d", vx, vy);
+
+    // Mirror symmetry and speed growing with tilt, for every curve
+    for (int curve = 0; curve < STICK_CURVE_COUNT; curve++) {
+        StickShaper stick(JOYSTICK_DEADZONE, (StickCurve)curve);
+        int last = 0;
+        for (int offset = 0; offset <= STICK_MAX_OFFSET; offset++) {
+            int ax, ay, bx, by;
+            stick.shape(offset, offset / 3, ax, ay);
+            stick.shape(-offset, -(offset / 3), bx, by);
+            CHECKF(ax == -bx && ay == -by, "curve %d, offset %d: %d,%d vs %d,%d", curve, offset, ax, ay, bx, by);
+            stick.shape(offset, 0, ax, ay);
+            CHECKF(ax >= last, "curve %d: %d at offset %d, %d before", curve, ax, offset, last);
+            last = ax;
+        }
+    }
+
+    // A held half tilt covers speed * velocity / 256 px per frame,
+    // with the fractions carried instead of dropped
+    {
+        GameState state;
+        resetGame(state, 3);
+        state.local.x = 10;
+        state.local.speed = 3;
+        GameInput half = { JOYSTICK_CENTER + 300, JOYSTICK_CENTER, 0 };
+        DEFAULT_STICK.shape(300, 0, vx, vy);
+        const int frames = 64;
+        for (int i = 0; i < frames; i++) step(state, half, 30);
+        int moved = (state.local.x - 10) * STICK_ONE + state.local.subX;
+        CHECKF(vx > 0 && vx < STICK_ONE && moved == vx * 3 * frames, "moved %d/256 px, expected %d", moved,
+               vx * 3 * frames);
+    }
+}
+
+TEST(stick_float) {
+    for (int rawY = 0; rawY < 1024; rawY += 4) {
+        for (int rawX = 0; rawX < 1024; rawX += 4) {
+            int offsetX = rawX - JOYSTICK_CENTER;
+            int offsetY = rawY - JOYSTICK_CENTER;
+            int fx, fy, vx, vy;
+            shapeFloat(offsetX, offsetY, JOYSTICK_DEADZONE, fx, fy);
+            DEFAULT_STICK.shape(offsetX, offsetY, vx, vy);
+            CHECKF(absInt(fx - vx) <= STICK_TOLERANCE && absInt(fy - vy) <= STICK_TOLERANCE,
+                   "stick %d,%d: %d,%d, float %d,%d", rawX, rawY, vx, vy, fx, fy);
+        }
+    }
+}
+
+BENCH(stick_shape_float) {
+    const GameInput *inputs = stickInputs();
+    for (uint32_t i = 0; i < iterations; i++) {
+        const GameInput &input = inputs[i & (STICK_BENCH_COUNT - 1)];
+        int vx, vy;
+        shapeFloat(input.joyX - JOYSTICK_CENTER, input.joyY - JOYSTICK_CENTER, JOYSTICK_DEADZONE, vx, vy);
+        doNotOptimize(vx);
+        doNotOptimize(vy);
+    }
+}
+
+BENCH(stick_shape) {
+    const GameInput *inputs = stickInputs();
+    for (uint32_t i = 0; i < iterations; i++) {
+        const GameInput &input = inputs[i & (STICK_BENCH_COUNT - 1)];
+        int vx, vy;
+        DEFAULT_STICK.shape(input.joyX - JOYSTICK_CENTER, input.joyY - JOYSTICK_CENTER, vx, vy);
+        doNotOptimize(vx);
+        doNotOptimize(vy);
+    }
+}
@@ -0,0 +1,198 @@
+#include "Bench.h"
+#include "Test.h"
+
+#include <GameCore.h>
+
+///////////////////////////////////////////////////////////////
+// Swept collision benchmarks.
+//
+// swept_oracle checks dotsCollideSwept() against an exact
+// oracle on random pairs of moves: every entry/exit time is a
+// multiple of 1 / (mx * my), so sampling the relative path at
+// every multiple of 1 / (2 * mx * my) finds any overlap there
+// is, in integer math. swept_step replays crossings that the
+// old end-of-frame check misses (head-on at full speed, cutting
+// a corner) through step(), and makes sure a SELECT warp across
+// the other dot is not swept.
+//
+// swept_point_misses reports how many of the random colliding
+// moves the old point check would have let through.
+///////////////////////////////////////////////////////////////
+static const int SWEEP_BENCH_COUNT = 256;  // Power of two
+
+struct SweepCase {
+    int ax0, ay0, ax1, ay1;
+    int bx0, by0, bx1, by1;
+};
+
+static const SweepCase *sweepCases() {
+    static SweepCase cases[SWEEP_BENCH_COUNT];
+    static bool filled = false;
+    if (!filled) {
+        uint32_t rng = 4711;
+        for (int i = 0; i < SWEEP_BENCH_COUNT; i++) {
+            SweepCase &c = cases[i];
+            c.ax0 = randomBetween(rng, 100, 140);
+            c.ay0 = randomBetween(rng, 100, 140);
+            c.bx0 = randomBetween(rng, 100, 140);
+            c.by0 = randomBetween(rng, 100, 140);
+            c.ax1 = c.ax0 + randomBetween(rng, -20, 21);
+            c.ay1 = c.ay0 + randomBetween(rng, -20, 21);
+            c.bx1 = c.bx0 + randomBetween(rng, -20, 21);
+            c.by1 = c.by0 + randomBetween(rng, -20, 21);
+        }
+        filled = true;
+    }
+    return cases;
+}
+
+// Exact answer by sampling every time step where the result could change
+static bool sweptOracle(const SweepCase &c) {
+    int rx = c.bx0 - c.ax0, ry = c.by0 - c.ay0;
+    int mx = (c.bx1 - c.ax1) - rx, my = (c.by1 - c.ay1) - ry;
+    int64_t steps = 2 * (int64_t)(mx ? (mx < 0 ? -mx : mx) : 1) * (my ? (my < 0 ? -my : my) : 1);
+    for (int64_t k = 0; k <= steps; k++) {
+        int64_t x = rx * steps + mx * k;  // Relative position, scaled by steps
+        int64_t y = ry * steps + my * k;
+        int64_t limit = COLLISION_DISTANCE * steps;
+        if (x > -limit && x < limit && y > -limit && y < limit) return true;
+    }
+    return false;
+}
+
+static bool sweptHit(const SweepCase &c) {
+    return dotsCollideSwept(c.ax0, c.ay0, c.ax1, c.ay1, c.bx0, c.by0, c.bx1, c.by1);
+}
+
+static bool pointHit(const SweepCase &c) {
+    return dotsCollide(c.ax1, c.ay1, c.bx1, c.by1);
+}
+
+// Two-player state with collisions armed and the remote dot at x, y
+static GameState armedState(int localX, int localY, int remoteX, int remoteY) {
+    GameState state;
+    resetGame(state, 7);
+    state.local.x = state.local.lastX = localX;
+    state.local.y = state.local.lastY = localY;
+    state.local.speed = MAX_SPEED;
+    state.remote.x = state.remote.lastX = remoteX;  // No spawn nudge, it would use up random numbers
+    state.remote.y = state.remote.lastY = remoteY;
+    state.remoteValid = true;
+    state.elapsedMs = COLLISION_GRACE_MS + 1;
+    return state;
+}
+
+static const GameInput RIGHT = { 1023, JOYSTICK_CENTER, 0 };
+static const GameInput DOWN_RIGHT = { 1023, 0, 0 };
+static const GameInput WARP = { JOYSTICK_CENTER, JOYSTICK_CENTER, GAME_BUTTON_SELECT };
+
+TEST(swept_step) {
+    // Head-on: we move right 5 px while the remote dot (one frame of
+    // interpolation, 30 px) passes the other way. Both ends are 20 px apart.
+    {
+        GameState state = armedState(100, 100, 115, 100);
+        setRemotePosition(state, 85, 100);
+        CHECK(!dotsCollide(105, 100, 85, 100));  // The old check would miss it
+        CHECK(step(state, RIGHT, 30) & STEP_COLLISION);
+    }
+
+    // Corner cut: we go down-right past the remote dot's corner while it
+    // moves up-left. 12 px apart on x before, 10+ px on y after.
+    {
+        GameState state = armedState(100, 100, 112, 100);
+        setRemotePosition(state, 107, 93);
+        bool hit = step(state, DOWN_RIGHT, 30) & STEP_COLLISION;
+        CHECK(!dotsCollide(100, 100, 112, 100) && !dotsCollide(state.local.x, state.local.y, 107, 93));
+        CHECK(hit);
+    }
+
+    // Parallel moves 10 px apart never touch
+    {
+        GameState state = armedState(100, 100, 100, 110);
+        setRemotePosition(state, 105, 110);
+        CHECK(!(step(state, RIGHT, 30) & STEP_COLLISION));
+    }
+
+    // A warp is a jump, not a sweep: put the remote dot half way
+    // between where we are and where SELECT will send us
+    {
+        GameState probe = armedState(20, 20, 300, 220);
+        step(probe, WARP, 30);
+        int midX = (20 + probe.local.x) / 2, midY = (20 + probe.local.y) / 2;
+        if (isJump(20, 20, probe.local.x, probe.local.y) &&
+            !dotsCollide(midX, midY, probe.local.x, probe.local.y) && !dotsCollide(midX, midY, 20, 20)) {
+            GameState state = armedState(20, 20, midX, midY);
+            CHECKF(!(step(state, WARP, 30) & STEP_COLLISION), "warp to %d,%d across %d,%d", probe.local.x,
+                   probe.local.y, midX, midY);
+        }
+    }
+
+    // Down-right at full speed with the remote dot coming up-left
+    {
+        GameState state = armedState(100, 100, 113, 113);
+        setRemotePosition(state, 93, 93);
+        CHECK(step(state, DOWN_RIGHT, 30) & STEP_COLLISION);
+    }
+}
+
+TEST(swept_oracle) {
+    const SweepCase *cases = sweepCases();
+    for (int i = 0; i < SWEEP_BENCH_COUNT; i++) {
+        const SweepCase &c = cases[i];
+        CHECKF(sweptHit(c) == sweptOracle(c) && (!pointHit(c) || sweptHit(c)),
+               "case %d: %d,%d -> %d,%d against %d,%d -> %d,%d", i, c.ax0, c.ay0, c.ax1, c.ay1, c.bx0, c.by0, c.bx1,
+               c.by1);
+    }
+}
+
+BENCH(swept_point_misses) {
+    const SweepCase *cases = sweepCases();
+    uint32_t hits = 0, misses = 0;
+    for (uint32_t i = 0; i < iterations; i++) {
+        const SweepCase &c = cases[i & (SWEEP_BENCH_COUNT - 1)];
+        if (!sweptOracle(c)) continue;
+        hits++;
+        if (!pointHit(c)) misses++;
+    }
+    benchMetric("% of collisions missed", hits ? 100.0 * misses / hits : 0);
+}
+
+///////////////////////////////////////////////////////////////
+// Cost per check. "near" is the table above (dots within a few
+// px, most paths need the full test); "field" has the dots
+// anywhere on the screen moving up to MAX_SPEED, like a frame
+// of play, where the quick reject answers almost every time.
+///////////////////////////////////////////////////////////////
+static const SweepCase *fieldCases() {
+    static SweepCase cases[SWEEP_BENCH_COUNT];
+    static bool filled = false;
+    if (!filled) {
+        uint32_t rng = 1337;
+        for (int i = 0; i < SWEEP_BENCH_COUNT; i++) {
+            SweepCase &c = cases[i];
+            c.ax0 = randomBetween(rng, 0, FIELD_MAX_X + 1);
+            c.ay0 = randomBetween(rng, 0, FIELD_MAX_Y + 1);
+            c.bx0 = randomBetween(rng, 0, FIELD_MAX_X + 1);
+            c.by0 = randomBetween(rng, 0, FIELD_MAX_Y + 1);
+            c.ax1 = c.ax0 + randomBetween(rng, -MAX_SPEED, MAX_SPEED + 1);
+            c.ay1 = c.ay0 + randomBetween(rng, -MAX_SPEED, MAX_SPEED + 1);
+            c.bx1 = c.bx0 + randomBetween(rng, -MAX_SPEED, MAX_SPEED + 1);
+            c.by1 = c.by0 + randomBetween(rng, -MAX_SPEED, MAX_SPEED + 1);
+        }
+        filled = true;
+    }
+    return cases;
+}
+
+static void runChecks(const SweepCase *cases, bool swept, uint32_t iterations) {
+    for (uint32_t i = 0; i < iterations; i++) {
+        const SweepCase &c = cases[i & (SWEEP_BENCH_COUNT - 1)];
+        bool hit = swept ? sweptHit(c) : pointHit(c);
+        doNotOptimize(hit);
+    }
+}
+
+BENCH(point_check_near) { runChecks(sweepCases(), false, iterations); }
+BENCH(swept_check_near) { runChecks(sweepCases(), true, iterations); }
+BENCH(point_check_field) { runChecks(fieldCases(), false, iterations); }
+BENCH(swept_check_field) { runChecks(fieldCases(), true, iterations); }
@@ -0,0 +1,188 @@
+#include "Bench.h"
+#include "Test.h"
+
+#include <Telemetry.h>
+#include <stdio.h>
+#include <string.h>
+#include <thread>
+#include <vector>
+
+///////////////////////////////////////////////////////////////
+// Telemetry: the cost of a log call on the BLE task against the
+// printf it replaces, and the stream the telemetry task writes.
+//
+// telemetry_codec round-trips every event through the frame
+// codec and makes sure damaged frames are rejected.
+// telemetry_stream logs through a channel into a slow sink mixed
+// with text and checks the decoder gets back every record in
+// order, with a "lost" record accounting for each one dropped
+// on the full ring. telemetry_threaded does the same with the
+// producer and the drain on different threads.
+///////////////////////////////////////////////////////////////
+struct StepClock {
+    StepClock() : us(0) {}
+    uint32_t nowUs() {
+        return us;
+    }
+    uint32_t us;
+};
+
+// A UART with room for `room` bytes per drain
+struct ByteSink {
+    ByteSink(int room) : room(room) {}
+    int availableForWrite() {
+        return room - (int)pending;
+    }
+    size_t write(const uint8_t *data, size_t length) {
+        bytes.insert(bytes.end(), data, data + length);
+        pending += length;
+        return length;
+    }
+    void flush() {
+        pending = 0;
+    }
+    std::vector<uint8_t> bytes;
+    int room;
+    size_t pending = 0;
+};
+
+// Decodes every frame in a stream, skipping anything else
+static std::vector<TelemetryRecord> decodeStream(const std::vector<uint8_t> &bytes) {
+    std::vector<TelemetryRecord> records;
+    size_t at = 0;
+    while (at < bytes.size()) {
+        TelemetryRecord record;
+        int result = decodeTelemetry(&bytes[at], bytes.size() - at, record);
+        if (result <= 0) {
+            at++;
+            continue;
+        }
+        records.push_back(record);
+        at += result;
+    }
+    return records;
+}
+
+TEST(telemetry_codec) {
+    uint8_t frame[TELEMETRY_FRAME_MAX_SIZE];
+    for (int e = 0; e < TELEMETRY_EVENT_COUNT; e++) {
+        TelemetryRecord record = { (uint32_t)(0x89ABCDEFUL + e), (uint8_t)e, telemetryArgCount(e), { 0xFFFF, 1, 0x8000, 0x1234 } };
+        for (int i = record.argCount; i < TELEMETRY_MAX_ARGS; i++) record.args[i] = 0;
+        size_t length = encodeTelemetry(record, frame);
+        CHECKF(length == TELEMETRY_FRAME_HEADER_SIZE + 2 * record.argCount + 1, "event %d: %d bytes", e,
+               (int)length);
+
+        TelemetryRecord decoded;
+        CHECKF(decodeTelemetry(frame, length, decoded) == (int)length && decoded.timeUs == record.timeUs &&
+                   decoded.event == record.event && decoded.argCount == record.argCount &&
+                   memcmp(decoded.args, record.args, sizeof(record.args)) == 0,
+               "event %d", e);
+
+        // A flipped byte is caught, a short read just waits for more
+        for (size_t i = 0; i < length; i++) {
+            frame[i] ^= 0x10;
+            CHECKF(decodeTelemetry(frame, length, decoded) <= 0, "event %d, byte %d flipped", e, (int)i);
+            frame[i] ^= 0x10;
+        }
+        CHECKF(decodeTelemetry(frame, length - 1, decoded) == 0, "event %d, one byte short", e);
+    }
+}
+
+// Logged records come back in order; every gap is covered by a lost record
+static void checkSequence(const std::vector<TelemetryRecord> &records, uint32_t logged) {
+    uint32_t expected = 0, lost = 0;
+    for (size_t i = 0; i < records.size(); i++) {
+        const TelemetryRecord &record = records[i];
+        if (record.event == TELEMETRY_LOST) {
+            lost += record.args[0];
+            continue;
+        }
+        uint32_t seq = record.args[0] | (uint32_t)record.args[1] << 16;
+        CHECKF(record.event == TELEMETRY_NOTIFY && seq >= expected && record.args[2] == (uint16_t)(seq * 7),
+               "record %d: event %d, seq %u after %u", (int)i, record.event, seq, expected);
+        expected = seq + 1;
+    }
+    size_t kept = 0;
+    for (size_t i = 0; i < records.size(); i++) kept += records[i].event != TELEMETRY_LOST;
+    CHECKF(kept + lost == logged, "%d kept, %u lost, %u logged", (int)kept, lost, logged);
+}
+
+TEST(telemetry_stream) {
+    const uint32_t events = 10000;
+    StepClock clock;
+    TelemetryChannel<StepClock, 16> channel(clock);
+    ByteSink sink(3 * TELEMETRY_FRAME_MAX_SIZE);
+
+    // Bursts of up to 40 notifies between drains that take 3 frames each: the ring overflows
+    for (uint32_t i = 0; i < events; i++) {
+        clock.us += 100;
+        channel.log(TELEMETRY_NOTIFY, (uint16_t)i, (uint16_t)(i >> 16), (uint16_t)(i * 7), 0);
+        if (i % 40 == 39) {
+            sink.flush();
+            channel.drain(sink);
+            // Someone else's text on the same UART
+            const char *text = "\xA7 Connection params: status 0\n";
+            sink.bytes.insert(sink.bytes.end(), text, text + strlen(text));
+        }
+    }
+    for (;;) {
+        sink.flush();
+        if (channel.drain(sink) == 0) break;
+    }
+    checkSequence(decodeStream(sink.bytes), events);
+    CHECK(channel.droppedCount() > 0);  // Or the test didn't overflow anything
+}
+
+struct ThreadClock {
+    uint32_t nowUs() {
+        return 0;
+    }
+};
+
+TEST(telemetry_threaded) {
+    const uint32_t events = 1000000;
+    ThreadClock clock;
+    TelemetryChannel<ThreadClock, 32> channel(clock);
+    ByteSink sink(1 << 30);
+    std::atomic<bool> done(false);
+
+    std::thread producer([&]() {
+        for (uint32_t i = 0; i < events; i++) {
+            channel.log(TELEMETRY_NOTIFY, (uint16_t)i, (uint16_t)(i >> 16), (uint16_t)(i * 7), 0);
+        }
+        done.store(true);
+    });
+    while (!done.load()) channel.drain(sink);
+    producer.join();
+    channel.drain(sink);
+    checkSequence(decodeStream(sink.bytes), events);
+}
+
+///////////////////////////////////////////////////////////////
+// Cost on the BLE task: a log call (with the drain keeping up)
+// against formatting the line notifyCallback used to print
+///////////////////////////////////////////////////////////////
+BENCH(telemetry_log) {
+    StepClock clock;
+    TelemetryChannel<StepClock> channel(clock);
+    ByteSink sink(1 << 30);
+    for (uint32_t i = 0; i < iterations; i++) {
+        clock.us += 30;
+        channel.log(TELEMETRY_NOTIFY, (uint16_t)i, 1, 100 + (i & 63), 120);
+        if ((i & 31) == 31) {
+            sink.bytes.clear();
+            sink.flush();
+            channel.drain(sink);
+        }
+    }
+    doNotOptimize(channel.droppedCount());
+}
+
+BENCH(telemetry_printf) {
+    char line[64];
+    for (uint32_t i = 0; i < iterations; i++) {
+        int length = snprintf(line, sizeof(line), "Notify #%u type %u: %u,%u\n", i & 0xFF, 1u, 100 + (i & 63), 120u);
+        doNotOptimize(length);
+        doNotOptimize(line);
+    }
+}
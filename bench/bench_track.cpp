@@ -0,0 +1,277 @@
+#include "Bench.h"
+#include "Test.h"
+
+#include <GameCore.h>
+#include <RemoteTrack.h>
+#include <stdlib.h>
+
+///////////////////////////////////////////////////////////////
+// Remote dot smoothing, replayed against packet traces: the
+// other player sweeps across the field at full speed and sends
+// at 10 Hz. We draw a frame every 30 ms and report the average
+// jerk: how much the on-screen step changes from one frame to
+// the next, in pixels. The real path only jerks when it bounces
+// off an edge.
+//
+// The jittered trace delivers each packet 20-80 ms later, in
+// order, and loses 5%. The reordered one spreads delivery over
+// 20-300 ms so packets overtake each other; the lossy one loses
+// 30% and goes silent for a second now and then.
+//
+// track_replay replays all three and checks that a packet older
+// than one already received never moves the dot, that the dot
+// stays on the sender's path, and that during a silence the dot
+// is extrapolated for maxExtrapolateMs at most and then holds.
+// track_extrapolation checks the extrapolation cap on a
+// scripted pair of samples.
+///////////////////////////////////////////////////////////////
+static const uint32_t SEND_PERIOD_MS = 100;
+static const uint32_t FRAME_MS = 30;
+static const uint32_t TRACK_DELAY_MS = 150;
+static const uint32_t TRACK_EXTRAPOLATE_MS = 100;
+
+// Triangle wave between lo and hi moving speed px per 30 ms
+static int sweep(uint32_t timeMs, int speed, int lo, int hi) {
+    int range = hi - lo;
+    int travelled = (int)((uint64_t)timeMs * speed / 30 % (2 * range));
+    return lo + (travelled < range ? travelled : 2 * range - travelled);
+}
+
+struct TracePacket {
+    uint32_t sentMs;
+    uint32_t arrivalMs;
+    int x;
+    int y;
+};
+
+struct TraceShape {
+    uint32_t minLatencyMs;
+    uint32_t maxLatencyMs;
+    int lossPercent;
+    bool reorder;             // Deliver by arrival time; otherwise a packet waits for the one before it
+    uint32_t silenceEveryMs;  // Drop everything sent in the first second of every period (0 = never)
+};
+
+static const TraceShape JITTERED = { 20, 80, 5, false, 0 };
+static const TraceShape REORDERED = { 20, 300, 5, true, 0 };
+static const TraceShape LOSSY = { 20, 80, 30, false, 10000 };
+
+static const int TRACE_IN_FLIGHT = 16;
+
+class JitteredTrace {
+public:
+    JitteredTrace(const TraceShape &shape = JITTERED)
+        : shape(shape), rng(12345), nextSendMs(0), lastArrivalMs(0), inFlight(0) {}
+
+    // Every packet that has arrived by nowMs, in arrival order
+    bool receive(uint32_t nowMs, TracePacket &packet) {
+        while (nextSendMs <= nowMs) {
+            TracePacket sent;
+            sent.sentMs = nextSendMs;
+            sent.arrivalMs = nextSendMs + randomBetween(rng, shape.minLatencyMs, shape.maxLatencyMs);
+            if (!shape.reorder && sent.arrivalMs < lastArrivalMs) sent.arrivalMs = lastArrivalMs;
+            sent.x = sweep(nextSendMs, MAX_SPEED, 10, 310);
+            sent.y = sweep(nextSendMs, 3, 10, 230);
+            bool lost = randomBetween(rng, 0, 99) < shape.lossPercent || silent(nextSendMs);
+            if (!lost && inFlight < TRACE_IN_FLIGHT) {
+                packets[inFlight++] = sent;
+                lastArrivalMs = sent.arrivalMs;
+            }
+            nextSendMs += SEND_PERIOD_MS;
+        }
+
+        int first = -1;
+        for (int i = 0; i < inFlight; i++) {
+            if (packets[i].arrivalMs <= nowMs && (first < 0 || packets[i].arrivalMs < packets[first].arrivalMs)) {
+                first = i;
+            }
+        }
+        if (first < 0) return false;
+        packet = packets[first];
+        packets[first] = packets[--inFlight];
+        return true;
+    }
+
+    bool silent(uint32_t sentMs) const {
+        return shape.silenceEveryMs && sentMs >= shape.silenceEveryMs && sentMs % shape.silenceEveryMs < 1000;
+    }
+
+private:
+    TraceShape shape;
+    uint32_t rng;
+    uint32_t nextSendMs;
+    uint32_t lastArrivalMs;
+    TracePacket packets[TRACE_IN_FLIGHT];  // Unordered
+    int inFlight;
+};
+
+// Average |second difference| of the drawn positions
+class JerkMeter {
+public:
+    JerkMeter() : frames(0), total(0) {}
+
+    void frame(int x, int y) {
+        if (frames >= 2) {
+            int ddx = (x - lastX) - (lastX - prevX);
+            int ddy = (y - lastY) - (lastY - prevY);
+            total += abs(ddx) + abs(ddy);
+        }
+        prevX = lastX;
+        prevY = lastY;
+        lastX = x;
+        lastY = y;
+        frames++;
+    }
+
+    double average() const {
+        return frames > 2 ? (double)total / (frames - 2) : 0;
+    }
+
+private:
+    uint64_t frames;
+    uint64_t total;
+    int prevX, prevY, lastX, lastY;
+};
+
+// Draw the latest received position, like the sketches used to
+BENCH(remote_replay_latest) {
+    JitteredTrace trace;
+    JerkMeter jerk;
+    int x = 0, y = 0;
+    for (uint32_t i = 0; i < iterations; i++) {
+        uint32_t now = i * FRAME_MS;
+        TracePacket packet;
+        while (trace.receive(now, packet)) {
+            x = packet.x;
+            y = packet.y;
+        }
+        jerk.frame(x, y);
+    }
+    benchMetric("jerk px/frame", jerk.average());
+}
+
+static double replayInterpolated(const TraceShape &shape, uint32_t frames) {
+    JitteredTrace trace(shape);
+    JerkMeter jerk;
+    RemoteTrack track(TRACK_DELAY_MS, TRACK_EXTRAPOLATE_MS);
+    int x = 0, y = 0;
+    for (uint32_t i = 0; i < frames; i++) {
+        uint32_t now = i * FRAME_MS;
+        TracePacket packet;
+        while (trace.receive(now, packet)) {
+            track.add((uint16_t)packet.sentMs, packet.arrivalMs, packet.x, packet.y, false);
+        }
+        track.position(now, x, y);
+        jerk.frame(x, y);
+    }
+    return jerk.average();
+}
+
+BENCH(remote_replay_interpolated) {
+    benchMetric("jerk px/frame", replayInterpolated(JITTERED, iterations));
+}
+
+BENCH(remote_replay_reordered) {
+    benchMetric("jerk px/frame", replayInterpolated(REORDERED, iterations));
+}
+
+BENCH(remote_replay_lossy) {
+    benchMetric("jerk px/frame", replayInterpolated(LOSSY, iterations));
+}
+
+///////////////////////////////////////////////////////////////
+// Checks
+///////////////////////////////////////////////////////////////
+static void checkReplay(const char *name, const TraceShape &shape, uint32_t frames, uint32_t &stale,
+                        uint32_t &holds) {
+    JitteredTrace trace(shape);
+    RemoteTrack track(TRACK_DELAY_MS, TRACK_EXTRAPOLATE_MS);
+    uint32_t newestSentMs = 0;
+    bool received = false;
+    int heldX = -1, heldY = -1;
+    uint32_t heldSentMs = 0;
+
+    for (uint32_t i = 0; i < frames; i++) {
+        uint32_t now = i * FRAME_MS;
+        TracePacket packet;
+        while (trace.receive(now, packet)) {
+            int beforeX = 0, beforeY = 0, afterX = 0, afterY = 0;
+            bool had = track.position(now, beforeX, beforeY);
+            track.add((uint16_t)packet.sentMs, packet.arrivalMs, packet.x, packet.y, false);
+            track.position(now, afterX, afterY);
+            if (received && packet.sentMs <= newestSentMs) {
+                stale++;
+                // Late packets change nothing
+                CHECKF(had && afterX == beforeX && afterY == beforeY, "%s, %u ms: packet sent at %u moved %d,%d to %d,%d",
+                       name, now, packet.sentMs, beforeX, beforeY, afterX, afterY);
+                continue;
+            }
+            received = true;
+            newestSentMs = packet.sentMs;
+        }
+        int x, y;
+        if (!track.position(now, x, y)) continue;
+
+        // When the newest sample is drawn, on our clock
+        uint32_t newestDrawnMs = track.toLocalMs((uint16_t)newestSentMs) + TRACK_DELAY_MS;
+        if ((int32_t)(now - newestDrawnMs) <= 0) {
+            // Between samples: on the path (x sweeps 10..310, y 10..230)
+            CHECKF(x >= 10 && x <= 310 && y >= 10 && y <= 230, "%s, %u ms: off the path at %d,%d", name, now, x, y);
+        } else {
+            CHECKF(x >= 0 && x <= FIELD_MAX_X && y >= 0 && y <= FIELD_MAX_Y, "%s, %u ms: off the field at %d,%d", name,
+                   now, x, y);
+        }
+
+        // Past the extrapolation cap (a silence, or a packet arriving later than the delay), the dot holds still
+        if ((int32_t)(now - newestDrawnMs) > (int32_t)TRACK_EXTRAPOLATE_MS) {
+            if (heldX >= 0 && heldSentMs == newestSentMs) {
+                CHECKF(x == heldX && y == heldY, "%s, %u ms: moved from %d,%d to %d,%d past the cap", name, now, heldX,
+                       heldY, x, y);
+                holds++;
+            }
+            heldX = x;
+            heldY = y;
+            heldSentMs = newestSentMs;
+        } else {
+            heldX = heldY = -1;
+        }
+    }
+}
+
+TEST(track_replay) {
+    const uint32_t frames = 20000;
+    uint32_t stale = 0, holds = 0;
+    checkReplay("jittered", JITTERED, frames, stale, holds);
+    CHECK(stale == 0);  // In order
+    checkReplay("reordered", REORDERED, frames, stale, holds);
+    CHECK(stale > 0);  // Or the trace didn't reorder anything
+    uint32_t staleBefore = stale;
+    checkReplay("lossy", LOSSY, frames, stale, holds);
+    CHECK(stale == staleBefore);
+    CHECK(holds > 0);  // Or no silence reached the hold
+}
+
+// Two samples 100 ms apart moving +20 px: 20 px more at the cap, never further
+TEST(track_extrapolation) {
+    RemoteTrack track(TRACK_DELAY_MS, TRACK_EXTRAPOLATE_MS);
+    track.add(1000, 1030, 100, 50, false);
+    track.add(1100, 1130, 120, 40, false);
+    const uint32_t newestLocalMs = 1130 + TRACK_DELAY_MS;  // When the newest sample is drawn
+    const uint32_t aheadMs[] = { 0, 50, 100, 101, 150, 500, 5000 };
+    for (int i = 0; i < 7; i++) {
+        int x, y;
+        if (!CHECKF(track.position(newestLocalMs + aheadMs[i], x, y), "%u ms ahead", aheadMs[i])) continue;
+        uint32_t ahead = aheadMs[i] < TRACK_EXTRAPOLATE_MS ? aheadMs[i] : TRACK_EXTRAPOLATE_MS;
+        CHECKF(x == 120 + (int)(ahead * 20 / 100) && y == 40 - (int)(ahead * 10 / 100), "%u ms ahead: %d,%d",
+               aheadMs[i], x, y);
+    }
+
+    // Not past a warp, and not off the field
+    track.add(1200, 1230, 10, 10, true);
+    int x, y;
+    track.position(1230 + TRACK_DELAY_MS + 80, x, y);
+    CHECKF(x == 10 && y == 10, "%d,%d after the warp", x, y);
+    track.add(1300, 1330, 5, 5, false);
+    track.position(1330 + TRACK_DELAY_MS + TRACK_EXTRAPOLATE_MS, x, y);
+    CHECKF(x == 0 && y == 0, "%d,%d off the field", x, y);
+}
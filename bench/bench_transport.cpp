@@ -0,0 +1,282 @@
+#include "Bench.h"
+#include "Test.h"
+
+#include <GameCore.h>
+#include <GameProtocol.h>
+#include <PlayerTable.h>
+#include <Transport.h>
+#include <UdpTransport.h>
+#include <WorldState.h>
+
+///////////////////////////////////////////////////////////////
+// The host transport: the link conditioner on its own, then
+// a server and clients talking over UdpTransport on localhost.
+//
+// transport_conditioner checks that the conditioner drops about
+// lossPermille of frames, delays every frame by latency plus at
+// most the jitter, keeps them in order unless reorder is set and
+// refuses frames past its capacity. In transport_session a
+// server with a PlayerTable takes MAX_CLIENTS + 1 clients over a
+// lossy, jittery link (the extra one is turned away), every
+// client's positions reach its slot, every client decodes the
+// server's WORLD frames, a client that goes quiet times out and
+// rejoins, and one that disconnects frees its slot.
+///////////////////////////////////////////////////////////////
+TEST(transport_conditioner) {
+    const uint32_t frames = 20000;
+    uint8_t frame[4] = {};
+
+    // Loss: 100 permille, within a couple of points
+    LinkConditioner<4> lossy(LinkImpairment{ 0, 0, 100, false }, 99);
+    ConditionedFrame out;
+    for (uint32_t i = 0; i < frames; i++) {
+        lossy.push(i, 0, 0, frame, sizeof(frame));
+        while (lossy.pop(i, out)) {
+        }
+    }
+    double lostShare = (double)lossy.lostCount() / frames;
+    CHECKF(lostShare >= 0.08 && lostShare <= 0.12, "%.3f lost", lostShare);
+    CHECK(lossy.lostCount() + lossy.passedCount() == frames);
+
+    // Latency and jitter: delays in [latency, latency + jitter], in order, averaging the middle
+    for (int reorder = 0; reorder < 2; reorder++) {
+        LinkConditioner<64> delayed(LinkImpairment{ 40, 20, 0, reorder != 0 }, 5);
+        uint32_t nextOut = 0, swapped = 0, lastSeq = 0;
+        uint64_t delaySum = 0;
+        for (uint32_t now = 0; nextOut < frames; now++) {
+            if (now < frames) {
+                for (int b = 0; b < 4; b++) frame[b] = (uint8_t)(now >> (8 * b));
+                CHECKF(delayed.push(now, 1, 7, frame, sizeof(frame)), "reorder %d, %u ms: refused", reorder, now);
+            }
+            while (delayed.pop(now, out)) {
+                uint32_t seq = out.data[0] | out.data[1] << 8 | out.data[2] << 16 | (uint32_t)out.data[3] << 24;
+                uint32_t delay = now - seq;
+                CHECK(out.link == 1 && out.tag == 7 && out.length == 4);
+                if (!reorder) {
+                    CHECKF(delay >= 40 && seq == nextOut, "frame %u out %u ms late, after %u", seq, delay, nextOut);
+                } else {
+                    CHECKF(delay >= 40 && delay <= 60, "frame %u out %u ms late", seq, delay);
+                }
+                if (nextOut > 0 && seq < lastSeq) swapped++;
+                lastSeq = seq;
+                delaySum += delay;
+                nextOut++;
+            }
+        }
+        double meanDelay = (double)delaySum / frames;
+        if (!reorder) {
+            // In-order frames queue up behind slow ones
+            CHECKF(swapped == 0 && meanDelay >= 45, "%u swapped, %.1f ms mean delay", swapped, meanDelay);
+        } else {
+            CHECKF(swapped > 0 && meanDelay >= 48 && meanDelay <= 52, "%u swapped, %.1f ms mean delay", swapped,
+                   meanDelay);
+        }
+    }
+
+    // Full: refused and counted, never lost
+    LinkConditioner<2> small(LinkImpairment{ 10, 0, 0, false });
+    for (int i = 0; i < 3; i++) small.push(0, 0, 0, frame, sizeof(frame));
+    uint8_t big[TRANSPORT_FRAME_MAX_SIZE + 1] = {};
+    CHECK(!small.push(0, 0, 0, big, sizeof(big)));
+    CHECKF(small.overflowCount() == 2 && small.lostCount() == 0, "%u overflowed, %u lost", small.overflowCount(),
+           small.lostCount());
+    CHECK(!small.pop(9, out) && small.pop(10, out) && small.pop(10, out) && !small.pop(10, out));
+}
+
+///////////////////////////////////////////////////////////////
+// A server and its clients over localhost
+///////////////////////////////////////////////////////////////
+typedef UdpTransport<MAX_CLIENTS + 1> BenchUdp;
+
+struct ServerSide : public TransportListener {
+    ServerSide(BenchUdp &transport) : transport(transport), rejected(0) {}
+    void onConnect(uint16_t link) {
+        if (table.onConnect(link) < 0) {
+            rejected++;
+            transport.disconnect(link);
+        }
+    }
+    void onDisconnect(uint16_t link) {
+        table.onDisconnect(link);
+    }
+    void onSubscribe(uint16_t link, bool subscribed) {
+        table.onSubscribe(link, subscribed);
+    }
+    void onMtu(uint16_t link, uint16_t mtu) {
+        table.onMtu(link, mtu);
+    }
+    void onReceive(uint16_t link, const uint8_t *data, size_t length) {
+        table.onWrite(link, data, length, 0);
+    }
+    BenchUdp &transport;
+    PlayerTable table;
+    uint32_t rejected;
+};
+
+struct ClientSide : public TransportListener {
+    ClientSide() : up(false), connects(0), disconnects(0), worlds(0), badFrames(0), sent(0) {}
+    void onConnect(uint16_t link) {
+        up = true;
+        connects++;
+    }
+    void onDisconnect(uint16_t link) {
+        up = false;
+        disconnects++;
+    }
+    void onReceive(uint16_t link, const uint8_t *data, size_t length) {
+        WorldState decoded;
+        if (decodeWorld(data, length, decoded)) {
+            world = decoded;
+            worlds++;
+        } else {
+            badFrames++;
+        }
+    }
+    void onSent(uint16_t link) {
+        sent++;
+    }
+    bool up;
+    uint32_t connects, disconnects, worlds, badFrames, sent;
+    WorldState world;
+};
+
+static const int SESSION_CLIENTS = MAX_CLIENTS + 1;
+
+struct Session {
+    Session() : server(serverTransport) {
+        serverTransport.setListener(&server);
+        for (int c = 0; c < SESSION_CLIENTS; c++) clientTransports[c].setListener(&clients[c]);
+    }
+    BenchUdp serverTransport;
+    ServerSide server;
+    UdpTransport<1> clientTransports[SESSION_CLIENTS];
+    ClientSide clients[SESSION_CLIENTS];
+};
+
+// Runs everyone for ms, 10 ms at a time; quiet clients aren't polled
+static void runSession(Session &session, uint32_t &nowMs, uint32_t ms, int quiet = -1) {
+    for (uint32_t end = nowMs + ms; nowMs < end; nowMs += 10) {
+        session.serverTransport.poll(nowMs);
+        for (int c = 0; c < SESSION_CLIENTS; c++) {
+            if (c != quiet) session.clientTransports[c].poll(nowMs);
+        }
+    }
+}
+
+// Slot whose view says link, or -1
+static int slotOfLink(const PlayerTable &table, uint16_t link) {
+    for (int slot = 0; slot < MAX_CLIENTS; slot++) {
+        PlayerView view;
+        table.read(slot, view);
+        if (view.connected && view.connId == link) return slot;
+    }
+    return -1;
+}
+
+TEST(transport_session) {
+    Session session;
+    if (!CHECK(session.serverTransport.listen(0))) return;
+    LinkImpairment impairment = { 15, 10, 50, false };
+    session.serverTransport.setImpairment(impairment, 11);
+    for (int c = 0; c < SESSION_CLIENTS; c++) {
+        if (!CHECK(session.clientTransports[c].connect("127.0.0.1", session.serverTransport.localPort()))) return;
+        session.clientTransports[c].setImpairment(impairment, 20 + c);
+    }
+
+    uint32_t nowMs = 1000;
+    runSession(session, nowMs, 1000);
+    int up = 0;
+    for (int c = 0; c < SESSION_CLIENTS; c++) up += session.clients[c].up;
+    PlayerTable &table = session.server.table;
+    CHECKF(up == MAX_CLIENTS && table.connectedCount() == MAX_CLIENTS && session.server.rejected > 0,
+           "%d up, %d connected, %d rejected", up, (int)table.connectedCount(), (int)session.server.rejected);
+    for (int slot = 0; slot < MAX_CLIENTS; slot++) {
+        PlayerView view;
+        table.read(slot, view);
+        CHECKF(view.connected && view.subscribed && fitsMtu(WORLD_PACKET_MAX_SIZE, view.mtu), "slot %d, mtu %d", slot,
+               (int)view.mtu);
+    }
+
+    // Positions up (each client its own spot), WORLD frames down
+    uint8_t seq = 0;
+    for (int round = 0; round < 30; round++, seq++) {
+        for (int c = 0; c < SESSION_CLIENTS; c++) {
+            if (!session.clients[c].up) continue;
+            uint8_t frame[GAME_PACKET_SIZE];
+            size_t length = encodePacket(makePositionPacket(seq, 10 + 50 * c, 100 + round, 0, nowMs), frame);
+            session.clientTransports[c].send(CLIENT_SERVER_LINK, frame, length);
+        }
+        WorldState world;
+        clearWorld(world);
+        world.seq = seq;
+        addWorldEntry(world, SERVER_PLAYER_ID, 160, 120 + round);
+        uint8_t frame[WORLD_PACKET_MAX_SIZE];
+        size_t length = encodeWorld(world, frame);
+        for (int slot = 0; slot < MAX_CLIENTS; slot++) {
+            PlayerView view;
+            table.read(slot, view);
+            if (view.connected) session.serverTransport.send(view.connId, frame, length);
+        }
+        runSession(session, nowMs, 100);
+    }
+    runSession(session, nowMs, 200);
+    for (int c = 0; c < SESSION_CLIENTS; c++) {
+        ClientSide &client = session.clients[c];
+        if (!client.up) continue;
+        const WorldEntry *server = findWorldEntry(client.world, SERVER_PLAYER_ID);
+        // 5% loss: most frames make it, the last few rounds certainly one
+        CHECKF(client.worlds >= 20 && client.badFrames == 0 && server && server->y >= 120 + 25,
+               "client %d: %d worlds, %d bad, server at y %d", c, (int)client.worlds, (int)client.badFrames,
+               server ? (int)server->y : -1);
+        CHECKF(client.sent >= 30, "client %d: %d sent", c, (int)client.sent);
+    }
+    for (int slot = 0; slot < MAX_CLIENTS; slot++) {
+        PlayerView view;
+        table.read(slot, view);
+        // At one of the clients' spots
+        CHECKF(view.remote.positionCount >= 20 && view.remote.y >= 100 + 25 && (view.remote.x - 10) % 50 == 0,
+               "slot %d: %d positions, at %d,%d", slot, (int)view.remote.positionCount, (int)view.remote.x,
+               (int)view.remote.y);
+    }
+
+    // A client that stops talking times out, and the one turned away takes its slot
+    int quiet = -1, waiting = -1, leaving = -1;
+    for (int c = 0; c < SESSION_CLIENTS; c++) {
+        if (!session.clients[c].up) waiting = c;
+        else if (quiet < 0) quiet = c;
+        else leaving = c;
+    }
+    uint16_t quietLink = 0;
+    for (int slot = 0; slot < MAX_CLIENTS; slot++) {
+        PlayerView view;
+        table.read(slot, view);
+        if (view.remote.x == 10 + 50 * quiet) quietLink = view.connId;
+    }
+    runSession(session, nowMs, 2500, quiet);
+    CHECK(slotOfLink(table, quietLink) < 0);
+    CHECK(session.clients[waiting].up && table.connectedCount() == MAX_CLIENTS);
+    // When it wakes up the server doesn't know it any more
+    runSession(session, nowMs, 1000);
+    CHECK(!session.clients[quiet].up && session.clients[quiet].disconnects == 1);
+
+    // A client that leaves frees its slot for the quiet one
+    session.clientTransports[leaving].disconnect(CLIENT_SERVER_LINK);
+    runSession(session, nowMs, 1500);
+    CHECK(!session.clients[leaving].up);
+    CHECK(session.clients[quiet].up && session.clients[quiet].connects == 2);
+    CHECK(table.connectedCount() == MAX_CLIENTS);
+    CHECK(session.serverTransport.badCount() == 0);
+}
+
+///////////////////////////////////////////////////////////////
+// Cost of one frame through the conditioner (push + pop)
+///////////////////////////////////////////////////////////////
+BENCH(link_conditioner) {
+    LinkConditioner<64> conditioner(LinkImpairment{ 20, 10, 20, false }, 3);
+    uint8_t frame[WORLD_PACKET_MAX_SIZE] = {};
+    ConditionedFrame out;
+    for (uint32_t i = 0; i < iterations; i++) {
+        conditioner.push(i, 1, UDP_DATA, frame, sizeof(frame));
+        while (conditioner.pop(i, out)) doNotOptimize(out.length);
+    }
+}
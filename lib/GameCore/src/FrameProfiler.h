@@ -0,0 +1,259 @@
+#ifndef FRAME_PROFILER_H
+#define FRAME_PROFILER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+///////////////////////////////////////////////////////////////
+// Per-stage frame timing with fixed-size histograms.
+//
+// Wrap a stage in begin()/end() (or a ProfileScope) and its
+// duration goes into that stage's StageHistogram: log-linear
+// buckets, exact below 16 us and 1/8 of an octave wide above,
+// so p50/p99 come back within ~6% with no allocation and no
+// sorting. summarize() boils a histogram down to count, p50,
+// p99 and max, and encodeProfileDump() packs one summary per
+// stage into a few dozen bytes for Serial.
+//
+// One profiler is written by one task. Stages timed on another
+// task (the gamepad sampler) get their own profiler.
+//
+// Clock is anything with uint32_t nowUs(), like FrameScheduler.
+///////////////////////////////////////////////////////////////
+enum ProfileStage {
+    PROFILE_INPUT,     // Seesaw I2C sample (input task)
+    PROFILE_SIMULATE,  // step() and collision checks
+    PROFILE_RENDER,    // Building and drawing the frame
+    PROFILE_NETWORK,   // Encoding and handing packets to BLE
+    PROFILE_FRAME,     // The whole of runFrame()
+    PROFILE_STAGE_COUNT
+};
+
+inline const char *profileStageName(ProfileStage stage) {
+    switch (stage) {
+    case PROFILE_INPUT: return "input";
+    case PROFILE_SIMULATE: return "simulate";
+    case PROFILE_RENDER: return "render";
+    case PROFILE_NETWORK: return "network";
+    case PROFILE_FRAME: return "frame";
+    default: return "?";
+    }
+}
+
+///////////////////////////////////////////////////////////////
+// Histogram buckets
+///////////////////////////////////////////////////////////////
+const int HISTOGRAM_SUB_BITS = 3;                          // 8 buckets per octave
+const int HISTOGRAM_SUB = 1 << HISTOGRAM_SUB_BITS;
+const int HISTOGRAM_LINEAR = 2 * HISTOGRAM_SUB;            // 0..15 us, one bucket each
+const int HISTOGRAM_FIRST_OCTAVE = HISTOGRAM_SUB_BITS + 1;  // 16 us = 2^4
+const int HISTOGRAM_LAST_OCTAVE = 22;                       // Up to ~8 s, the rest share the top bucket
+const int HISTOGRAM_BUCKETS =
+    HISTOGRAM_LINEAR + (HISTOGRAM_LAST_OCTAVE - HISTOGRAM_FIRST_OCTAVE + 1) * HISTOGRAM_SUB;
+
+inline int histogramBucket(uint32_t us) {
+    if (us < (uint32_t)HISTOGRAM_LINEAR) return (int)us;
+    int octave = 31 - __builtin_clz(us);
+    if (octave > HISTOGRAM_LAST_OCTAVE) return HISTOGRAM_BUCKETS - 1;
+    int sub = (int)(us >> (octave - HISTOGRAM_SUB_BITS)) & (HISTOGRAM_SUB - 1);
+    return HISTOGRAM_LINEAR + (octave - HISTOGRAM_FIRST_OCTAVE) * HISTOGRAM_SUB + sub;
+}
+
+// Smallest value that lands in a bucket
+inline uint32_t histogramBucketLow(int bucket) {
+    if (bucket < HISTOGRAM_LINEAR) return (uint32_t)bucket;
+    int octave = HISTOGRAM_FIRST_OCTAVE + (bucket - HISTOGRAM_LINEAR) / HISTOGRAM_SUB;
+    int sub = (bucket - HISTOGRAM_LINEAR) % HISTOGRAM_SUB;
+    return (uint32_t)(HISTOGRAM_SUB + sub) << (octave - HISTOGRAM_SUB_BITS);
+}
+
+class StageHistogram {
+public:
+    StageHistogram() {
+        reset();
+    }
+
+    void reset() {
+        memset(counts, 0, sizeof(counts));
+        total = 0;
+        largest = 0;
+    }
+
+    void record(uint32_t us) {
+        uint16_t &count = counts[histogramBucket(us)];
+        if (count < 0xFFFF) count++;
+        total++;
+        if (us > largest) largest = us;
+    }
+
+    uint32_t count() const {
+        return total;
+    }
+
+    uint32_t maxUs() const {
+        return largest;
+    }
+
+    // Duration that permille / 1000 of the samples took at most: the
+    // middle of the bucket holding that rank, capped at the max seen
+    uint32_t percentile(uint32_t permille) const {
+        if (total == 0) return 0;
+        uint32_t rank = (uint32_t)(((uint64_t)total * permille + 999) / 1000);
+        if (rank == 0) rank = 1;
+
+        uint32_t seen = 0;
+        for (int b = 0; b < HISTOGRAM_BUCKETS; b++) {
+            seen += counts[b];
+            if (seen < rank) continue;
+            uint32_t low = histogramBucketLow(b);
+            uint32_t high = b + 1 < HISTOGRAM_BUCKETS ? histogramBucketLow(b + 1) : largest + 1;
+            uint32_t middle = low + (high - low - 1) / 2;
+            return middle < largest ? middle : largest;
+        }
+        return largest;  // Counts saturated
+    }
+
+private:
+    uint16_t counts[HISTOGRAM_BUCKETS];
+    uint32_t total;
+    uint32_t largest;
+};
+
+///////////////////////////////////////////////////////////////
+// Profiler: one histogram per stage
+///////////////////////////////////////////////////////////////
+template <typename Clock>
+class FrameProfiler {
+public:
+    FrameProfiler(Clock &clock) : clock(clock) {
+        for (int i = 0; i < PROFILE_STAGE_COUNT; i++) startUs[i] = 0;
+    }
+
+    void begin(ProfileStage stage) {
+        startUs[stage] = clock.nowUs();
+    }
+
+    // Returns the stage's duration
+    uint32_t end(ProfileStage stage) {
+        uint32_t us = clock.nowUs() - startUs[stage];
+        histograms[stage].record(us);
+        return us;
+    }
+
+    const StageHistogram &histogram(ProfileStage stage) const {
+        return histograms[stage];
+    }
+
+    void reset() {
+        for (int i = 0; i < PROFILE_STAGE_COUNT; i++) histograms[i].reset();
+    }
+
+private:
+    Clock &clock;
+    uint32_t startUs[PROFILE_STAGE_COUNT];
+    StageHistogram histograms[PROFILE_STAGE_COUNT];
+};
+
+// Times the enclosing block as one run of a stage
+template <typename Clock>
+class ProfileScope {
+public:
+    ProfileScope(FrameProfiler<Clock> &profiler, ProfileStage stage) : profiler(profiler), stage(stage) {
+        profiler.begin(stage);
+    }
+
+    ~ProfileScope() {
+        profiler.end(stage);
+    }
+
+private:
+    FrameProfiler<Clock> &profiler;
+    ProfileStage stage;
+};
+
+///////////////////////////////////////////////////////////////
+// Summaries and the Serial dump
+//
+//   [0xB5][version][stage count][payload][checksum]
+//   payload: per stage [stage][count u16][p50 u16][p99 u16][max u16]
+//
+// Little-endian, times in us, everything saturating at 65535.
+// checksum = low byte of the sum of every byte before it, so a
+// reader can find dumps in a stream that also carries text.
+///////////////////////////////////////////////////////////////
+const uint8_t PROFILE_DUMP_MAGIC = 0xB5;
+const uint8_t PROFILE_DUMP_VERSION = 1;
+const size_t PROFILE_DUMP_HEADER_SIZE = 3;
+const size_t PROFILE_DUMP_STAGE_SIZE = 9;
+const size_t PROFILE_DUMP_MAX_SIZE = PROFILE_DUMP_HEADER_SIZE + PROFILE_STAGE_COUNT * PROFILE_DUMP_STAGE_SIZE + 1;
+
+struct ProfileSummary {
+    uint8_t stage;
+    uint16_t count;
+    uint16_t p50Us;
+    uint16_t p99Us;
+    uint16_t maxUs;
+};
+
+inline uint16_t saturate16(uint32_t value) {
+    return value > 0xFFFF ? 0xFFFF : (uint16_t)value;
+}
+
+inline ProfileSummary summarize(ProfileStage stage, const StageHistogram &histogram) {
+    ProfileSummary summary;
+    summary.stage = (uint8_t)stage;
+    summary.count = saturate16(histogram.count());
+    summary.p50Us = saturate16(histogram.percentile(500));
+    summary.p99Us = saturate16(histogram.percentile(990));
+    summary.maxUs = saturate16(histogram.maxUs());
+    return summary;
+}
+
+// out must hold PROFILE_DUMP_MAX_SIZE bytes. Returns the dump length.
+inline size_t encodeProfileDump(const ProfileSummary *summaries, int count, uint8_t *out) {
+    if (count > PROFILE_STAGE_COUNT) count = PROFILE_STAGE_COUNT;
+    size_t length = 0;
+    out[length++] = PROFILE_DUMP_MAGIC;
+    out[length++] = PROFILE_DUMP_VERSION;
+    out[length++] = (uint8_t)count;
+    for (int i = 0; i < count; i++) {
+        const ProfileSummary &s = summaries[i];
+        const uint16_t values[4] = { s.count, s.p50Us, s.p99Us, s.maxUs };
+        out[length++] = s.stage;
+        for (int v = 0; v < 4; v++) {
+            out[length++] = (uint8_t)(values[v] & 0xFF);
+            out[length++] = (uint8_t)(values[v] >> 8);
+        }
+    }
+
+    uint8_t sum = 0;
+    for (size_t i = 0; i < length; i++) sum += out[i];
+    out[length++] = sum;
+    return length;
+}
+
+// Returns the number of summaries read, or -1 if data isn't a whole valid dump
+inline int decodeProfileDump(const uint8_t *data, size_t length, ProfileSummary *summaries, int maxCount) {
+    if (length < PROFILE_DUMP_HEADER_SIZE + 1) return -1;
+    if (data[0] != PROFILE_DUMP_MAGIC || data[1] != PROFILE_DUMP_VERSION) return -1;
+    int count = data[2];
+    if (count > maxCount || length != PROFILE_DUMP_HEADER_SIZE + count * PROFILE_DUMP_STAGE_SIZE + 1) return -1;
+
+    uint8_t sum = 0;
+    for (size_t i = 0; i + 1 < length; i++) sum += data[i];
+    if (sum != data[length - 1]) return -1;
+
+    const uint8_t *p = data + PROFILE_DUMP_HEADER_SIZE;
+    for (int i = 0; i < count; i++, p += PROFILE_DUMP_STAGE_SIZE) {
+        ProfileSummary &s = summaries[i];
+        s.stage = p[0];
+        s.count = (uint16_t)(p[1] | p[2] << 8);
+        s.p50Us = (uint16_t)(p[3] | p[4] << 8);
+        s.p99Us = (uint16_t)(p[5] | p[6] << 8);
+        s.maxUs = (uint16_t)(p[7] | p[8] << 8);
+    }
+    return count;
+}
+
+#endif
@@ -0,0 +1,185 @@
+#ifndef FRAME_SCHEDULER_H
+#define FRAME_SCHEDULER_H
+
+#include <stdint.h>
+
+#ifdef ARDUINO
+#include <Arduino.h>
+#endif
+
+///////////////////////////////////////////////////////////////
+// Fixed-timestep scheduler for the game loop.
+//
+// Simulation, rendering and network sends each have their own
+// period. update() adds the time since the last call to every
+// stage's accumulator and says how many times each stage should
+// run now: simulation catches up with several fixed steps (up to
+// SCHEDULER_MAX_CATCHUP, the rest is dropped), render and network
+// run at most once and skip missed slots. Wrap each stage in
+// begin()/end() to record how long it took and count overruns of
+// its budget.
+//
+// Clock is anything with uint32_t nowUs(), so the host can drive
+// the scheduler with a fake clock.
+///////////////////////////////////////////////////////////////
+enum SchedulerStage {
+    STAGE_SIMULATE,
+    STAGE_RENDER,
+    STAGE_NETWORK,
+    STAGE_COUNT
+};
+
+inline const char *stageName(SchedulerStage stage) {
+    switch (stage) {
+    case STAGE_SIMULATE: return "simulate";
+    case STAGE_RENDER: return "render";
+    case STAGE_NETWORK: return "network";
+    default: return "?";
+    }
+}
+
+const uint32_t SCHEDULER_MAX_CATCHUP = 4;  // Max fixed steps per update()
+
+struct StageStats {
+    uint32_t periodUs;  // How often the stage runs
+    uint32_t budgetUs;  // How long one run may take
+    uint32_t runs;      // Runs scheduled
+    uint32_t dropped;   // Runs skipped because we fell behind
+    uint32_t overruns;  // Runs that took longer than budgetUs
+    uint32_t lastUs;    // Duration of the last run
+    uint32_t worstUs;   // Longest run
+};
+
+template <typename Clock>
+class FrameScheduler {
+public:
+    // Every stage starts at periodUs with the whole period as its budget
+    FrameScheduler(Clock &clock, uint32_t periodUs = 30000)
+        : clock(clock), lastUs(0), started(false) {
+        for (int i = 0; i < STAGE_COUNT; i++) {
+            StageStats &s = stats[i];
+            s.periodUs = periodUs;
+            s.budgetUs = periodUs;
+            accumulatorUs[i] = 0;
+            due[i] = 0;
+            startUs[i] = 0;
+        }
+        resetStats();
+    }
+
+    // budgetUs = 0 uses the period as the budget
+    void setStage(SchedulerStage stage, uint32_t periodUs, uint32_t budgetUs = 0) {
+        stats[stage].periodUs = periodUs ? periodUs : 1;
+        stats[stage].budgetUs = budgetUs ? budgetUs : stats[stage].periodUs;
+        accumulatorUs[stage] = 0;
+    }
+
+    // Start counting from now, e.g. after a pause or a new round
+    void restart() {
+        started = false;
+        for (int i = 0; i < STAGE_COUNT; i++) {
+            accumulatorUs[i] = 0;
+            due[i] = 0;
+        }
+    }
+
+    // Advance time. The first call after construction or restart()
+    // only starts the clock; nothing is due yet.
+    void update() {
+        uint32_t now = clock.nowUs();
+        uint32_t elapsed = started ? now - lastUs : 0;
+        lastUs = now;
+        started = true;
+
+        for (int i = 0; i < STAGE_COUNT; i++) {
+            StageStats &s = stats[i];
+            uint32_t maxRuns = i == STAGE_SIMULATE ? SCHEDULER_MAX_CATCHUP : 1;
+
+            accumulatorUs[i] += elapsed;
+            uint32_t runs = accumulatorUs[i] / s.periodUs;
+            accumulatorUs[i] -= runs * s.periodUs;
+            if (runs > maxRuns) {
+                s.dropped += runs - maxRuns;
+                runs = maxRuns;
+            }
+            due[i] = runs;
+            s.runs += runs;
+        }
+    }
+
+    // How many times the stage should run after the last update()
+    uint32_t dueCount(SchedulerStage stage) const {
+        return due[stage];
+    }
+
+    bool isDue(SchedulerStage stage) const {
+        return due[stage] > 0;
+    }
+
+    // Fixed simulation step in milliseconds (for step()'s dtMs)
+    uint32_t stepMs() const {
+        return stats[STAGE_SIMULATE].periodUs / 1000;
+    }
+
+    // Time until the next stage is due; sleep this long between frames
+    uint32_t untilNextUs() const {
+        uint32_t soonest = 0xFFFFFFFF;
+        for (int i = 0; i < STAGE_COUNT; i++) {
+            uint32_t wait = stats[i].periodUs - accumulatorUs[i];
+            if (wait < soonest) soonest = wait;
+        }
+        uint32_t sinceUpdate = clock.nowUs() - lastUs;
+        return sinceUpdate >= soonest ? 0 : soonest - sinceUpdate;
+    }
+
+    void begin(SchedulerStage stage) {
+        startUs[stage] = clock.nowUs();
+    }
+
+    void end(SchedulerStage stage) {
+        StageStats &s = stats[stage];
+        s.lastUs = clock.nowUs() - startUs[stage];
+        if (s.lastUs > s.worstUs) s.worstUs = s.lastUs;
+        if (s.lastUs > s.budgetUs) s.overruns++;
+    }
+
+    const StageStats &stageStats(SchedulerStage stage) const {
+        return stats[stage];
+    }
+
+    // Total overruns across all stages (handy for "anything late?" checks)
+    uint32_t totalOverruns() const {
+        uint32_t total = 0;
+        for (int i = 0; i < STAGE_COUNT; i++) total += stats[i].overruns;
+        return total;
+    }
+
+    // Clear the counters, keeping the configured periods and budgets
+    void resetStats() {
+        for (int i = 0; i < STAGE_COUNT; i++) {
+            StageStats &s = stats[i];
+            s.runs = s.dropped = s.overruns = 0;
+            s.lastUs = s.worstUs = 0;
+        }
+    }
+
+private:
+    Clock &clock;
+    uint32_t lastUs;
+    bool started;
+    StageStats stats[STAGE_COUNT];
+    uint32_t accumulatorUs[STAGE_COUNT];
+    uint32_t due[STAGE_COUNT];
+    uint32_t startUs[STAGE_COUNT];
+};
+
+#ifdef ARDUINO
+// The scheduler's clock on the device
+struct ArduinoClock {
+    uint32_t nowUs() {
+        return micros();
+    }
+};
+#endif
+
+#endif
@@ -0,0 +1,372 @@
+#ifndef GAME_CORE_H
+#define GAME_CORE_H
+
+#include "StickShaper.h"
+#include <stdint.h>
+
+///////////////////////////////////////////////////////////////
+// Hardware-free game logic shared by every dot-game sketch.
+//
+// Nothing in here touches the LCD, the gamepad or BLE, so the
+// same code builds for the Core2 and for the native host env.
+// Sketches read the gamepad into a GameInput, call step() once
+// per frame and draw whatever ends up in the GameState.
+///////////////////////////////////////////////////////////////
+
+// Playfield
+const int FIELD_WIDTH = 320;
+const int FIELD_HEIGHT = 240;
+const int DOT_SIZE = 5;
+const int FIELD_MAX_X = FIELD_WIDTH - DOT_SIZE;   // Right-most dot position
+const int FIELD_MAX_Y = FIELD_HEIGHT - DOT_SIZE;  // Bottom-most dot position
+
+// Collision threshold (per axis, in pixels)
+const int COLLISION_DISTANCE = 10;
+
+// Moves longer than this (per axis) between two collision checks are
+// jumps (warps, respawns), tested at the new position instead of swept
+const int SWEEP_MAX_MOVE = 40;
+
+// Ignore collisions until the remote dot has been tracked this long
+const uint32_t COLLISION_GRACE_MS = 2000;
+
+// Speed cycles 1..MAX_SPEED with the START button
+const int MAX_SPEED = 5;
+
+// Joystick (raw 0..1023 after the sketches' 1023 - analogRead() flip)
+const int JOYSTICK_CENTER = 512;
+const int JOYSTICK_DEADZONE = 102;  // Same as |(raw - 512) / 512.0| > 0.2
+
+// How step() turns stick tilt into motion (see StickShaper.h)
+const StickShaper DEFAULT_STICK(JOYSTICK_DEADZONE, STICK_CURVE_EXPO);
+
+// Button bits in GameInput::buttons (1 = held). Bit positions match the
+// seesaw gamepad pins so a digitalReadBulk() mask maps straight across.
+const uint32_t GAME_BUTTON_SELECT = 1UL << 0;
+const uint32_t GAME_BUTTON_B = 1UL << 1;
+const uint32_t GAME_BUTTON_A = 1UL << 5;
+const uint32_t GAME_BUTTON_START = 1UL << 16;
+
+// A + B together toggle the profiler overlay; step() ignores both
+const uint32_t GAME_COMBO_PROFILER = GAME_BUTTON_A | GAME_BUTTON_B;
+
+// Events reported by step()
+enum {
+    STEP_SPEED_CHANGED = 0x01,
+    STEP_WARPED = 0x02,
+    STEP_COLLISION = 0x04,
+};
+
+///////////////////////////////////////////////////////////////
+// Game state
+///////////////////////////////////////////////////////////////
+struct PlayerState {
+    int x;
+    int y;
+    int speed;
+    int lastX;    // Position at the last collision check (swept from here)
+    int lastY;
+    int subX;     // Sub-pixel remainder of x, in 1/256 px
+    int subY;
+};
+
+struct GameState {
+    PlayerState local;        // Dot driven by this board's gamepad
+    PlayerState remote;       // Dot reported by the other board
+    bool remoteValid;         // True once a remote position has been received
+    bool gameOver;
+    bool detectCollisions;    // False on a board that leaves collisions to the other one
+    uint32_t elapsedMs;       // Game time, advanced by step()
+    uint32_t remoteSinceMs;   // elapsedMs when the remote dot first appeared
+    uint32_t buttonsHeld;     // Buttons held last frame (for edge detection)
+    uint32_t rng;             // xorshift32 state, never zero
+};
+
+struct GameInput {
+    int joyX;          // 0..1023, 512 = centered
+    int joyY;          // 0..1023, 512 = centered
+    uint32_t buttons;  // GAME_BUTTON_* bits that are currently held
+};
+
+///////////////////////////////////////////////////////////////
+// Helpers
+///////////////////////////////////////////////////////////////
+inline int clampInt(int value, int low, int high) {
+    return value < low ? low : (value > high ? high : value);
+}
+
+// xorshift32 so warps and spawn points are reproducible from the seed
+inline uint32_t nextRandom(uint32_t &rng) {
+    rng ^= rng << 13;
+    rng ^= rng >> 17;
+    rng ^= rng << 5;
+    return rng;
+}
+
+// Random value in [low, high), like Arduino's random(low, high)
+inline int randomBetween(uint32_t &rng, int low, int high) {
+    if (high <= low) return low;
+    return low + (int)(nextRandom(rng) % (uint32_t)(high - low));
+}
+
+// -1, 0 or +1 depending on which side of the deadzone the axis is
+// (the Lab 1 / Lab 2 Challenge 1 sketches; step() uses DEFAULT_STICK)
+inline int joystickAxis(int raw) {
+    int offset = raw - JOYSTICK_CENTER;
+    if (offset > JOYSTICK_DEADZONE) return 1;
+    if (offset < -JOYSTICK_DEADZONE) return -1;
+    return 0;
+}
+
+inline bool dotsCollide(int ax, int ay, int bx, int by) {
+    int dx = ax - bx;
+    int dy = ay - by;
+    if (dx < 0) dx = -dx;
+    if (dy < 0) dy = -dy;
+    return dx < COLLISION_DISTANCE && dy < COLLISION_DISTANCE;
+}
+
+///////////////////////////////////////////////////////////////
+// Swept collision: dot A moves from (ax0, ay0) to (ax1, ay1)
+// while dot B moves from (bx0, by0) to (bx1, by1), both at a
+// constant rate over the same step. True if at any moment in
+// between they are within COLLISION_DISTANCE on both axes, as
+// dotsCollide() would say if it had been sampled right then.
+//
+// In B's frame of reference A stands still and B travels along
+// one segment, so this is a slab test of that segment against
+// the collision box. Each axis gives an open interval of step
+// time t when it overlaps; the entry/exit times are kept as
+// fractions (num / den, den > 0) and compared by cross
+// multiplication, so it is all integer math, no division.
+///////////////////////////////////////////////////////////////
+inline bool dotsCollideSwept(int ax0, int ay0, int ax1, int ay1,
+                             int bx0, int by0, int bx1, int by1) {
+    const int D = COLLISION_DISTANCE;
+
+    // Relative start and motion of B
+    int rx = bx0 - ax0, ry = by0 - ay0;
+    int mx = (bx1 - ax1) - rx, my = (by1 - ay1) - ry;
+
+    // Quick reject (the usual case): the whole path stays off one side of the box
+    int ex = rx + mx, ey = ry + my;
+    if ((rx >= D && ex >= D) || (rx <= -D && ex <= -D) || (ry >= D && ey >= D) || (ry <= -D && ey <= -D)) {
+        return false;
+    }
+
+    // Work with a positive motion per axis (mirror the axis otherwise)
+    int sx = mx < 0 ? -1 : 1, sy = my < 0 ? -1 : 1;
+    rx *= sx; mx *= sx;
+    ry *= sy; my *= sy;
+
+    // Axis not moving: overlaps for the whole step or never.
+    // Moving: overlaps for (-D - r) / m < t < (D - r) / m.
+    int xIn = mx ? -D - rx : -1, xOut = mx ? D - rx : 2, xDen = mx ? mx : 1;
+    int yIn = my ? -D - ry : -1, yOut = my ? D - ry : 2, yDen = my ? my : 1;
+    if (!mx && (rx <= -D || rx >= D)) return false;
+    if (!my && (ry <= -D || ry >= D)) return false;
+
+    // Latest entry and earliest exit (as fractions)
+    bool xEntersLater = xIn * yDen > yIn * xDen;
+    int inNum = xEntersLater ? xIn : yIn, inDen = xEntersLater ? xDen : yDen;
+    bool xExitsFirst = xOut * yDen < yOut * xDen;
+    int outNum = xExitsFirst ? xOut : yOut, outDen = xExitsFirst ? xDen : yDen;
+
+    // Both axes overlap at once, and that window meets t in [0, 1]
+    return inNum * outDen < outNum * inDen && inNum < inDen && outNum > 0;
+}
+
+///////////////////////////////////////////////////////////////
+// Start a new round: random local spawn, speed 1, no remote dot
+///////////////////////////////////////////////////////////////
+inline void resetGame(GameState &state, uint32_t seed) {
+    state.rng = seed ? seed : 0x2545F491UL;
+    state.local.x = randomBetween(state.rng, 50, 250);
+    state.local.y = randomBetween(state.rng, 50, 200);
+    state.local.speed = 1;
+    state.local.lastX = state.local.x;
+    state.local.lastY = state.local.y;
+    state.local.subX = state.local.subY = 0;
+    state.remote.x = -1;
+    state.remote.y = -1;
+    state.remote.speed = 1;
+    state.remote.lastX = -1;
+    state.remote.lastY = -1;
+    state.remote.subX = state.remote.subY = 0;
+    state.remoteValid = false;
+    state.gameOver = false;
+    state.detectCollisions = true;
+    state.elapsedMs = 0;
+    state.remoteSinceMs = 0;
+    state.buttonsHeld = 0;
+}
+
+///////////////////////////////////////////////////////////////
+// Move the local dot away from a dot that just appeared at x, y
+// if the two would spawn on top of each other.
+///////////////////////////////////////////////////////////////
+inline void avoidSpawnOverlap(GameState &state, int x, int y) {
+    int dx = state.local.x - x;
+    int dy = state.local.y - y;
+    if (dx > -50 && dx < 50 && dy > -50 && dy < 50) {
+        state.local.x = (x < 160) ? randomBetween(state.rng, 200, 300)
+                                  : randomBetween(state.rng, 20, 120);
+        state.local.y = (y < 120) ? randomBetween(state.rng, 150, 220)
+                                  : randomBetween(state.rng, 20, 90);
+        state.local.lastX = state.local.x;  // A respawn, not a move
+        state.local.lastY = state.local.y;
+        state.local.subX = state.local.subY = 0;
+    }
+}
+
+///////////////////////////////////////////////////////////////
+// Record a remote position. The first one of a round moves the
+// local dot out of the way (see avoidSpawnOverlap()).
+///////////////////////////////////////////////////////////////
+inline void setRemotePosition(GameState &state, int x, int y) {
+    state.remote.x = clampInt(x, 0, FIELD_MAX_X);
+    state.remote.y = clampInt(y, 0, FIELD_MAX_Y);
+
+    if (!state.remoteValid) {
+        state.remoteValid = true;
+        state.remoteSinceMs = state.elapsedMs;
+        state.remote.lastX = state.remote.x;
+        state.remote.lastY = state.remote.y;
+        avoidSpawnOverlap(state, state.remote.x, state.remote.y);
+    }
+}
+
+///////////////////////////////////////////////////////////////
+// Swept test for two players since their last check (see
+// dotsCollideSwept()); a jump longer than SWEEP_MAX_MOVE is
+// only tested where it landed
+///////////////////////////////////////////////////////////////
+inline bool isJump(int fromX, int fromY, int toX, int toY) {
+    int dx = toX - fromX;
+    int dy = toY - fromY;
+    return dx > SWEEP_MAX_MOVE || dx < -SWEEP_MAX_MOVE || dy > SWEEP_MAX_MOVE || dy < -SWEEP_MAX_MOVE;
+}
+
+inline bool playersCollideSwept(int ax0, int ay0, int ax1, int ay1, int bx0, int by0, int bx1, int by1) {
+    if (isJump(ax0, ay0, ax1, ay1)) {
+        ax0 = ax1;
+        ay0 = ay1;
+    }
+    if (isJump(bx0, by0, bx1, by1)) {
+        bx0 = bx1;
+        by0 = by1;
+    }
+    return dotsCollideSwept(ax0, ay0, ax1, ay1, bx0, by0, bx1, by1);
+}
+
+inline bool collisionsArmed(const GameState &state) {
+    return !state.gameOver && state.remoteValid && state.detectCollisions &&
+           state.elapsedMs - state.remoteSinceMs > COLLISION_GRACE_MS;
+}
+
+///////////////////////////////////////////////////////////////
+// Check for collision between the dots at the given positions
+// (e.g. rewound ones, see PositionHistory.h), with the usual
+// grace period. Sets gameOver and returns true on a hit.
+///////////////////////////////////////////////////////////////
+inline bool checkCollisionAt(GameState &state, int localX, int localY, int remoteX, int remoteY) {
+    if (!collisionsArmed(state)) return false;
+
+    if (dotsCollide(localX, localY, remoteX, remoteY)) {
+        state.gameOver = true;
+        return true;
+    }
+    return false;
+}
+
+///////////////////////////////////////////////////////////////
+// Check for collision between the dots along the paths both
+// took since the last check, so fast dots can't pass through
+// each other between frames. Sets gameOver and returns true on
+// the frame the dots first touch.
+///////////////////////////////////////////////////////////////
+inline bool checkCollision(GameState &state) {
+    bool hit = collisionsArmed(state) &&
+               playersCollideSwept(state.local.lastX, state.local.lastY, state.local.x, state.local.y,
+                                   state.remote.lastX, state.remote.lastY, state.remote.x, state.remote.y);
+    state.local.lastX = state.local.x;
+    state.local.lastY = state.local.y;
+    state.remote.lastX = state.remote.x;
+    state.remote.lastY = state.remote.y;
+
+    if (hit) state.gameOver = true;
+    return hit;
+}
+
+// Move one axis by a Q8 distance, carrying the fraction to the next frame
+inline void moveAxis(int &position, int &sub, int deltaQ8, int high) {
+    int total = position * STICK_ONE + sub + deltaQ8;
+    if (total < 0) {
+        position = sub = 0;
+        return;
+    }
+    position = total >> STICK_Q;
+    sub = total & (STICK_ONE - 1);
+    if (position > high) {
+        position = high;
+        sub = 0;
+    }
+}
+
+///////////////////////////////////////////////////////////////
+// Advance the game by one frame of dtMs milliseconds.
+// Returns a mask of STEP_* events that happened this frame.
+//
+// The dot moves speed px per frame at full tilt in any
+// direction, less for a partial tilt (the stick's response
+// curve), keeping the sub-pixel remainder between frames.
+//
+// Buttons act on their rising edge: held now but not on the
+// last step, or in pressed, which carries taps the sampler saw
+// go down and up again between two steps.
+///////////////////////////////////////////////////////////////
+inline uint8_t step(GameState &state, const GameInput &input, uint32_t pressed, uint32_t dtMs,
+                    const StickShaper &stick = DEFAULT_STICK) {
+    if (state.gameOver) return 0;
+
+    uint8_t events = 0;
+    state.elapsedMs += dtMs;
+
+    // Rising edges only, so holding a button doesn't repeat it
+    pressed |= input.buttons & ~state.buttonsHeld;
+    state.buttonsHeld = input.buttons;
+
+    // Start button - Increase speed, wrap around from MAX_SPEED to 1
+    if (pressed & GAME_BUTTON_START) {
+        state.local.speed = (state.local.speed % MAX_SPEED) + 1;
+        events |= STEP_SPEED_CHANGED;
+    }
+
+    // Select button - Warp to random position
+    if (pressed & GAME_BUTTON_SELECT) {
+        state.local.x = randomBetween(state.rng, 10, 310);
+        state.local.y = randomBetween(state.rng, 10, 230);
+        state.local.lastX = state.local.x;  // Teleported, nothing in between was crossed
+        state.local.lastY = state.local.y;
+        state.local.subX = state.local.subY = 0;
+        events |= STEP_WARPED;
+    }
+
+    // Screen Y grows downward, joystick Y grows upward
+    int velocityX, velocityY;
+    stick.shape(input.joyX - JOYSTICK_CENTER, input.joyY - JOYSTICK_CENTER, velocityX, velocityY);
+    moveAxis(state.local.x, state.local.subX, velocityX * state.local.speed, FIELD_MAX_X);
+    moveAxis(state.local.y, state.local.subY, -velocityY * state.local.speed, FIELD_MAX_Y);
+
+    if (checkCollision(state)) events |= STEP_COLLISION;
+
+    return events;
+}
+
+// Edges from input.buttons alone
+inline uint8_t step(GameState &state, const GameInput &input, uint32_t dtMs,
+                    const StickShaper &stick = DEFAULT_STICK) {
+    return step(state, input, 0, dtMs, stick);
+}
+
+#endif
@@ -0,0 +1,184 @@
+#ifndef INPUT_SNAPSHOT_H
+#define INPUT_SNAPSHOT_H
+
+#include "GameCore.h"
+
+///////////////////////////////////////////////////////////////
+// Gamepad sampling with the fewest seesaw I2C transactions.
+//
+// Each sample is one digitalReadBulk() for every button plus one
+// analogRead() per joystick axis. Button edges are derived from
+// the bulk mask instead of extra digitalRead() calls. The sampler
+// is a template so the host can drive it with a fake seesaw.
+///////////////////////////////////////////////////////////////
+
+// Seesaw pins on the gamepad
+const uint8_t JOYSTICK_X_PIN = 14;
+const uint8_t JOYSTICK_Y_PIN = 15;
+
+// Buttons the game reads (seesaw pin bits, active LOW on the wire)
+const uint32_t GAMEPAD_BUTTON_MASK = GAME_BUTTON_START | GAME_BUTTON_SELECT | GAME_BUTTON_A | GAME_BUTTON_B;
+
+struct InputSnapshot {
+    uint32_t timeMs;   // When the sample was taken
+    GameInput input;   // Joystick and held buttons (1 = held)
+    uint32_t pressed;  // Buttons that went down since the previous sample
+    uint32_t released; // Buttons that came up since the previous sample
+};
+
+template <typename Gamepad>
+class InputSampler {
+public:
+    InputSampler(Gamepad &gamepad, uint32_t buttonMask = GAMEPAD_BUTTON_MASK)
+        : gamepad(gamepad), buttonMask(buttonMask), lastHeld(0) {}
+
+    InputSnapshot sample(uint32_t nowMs) {
+        InputSnapshot snapshot;
+        snapshot.timeMs = nowMs;
+
+        // One bulk read for all buttons; pressed = 0 on the wire
+        uint32_t held = ~gamepad.digitalReadBulk(buttonMask) & buttonMask;
+        snapshot.input.buttons = held;
+        snapshot.pressed = held & ~lastHeld;
+        snapshot.released = lastHeld & ~held;
+        lastHeld = held;
+
+        // Flip the axes so up/right read high, like the original sketches
+        snapshot.input.joyX = 1023 - gamepad.analogRead(JOYSTICK_X_PIN);
+        snapshot.input.joyY = 1023 - gamepad.analogRead(JOYSTICK_Y_PIN);
+        return snapshot;
+    }
+
+    // Treat the current buttons as already held (e.g. after a reset)
+    void setHeld(uint32_t held) {
+        lastHeld = held & buttonMask;
+    }
+
+private:
+    Gamepad &gamepad;
+    uint32_t buttonMask;
+    uint32_t lastHeld;
+};
+
+///////////////////////////////////////////////////////////////
+// Interrupt-driven sampling.
+//
+// The seesaw pulls its INT line low when a button in the
+// interrupt mask changes. The ISR only calls onInterrupt();
+// poll() then reads the buttons once per interrupt and reads
+// the joystick every joystickPeriodMs, so an idle gamepad costs
+// no button traffic at all. Gamepad also needs
+// readGPIOInterruptFlags() (see SeesawGamepad.h), which tells
+// us about taps that were released again before we got to them.
+///////////////////////////////////////////////////////////////
+template <typename Gamepad>
+class InterruptSampler {
+public:
+    InterruptSampler(Gamepad &gamepad, uint32_t joystickPeriodMs = 30,
+                     uint32_t buttonMask = GAMEPAD_BUTTON_MASK)
+        : gamepad(gamepad), buttonMask(buttonMask), joystickPeriodMs(joystickPeriodMs),
+          pending(true), joystickDue(true), lastJoystickMs(0), unflagged(0) {
+        snapshot.timeMs = 0;
+        snapshot.input.joyX = JOYSTICK_CENTER;
+        snapshot.input.joyY = JOYSTICK_CENTER;
+        snapshot.input.buttons = 0;
+        snapshot.pressed = 0;
+        snapshot.released = 0;
+    }
+
+    // Call from the INT pin ISR
+    void onInterrupt() {
+        pending = true;
+    }
+
+    void setJoystickPeriod(uint32_t periodMs) {
+        joystickPeriodMs = periodMs;
+    }
+
+    // Latest input; pressed/released only cover what happened since the last poll()
+    InputSnapshot poll(uint32_t nowMs) {
+        snapshot.timeMs = nowMs;
+        snapshot.pressed = 0;
+        snapshot.released = 0;
+
+        if (pending) {
+            pending = false;
+            uint32_t changed = gamepad.readGPIOInterruptFlags() & buttonMask;
+            uint32_t lastHeld = snapshot.input.buttons;
+            uint32_t held = ~gamepad.digitalReadBulk(buttonMask) & buttonMask;
+
+            snapshot.pressed = held & ~lastHeld;
+            snapshot.released = lastHeld & ~held;
+
+            // Flagged but back where it started: a tap (or release+press) we missed in between.
+            // A change seen here that wasn't flagged yet happened between the two reads; its
+            // flag turns up next time and is not a tap.
+            uint32_t bounced = changed & ~(held ^ lastHeld) & ~unflagged;
+            unflagged = (held ^ lastHeld) & ~changed;
+            snapshot.pressed |= bounced;
+            snapshot.released |= bounced;
+            snapshot.input.buttons = held;
+        }
+
+        if (joystickDue || nowMs - lastJoystickMs >= joystickPeriodMs) {
+            joystickDue = false;
+            lastJoystickMs = nowMs;
+            snapshot.input.joyX = 1023 - gamepad.analogRead(JOYSTICK_X_PIN);
+            snapshot.input.joyY = 1023 - gamepad.analogRead(JOYSTICK_Y_PIN);
+        }
+        return snapshot;
+    }
+
+private:
+    Gamepad &gamepad;
+    uint32_t buttonMask;
+    uint32_t joystickPeriodMs;
+    volatile bool pending;  // Set by the ISR (starts true to read the initial state)
+    bool joystickDue;
+    uint32_t lastJoystickMs;
+    uint32_t unflagged;  // Edges the last poll saw whose interrupt flag was still to come
+    InputSnapshot snapshot;
+};
+
+///////////////////////////////////////////////////////////////
+// Fold every snapshot waiting in queue (an SpscRing filled by
+// the input task) into latest: joystick and held buttons come
+// from the newest one, pressed/released collect every edge since
+// the last call so a short tap isn't lost between frames.
+// Returns the number of snapshots consumed.
+///////////////////////////////////////////////////////////////
+template <typename Queue>
+int drainInput(Queue &queue, InputSnapshot &latest) {
+    latest.pressed = 0;
+    latest.released = 0;
+
+    int count = 0;
+    InputSnapshot snapshot;
+    while (queue.pop(snapshot)) {
+        uint32_t pressed = latest.pressed | snapshot.pressed;
+        uint32_t released = latest.released | snapshot.released;
+        latest = snapshot;
+        latest.pressed = pressed;
+        latest.released = released;
+        count++;
+    }
+    return count;
+}
+
+///////////////////////////////////////////////////////////////
+// step() with a snapshot from drainInput(): its pressed mask
+// keeps taps that were already released when the frame read
+// them. A frame catching up with several steps passes
+// firstStep = false after the first, so a tap counts once.
+///////////////////////////////////////////////////////////////
+inline uint8_t step(GameState &state, const InputSnapshot &snapshot, uint32_t dtMs, bool firstStep = true,
+                    const StickShaper &stick = DEFAULT_STICK) {
+    return step(state, snapshot.input, firstStep ? snapshot.pressed : 0, dtMs, stick);
+}
+
+// True when the last button of combo went down with the others already held
+inline bool comboPressed(const InputSnapshot &snapshot, uint32_t combo) {
+    return (snapshot.input.buttons & combo) == combo && (snapshot.pressed & combo) != 0;
+}
+
+#endif
@@ -0,0 +1,87 @@
+#ifndef POSITION_HISTORY_H
+#define POSITION_HISTORY_H
+
+#include "GameCore.h"
+
+///////////////////////////////////////////////////////////////
+// Short history of the server's dot for lag-compensated
+// collisions.
+//
+// The server records where its dot was after every simulation
+// step. When a client position arrives, rewind() looks up where
+// the server's dot was at the moment the client was looking at
+// the screen, so the hit test uses the same picture the client
+// player saw instead of a later one. The client's side of the
+// test is the position it sent, so the clients' dots aren't
+// recorded.
+//
+// The client's timestamp mapped onto our clock (RemoteTrack's
+// toLocalMs()) lands when the packet arrived, one trip up after
+// it was sent, and the client drew our dot one trip down plus
+// its render delay behind the WORLD frame's time: see
+// rewindTimeMs().
+///////////////////////////////////////////////////////////////
+const int POSITION_HISTORY_SIZE = 64;  // Power of two; ~2 s of 30 ms steps
+
+struct PositionRecord {
+    uint32_t timeMs;  // Local millis() after the step
+    int16_t localX;
+    int16_t localY;
+};
+
+// When the client drew what it saw as it sent a position, on our clock
+inline uint32_t rewindTimeMs(uint32_t sentLocalMs, uint32_t roundTrip, uint32_t renderDelayMs) {
+    return sentLocalMs - roundTrip - renderDelayMs;
+}
+
+class PositionHistory {
+public:
+    PositionHistory() {
+        clear();
+    }
+
+    void clear() {
+        count = 0;
+        newest = 0;
+    }
+
+    int size() const {
+        return count;
+    }
+
+    void record(uint32_t timeMs, const GameState &state) {
+        newest = (newest + 1) & (POSITION_HISTORY_SIZE - 1);
+        PositionRecord &entry = records[newest];
+        entry.timeMs = timeMs;
+        entry.localX = (int16_t)state.local.x;
+        entry.localY = (int16_t)state.local.y;
+        if (count < POSITION_HISTORY_SIZE) count++;
+    }
+
+    // The newest record taken at or before timeMs. Times older than the
+    // history return the oldest record; returns false only when empty.
+    bool rewind(uint32_t timeMs, PositionRecord &record) const {
+        if (count == 0) return false;
+        for (int age = 0; age < count; age++) {
+            const PositionRecord &entry = at(age);
+            if ((int32_t)(timeMs - entry.timeMs) >= 0) {
+                record = entry;
+                return true;
+            }
+        }
+        record = at(count - 1);
+        return true;
+    }
+
+private:
+    // age 0 = newest
+    const PositionRecord &at(int age) const {
+        return records[(newest - age) & (POSITION_HISTORY_SIZE - 1)];
+    }
+
+    PositionRecord records[POSITION_HISTORY_SIZE];
+    int count;
+    int newest;
+};
+
+#endif
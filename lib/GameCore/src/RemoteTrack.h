@@ -0,0 +1,165 @@
+#ifndef REMOTE_TRACK_H
+#define REMOTE_TRACK_H
+
+#include "GameCore.h"
+
+///////////////////////////////////////////////////////////////
+// Smoothed position of the other player.
+//
+// Received positions go into a small ring with the sender's
+// timestamp. position() shows the dot as it was delayMs ago,
+// interpolating between the two samples around that time, so a
+// steady path stays steady however unevenly the packets arrive.
+// Past the newest sample the dot keeps moving at its last
+// velocity for at most maxExtrapolateMs, then holds. Warps are
+// never interpolated across.
+//
+// Sender time is mapped onto our clock with the smallest
+// (arrival - sent) offset seen, i.e. the least delayed packet;
+// the offset creeps up 1 ms per packet so clock drift and a
+// longer radio path are followed too.
+///////////////////////////////////////////////////////////////
+const int REMOTE_TRACK_SIZE = 8;  // Power of two
+
+class RemoteTrack {
+public:
+    RemoteTrack(uint32_t delayMs = 150, uint32_t maxExtrapolateMs = 100)
+        : delayMs(delayMs), maxExtrapolateMs(maxExtrapolateMs) {
+        reset();
+    }
+
+    void reset() {
+        count = 0;
+        newest = 0;
+        lastSent16 = 0;
+        lastSent = 0;
+        offset = 0;
+    }
+
+    void setDelay(uint32_t ms) {
+        delayMs = ms;
+    }
+
+    bool empty() const {
+        return count == 0;
+    }
+
+    // sentMs: sender's 16-bit clock; arrivalMs: our millis() when it arrived
+    void add(uint16_t sentMs, uint32_t arrivalMs, int x, int y, bool warped) {
+        // Unwrap the 16-bit sender clock (packets are < 32 s apart)
+        int32_t sent = count ? lastSent + (int16_t)(uint16_t)(sentMs - lastSent16) : sentMs;
+        if (count && sent <= lastSent) return;  // Late or duplicate
+        lastSent16 = sentMs;
+        lastSent = sent;
+
+        int32_t candidate = (int32_t)arrivalMs - sent;
+        if (count == 0 || candidate < offset + 1) offset = candidate;
+        else offset++;
+
+        newest = (newest + 1) & (REMOTE_TRACK_SIZE - 1);
+        Sample &sample = samples[newest];
+        sample.timeMs = sent;
+        sample.x = x;
+        sample.y = y;
+        sample.warped = warped;
+        if (count < REMOTE_TRACK_SIZE) count++;
+    }
+
+    // Our clock minus the sender's, plus the fastest trip over (see roundTripMs())
+    int32_t clockOffset() const {
+        return offset;
+    }
+
+    // A sender timestamp (from a packet just add()ed) on our clock
+    uint32_t toLocalMs(uint16_t sentMs) const {
+        int32_t sent = lastSent + (int16_t)(uint16_t)(sentMs - lastSent16);
+        return (uint32_t)(sent + offset);
+    }
+
+    // Where to draw the remote dot at nowMs. Returns false until a sample arrives.
+    bool position(uint32_t nowMs, int &x, int &y) const {
+        if (count == 0) return false;
+
+        // Render time on the sender's clock
+        int32_t t = (int32_t)(nowMs - delayMs) - offset;
+
+        const Sample &last = at(0);
+        if (t >= last.timeMs) {
+            x = last.x;
+            y = last.y;
+            if (count < 2 || last.warped) return true;
+
+            // Dead reckoning from the last two samples
+            const Sample &prev = at(1);
+            int32_t ahead = t - last.timeMs;
+            if (ahead > (int32_t)maxExtrapolateMs) ahead = maxExtrapolateMs;
+            int32_t span = last.timeMs - prev.timeMs;
+            x += (int)((last.x - prev.x) * ahead / span);
+            y += (int)((last.y - prev.y) * ahead / span);
+            x = clampInt(x, 0, FIELD_MAX_X);
+            y = clampInt(y, 0, FIELD_MAX_Y);
+            return true;
+        }
+
+        // Newest sample at or before t, interpolated towards the one after it
+        for (int i = 1; i < count; i++) {
+            const Sample &before = at(i);
+            if (before.timeMs > t) continue;
+
+            const Sample &after = at(i - 1);
+            if (after.warped) {
+                x = before.x;
+                y = before.y;
+            } else {
+                int32_t span = after.timeMs - before.timeMs;
+                int32_t into = t - before.timeMs;
+                x = before.x + (int)((after.x - before.x) * into / span);
+                y = before.y + (int)((after.y - before.y) * into / span);
+            }
+            return true;
+        }
+
+        // Older than everything we have
+        const Sample &oldest = at(count - 1);
+        x = oldest.x;
+        y = oldest.y;
+        return true;
+    }
+
+private:
+    struct Sample {
+        int32_t timeMs;  // Unwrapped sender time
+        int x;
+        int y;
+        bool warped;     // Jumped here, don't interpolate from the previous sample
+    };
+
+    // age 0 = newest
+    const Sample &at(int age) const {
+        return samples[(newest - age) & (REMOTE_TRACK_SIZE - 1)];
+    }
+
+    uint32_t delayMs;
+    uint32_t maxExtrapolateMs;
+    Sample samples[REMOTE_TRACK_SIZE];
+    int count;
+    int newest;
+    uint16_t lastSent16;
+    int32_t lastSent;
+    int32_t offset;  // Our clock minus the sender's, for the fastest packet
+};
+
+///////////////////////////////////////////////////////////////
+// Round trip between two devices that track each other: each
+// clockOffset() is the other's clock difference plus the
+// fastest one-way trip, so the clock differences cancel in the
+// sum and what is left is the trip there plus the trip back,
+// however unevenly it splits. The offsets come from unwrapped
+// 16-bit clocks, so only the low 16 bits of the sum count.
+///////////////////////////////////////////////////////////////
+inline uint32_t roundTripMs(int32_t ourOffset, int32_t theirOffset) {
+    int16_t sum = (int16_t)(uint16_t)((uint32_t)ourOffset + (uint32_t)theirOffset);
+    return sum > 0 ? (uint32_t)sum : 0;
+}
+
+#endif
@@ -0,0 +1,22 @@
+#ifndef SEESAW_GAMEPAD_H
+#define SEESAW_GAMEPAD_H
+
+#include <Adafruit_seesaw.h>
+
+///////////////////////////////////////////////////////////////
+// Adafruit_seesaw plus the GPIO interrupt flag register, which
+// the stock driver doesn't expose. Core2 only - the rest of
+// GameCore stays hardware-free.
+///////////////////////////////////////////////////////////////
+class SeesawGamepad : public Adafruit_seesaw {
+public:
+    // Read (and clear) the pins that changed since the last read
+    uint32_t readGPIOInterruptFlags() {
+        uint8_t buf[4];
+        if (!read(SEESAW_GPIO_BASE, SEESAW_GPIO_INTFLAG, buf, 4)) return 0;
+        return ((uint32_t)buf[0] << 24) | ((uint32_t)buf[1] << 16) |
+               ((uint32_t)buf[2] << 8) | (uint32_t)buf[3];
+    }
+};
+
+#endif
@@ -0,0 +1,60 @@
+#ifndef SEQLOCK_CELL_H
+#define SEQLOCK_CELL_H
+
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+///////////////////////////////////////////////////////////////
+// Single-writer "latest value" cell (a seqlock).
+//
+// The writer (e.g. a BLE callback) publishes with write() and
+// never waits. Readers copy the value out with read(), retrying
+// if a write was in progress, so they never see a half-updated
+// value. The value is stored as atomic words, which keeps the
+// concurrent copy well-defined; T must be trivially copyable.
+///////////////////////////////////////////////////////////////
+template <typename T>
+class SeqlockCell {
+public:
+    SeqlockCell() : sequence(0) {
+        for (size_t i = 0; i < WORDS; i++) words[i].store(0, std::memory_order_relaxed);
+    }
+
+    // Writer only
+    void write(const T &value) {
+        uint32_t buffer[WORDS] = {};
+        memcpy(buffer, &value, sizeof(T));
+
+        uint32_t seq = sequence.load(std::memory_order_relaxed);
+        sequence.store(seq + 1, std::memory_order_relaxed);  // Odd: write in progress
+        std::atomic_thread_fence(std::memory_order_release);
+        for (size_t i = 0; i < WORDS; i++) words[i].store(buffer[i], std::memory_order_relaxed);
+        sequence.store(seq + 2, std::memory_order_release);
+    }
+
+    // Copy out the latest value. Returns its version: 0 if nothing has
+    // been written yet, and a different (even) number after every write().
+    uint32_t read(T &value) const {
+        uint32_t buffer[WORDS];
+        for (;;) {
+            uint32_t before = sequence.load(std::memory_order_acquire);
+            if (before & 1) continue;
+            for (size_t i = 0; i < WORDS; i++) buffer[i] = words[i].load(std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (sequence.load(std::memory_order_relaxed) == before) {
+                memcpy(&value, buffer, sizeof(T));
+                return before;
+            }
+        }
+    }
+
+private:
+    static const size_t WORDS = (sizeof(T) + 3) / 4;
+
+    std::atomic<uint32_t> sequence;
+    std::atomic<uint32_t> words[WORDS];
+};
+
+#endif
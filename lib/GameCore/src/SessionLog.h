@@ -0,0 +1,554 @@
+#ifndef SESSION_LOG_H
+#define SESSION_LOG_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include "GameCore.h"
+#include "InputSnapshot.h"
+#include "SpscRing.h"
+
+///////////////////////////////////////////////////////////////
+// Session record / replay.
+//
+// A round only depends on its seed, the InputSnapshot each
+// simulate tick stepped with, and what loop() did with the other
+// players' positions. The sketches hand exactly those to a
+// SessionRecorder next to the calls that change the GameState,
+// and SessionReplayer makes the same calls again on the host:
+//
+//   ROUND      resetGame(seed), plus detectCollisions and
+//              buttonsHeld if the sketch changed them
+//   TICK       steps x step(snapshot, stepMs), its pressed
+//              edges on the first
+//   REMOTE     setRemotePosition(x, y)
+//   SPAWN      avoidSpawnOverlap(x, y)
+//   GAME_OVER  gameOver set and elapsedMs as the board had it
+//   PACKET     a received packet as loop() used it (kept for
+//              offline protocol checks, the replay ignores it)
+//
+// Every TICK carries gameStateHash() of the board's state after
+// it, so the replay can tell the first tick where it differs.
+// The stick curve isn't recorded: replay with the StickShaper
+// the board used (DEFAULT_STICK unless a sketch changed it).
+///////////////////////////////////////////////////////////////
+enum SessionRecordType {
+    SESSION_HEADER = 0,
+    SESSION_ROUND = 1,
+    SESSION_TICK = 2,
+    SESSION_REMOTE = 3,
+    SESSION_SPAWN = 4,
+    SESSION_GAME_OVER = 5,
+    SESSION_PACKET = 6,
+    SESSION_RECORD_TYPES
+};
+
+enum SessionRole {
+    SESSION_ROLE_SERVER = 0,
+    SESSION_ROLE_CLIENT = 1,
+};
+
+const uint8_t SESSION_VERSION = 1;
+const size_t SESSION_MAX_PACKET = 32;  // Larger packets are cut short
+
+struct SessionRecord {
+    uint8_t type;
+    uint8_t role;                // HEADER
+    uint8_t version;             // HEADER
+    uint32_t seed;               // ROUND
+    bool detectCollisions;       // ROUND
+    uint32_t buttonsHeld;        // ROUND
+    uint32_t nowMs;              // TICK: millis() at the tick; PACKET: when it arrived
+    InputSnapshot snapshot;      // TICK
+    uint16_t stepMs;             // TICK
+    uint8_t steps;               // TICK: how many times step() ran
+    uint32_t stateHash;          // TICK: gameStateHash() afterwards
+    int16_t x;                   // REMOTE, SPAWN
+    int16_t y;
+    uint32_t elapsedMs;          // GAME_OVER
+    uint8_t source;              // PACKET: player id it came from
+    uint8_t length;              // PACKET
+    uint8_t bytes[SESSION_MAX_PACKET];
+};
+
+///////////////////////////////////////////////////////////////
+// FNV-1a over every GameState field, one at a time so struct
+// padding never gets in
+///////////////////////////////////////////////////////////////
+inline void hashWord(uint32_t &hash, uint32_t value) {
+    for (int shift = 0; shift < 32; shift += 8) {
+        hash ^= (value >> shift) & 0xFF;
+        hash *= 16777619UL;
+    }
+}
+
+inline uint32_t gameStateHash(const GameState &state) {
+    uint32_t hash = 2166136261UL;
+    const PlayerState *players[2] = { &state.local, &state.remote };
+    for (int i = 0; i < 2; i++) {
+        const PlayerState &p = *players[i];
+        const int values[7] = { p.x, p.y, p.speed, p.lastX, p.lastY, p.subX, p.subY };
+        for (int v = 0; v < 7; v++) hashWord(hash, (uint32_t)values[v]);
+    }
+    hashWord(hash, (state.remoteValid ? 1 : 0) | (state.gameOver ? 2 : 0) | (state.detectCollisions ? 4 : 0));
+    hashWord(hash, state.elapsedMs);
+    hashWord(hash, state.remoteSinceMs);
+    hashWord(hash, state.buttonsHeld);
+    hashWord(hash, state.rng);
+    return hash;
+}
+
+///////////////////////////////////////////////////////////////
+// Framing
+//
+//   [0xC5][type][payload length][payload][checksum]
+//
+// Little-endian payloads, checksum as in the profile dump. The
+// same framing works in a file on SD or mixed into a Serial
+// capture: a reader skips bytes until a frame checks out.
+///////////////////////////////////////////////////////////////
+const uint8_t SESSION_MAGIC = 0xC5;
+const size_t SESSION_FRAME_OVERHEAD = 4;
+const size_t SESSION_TICK_PAYLOAD = 31;
+const size_t SESSION_FRAME_MAX_SIZE = SESSION_FRAME_OVERHEAD + 5 + SESSION_MAX_PACKET;
+
+inline void putSession16(uint8_t *&p, uint16_t value) {
+    *p++ = (uint8_t)(value & 0xFF);
+    *p++ = (uint8_t)(value >> 8);
+}
+
+inline void putSession32(uint8_t *&p, uint32_t value) {
+    putSession16(p, (uint16_t)(value & 0xFFFF));
+    putSession16(p, (uint16_t)(value >> 16));
+}
+
+inline uint16_t getSession16(const uint8_t *&p) {
+    uint16_t value = (uint16_t)(p[0] | p[1] << 8);
+    p += 2;
+    return value;
+}
+
+inline uint32_t getSession32(const uint8_t *&p) {
+    uint32_t low = getSession16(p);
+    return low | (uint32_t)getSession16(p) << 16;
+}
+
+// out must hold SESSION_FRAME_MAX_SIZE bytes. Returns the frame length.
+inline size_t encodeSessionRecord(const SessionRecord &record, uint8_t *out) {
+    uint8_t *p = out + 3;
+    switch (record.type) {
+    case SESSION_HEADER:
+        *p++ = record.version;
+        *p++ = record.role;
+        break;
+    case SESSION_ROUND:
+        putSession32(p, record.seed);
+        *p++ = record.detectCollisions ? 1 : 0;
+        putSession32(p, record.buttonsHeld);
+        break;
+    case SESSION_TICK:
+        putSession32(p, record.nowMs);
+        putSession32(p, record.snapshot.timeMs);
+        putSession16(p, (uint16_t)record.snapshot.input.joyX);
+        putSession16(p, (uint16_t)record.snapshot.input.joyY);
+        putSession32(p, record.snapshot.input.buttons);
+        putSession32(p, record.snapshot.pressed);
+        putSession32(p, record.snapshot.released);
+        putSession16(p, record.stepMs);
+        *p++ = record.steps;
+        putSession32(p, record.stateHash);
+        break;
+    case SESSION_REMOTE:
+    case SESSION_SPAWN:
+        putSession16(p, (uint16_t)record.x);
+        putSession16(p, (uint16_t)record.y);
+        break;
+    case SESSION_GAME_OVER:
+        putSession32(p, record.elapsedMs);
+        break;
+    case SESSION_PACKET: {
+        size_t length = record.length > SESSION_MAX_PACKET ? SESSION_MAX_PACKET : record.length;
+        putSession32(p, record.nowMs);
+        *p++ = record.source;
+        memcpy(p, record.bytes, length);
+        p += length;
+        break;
+    }
+    }
+
+    size_t length = (size_t)(p - out);
+    out[0] = SESSION_MAGIC;
+    out[1] = record.type;
+    out[2] = (uint8_t)(length - 3);
+    uint8_t sum = 0;
+    for (size_t i = 0; i < length; i++) sum += out[i];
+    out[length++] = sum;
+    return length;
+}
+
+// Payload length each type must have (PACKET: at least)
+inline int sessionPayloadSize(uint8_t type) {
+    switch (type) {
+    case SESSION_HEADER: return 2;
+    case SESSION_ROUND: return 9;
+    case SESSION_TICK: return (int)SESSION_TICK_PAYLOAD;
+    case SESSION_REMOTE:
+    case SESSION_SPAWN: return 4;
+    case SESSION_GAME_OVER: return 4;
+    case SESSION_PACKET: return 5;
+    default: return -1;
+    }
+}
+
+// Like decodeTelemetry(): the frame length if one starts at data, 0 if
+// data could be the start of one, -1 if not (skip a byte and retry)
+inline int decodeSessionRecord(const uint8_t *data, size_t length, SessionRecord &record) {
+    if (length == 0) return 0;
+    if (data[0] != SESSION_MAGIC) return -1;
+    if (length < 3) return 0;
+    int expected = sessionPayloadSize(data[1]);
+    size_t payload = data[2];
+    if (expected < 0 || payload < (size_t)expected || payload > SESSION_FRAME_MAX_SIZE - SESSION_FRAME_OVERHEAD ||
+        (data[1] != SESSION_PACKET && payload != (size_t)expected)) {
+        return -1;
+    }
+    size_t frameLength = payload + SESSION_FRAME_OVERHEAD;
+    if (length < frameLength) return 0;
+
+    uint8_t sum = 0;
+    for (size_t i = 0; i + 1 < frameLength; i++) sum += data[i];
+    if (sum != data[frameLength - 1]) return -1;
+
+    memset(&record, 0, sizeof(record));
+    record.type = data[1];
+    const uint8_t *p = data + 3;
+    switch (record.type) {
+    case SESSION_HEADER:
+        record.version = p[0];
+        record.role = p[1];
+        break;
+    case SESSION_ROUND:
+        record.seed = getSession32(p);
+        record.detectCollisions = *p++ != 0;
+        record.buttonsHeld = getSession32(p);
+        break;
+    case SESSION_TICK:
+        record.nowMs = getSession32(p);
+        record.snapshot.timeMs = getSession32(p);
+        record.snapshot.input.joyX = getSession16(p);
+        record.snapshot.input.joyY = getSession16(p);
+        record.snapshot.input.buttons = getSession32(p);
+        record.snapshot.pressed = getSession32(p);
+        record.snapshot.released = getSession32(p);
+        record.stepMs = getSession16(p);
+        record.steps = *p++;
+        record.stateHash = getSession32(p);
+        break;
+    case SESSION_REMOTE:
+    case SESSION_SPAWN:
+        record.x = (int16_t)getSession16(p);
+        record.y = (int16_t)getSession16(p);
+        break;
+    case SESSION_GAME_OVER:
+        record.elapsedMs = getSession32(p);
+        break;
+    case SESSION_PACKET:
+        record.nowMs = getSession32(p);
+        record.source = *p++;
+        record.length = (uint8_t)(payload - 5);
+        memcpy(record.bytes, p, record.length);
+        break;
+    }
+    return (int)frameLength;
+}
+
+///////////////////////////////////////////////////////////////
+// Recorder: loop() calls these right next to the GameState
+// changes they describe. Sink is anything with
+// write(const uint8_t *, size_t), like an SD File or Serial.
+// Does nothing until begin().
+///////////////////////////////////////////////////////////////
+template <typename Sink>
+class SessionRecorder {
+public:
+    SessionRecorder(Sink &sink) : sink(sink), recording(false) {}
+
+    void begin(SessionRole role) {
+        recording = true;
+        SessionRecord record = make(SESSION_HEADER);
+        record.version = SESSION_VERSION;
+        record.role = (uint8_t)role;
+        write(record);
+    }
+
+    bool active() const {
+        return recording;
+    }
+
+    // After resetGame(state, seed) and any changes to detectCollisions / buttonsHeld
+    void round(uint32_t seed, const GameState &state) {
+        if (!recording) return;
+        SessionRecord record = make(SESSION_ROUND);
+        record.seed = seed;
+        record.detectCollisions = state.detectCollisions;
+        record.buttonsHeld = state.buttonsHeld;
+        write(record);
+    }
+
+    // After the tick's step() calls
+    void tick(uint32_t nowMs, const InputSnapshot &snapshot, uint32_t stepMs, uint32_t steps,
+              const GameState &state) {
+        if (!recording) return;
+        SessionRecord record = make(SESSION_TICK);
+        record.nowMs = nowMs;
+        record.snapshot = snapshot;
+        record.stepMs = (uint16_t)stepMs;
+        record.steps = (uint8_t)steps;
+        record.stateHash = gameStateHash(state);
+        write(record);
+    }
+
+    // Before setRemotePosition(state, x, y)
+    void remote(int x, int y) {
+        position(SESSION_REMOTE, x, y);
+    }
+
+    // Before avoidSpawnOverlap(state, x, y)
+    void spawn(int x, int y) {
+        position(SESSION_SPAWN, x, y);
+    }
+
+    void gameOver(const GameState &state) {
+        if (!recording) return;
+        SessionRecord record = make(SESSION_GAME_OVER);
+        record.elapsedMs = state.elapsedMs;
+        write(record);
+    }
+
+    void packet(uint32_t receivedMs, uint8_t source, const uint8_t *data, size_t length) {
+        if (!recording) return;
+        SessionRecord record = make(SESSION_PACKET);
+        record.nowMs = receivedMs;
+        record.source = source;
+        record.length = (uint8_t)(length > SESSION_MAX_PACKET ? SESSION_MAX_PACKET : length);
+        memcpy(record.bytes, data, record.length);
+        write(record);
+    }
+
+private:
+    static SessionRecord make(SessionRecordType type) {
+        SessionRecord record;
+        memset(&record, 0, sizeof(record));
+        record.type = (uint8_t)type;
+        return record;
+    }
+
+    void position(SessionRecordType type, int x, int y) {
+        if (!recording) return;
+        SessionRecord record = make(type);
+        record.x = (int16_t)x;
+        record.y = (int16_t)y;
+        write(record);
+    }
+
+    void write(const SessionRecord &record) {
+        uint8_t frame[SESSION_FRAME_MAX_SIZE];
+        sink.write(frame, encodeSessionRecord(record, frame));
+    }
+
+    Sink &sink;
+    bool recording;
+};
+
+///////////////////////////////////////////////////////////////
+// SessionRecorder sink for a slow stream shared with others,
+// like Serial. write() (on loop(), the recorder's only caller)
+// queues each frame whole and never waits; drain() on a
+// low-priority task writes whole frames while the stream has
+// room, so they interleave cleanly with telemetry frames. A
+// replay needs every frame, so once the ring has been full the
+// recording stops: what was queued still replays up to there.
+///////////////////////////////////////////////////////////////
+template <size_t Capacity = 64>
+class SessionChannel {
+public:
+    SessionChannel() : overflow(false), pendingLength(0) {}
+
+    // Producer only
+    size_t write(const uint8_t *data, size_t length) {
+        if (overflow || length > SESSION_FRAME_MAX_SIZE) return 0;
+        Frame frame;
+        frame.length = (uint8_t)length;
+        memcpy(frame.bytes, data, length);
+        if (!ring.push(frame)) {
+            overflow = true;
+            return 0;
+        }
+        return length;
+    }
+
+    // Producer only: true once a frame was dropped and recording stopped
+    bool overflowed() const {
+        return overflow;
+    }
+
+    // Consumer only. Writes whole frames while the sink has room.
+    // Returns the bytes written.
+    template <typename Sink>
+    size_t drain(Sink &sink) {
+        size_t written = 0;
+        for (;;) {
+            if (pendingLength == 0) {
+                Frame frame;
+                if (!ring.pop(frame)) return written;
+                pendingLength = frame.length;
+                memcpy(pending, frame.bytes, frame.length);
+            }
+            int room = sink.availableForWrite();
+            if (room < (int)pendingLength) return written;
+            sink.write(pending, pendingLength);
+            written += pendingLength;
+            pendingLength = 0;
+        }
+    }
+
+private:
+    struct Frame {
+        uint8_t length;
+        uint8_t bytes[SESSION_FRAME_MAX_SIZE];
+    };
+
+    SpscRing<Frame, Capacity> ring;
+    bool overflow;  // Producer only
+    uint8_t pending[SESSION_FRAME_MAX_SIZE];  // Consumer only: a frame that didn't fit yet
+    size_t pendingLength;
+};
+
+///////////////////////////////////////////////////////////////
+// Replayer: makes the recorded calls again on a GameState.
+// apply() returns false on the first TICK whose state doesn't
+// match the board's; mismatchTick() says which one.
+///////////////////////////////////////////////////////////////
+class SessionReplayer {
+public:
+    SessionReplayer(const StickShaper &stick = DEFAULT_STICK) : stick(stick) {
+        memset(&game, 0, sizeof(game));
+        resetGame(game, 0);
+        role = SESSION_ROLE_SERVER;
+        tickCount = 0;
+        stepCount = 0;
+        roundCount = 0;
+        packetCount = 0;
+        events = 0;
+        mismatch = -1;
+    }
+
+    bool apply(const SessionRecord &record) {
+        switch (record.type) {
+        case SESSION_HEADER:
+            role = record.role;
+            break;
+        case SESSION_ROUND:
+            resetGame(game, record.seed);
+            game.detectCollisions = record.detectCollisions;
+            game.buttonsHeld = record.buttonsHeld;
+            roundCount++;
+            break;
+        case SESSION_TICK:
+            events = 0;
+            for (uint8_t i = 0; i < record.steps; i++) {
+                events |= step(game, record.snapshot, record.stepMs, i == 0, stick);
+            }
+            stepCount += record.steps;
+            tickCount++;
+            if (gameStateHash(game) != record.stateHash) {
+                if (mismatch < 0) mismatch = (int32_t)tickCount - 1;
+                return false;
+            }
+            break;
+        case SESSION_REMOTE:
+            setRemotePosition(game, record.x, record.y);
+            break;
+        case SESSION_SPAWN:
+            avoidSpawnOverlap(game, record.x, record.y);
+            break;
+        case SESSION_GAME_OVER:
+            game.gameOver = true;
+            game.elapsedMs = record.elapsedMs;
+            break;
+        case SESSION_PACKET:
+            packetCount++;
+            break;
+        }
+        return true;
+    }
+
+    const GameState &state() const {
+        return game;
+    }
+
+    // STEP_* events of the latest tick
+    uint8_t lastEvents() const {
+        return events;
+    }
+
+    uint8_t sessionRole() const {
+        return role;
+    }
+
+    uint32_t ticks() const {
+        return tickCount;
+    }
+
+    uint32_t steps() const {
+        return stepCount;
+    }
+
+    uint32_t rounds() const {
+        return roundCount;
+    }
+
+    uint32_t packets() const {
+        return packetCount;
+    }
+
+    // Index of the first tick that didn't match, or -1
+    int32_t mismatchTick() const {
+        return mismatch;
+    }
+
+private:
+    const StickShaper &stick;
+    GameState game;
+    uint8_t role;
+    uint32_t tickCount;
+    uint32_t stepCount;
+    uint32_t roundCount;
+    uint32_t packetCount;
+    uint8_t events;
+    int32_t mismatch;
+};
+
+// Replays a whole recording, skipping anything that isn't a valid
+// frame. Returns the number of records applied.
+inline uint32_t replaySession(SessionReplayer &replayer, const uint8_t *data, size_t length,
+                              size_t *skipped = NULL) {
+    uint32_t records = 0;
+    size_t at = 0;
+    if (skipped) *skipped = 0;
+    while (at < length) {
+        SessionRecord record;
+        int result = decodeSessionRecord(data + at, length - at, record);
+        if (result <= 0) {
+            at++;
+            if (skipped) (*skipped)++;
+            continue;
+        }
+        replayer.apply(record);
+        records++;
+        at += result;
+    }
+    return records;
+}
+
+#endif
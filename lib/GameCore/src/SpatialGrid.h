@@ -0,0 +1,151 @@
+#ifndef SPATIAL_GRID_H
+#define SPATIAL_GRID_H
+
+#include "GameCore.h"
+#include <stddef.h>
+#include <stdint.h>
+
+///////////////////////////////////////////////////////////////
+// Uniform-grid spatial hash for collisions between many dots.
+//
+// The playfield is cut into COLLISION_DISTANCE-sized cells, so
+// two dots that collide (dotsCollide()) are always in the same
+// cell or in neighbouring ones. Each frame: clear(), insert()
+// every dot, then forEachPair() visits every colliding pair
+// once by checking each dot's own cell and the four "forward"
+// neighbours (right, and the three below), instead of testing
+// all n^2 / 2 pairs.
+//
+// Everything is fixed-size: Capacity dots, one bucket head per
+// cell, and clear() only bumps a generation stamp instead of
+// wiping the bucket table.
+///////////////////////////////////////////////////////////////
+const int GRID_CELL_SIZE = COLLISION_DISTANCE;
+const int GRID_COLS = (FIELD_WIDTH + GRID_CELL_SIZE - 1) / GRID_CELL_SIZE;
+const int GRID_ROWS = (FIELD_HEIGHT + GRID_CELL_SIZE - 1) / GRID_CELL_SIZE;
+const int GRID_CELLS = GRID_COLS * GRID_ROWS;
+
+template <size_t Capacity>
+class SpatialGrid {
+    static_assert(Capacity > 0 && Capacity < 0x7FFF, "SpatialGrid capacity must fit an int16_t index");
+
+public:
+    SpatialGrid() : count(0), stamp(1) {
+        for (int i = 0; i < GRID_CELLS; i++) cellStamp[i] = 0;
+    }
+
+    // Forget every dot (O(1) except once every 65535 frames)
+    void clear() {
+        count = 0;
+        if (++stamp == 0) {
+            for (int i = 0; i < GRID_CELLS; i++) cellStamp[i] = 0;
+            stamp = 1;
+        }
+    }
+
+    int size() const {
+        return count;
+    }
+
+    // Add a dot with a caller-chosen id. Returns false when full.
+    bool insert(uint16_t id, int x, int y) {
+        if (count >= (int)Capacity) return false;
+
+        int cell = cellOf(x, y);
+        Entry &entry = entries[count];
+        entry.id = id;
+        entry.x = (int16_t)x;
+        entry.y = (int16_t)y;
+        entry.cell = (int16_t)cell;
+        entry.next = head(cell);
+        cellHead[cell] = (int16_t)count;
+        cellStamp[cell] = stamp;
+        count++;
+        return true;
+    }
+
+    // Call visit(idA, idB) for every colliding pair, each pair once.
+    // visit returns true to stop early; so does forEachPair().
+    template <typename Visit>
+    bool forEachPair(Visit visit) const {
+        for (int i = 0; i < count; i++) {
+            const Entry &a = entries[i];
+            int col = a.cell % GRID_COLS;
+            int row = a.cell / GRID_COLS;
+
+            // Own cell: only dots inserted before this one, so each pair comes up once
+            for (int j = a.next; j >= 0; j = entries[j].next) {
+                if (collides(a, entries[j]) && visit(a.id, entries[j].id)) return true;
+            }
+
+            // Forward neighbours
+            if (col + 1 < GRID_COLS && visitCell(a, a.cell + 1, visit)) return true;
+            if (row + 1 < GRID_ROWS) {
+                int below = a.cell + GRID_COLS;
+                if (col > 0 && visitCell(a, below - 1, visit)) return true;
+                if (visitCell(a, below, visit)) return true;
+                if (col + 1 < GRID_COLS && visitCell(a, below + 1, visit)) return true;
+            }
+        }
+        return false;
+    }
+
+    // Call visit(id) for every dot colliding with one at x, y.
+    // visit returns true to stop early; so does query().
+    template <typename Visit>
+    bool query(int x, int y, Visit visit) const {
+        int cell = cellOf(x, y);
+        int col = cell % GRID_COLS;
+        int row = cell / GRID_COLS;
+        for (int r = row - 1; r <= row + 1; r++) {
+            if (r < 0 || r >= GRID_ROWS) continue;
+            for (int c = col - 1; c <= col + 1; c++) {
+                if (c < 0 || c >= GRID_COLS) continue;
+                for (int j = head(r * GRID_COLS + c); j >= 0; j = entries[j].next) {
+                    if (dotsCollide(x, y, entries[j].x, entries[j].y) && visit(entries[j].id)) return true;
+                }
+            }
+        }
+        return false;
+    }
+
+private:
+    struct Entry {
+        uint16_t id;
+        int16_t x;
+        int16_t y;
+        int16_t cell;
+        int16_t next;  // Next dot in the same cell, -1 at the end
+    };
+
+    static int cellOf(int x, int y) {
+        int col = clampInt(x, 0, FIELD_WIDTH - 1) / GRID_CELL_SIZE;
+        int row = clampInt(y, 0, FIELD_HEIGHT - 1) / GRID_CELL_SIZE;
+        return row * GRID_COLS + col;
+    }
+
+    static bool collides(const Entry &a, const Entry &b) {
+        return dotsCollide(a.x, a.y, b.x, b.y);
+    }
+
+    // First dot in a cell this generation, or -1
+    int head(int cell) const {
+        return cellStamp[cell] == stamp ? cellHead[cell] : -1;
+    }
+
+    template <typename Visit>
+    bool visitCell(const Entry &a, int cell, Visit &visit) const {
+        for (int j = head(cell); j >= 0; j = entries[j].next) {
+            if (collides(a, entries[j]) && visit(a.id, entries[j].id)) return true;
+        }
+        return false;
+    }
+
+    Entry entries[Capacity];
+    int count;
+    uint16_t stamp;
+    int16_t cellHead[GRID_CELLS];
+    uint16_t cellStamp[GRID_CELLS];
+};
+
+#endif
@@ -0,0 +1,62 @@
+#ifndef SPSC_RING_H
+#define SPSC_RING_H
+
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+
+///////////////////////////////////////////////////////////////
+// Lock-free single-producer/single-consumer ring buffer.
+//
+// One task may push() and one (other) task may pop(); neither
+// ever blocks or allocates. The indices run freely and are masked
+// on access, so Capacity must be a power of two and all Capacity
+// slots are usable. Uses std::atomic only, so the same code runs
+// under FreeRTOS on the ESP32 and with std::thread on the host.
+///////////////////////////////////////////////////////////////
+template <typename T, size_t Capacity>
+class SpscRing {
+    static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0,
+                  "SpscRing capacity must be a power of two");
+
+public:
+    SpscRing() : head(0), tail(0) {}
+
+    // Producer only. Returns false (and drops item) if the ring is full.
+    bool push(const T &item) {
+        uint32_t write = head.load(std::memory_order_relaxed);
+        if (write - tail.load(std::memory_order_acquire) >= Capacity) return false;
+        items[write & (Capacity - 1)] = item;
+        head.store(write + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer only. Returns false if there was nothing to pop.
+    bool pop(T &item) {
+        uint32_t read = tail.load(std::memory_order_relaxed);
+        if (read == head.load(std::memory_order_acquire)) return false;
+        item = items[read & (Capacity - 1)];
+        tail.store(read + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Approximate when called from the other side while it's running
+    size_t size() const {
+        return head.load(std::memory_order_acquire) - tail.load(std::memory_order_acquire);
+    }
+
+    bool empty() const {
+        return size() == 0;
+    }
+
+    static size_t capacity() {
+        return Capacity;
+    }
+
+private:
+    T items[Capacity];
+    std::atomic<uint32_t> head;  // Next slot to write (producer)
+    std::atomic<uint32_t> tail;  // Next slot to read (consumer)
+};
+
+#endif
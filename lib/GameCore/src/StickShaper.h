@@ -0,0 +1,149 @@
+#ifndef STICK_SHAPER_H
+#define STICK_SHAPER_H
+
+#include <stdint.h>
+
+///////////////////////////////////////////////////////////////
+// Integer joystick pipeline: stick offset in, velocity out.
+//
+// shape() takes the stick's offset from center (-511..511 per
+// axis) and returns a Q8 velocity per axis (STICK_ONE = full
+// speed). Three stages, all integer:
+//  - a radial deadzone, so the dead area is a circle and the
+//    diagonals aren't cut off square like the old per-axis test;
+//  - a response curve (constexpr table) over the distance past
+//    the deadzone, so speed ramps up from 0 instead of jumping;
+//  - the stick's direction kept: each axis gets curve * offset
+//    / distance, so full tilt is full speed on every heading.
+//
+// Two integer divides per sample: the square root's Newton
+// step and the split along the stick's direction.
+///////////////////////////////////////////////////////////////
+const int STICK_Q = 8;
+const int STICK_ONE = 1 << STICK_Q;  // Q8 1.0
+const int STICK_MAX_OFFSET = 511;    // Furthest the stick reads from center
+const int STICK_CURVE_STEPS = 256;   // Table entries - 1, one per Q8 step
+
+enum StickCurve {
+    STICK_CURVE_LINEAR,  // Speed proportional to tilt
+    STICK_CURVE_EXPO,    // Half linear, half cubic: fine control near center
+    STICK_CURVE_CUBIC,   // Slow until most of the way out
+    STICK_CURVE_COUNT,
+};
+
+///////////////////////////////////////////////////////////////
+// Response curves, Q8 in and out, built at compile time
+///////////////////////////////////////////////////////////////
+constexpr uint16_t stickLinear(int t) {
+    return (uint16_t)t;
+}
+
+constexpr uint16_t stickExpo(int t) {
+    return (uint16_t)((t * 65536 + t * t * t + 65536) / 131072);
+}
+
+constexpr uint16_t stickCubic(int t) {
+    return (uint16_t)((t * t * t + 32768) / 65536);
+}
+
+// floor(16 * sqrt(i)), the first guess for stickSqrt()
+constexpr uint16_t stickRootEntry(int i, int root = 0) {
+    return (root + 1) * (root + 1) > i * 256 ? (uint16_t)root : stickRootEntry(i, root + 1);
+}
+
+#define STICK_ROW4(f, i) f(i), f(i + 1), f(i + 2), f(i + 3)
+#define STICK_ROW16(f, i) STICK_ROW4(f, i), STICK_ROW4(f, i + 4), STICK_ROW4(f, i + 8), STICK_ROW4(f, i + 12)
+#define STICK_ROW64(f, i) STICK_ROW16(f, i), STICK_ROW16(f, i + 16), STICK_ROW16(f, i + 32), STICK_ROW16(f, i + 48)
+#define STICK_ROW256(f) STICK_ROW64(f, 0), STICK_ROW64(f, 64), STICK_ROW64(f, 128), STICK_ROW64(f, 192)
+
+constexpr uint16_t STICK_CURVES[STICK_CURVE_COUNT][STICK_CURVE_STEPS + 1] = {
+    { STICK_ROW256(stickLinear), stickLinear(256) },
+    { STICK_ROW256(stickExpo), stickExpo(256) },
+    { STICK_ROW256(stickCubic), stickCubic(256) },
+};
+
+constexpr uint16_t STICK_ROOTS[256] = { STICK_ROW256(stickRootEntry) };
+
+#undef STICK_ROW256
+#undef STICK_ROW64
+#undef STICK_ROW16
+#undef STICK_ROW4
+
+static_assert(STICK_CURVES[STICK_CURVE_EXPO][0] == 0 && STICK_CURVES[STICK_CURVE_EXPO][STICK_CURVE_STEPS] == STICK_ONE,
+              "Response curves must run from 0 to full speed");
+static_assert(STICK_CURVES[STICK_CURVE_CUBIC][STICK_CURVE_STEPS] == STICK_ONE,
+              "Response curves must run from 0 to full speed");
+
+// Integer square root rounded to nearest, for anything two stick axes
+// can make: a table guess from n's top 8 bits, one Newton step, then
+// a fix-up to the nearest whole root.
+inline int stickSqrt(uint32_t n) {
+    if (n == 0) return 0;
+    int top = 31 - __builtin_clz(n);
+    int shift = top < 7 ? 0 : (top - 6) & ~1;  // Even, leaves 7 or 8 bits
+    uint32_t root = ((uint32_t)STICK_ROOTS[n >> shift] << (shift >> 1)) >> 4;
+    root = (root + n / root) >> 1;
+
+    uint32_t square = root * root;
+    if (square > n) {
+        root--;  // Floor
+        square = root * root;
+    }
+    return (int)(root + (n - square > root));  // n - root^2 > root: closer to root + 1
+}
+
+class StickShaper {
+public:
+    // deadzone is in raw stick counts from center (102 = the old 20%)
+    constexpr StickShaper(int deadzone = 102, StickCurve curve = STICK_CURVE_EXPO)
+        : deadzone(clampDeadzone(deadzone)),
+          curve(curve),
+          scale((STICK_ONE << 16) / (STICK_MAX_OFFSET - clampDeadzone(deadzone))) {}
+
+    // Offsets from center in, Q8 velocity per axis out (-256..256)
+    void shape(int offsetX, int offsetY, int &velocityX, int &velocityY) const {
+        offsetX = clampOffset(offsetX);
+        offsetY = clampOffset(offsetY);
+
+        uint32_t distance2 = (uint32_t)(offsetX * offsetX + offsetY * offsetY);
+        if (distance2 <= (uint32_t)(deadzone * deadzone)) {
+            velocityX = velocityY = 0;
+            return;
+        }
+
+        // Tilt past the deadzone, 0..STICK_ONE
+        int distance = stickSqrt(distance2);
+        int tilt = distance >= STICK_MAX_OFFSET ? STICK_ONE : (int)(((uint32_t)(distance - deadzone) * scale + 0x8000) >> 16);
+        if (tilt > STICK_ONE) tilt = STICK_ONE;
+
+        // Curve over distance, Q16, then split along the stick's direction
+        int32_t gain = ((int32_t)STICK_CURVES[curve][tilt] << 16) / distance;
+        velocityX = scaleAxis(offsetX, gain);
+        velocityY = scaleAxis(offsetY, gain);
+    }
+
+    int deadzoneCounts() const {
+        return deadzone;
+    }
+
+private:
+    static constexpr int clampDeadzone(int deadzone) {
+        return deadzone < 0 ? 0 : (deadzone > STICK_MAX_OFFSET - 1 ? STICK_MAX_OFFSET - 1 : deadzone);
+    }
+
+    static int clampOffset(int offset) {
+        return offset < -STICK_MAX_OFFSET ? -STICK_MAX_OFFSET : (offset > STICK_MAX_OFFSET ? STICK_MAX_OFFSET : offset);
+    }
+
+    // Rounded to nearest, same magnitude either way so left matches right
+    static int scaleAxis(int offset, int32_t gain) {
+        int magnitude = (int)(((offset < 0 ? -offset : offset) * gain + 0x8000) >> 16);
+        return offset < 0 ? -magnitude : magnitude;
+    }
+
+    int deadzone;
+    StickCurve curve;
+    uint32_t scale;  // Q16 STICK_ONE / (STICK_MAX_OFFSET - deadzone)
+};
+
+#endif
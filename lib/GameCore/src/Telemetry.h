@@ -0,0 +1,205 @@
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+#include "SpscRing.h"
+
+///////////////////////////////////////////////////////////////
+// Binary telemetry instead of Serial.printf on hot paths.
+//
+// log() stamps an event id and up to four 16-bit values with the
+// time and pushes them into a ring: a few stores, no formatting,
+// and it never waits for the UART. If the ring is full the record
+// is dropped and counted. A low-priority task calls drain(),
+// which frames records and writes only as many as the sink has
+// room for, so it never blocks either. tools/telemetry_csv turns
+// the captured stream back into CSV using TELEMETRY_EVENTS.
+//
+// A channel has one producing task (like SpscRing). The BLE
+// callbacks all run on the BLE task, so they share one.
+//
+// Clock is anything with uint32_t nowUs(), like FrameScheduler.
+///////////////////////////////////////////////////////////////
+
+// Event ids go on the wire: append new ones, never renumber
+enum TelemetryEvent {
+    TELEMETRY_LOST = 0,        // Records dropped on a full ring since the last report
+    TELEMETRY_NOTIFY = 1,      // Client: position packet from the server
+    TELEMETRY_WORLD = 2,       // Client: WORLD frame from the server
+    TELEMETRY_BAD_PACKET = 3,  // Client: malformed packet dropped
+    TELEMETRY_BAD_WORLD = 4,   // Client: malformed WORLD frame dropped
+    TELEMETRY_WRITE = 5,       // Server: position write from a client
+    TELEMETRY_BAD_WRITE = 6,   // Server: malformed, stale or unknown-connection write
+    TELEMETRY_EVENT_COUNT
+};
+
+const int TELEMETRY_MAX_ARGS = 4;
+
+// What the host decoder calls each event and its values
+struct TelemetryEventInfo {
+    const char *name;
+    const char *fields[TELEMETRY_MAX_ARGS];  // NULL past the last value
+};
+
+const TelemetryEventInfo TELEMETRY_EVENTS[TELEMETRY_EVENT_COUNT] = {
+    { "lost", { "records", NULL, NULL, NULL } },
+    { "notify", { "seq", "type", "x", "y" } },
+    { "world", { "seq", "players", "bytes", NULL } },
+    { "bad_packet", { "bytes", NULL, NULL, NULL } },
+    { "bad_world", { "bytes", NULL, NULL, NULL } },
+    { "write", { "player", "bytes", NULL, NULL } },
+    { "bad_write", { "conn", "bytes", NULL, NULL } },
+};
+
+inline const TelemetryEventInfo *telemetryEventInfo(uint8_t event) {
+    return event < TELEMETRY_EVENT_COUNT ? &TELEMETRY_EVENTS[event] : NULL;
+}
+
+// Number of values an event carries
+inline uint8_t telemetryArgCount(uint8_t event) {
+    const TelemetryEventInfo *info = telemetryEventInfo(event);
+    uint8_t count = 0;
+    while (info && count < TELEMETRY_MAX_ARGS && info->fields[count]) count++;
+    return count;
+}
+
+struct TelemetryRecord {
+    uint32_t timeUs;
+    uint8_t event;
+    uint8_t argCount;
+    uint16_t args[TELEMETRY_MAX_ARGS];
+};
+
+///////////////////////////////////////////////////////////////
+// Wire frame
+//
+//   [0xA7][event][arg count][time u32][args u16 x count][checksum]
+//
+// Little-endian. checksum = low byte of the sum of every byte
+// before it, like the profile dump, so frames can be picked out
+// of a stream that also carries text and profile dumps.
+///////////////////////////////////////////////////////////////
+const uint8_t TELEMETRY_MAGIC = 0xA7;
+const size_t TELEMETRY_FRAME_HEADER_SIZE = 7;
+const size_t TELEMETRY_FRAME_MAX_SIZE = TELEMETRY_FRAME_HEADER_SIZE + 2 * TELEMETRY_MAX_ARGS + 1;
+
+// out must hold TELEMETRY_FRAME_MAX_SIZE bytes. Returns the frame length.
+inline size_t encodeTelemetry(const TelemetryRecord &record, uint8_t *out) {
+    int argCount = record.argCount > TELEMETRY_MAX_ARGS ? TELEMETRY_MAX_ARGS : record.argCount;
+    size_t length = 0;
+    out[length++] = TELEMETRY_MAGIC;
+    out[length++] = record.event;
+    out[length++] = (uint8_t)argCount;
+    for (int shift = 0; shift < 32; shift += 8) out[length++] = (uint8_t)(record.timeUs >> shift);
+    for (int i = 0; i < argCount; i++) {
+        out[length++] = (uint8_t)(record.args[i] & 0xFF);
+        out[length++] = (uint8_t)(record.args[i] >> 8);
+    }
+
+    uint8_t sum = 0;
+    for (size_t i = 0; i < length; i++) sum += out[i];
+    out[length++] = sum;
+    return length;
+}
+
+// Looks for a frame at the start of data. Returns its length, 0 if
+// data is a valid but incomplete start, or -1 if no frame starts here
+// (the caller skips a byte and tries again).
+inline int decodeTelemetry(const uint8_t *data, size_t length, TelemetryRecord &record) {
+    if (length == 0) return 0;
+    if (data[0] != TELEMETRY_MAGIC) return -1;
+    if (length < 3) return 0;
+    int argCount = data[2];
+    if (argCount > TELEMETRY_MAX_ARGS) return -1;
+    size_t frameLength = TELEMETRY_FRAME_HEADER_SIZE + 2 * argCount + 1;
+    if (length < frameLength) return 0;
+
+    uint8_t sum = 0;
+    for (size_t i = 0; i + 1 < frameLength; i++) sum += data[i];
+    if (sum != data[frameLength - 1]) return -1;
+
+    record.event = data[1];
+    record.argCount = (uint8_t)argCount;
+    record.timeUs = (uint32_t)data[3] | (uint32_t)data[4] << 8 | (uint32_t)data[5] << 16 | (uint32_t)data[6] << 24;
+    const uint8_t *p = data + TELEMETRY_FRAME_HEADER_SIZE;
+    for (int i = 0; i < TELEMETRY_MAX_ARGS; i++) {
+        record.args[i] = i < argCount ? (uint16_t)(p[2 * i] | p[2 * i + 1] << 8) : 0;
+    }
+    return (int)frameLength;
+}
+
+///////////////////////////////////////////////////////////////
+// Channel: the producing task logs, the telemetry task drains.
+// Sink is anything with availableForWrite() and
+// write(const uint8_t *, size_t), like HardwareSerial.
+///////////////////////////////////////////////////////////////
+template <typename Clock, size_t Capacity = 64>
+class TelemetryChannel {
+public:
+    TelemetryChannel(Clock &clock) : clock(clock), dropped(0), reported(0), pendingLength(0) {}
+
+    // Producer only. Constant time; false if the record was dropped.
+    bool log(TelemetryEvent event, uint16_t a = 0, uint16_t b = 0, uint16_t c = 0, uint16_t d = 0) {
+        TelemetryRecord record;
+        record.timeUs = clock.nowUs();
+        record.event = (uint8_t)event;
+        record.argCount = telemetryArgCount(event);
+        record.args[0] = a;
+        record.args[1] = b;
+        record.args[2] = c;
+        record.args[3] = d;
+        if (ring.push(record)) return true;
+        dropped.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    // Consumer only. Writes whole frames while the sink has room.
+    // Returns the bytes written.
+    template <typename Sink>
+    size_t drain(Sink &sink) {
+        size_t written = 0;
+        for (;;) {
+            if (pendingLength == 0 && !nextFrame()) return written;
+            int room = sink.availableForWrite();
+            if (room < (int)pendingLength) return written;
+            sink.write(pending, pendingLength);
+            written += pendingLength;
+            pendingLength = 0;
+        }
+    }
+
+    // Records dropped on a full ring so far
+    uint32_t droppedCount() const {
+        return dropped.load(std::memory_order_relaxed);
+    }
+
+private:
+    // Frames the next thing to send into pending. Drops are reported
+    // once the ring is empty, so their time follows the records before.
+    bool nextFrame() {
+        TelemetryRecord record;
+        if (!ring.pop(record)) {
+            uint32_t lost = dropped.load(std::memory_order_relaxed) - reported;
+            if (lost == 0) return false;
+            if (lost > 0xFFFF) lost = 0xFFFF;
+            reported += lost;
+            record.timeUs = clock.nowUs();
+            record.event = TELEMETRY_LOST;
+            record.argCount = 1;
+            record.args[0] = (uint16_t)lost;
+        }
+        pendingLength = encodeTelemetry(record, pending);
+        return true;
+    }
+
+    Clock &clock;
+    SpscRing<TelemetryRecord, Capacity> ring;
+    std::atomic<uint32_t> dropped;  // Written by the producer
+    uint32_t reported;              // Drops already sent (consumer)
+    uint8_t pending[TELEMETRY_FRAME_MAX_SIZE];  // A frame that didn't fit in the sink yet
+    size_t pendingLength;
+};
+
+#endif
@@ -0,0 +1,138 @@
+#ifndef BLE_TRANSPORT_H
+#define BLE_TRANSPORT_H
+
+#ifdef ARDUINO
+
+#include "Transport.h"
+#include <BLE2902.h>
+#include <BLEDevice.h>
+#include <atomic>
+
+///////////////////////////////////////////////////////////////
+// The ESP32 backend (arduino-esp32 BLE), one class per side.
+//
+// BleServerTransport is fed the raw GATTS events from the
+// sketch's custom handler: a link is a conn_id, a write to our
+// characteristic is a received frame, a write to its CCCD is a
+// subscription, and send() notifies the client. The listener
+// runs on the BLE task.
+//
+// BleClientTransport is attach()ed once the sketch has connected
+// and found the server's characteristic, and detach()ed from
+// BLEClientCallbacks::onDisconnect. send() writes without
+// response where the characteristic allows it; the GATTC write
+// event reports it done.
+///////////////////////////////////////////////////////////////
+class BleServerTransport : public Transport {
+public:
+    BleServerTransport() : characteristic(NULL), cccd(NULL), gattsIf(ESP_GATT_IF_NONE) {}
+
+    void begin(BLECharacteristic *serverCharacteristic, BLE2902 *serverCccd) {
+        characteristic = serverCharacteristic;
+        cccd = serverCccd;
+    }
+
+    // From the sketch's custom GATTS handler (BLE task)
+    void onGattsEvent(esp_gatts_cb_event_t event, esp_gatt_if_t eventGattsIf, esp_ble_gatts_cb_param_t *param) {
+        if (!listener) return;
+        switch (event) {
+        case ESP_GATTS_CONNECT_EVT:
+            gattsIf = eventGattsIf;
+            listener->onConnect(param->connect.conn_id);
+            break;
+        case ESP_GATTS_DISCONNECT_EVT:
+            listener->onDisconnect(param->disconnect.conn_id);
+            break;
+        case ESP_GATTS_MTU_EVT:
+            listener->onMtu(param->mtu.conn_id, param->mtu.mtu);
+            break;
+        case ESP_GATTS_CONF_EVT:
+            listener->onSent(param->conf.conn_id);
+            break;
+        case ESP_GATTS_WRITE_EVT:
+            if (param->write.is_prep) break;
+            if (cccd && param->write.handle == cccd->getHandle() && param->write.len == 2) {
+                listener->onSubscribe(param->write.conn_id, param->write.value[0] & 0x01);
+            } else if (characteristic && param->write.handle == characteristic->getHandle()) {
+                listener->onReceive(param->write.conn_id, param->write.value, param->write.len);
+            }
+            break;
+        default:
+            break;
+        }
+    }
+
+    bool send(uint16_t link, const uint8_t *data, size_t length) {
+        if (!characteristic || gattsIf == ESP_GATT_IF_NONE) return false;
+        return esp_ble_gatts_send_indicate(gattsIf, link, characteristic->getHandle(), length, (uint8_t *)data,
+                                           false) == ESP_OK;
+    }
+
+    void disconnect(uint16_t link) {
+        if (gattsIf != ESP_GATT_IF_NONE) esp_ble_gatts_close(gattsIf, link);
+    }
+
+private:
+    BLECharacteristic *characteristic;
+    BLE2902 *cccd;
+    esp_gatt_if_t gattsIf;
+};
+
+class BleClientTransport : public Transport {
+public:
+    BleClientTransport() : client(NULL), characteristic(NULL), writeType(ESP_GATT_WRITE_TYPE_RSP), up(false) {}
+
+    // Connected and discovered: take notifications and open the link
+    void attach(BLEClient *serverClient, BLERemoteCharacteristic *serverCharacteristic) {
+        client = serverClient;
+        characteristic = serverCharacteristic;
+        writeType = characteristic->canWriteNoResponse() ? ESP_GATT_WRITE_TYPE_NO_RSP : ESP_GATT_WRITE_TYPE_RSP;
+        if (characteristic->canNotify()) {
+            characteristic->registerForNotify([this](BLERemoteCharacteristic *, uint8_t *data, size_t length, bool) {
+                if (listener) listener->onReceive(CLIENT_SERVER_LINK, data, length);
+            });
+        }
+        up.store(true);
+        if (listener) listener->onConnect(CLIENT_SERVER_LINK);
+    }
+
+    // From BLEClientCallbacks::onDisconnect (BLE task)
+    void detach() {
+        bool wasUp = up.exchange(false);
+        if (wasUp && listener) listener->onDisconnect(CLIENT_SERVER_LINK);
+    }
+
+    // From the sketch's custom GATTC handler (BLE task)
+    void onGattcEvent(esp_gattc_cb_event_t event, esp_gatt_if_t gattcIf, esp_ble_gattc_cb_param_t *param) {
+        if (!listener) return;
+        if (event == ESP_GATTC_WRITE_CHAR_EVT) {
+            listener->onSent(CLIENT_SERVER_LINK);
+        } else if (event == ESP_GATTC_CFG_MTU_EVT) {
+            listener->onMtu(CLIENT_SERVER_LINK, param->cfg_mtu.mtu);
+        }
+    }
+
+    bool connected() const {
+        return up.load();
+    }
+
+    bool send(uint16_t link, const uint8_t *data, size_t length) {
+        if (!up.load() || !client || !characteristic) return false;
+        return esp_ble_gattc_write_char(client->getGattcIf(), client->getConnId(), characteristic->getHandle(), length,
+                                        (uint8_t *)data, writeType, ESP_GATT_AUTH_REQ_NONE) == ESP_OK;
+    }
+
+    void disconnect(uint16_t link) {
+        if (client) client->disconnect();
+    }
+
+private:
+    BLEClient *client;
+    BLERemoteCharacteristic *characteristic;
+    esp_gatt_write_type_t writeType;
+    std::atomic<bool> up;
+};
+
+#endif  // ARDUINO
+
+#endif
@@ -0,0 +1,199 @@
+#ifndef CLIENT_SESSION_H
+#define CLIENT_SESSION_H
+
+#include "GameProtocol.h"
+#include "PositionCodec.h"
+#include "RemoteState.h"
+#include "SendQueue.h"
+#include "Transport.h"
+#include "WorldState.h"
+#include <GameCore.h>
+#include <RemoteTrack.h>
+
+///////////////////////////////////////////////////////////////
+// A client's side of a game, minus the radio and the screen.
+//
+// The client sketch and tools/host_session's bots both run the
+// game through this. The Transport's callbacks publish what the
+// server sent into a RemoteState and a RemoteWorld (through
+// SeqlockCells on the ESP32), and hand finished writes to
+// onSent(); once per frame the loop calls
+//   applyRemoteState()   round starts and ends in the order
+//                        they came, every other dot into its
+//                        RemoteTrack, the red dot into the game
+//   simulated()          after the simulate tick
+//   queueUploads()       on network ticks: our position through
+//                        a PositionEncoder, and every
+//                        CLOCK_PERIOD_MS our clock offset for the
+//                        server's dot (its lag compensation takes
+//                        the round trip out with it)
+//   flush()              whatever the SendQueue lets out now
+// The GameState is the caller's; the server owns collisions.
+//
+// What the sketch does on top (the game reset, the game over
+// screen, session recording) comes back through a
+// ClientSessionListener.
+///////////////////////////////////////////////////////////////
+const uint32_t CLOCK_PERIOD_MS = 1000;
+
+class ClientSessionListener {
+public:
+    virtual ~ClientSessionListener() {}
+    // The server started a round with us as playerId: reset the game and call newRound()
+    virtual void onRoundStart(uint8_t playerId) = 0;
+    // The server ended the round; game.gameOver and its official time are set already
+    virtual void onGameOver() {}
+    virtual void onWorld(const RemoteWorld &world) {}  // A new WORLD frame, before it's tracked
+    virtual void onRemoteMoved(int x, int y) {}        // The red dot's new position, before it's set
+};
+
+class ClientSession {
+public:
+    // Other dots are tracked remoteDelayMs in the past, interpolated between received positions
+    // (and extrapolated for at most RemoteTrack's default 100 ms)
+    ClientSession(GameState &game, Transport &transport, ClientSessionListener &listener, uint32_t remoteDelayMs,
+                  uint32_t keyframeMs, uint8_t maxWritesInFlight)
+        : game(game), transport(transport), listener(listener), positionEncoder(keyframeMs),
+          sendQueue(maxWritesInFlight), id(1), txSeq(0), over(false), pendingFlags(0), seenWorldCount(0),
+          lastClockMs(0) {
+        seenRemote = RemoteState();
+        for (int i = 0; i < WORLD_MAX_PLAYERS; i++) {
+            tracks[i].setDelay(remoteDelayMs);
+            present[i] = false;
+        }
+    }
+
+    ///////////////////////////////////////////////////////////
+    // Act on whatever the server sent since the last frame
+    ///////////////////////////////////////////////////////////
+    void applyRemoteState(const RemoteState &remote, const RemoteWorld &world, uint32_t nowMs) {
+        // A restart is GAMEOVER then CONNECTED; joining during a game over, CONNECTED then GAMEOVER
+        RoundChange round = roundChange(seenRemote, remote);
+        if (round.ended && !round.endedLast) gameOver(remote.gameOverMs);
+        if (round.started) {
+            id = remote.playerId;
+            listener.onRoundStart(id);
+        }
+        if (round.endedLast) gameOver(remote.gameOverMs);
+        seenRemote = remote;
+
+        // Everyone else's positions, from the latest WORLD frame
+        if (world.worldCount != seenWorldCount) {
+            seenWorldCount = world.worldCount;
+            listener.onWorld(world);
+            for (int i = 0; i < WORLD_MAX_PLAYERS; i++) present[i] = false;
+            for (int i = 0; i < world.world.count; i++) {
+                const WorldEntry &entry = world.world.entries[i];
+                if (entry.id >= WORLD_MAX_PLAYERS || entry.id == id) continue;
+                tracks[entry.id].add(world.world.timeMs, world.receivedMs, entry.x, entry.y,
+                                     entry.flags & PACKET_FLAG_WARPED);
+                present[entry.id] = true;
+            }
+        }
+
+        // Track the red dot (drawn only; the server checks collisions)
+        int x, y;
+        if (!over && trackedPosition(SERVER_PLAYER_ID, nowMs, x, y)) {
+            if (!game.remoteValid || x != game.remote.x || y != game.remote.y) listener.onRemoteMoved(x, y);
+            setRemotePosition(game, x, y);
+        }
+    }
+
+    // After a simulate tick (events from step())
+    void simulated(uint8_t events) {
+        if (events & STEP_WARPED) pendingFlags |= PACKET_FLAG_WARPED;
+    }
+
+    // Network tick: our position if it changed (or a keyframe is due), and our clock offset
+    void queueUploads(uint32_t nowMs) {
+        GamePacket packet;
+        if (positionEncoder.encode(txSeq, game.local.x, game.local.y, pendingFlags, nowMs, packet)) {
+            txSeq++;
+            sendQueue.push(packet);
+        }
+        pendingFlags = 0;
+        const RemoteTrack &serverTrack = tracks[SERVER_PLAYER_ID];
+        if (nowMs - lastClockMs >= CLOCK_PERIOD_MS && !serverTrack.empty()) {
+            lastClockMs = nowMs;
+            sendQueue.push(makeClockPacket(txSeq++, serverTrack.clockOffset()));
+        }
+    }
+
+    ///////////////////////////////////////////////////////////
+    // Hand queued packets to the transport without waiting for
+    // it; completions come back through onSent(). Returns how
+    // many writes the transport refused.
+    ///////////////////////////////////////////////////////////
+    int flush(uint32_t nowMs) {
+        int failed = 0;
+        GamePacket packet;
+        while (sendQueue.next(nowMs, packet)) {
+            uint8_t frame[GAME_PACKET_SIZE];
+            if (!transport.send(CLIENT_SERVER_LINK, frame, encodePacket(packet, frame))) {
+                sendQueue.onSent();  // Never queued, so nothing will complete
+                failed++;
+            }
+        }
+        return failed;
+    }
+
+    // The link came up: nothing from before is in flight any more
+    void onConnect() {
+        sendQueue.reset();
+    }
+
+    // A finished write frees a SendQueue slot (may be called from the radio's task)
+    void onSent() {
+        sendQueue.onSent();
+    }
+
+    // Forget the last round's tracks (the caller resets the game)
+    void newRound() {
+        over = false;
+        pendingFlags = 0;
+        positionEncoder.reset();
+        for (int i = 0; i < WORLD_MAX_PLAYERS; i++) {
+            tracks[i].reset();
+            present[i] = false;
+        }
+    }
+
+    // Where player id's dot is drawn now, if it was in the latest WORLD frame
+    bool trackedPosition(uint8_t playerId, uint32_t nowMs, int &x, int &y) const {
+        return playerId < WORLD_MAX_PLAYERS && present[playerId] && tracks[playerId].position(nowMs, x, y);
+    }
+
+    uint8_t playerId() const {
+        return id;
+    }
+
+    bool isGameOver() const {
+        return over;
+    }
+
+private:
+    // The server's time is the official one
+    void gameOver(uint32_t serverTimeMs) {
+        over = true;
+        game.gameOver = true;
+        game.elapsedMs = serverTimeMs;
+        listener.onGameOver();
+    }
+
+    GameState &game;
+    Transport &transport;
+    ClientSessionListener &listener;
+    PositionEncoder positionEncoder;
+    SendQueue sendQueue;
+    RemoteTrack tracks[WORLD_MAX_PLAYERS];  // Indexed by player id
+    bool present[WORLD_MAX_PLAYERS];        // In the latest WORLD frame
+    RemoteState seenRemote;                 // As of the last frame
+    uint8_t id;                             // Ours, from the server's CONNECTED
+    uint8_t txSeq;
+    bool over;
+    uint8_t pendingFlags;  // PACKET_FLAG_* for the next position upload
+    uint32_t seenWorldCount;
+    uint32_t lastClockMs;
+};
+
+#endif
@@ -0,0 +1,216 @@
+#ifndef GAME_PROTOCOL_H
+#define GAME_PROTOCOL_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+///////////////////////////////////////////////////////////////
+// Binary game packet shared by the BLE server and client.
+//
+// Messages are little-endian frames of 9 bytes:
+//
+//   byte 0     type   (PACKET_TYPE_*)
+//   byte 1     seq    (wraps at 256, compare with seqNewer())
+//   byte 2..3  x      (uint16)
+//   byte 4..5  y      (uint16)
+//   byte 6     flags  (PACKET_FLAG_*)
+//   byte 7..8  time   (sender's millis() when sent, low 16 bits)
+//
+// GAMEOVER frames carry the elapsed game time in milliseconds
+// as a uint32 spread across the x (low) and y (high) words.
+//
+// DELTA frames are 7 bytes: a move relative to the POSITION
+// (keyframe) with sequence number base, see PositionCodec.h:
+//
+//   byte 0     type   (PACKET_TYPE_DELTA)
+//   byte 1     seq
+//   byte 2     base   (seq of the keyframe)
+//   byte 3     dx     (int8)
+//   byte 4     dy     (int8)
+//   byte 5..6  time
+//
+// In a decoded DELTA GamePacket, x/y hold dx/dy and flags holds
+// base; use the packetDelta*() accessors.
+//
+// CONNECTED frames from the server carry the receiving client's
+// player id in x (see PlayerTable.h). CLOCK frames from a client
+// carry its RemoteTrack offset for the server's dot (its clock
+// minus the server's, plus the trip down) as an int32 laid out
+// like GAMEOVER's time; with its own offset for the client the
+// server gets the round trip (see roundTripMs()). WORLD frames
+// hold every player's position at once and have their own
+// codec, see WorldState.h.
+//
+// WORLD frames are longer than any GamePacket: size buffers for
+// received frames with TRANSPORT_FRAME_MAX_SIZE (Transport.h),
+// or WORLD_PACKET_MAX_SIZE when encoding a WORLD frame.
+///////////////////////////////////////////////////////////////
+const size_t GAME_PACKET_SIZE = 9;        // Largest GamePacket frame, for encodePacket() buffers
+const size_t GAME_DELTA_PACKET_SIZE = 7;
+
+enum {
+    PACKET_TYPE_POSITION = 0x01,
+    PACKET_TYPE_CONNECTED = 0x02,
+    PACKET_TYPE_GAMEOVER = 0x03,
+    PACKET_TYPE_DELTA = 0x04,
+    PACKET_TYPE_WORLD = 0x05,
+    PACKET_TYPE_CLOCK = 0x06,
+};
+
+enum {
+    PACKET_FLAG_WARPED = 0x01,  // Sender jumped (SELECT warp), don't interpolate across it
+};
+
+// Screen bounds a POSITION frame must fall inside
+const uint16_t PACKET_MAX_X = 320;
+const uint16_t PACKET_MAX_Y = 240;
+
+struct GamePacket {
+    uint8_t type;
+    uint8_t seq;
+    uint16_t x;
+    uint16_t y;
+    uint8_t flags;
+    uint16_t timeMs;
+};
+
+///////////////////////////////////////////////////////////////
+// Little-endian helpers
+///////////////////////////////////////////////////////////////
+inline void putU16(uint8_t *buf, uint16_t value) {
+    buf[0] = (uint8_t)(value & 0xFF);
+    buf[1] = (uint8_t)(value >> 8);
+}
+
+inline uint16_t getU16(const uint8_t *buf) {
+    return (uint16_t)(buf[0] | (buf[1] << 8));
+}
+
+///////////////////////////////////////////////////////////////
+// Encode a packet into buf (must hold GAME_PACKET_SIZE bytes).
+// Returns the number of bytes written.
+///////////////////////////////////////////////////////////////
+inline size_t encodePacket(const GamePacket &packet, uint8_t *buf) {
+    buf[0] = packet.type;
+    buf[1] = packet.seq;
+    if (packet.type == PACKET_TYPE_DELTA) {
+        buf[2] = packet.flags;
+        buf[3] = (uint8_t)packet.x;
+        buf[4] = (uint8_t)packet.y;
+        putU16(buf + 5, packet.timeMs);
+        return GAME_DELTA_PACKET_SIZE;
+    }
+
+    putU16(buf + 2, packet.x);
+    putU16(buf + 4, packet.y);
+    buf[6] = packet.flags;
+    putU16(buf + 7, packet.timeMs);
+    return GAME_PACKET_SIZE;
+}
+
+///////////////////////////////////////////////////////////////
+// Decode and validate a received frame. Returns false for
+// frames of the wrong size, unknown types or off-screen
+// positions; packet is left untouched in that case.
+///////////////////////////////////////////////////////////////
+inline bool decodePacket(const uint8_t *buf, size_t length, GamePacket &packet) {
+    if (buf == NULL || length < 1) return false;
+
+    GamePacket decoded;
+    if (buf[0] == PACKET_TYPE_DELTA) {
+        if (length != GAME_DELTA_PACKET_SIZE) return false;
+        decoded.type = buf[0];
+        decoded.seq = buf[1];
+        decoded.flags = buf[2];
+        decoded.x = (uint16_t)(int16_t)(int8_t)buf[3];
+        decoded.y = (uint16_t)(int16_t)(int8_t)buf[4];
+        decoded.timeMs = getU16(buf + 5);
+        packet = decoded;
+        return true;
+    }
+    if (length != GAME_PACKET_SIZE) return false;
+
+    decoded.type = buf[0];
+    decoded.seq = buf[1];
+    decoded.x = getU16(buf + 2);
+    decoded.y = getU16(buf + 4);
+    decoded.flags = buf[6];
+    decoded.timeMs = getU16(buf + 7);
+
+    switch (decoded.type) {
+        case PACKET_TYPE_POSITION:
+            if (decoded.x >= PACKET_MAX_X || decoded.y >= PACKET_MAX_Y) return false;
+            break;
+        case PACKET_TYPE_CONNECTED:
+        case PACKET_TYPE_GAMEOVER:
+        case PACKET_TYPE_CLOCK:
+            break;
+        default:
+            return false;
+    }
+
+    packet = decoded;
+    return true;
+}
+
+///////////////////////////////////////////////////////////////
+// Packet builders
+///////////////////////////////////////////////////////////////
+inline GamePacket makePositionPacket(uint8_t seq, uint16_t x, uint16_t y, uint8_t flags = 0,
+                                     uint16_t timeMs = 0) {
+    GamePacket packet = { PACKET_TYPE_POSITION, seq, x, y, flags, timeMs };
+    return packet;
+}
+
+inline GamePacket makeConnectedPacket(uint8_t seq, uint8_t playerId = 0) {
+    GamePacket packet = { PACKET_TYPE_CONNECTED, seq, playerId, 0, 0, 0 };
+    return packet;
+}
+
+inline GamePacket makeGameOverPacket(uint8_t seq, uint32_t elapsedMs) {
+    GamePacket packet = { PACKET_TYPE_GAMEOVER, seq,
+                          (uint16_t)(elapsedMs & 0xFFFF), (uint16_t)(elapsedMs >> 16), 0, 0 };
+    return packet;
+}
+
+inline uint32_t packetElapsedMs(const GamePacket &packet) {
+    return (uint32_t)packet.x | ((uint32_t)packet.y << 16);
+}
+
+inline GamePacket makeClockPacket(uint8_t seq, int32_t offsetMs) {
+    GamePacket packet = { PACKET_TYPE_CLOCK, seq,
+                          (uint16_t)((uint32_t)offsetMs & 0xFFFF), (uint16_t)((uint32_t)offsetMs >> 16), 0, 0 };
+    return packet;
+}
+
+inline int32_t packetClockOffsetMs(const GamePacket &packet) {
+    return (int32_t)packetElapsedMs(packet);
+}
+
+inline GamePacket makeDeltaPacket(uint8_t seq, uint8_t baseSeq, int8_t dx, int8_t dy,
+                                  uint16_t timeMs = 0) {
+    GamePacket packet = { PACKET_TYPE_DELTA, seq, (uint16_t)(int16_t)dx, (uint16_t)(int16_t)dy,
+                          baseSeq, timeMs };
+    return packet;
+}
+
+inline int packetDeltaX(const GamePacket &packet) {
+    return (int16_t)packet.x;
+}
+
+inline int packetDeltaY(const GamePacket &packet) {
+    return (int16_t)packet.y;
+}
+
+inline uint8_t packetDeltaBase(const GamePacket &packet) {
+    return packet.flags;
+}
+
+///////////////////////////////////////////////////////////////
+// True if sequence number a was sent after b (wrap-safe)
+///////////////////////////////////////////////////////////////
+inline bool seqNewer(uint8_t a, uint8_t b) {
+    return (int8_t)(uint8_t)(a - b) > 0;
+}
+
+#endif
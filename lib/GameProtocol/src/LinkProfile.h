@@ -0,0 +1,110 @@
+#ifndef LINK_PROFILE_H
+#define LINK_PROFILE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+///////////////////////////////////////////////////////////////
+// BLE connection parameter profiles.
+//
+// While a round is running we want the shortest connection
+// interval and no slave latency, so a position goes out within
+// a few ms; in the lobby and on the game over screen nothing is
+// moving and a long interval saves power. LinkProfileManager
+// picks the profile for the current phase and asks the BLE stack
+// for it; switching to low latency is immediate, dropping back
+// to the battery profile waits settleMs so a quick restart
+// doesn't bounce the interval. The larger MTU is requested once
+// per connection.
+//
+// Link is anything with
+//   bool requestConnectionParams(const ConnectionProfile &)
+//   bool requestMtu(uint16_t)
+// so the host can check the logic against a fake stack.
+///////////////////////////////////////////////////////////////
+struct ConnectionProfile {
+    const char *name;
+    uint16_t minInterval;  // 1.25 ms units
+    uint16_t maxInterval;  // 1.25 ms units
+    uint16_t latency;      // Connection events the peripheral may skip
+    uint16_t timeout;      // Supervision timeout, 10 ms units
+};
+
+const ConnectionProfile PROFILE_LOW_LATENCY = { "low-latency", 6, 12, 0, 200 };  // 7.5-15 ms
+const ConnectionProfile PROFILE_BATTERY = { "battery", 80, 160, 4, 600 };        // 100-200 ms
+
+const uint16_t LINK_MTU = 185;  // Room for several frames per notification
+
+enum LinkPhase {
+    LINK_LOBBY,      // Connected, waiting for the round to start
+    LINK_PLAYING,
+    LINK_GAME_OVER,
+};
+
+inline const ConnectionProfile &profileForPhase(LinkPhase phase) {
+    return phase == LINK_PLAYING ? PROFILE_LOW_LATENCY : PROFILE_BATTERY;
+}
+
+template <typename Link>
+class LinkProfileManager {
+public:
+    LinkProfileManager(Link &link, uint32_t settleMs = 1000)
+        : link(link), settleMs(settleMs) {
+        onConnect(0);
+    }
+
+    // A new connection starts with whatever the stack picked
+    void onConnect(uint32_t nowMs) {
+        requested = NULL;
+        mtuRequested = false;
+        phase = LINK_LOBBY;
+        phaseSinceMs = nowMs;
+        requests = 0;
+    }
+
+    // Call every frame while connected. Makes at most one request per call.
+    void update(LinkPhase currentPhase, uint32_t nowMs) {
+        if (currentPhase != phase) {
+            phase = currentPhase;
+            phaseSinceMs = nowMs;
+        }
+
+        if (!mtuRequested) {
+            mtuRequested = link.requestMtu(LINK_MTU);
+            if (mtuRequested) return;
+        }
+
+        const ConnectionProfile &want = profileForPhase(phase);
+        if (&want == requested) return;
+        if (&want == &PROFILE_BATTERY && requested && nowMs - phaseSinceMs < settleMs) return;
+
+        if (link.requestConnectionParams(want)) {
+            requested = &want;
+            requests++;
+        }
+    }
+
+    // Profile last asked for, or NULL
+    const ConnectionProfile *requestedProfile() const {
+        return requested;
+    }
+
+    uint32_t requests;  // Connection parameter requests on this connection
+
+private:
+    Link &link;
+    uint32_t settleMs;
+    const ConnectionProfile *requested;
+    bool mtuRequested;
+    LinkPhase phase;
+    uint32_t phaseSinceMs;
+};
+
+///////////////////////////////////////////////////////////////
+// Human-readable connection parameters for the serial log
+///////////////////////////////////////////////////////////////
+inline uint32_t intervalMicros(uint16_t interval) {
+    return interval * 1250UL;
+}
+
+#endif
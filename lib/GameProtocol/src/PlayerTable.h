@@ -0,0 +1,170 @@
+#ifndef PLAYER_TABLE_H
+#define PLAYER_TABLE_H
+
+#include "GameProtocol.h"
+#include "PositionCodec.h"
+#include "RemoteState.h"
+#include <SeqlockCell.h>
+#include <atomic>
+
+///////////////////////////////////////////////////////////////
+// The server's table of connected clients.
+//
+// Each BLE connection (by conn_id) gets one of MAX_CLIENTS
+// slots, with its own packet decoder, sequence tracking, MTU
+// and notify subscription. Slot n is player id n + 1 on the
+// wire (SERVER_PLAYER_ID is the server's own dot).
+//
+// The on*() calls come from the BLE task and are the only
+// writers; after every change the slot is published to a
+// SeqlockCell, and the game loop copies it out with read().
+// A new connection in a slot bumps joinCount, so the loop can
+// tell a rejoin from the player it already knew.
+///////////////////////////////////////////////////////////////
+const int MAX_CLIENTS = 3;             // The ESP32 controller's default connection limit
+const uint16_t ATT_DEFAULT_MTU = 23;   // Until the client asks for more
+
+// True if a notification of length bytes fits in one ATT packet
+inline bool fitsMtu(size_t length, uint16_t mtu) {
+    return length + 3 <= mtu;
+}
+
+inline uint8_t playerIdForSlot(int slot) {
+    return (uint8_t)(slot + 1);
+}
+
+struct PlayerView {
+    uint32_t joinCount;   // Connections this slot has taken so far
+    uint16_t connId;
+    uint16_t mtu;
+    bool connected;
+    bool subscribed;      // Notifications enabled on our characteristic
+    uint32_t stale;       // Positions dropped for being older than the latest
+    RemoteState remote;   // Everything this client has sent since it connected
+};
+
+class PlayerTable {
+public:
+    PlayerTable() : connected(0) {
+        for (int i = 0; i < MAX_CLIENTS; i++) {
+            slots[i].used = false;
+            slots[i].view = PlayerView();
+        }
+    }
+
+    ///////////////////////////////////////////////////////////
+    // BLE task. Each returns the slot that changed, or -1.
+    ///////////////////////////////////////////////////////////
+
+    // -1 if the table is full (the caller should drop the link)
+    int onConnect(uint16_t connId) {
+        int slot = slotOf(connId);
+        if (slot >= 0) return slot;
+        for (slot = 0; slot < MAX_CLIENTS && slots[slot].used; slot++) {
+        }
+        if (slot == MAX_CLIENTS) return -1;
+
+        Slot &entry = slots[slot];
+        entry.used = true;
+        entry.decoder = PositionDecoder();
+        uint32_t joinCount = entry.view.joinCount + 1;
+        entry.view = PlayerView();
+        entry.view.joinCount = joinCount;
+        entry.view.connId = connId;
+        entry.view.mtu = ATT_DEFAULT_MTU;
+        entry.view.connected = true;
+        connected.fetch_add(1);
+        publish(slot);
+        return slot;
+    }
+
+    int onDisconnect(uint16_t connId) {
+        int slot = slotOf(connId);
+        if (slot < 0) return -1;
+        slots[slot].used = false;
+        slots[slot].view.connected = false;
+        slots[slot].view.subscribed = false;
+        connected.fetch_sub(1);
+        publish(slot);
+        return slot;
+    }
+
+    // The client wrote our characteristic's CCCD
+    int onSubscribe(uint16_t connId, bool subscribed) {
+        int slot = slotOf(connId);
+        if (slot < 0) return -1;
+        slots[slot].view.subscribed = subscribed;
+        publish(slot);
+        return slot;
+    }
+
+    int onMtu(uint16_t connId, uint16_t mtu) {
+        int slot = slotOf(connId);
+        if (slot < 0) return -1;
+        slots[slot].view.mtu = mtu;
+        publish(slot);
+        return slot;
+    }
+
+    // A frame the client wrote. Malformed frames, deltas without
+    // their keyframe and out-of-date positions are dropped (-1).
+    int onWrite(uint16_t connId, const uint8_t *data, size_t length, uint32_t nowMs) {
+        int slot = slotOf(connId);
+        if (slot < 0) return -1;
+
+        Slot &entry = slots[slot];
+        GamePacket packet;
+        if (!decodePacket(data, length, packet) || !entry.decoder.decode(packet, packet)) return -1;
+
+        RemoteState &remote = entry.view.remote;
+        if (packet.type == PACKET_TYPE_POSITION && remote.positionCount > 0 &&
+            !seqNewer(packet.seq, remote.seq)) {
+            entry.view.stale++;
+            publish(slot);
+            return -1;
+        }
+        applyPacket(remote, packet, nowMs);
+        publish(slot);
+        return slot;
+    }
+
+    // Slot holding connId, or -1 (BLE task)
+    int slotOf(uint16_t connId) const {
+        for (int i = 0; i < MAX_CLIENTS; i++) {
+            if (slots[i].used && slots[i].view.connId == connId) return i;
+        }
+        return -1;
+    }
+
+    ///////////////////////////////////////////////////////////
+    // Any task
+    ///////////////////////////////////////////////////////////
+    void read(int slot, PlayerView &view) const {
+        cells[slot].read(view);
+    }
+
+    int connectedCount() const {
+        return connected.load();
+    }
+
+    bool full() const {
+        return connectedCount() >= MAX_CLIENTS;
+    }
+
+private:
+    void publish(int slot) {
+        cells[slot].write(slots[slot].view);
+    }
+
+    struct Slot {
+        bool used;
+        PlayerView view;
+        PositionDecoder decoder;
+    };
+
+    Slot slots[MAX_CLIENTS];            // BLE task only
+    SeqlockCell<PlayerView> cells[MAX_CLIENTS];
+    std::atomic<int> connected;
+};
+
+#endif
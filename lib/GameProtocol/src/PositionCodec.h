@@ -0,0 +1,108 @@
+#ifndef POSITION_CODEC_H
+#define POSITION_CODEC_H
+
+#include "GameProtocol.h"
+
+///////////////////////////////////////////////////////////////
+// Change-only position stream.
+//
+// PositionEncoder decides what (if anything) to send each
+// network tick:
+//   - nothing while the dot sits still (after one last packet
+//     confirming it stopped, so the receiver stops
+//     extrapolating),
+//   - a 7-byte DELTA relative to the last keyframe for moves
+//     within +-127 px of it,
+//   - a 9-byte absolute POSITION keyframe on the first send,
+//     after a warp, when the delta won't fit, and every
+//     keyframeMs so a receiver that lost the keyframe recovers.
+// Deltas are relative to the keyframe, not to the previous
+// delta, so a dropped DELTA never causes drift; deltas whose
+// keyframe was lost are ignored until the next keyframe.
+//
+// PositionDecoder turns DELTA frames back into POSITION packets.
+///////////////////////////////////////////////////////////////
+class PositionEncoder {
+public:
+    PositionEncoder(uint32_t keyframeMs = 1000) : keyframeMs(keyframeMs) {
+        reset();
+    }
+
+    // Next send is a keyframe (e.g. for a new round)
+    void reset() {
+        haveKeyframe = false;
+        sentChange = false;
+        keySeq = 0;
+        keyX = keyY = lastX = lastY = 0;
+        keyMs = 0;
+    }
+
+    // Fill packet and return true if something should go out now.
+    // seq is only used (and should only be advanced) when it returns true.
+    bool encode(uint8_t seq, int x, int y, uint8_t flags, uint32_t nowMs, GamePacket &packet) {
+        uint16_t timeMs = (uint16_t)nowMs;
+        bool changed = !haveKeyframe || x != lastX || y != lastY || flags != 0;
+        int dx = x - keyX;
+        int dy = y - keyY;
+
+        if (!haveKeyframe || flags != 0 || nowMs - keyMs >= keyframeMs ||
+            dx < -127 || dx > 127 || dy < -127 || dy > 127) {
+            packet = makePositionPacket(seq, (uint16_t)x, (uint16_t)y, flags, timeMs);
+            haveKeyframe = true;
+            keySeq = seq;
+            keyX = x;
+            keyY = y;
+            keyMs = nowMs;
+        } else if (changed || sentChange) {
+            packet = makeDeltaPacket(seq, keySeq, (int8_t)dx, (int8_t)dy, timeMs);
+        } else {
+            return false;
+        }
+
+        sentChange = changed;
+        lastX = x;
+        lastY = y;
+        return true;
+    }
+
+private:
+    uint32_t keyframeMs;
+    bool haveKeyframe;
+    bool sentChange;   // The last packet carried a move
+    uint8_t keySeq;
+    int keyX;
+    int keyY;
+    uint32_t keyMs;
+    int lastX;
+    int lastY;
+};
+
+class PositionDecoder {
+public:
+    PositionDecoder() : haveKeyframe(false), key(makePositionPacket(0, 0, 0)) {}
+
+    // POSITION keyframes are remembered and passed through, DELTAs
+    // become the equivalent POSITION packet, anything else passes
+    // through. Returns false for a DELTA whose keyframe we don't have.
+    bool decode(const GamePacket &packet, GamePacket &out) {
+        if (packet.type == PACKET_TYPE_POSITION) {
+            haveKeyframe = true;
+            key = packet;
+        } else if (packet.type == PACKET_TYPE_DELTA) {
+            if (!haveKeyframe || packetDeltaBase(packet) != key.seq) return false;
+            int x = key.x + packetDeltaX(packet);
+            int y = key.y + packetDeltaY(packet);
+            if (x < 0 || y < 0 || x >= PACKET_MAX_X || y >= PACKET_MAX_Y) return false;
+            out = makePositionPacket(packet.seq, (uint16_t)x, (uint16_t)y, 0, packet.timeMs);
+            return true;
+        }
+        out = packet;
+        return true;
+    }
+
+private:
+    bool haveKeyframe;
+    GamePacket key;
+};
+
+#endif
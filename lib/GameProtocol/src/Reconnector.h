@@ -0,0 +1,180 @@
+#ifndef RECONNECTOR_H
+#define RECONNECTOR_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <atomic>
+
+///////////////////////////////////////////////////////////////
+// Finding the server again after a disconnect (or at boot).
+//
+// The last server we connected to is kept in a Store (NVS on the
+// Core2), so the first thing we try is a direct connect to that
+// address, which completes as soon as the server advertises
+// again. If there is no saved address or the direct connect
+// fails, we run short high-duty scan windows (with a pause in
+// between) and connect to the first device that advertises our
+// service UUID. Advertisements are matched on the raw AD data,
+// so a scan result costs no allocation.
+//
+// The direct connect is tried once per start(): on the ESP32 it
+// only gives up after Bluedroid's 30 s timeout, so a stale
+// address (the server board was swapped) must not be retried
+// between scan windows. A server that came back where it was is
+// found by the scan just the same.
+//
+// Stack is anything with
+//   bool connect(const PeerAddress &)  (blocking, true when ready to play)
+//   void startScan()
+//   void stopScan()
+// and Store anything with
+//   bool load(PeerAddress &)
+//   void save(const PeerAddress &)
+// so the host can drive it with a scripted fake scanner.
+///////////////////////////////////////////////////////////////
+struct PeerAddress {
+    uint8_t bytes[6];
+    uint8_t type;  // Public / random, as the BLE stack reports it
+};
+
+inline bool sameAddress(const PeerAddress &a, const PeerAddress &b) {
+    return a.type == b.type && memcmp(a.bytes, b.bytes, sizeof(a.bytes)) == 0;
+}
+
+// AD types that list 128-bit service UUIDs
+const uint8_t AD_TYPE_UUID128_INCOMPLETE = 0x06;
+const uint8_t AD_TYPE_UUID128_COMPLETE = 0x07;
+
+///////////////////////////////////////////////////////////////
+// True if the advertising (+ scan response) data lists uuid,
+// given in the little-endian order used on the air. Stops at
+// the first malformed AD structure.
+///////////////////////////////////////////////////////////////
+inline bool advertisesService(const uint8_t *data, size_t length, const uint8_t uuid[16]) {
+    size_t pos = 0;
+    while (pos < length) {
+        uint8_t fieldLength = data[pos];
+        if (fieldLength == 0 || pos + 1 + fieldLength > length) return false;
+
+        uint8_t type = data[pos + 1];
+        if (type == AD_TYPE_UUID128_INCOMPLETE || type == AD_TYPE_UUID128_COMPLETE) {
+            for (size_t i = pos + 2; i + 16 <= pos + 1 + fieldLength; i += 16) {
+                if (memcmp(data + i, uuid, 16) == 0) return true;
+            }
+        }
+        pos += 1 + fieldLength;
+    }
+    return false;
+}
+
+enum ReconnectState {
+    RECONNECT_DIRECT,     // Next update() tries the saved address (once per start())
+    RECONNECT_SCANNING,
+    RECONNECT_PAUSED,     // Between scan windows
+    RECONNECT_CONNECTED,
+};
+
+template <typename Stack, typename Store>
+class Reconnector {
+public:
+    Reconnector(Stack &stack, Store &store, const uint8_t serviceUuid[16],
+                uint32_t scanWindowMs = 1500, uint32_t scanPauseMs = 500)
+        : stack(stack), store(store), scanWindowMs(scanWindowMs), scanPauseMs(scanPauseMs),
+          state(RECONNECT_CONNECTED), haveSaved(false), found(false), startedMs(0), stateSinceMs(0) {
+        memcpy(uuid, serviceUuid, sizeof(uuid));
+    }
+
+    // Start looking for the server (at boot, or after the link dropped)
+    void start(uint32_t nowMs) {
+        haveSaved = store.load(saved);
+        startedMs = nowMs;
+        enter(haveSaved ? RECONNECT_DIRECT : RECONNECT_SCANNING, nowMs);
+    }
+
+    // Call for every scan result; safe on the BLE task
+    void onAdvertisement(const PeerAddress &address, const uint8_t *data, size_t length) {
+        if (found.load(std::memory_order_acquire)) return;
+        if (!advertisesService(data, length, uuid)) return;
+        candidate = address;
+        found.store(true, std::memory_order_release);
+    }
+
+    // Call every loop while not connected. May block in Stack::connect().
+    // Returns true once connected.
+    bool update(uint32_t nowMs) {
+        switch (state) {
+        case RECONNECT_DIRECT:
+            if (stack.connect(saved)) {
+                enter(RECONNECT_CONNECTED, nowMs);
+                return true;
+            }
+            enter(RECONNECT_SCANNING, nowMs);
+            return false;
+
+        case RECONNECT_SCANNING:
+            if (found.load(std::memory_order_acquire)) {
+                stack.stopScan();
+                PeerAddress address = candidate;
+                if (stack.connect(address)) {
+                    if (!haveSaved || !sameAddress(address, saved)) store.save(address);
+                    saved = address;
+                    haveSaved = true;
+                    enter(RECONNECT_CONNECTED, nowMs);
+                    return true;
+                }
+                enter(RECONNECT_SCANNING, nowMs);
+            } else if (nowMs - stateSinceMs >= scanWindowMs) {
+                stack.stopScan();
+                enter(RECONNECT_PAUSED, nowMs);
+            }
+            return false;
+
+        case RECONNECT_PAUSED:
+            if (nowMs - stateSinceMs >= scanPauseMs) enter(RECONNECT_SCANNING, nowMs);
+            return false;
+
+        case RECONNECT_CONNECTED:
+            return true;
+        }
+        return false;
+    }
+
+    bool connected() const {
+        return state == RECONNECT_CONNECTED;
+    }
+
+    ReconnectState currentState() const {
+        return state;
+    }
+
+    // When the current (or last) search started
+    uint32_t startedAt() const {
+        return startedMs;
+    }
+
+private:
+    void enter(ReconnectState next, uint32_t nowMs) {
+        state = next;
+        stateSinceMs = nowMs;
+        if (next == RECONNECT_SCANNING) {
+            found.store(false, std::memory_order_release);
+            stack.startScan();
+        }
+    }
+
+    Stack &stack;
+    Store &store;
+    uint8_t uuid[16];
+    uint32_t scanWindowMs;
+    uint32_t scanPauseMs;
+    ReconnectState state;
+    PeerAddress saved;
+    bool haveSaved;
+    PeerAddress candidate;         // Written by onAdvertisement() before found is set
+    std::atomic<bool> found;
+    uint32_t startedMs;
+    uint32_t stateSinceMs;
+};
+
+#endif
@@ -0,0 +1,84 @@
+#ifndef REMOTE_STATE_H
+#define REMOTE_STATE_H
+
+#include "GameProtocol.h"
+
+///////////////////////////////////////////////////////////////
+// Everything the other device has told us, as of the latest
+// packet. The BLE callback folds each packet in with
+// applyPacket() and publishes the result (see SeqlockCell.h);
+// the game loop reads it once per frame and compares the
+// counters with the previous frame's copy to spot new data.
+///////////////////////////////////////////////////////////////
+struct RemoteState {
+    uint32_t positionCount;   // POSITION packets received
+    uint16_t x;               // Latest position
+    uint16_t y;
+    uint8_t seq;              // Sequence number of the latest position
+    uint8_t flags;            // PACKET_FLAG_* of the latest position
+    uint16_t sentMs;          // Sender's clock when the latest position was sent
+    uint32_t receivedMs;      // When the latest position arrived
+    uint32_t connectedCount;  // CONNECTED packets received
+    uint8_t playerId;         // Our id, as assigned in the latest CONNECTED
+    uint32_t gameOverCount;   // GAMEOVER packets received
+    uint32_t gameOverMs;      // Elapsed time in the latest GAMEOVER
+    uint8_t lastRoundPacket;  // PACKET_TYPE_CONNECTED or _GAMEOVER, whichever came last
+    uint32_t clockCount;      // CLOCK packets received
+    int32_t clockOffsetMs;    // Sender's RemoteTrack offset for us, from the latest CLOCK
+};
+
+inline void applyPacket(RemoteState &state, const GamePacket &packet, uint32_t nowMs) {
+    switch (packet.type) {
+    case PACKET_TYPE_POSITION:
+        state.positionCount++;
+        state.x = packet.x;
+        state.y = packet.y;
+        state.seq = packet.seq;
+        state.flags = packet.flags;
+        state.sentMs = packet.timeMs;
+        state.receivedMs = nowMs;
+        break;
+    case PACKET_TYPE_CONNECTED:
+        state.connectedCount++;
+        state.playerId = (uint8_t)packet.x;
+        state.lastRoundPacket = packet.type;
+        break;
+    case PACKET_TYPE_GAMEOVER:
+        state.gameOverCount++;
+        state.gameOverMs = packetElapsedMs(packet);
+        state.lastRoundPacket = packet.type;
+        break;
+    case PACKET_TYPE_CLOCK:
+        state.clockCount++;
+        state.clockOffsetMs = packetClockOffsetMs(packet);
+        break;
+    }
+}
+
+///////////////////////////////////////////////////////////////
+// Round changes between two reads of a RemoteState. CONNECTED
+// starts a round, GAMEOVER ends it, and both can land in one
+// frame either way round: a restart after a game over sends
+// GAMEOVER then CONNECTED, while a player joining during a game
+// over gets CONNECTED then GAMEOVER and has to stay in game
+// over. Apply them in the order they came:
+//
+//   if (change.ended && !change.endedLast) gameOver();
+//   if (change.started) newRound();
+//   if (change.endedLast) gameOver();
+///////////////////////////////////////////////////////////////
+struct RoundChange {
+    bool started;    // A CONNECTED came in
+    bool ended;      // A GAMEOVER came in
+    bool endedLast;  // ...after any CONNECTED
+};
+
+inline RoundChange roundChange(const RemoteState &seen, const RemoteState &now) {
+    RoundChange change;
+    change.started = now.connectedCount != seen.connectedCount;
+    change.ended = now.gameOverCount != seen.gameOverCount;
+    change.endedLast = change.ended && now.lastRoundPacket == PACKET_TYPE_GAMEOVER;
+    return change;
+}
+
+#endif
@@ -0,0 +1,141 @@
+#ifndef SEND_QUEUE_H
+#define SEND_QUEUE_H
+
+#include "GameProtocol.h"
+#include <atomic>
+
+///////////////////////////////////////////////////////////////
+// Outgoing packet queue with a bound on writes in flight.
+//
+// The game loop push()es packets and sends whatever next()
+// hands out; the radio reports each finished write with
+// onSent(), which may be called from the BLE task. Only the
+// newest position matters, so while the radio is busy:
+//   - a DELTA replaces the pending DELTA,
+//   - a POSITION keyframe replaces the pending keyframe and
+//     any pending DELTA (they were relative to older data),
+//   - other packets (CONNECTED, GAMEOVER, CLOCK) wait in a small FIFO
+//     and are sent first.
+// Pending keyframes are never dropped in favour of a delta, so
+// the receiver's PositionDecoder always has the right base.
+// A write that never completes (e.g. on disconnect) is written
+// off after timeoutMs.
+///////////////////////////////////////////////////////////////
+const int SEND_QUEUE_CONTROL_SIZE = 4;
+
+class SendQueue {
+public:
+    SendQueue(uint8_t maxInFlight = 2, uint32_t timeoutMs = 250)
+        : maxInFlight(maxInFlight), timeoutMs(timeoutMs), inFlight(0), completions(0) {
+        reset();
+    }
+
+    // Forget everything, e.g. after a (re)connect
+    void reset() {
+        haveKey = false;
+        haveDelta = false;
+        controlHead = controlCount = 0;
+        inFlight.store(0);
+        seenCompletions = completions.load();
+        lastActivityMs = 0;
+        sent = dropped = 0;
+    }
+
+    // Returns false if a control packet didn't fit
+    bool push(const GamePacket &packet) {
+        switch (packet.type) {
+        case PACKET_TYPE_POSITION:
+            if (haveKey) dropped++;
+            if (haveDelta) dropped++;
+            key = packet;
+            haveKey = true;
+            haveDelta = false;
+            return true;
+        case PACKET_TYPE_DELTA:
+            if (haveDelta) dropped++;
+            delta = packet;
+            haveDelta = true;
+            return true;
+        default:
+            if (controlCount == SEND_QUEUE_CONTROL_SIZE) {
+                dropped++;
+                return false;
+            }
+            control[(controlHead + controlCount++) % SEND_QUEUE_CONTROL_SIZE] = packet;
+            return true;
+        }
+    }
+
+    // The next packet to write now, if any and if the radio has room.
+    // Each packet handed out counts as in flight until onSent().
+    bool next(uint32_t nowMs, GamePacket &packet) {
+        uint32_t done = completions.load();
+        if (done != seenCompletions) {
+            seenCompletions = done;
+            lastActivityMs = nowMs;  // The radio is making progress
+        }
+
+        uint8_t busy = inFlight.load();
+        if (busy > 0 && nowMs - lastActivityMs >= timeoutMs) {
+            inFlight.store(0);  // Lost completions; don't stall forever
+            busy = 0;
+        }
+        if (busy >= maxInFlight) return false;
+
+        if (controlCount > 0) {
+            packet = control[controlHead];
+            controlHead = (controlHead + 1) % SEND_QUEUE_CONTROL_SIZE;
+            controlCount--;
+        } else if (haveKey) {
+            packet = key;
+            haveKey = false;
+        } else if (haveDelta) {
+            packet = delta;
+            haveDelta = false;
+        } else {
+            return false;
+        }
+
+        if (busy == 0) lastActivityMs = nowMs;
+        inFlight.fetch_add(1);
+        sent++;
+        return true;
+    }
+
+    // A write finished (any task)
+    void onSent() {
+        uint8_t busy = inFlight.load();
+        while (busy > 0 && !inFlight.compare_exchange_weak(busy, busy - 1)) {
+        }
+        completions.fetch_add(1);
+    }
+
+    uint8_t inFlightCount() const {
+        return inFlight.load();
+    }
+
+    bool idle() const {
+        return !haveKey && !haveDelta && controlCount == 0;
+    }
+
+    uint32_t sent;     // Packets handed out by next()
+    uint32_t dropped;  // Stale packets replaced before they were sent
+
+private:
+    uint8_t maxInFlight;
+    uint32_t timeoutMs;
+    std::atomic<uint8_t> inFlight;
+    std::atomic<uint32_t> completions;  // onSent() calls so far
+    uint32_t seenCompletions;
+    uint32_t lastActivityMs;            // Last send from idle or completion seen
+
+    GamePacket key;
+    bool haveKey;
+    GamePacket delta;
+    bool haveDelta;
+    GamePacket control[SEND_QUEUE_CONTROL_SIZE];
+    int controlHead;
+    int controlCount;
+};
+
+#endif
@@ -0,0 +1,343 @@
+#ifndef SERVER_SESSION_H
+#define SERVER_SESSION_H
+
+#include "GameProtocol.h"
+#include "PlayerTable.h"
+#include "RemoteState.h"
+#include "Transport.h"
+#include "WorldState.h"
+#include <GameCore.h>
+#include <PositionHistory.h>
+#include <RemoteTrack.h>
+#include <SpatialGrid.h>
+
+///////////////////////////////////////////////////////////////
+// The server's side of a game, minus the radio and the screen.
+//
+// The server sketch and tools/host_session both run the game
+// through this: the Transport's callbacks fill a PlayerTable,
+// and once per frame the loop calls
+//   updatePlayers()          joins and leaves; CONNECTED to each
+//                            new subscriber (then GAMEOVER if it
+//                            joined during one)
+//   applyRemoteStates()      each client's new positions into its
+//                            RemoteTrack, plus the rewound check
+//                            of each against our dot as that
+//                            client saw it
+//   checkCollisions()        after every step: our dot swept
+//                            against each client's, then every
+//                            pair on the field through a
+//                            SpatialGrid
+//   simulated()              our dot into the PositionHistory
+//   broadcastWorld()         on network ticks, one WORLD frame
+// and gameOver() / sendStart() at the end and restart of a
+// round. The GameState is the caller's; the session only reads
+// our dot and parks client spawns away from it.
+//
+// What the sketch does on top (logging, session recording, the
+// game reset) comes back through a ServerSessionListener.
+///////////////////////////////////////////////////////////////
+
+// What loop() knows about each PlayerTable slot
+struct ServerPlayer {
+    uint32_t joinCount;   // Connection we set up the slot for
+    bool connected;
+    bool welcomed;        // Sent CONNECTED once it subscribed
+    RemoteState seen;     // Slot's RemoteState as of the last frame
+    RemoteTrack track;
+    bool valid;           // Has a position this round
+    uint32_t sinceMs;     // game.elapsedMs when it appeared (collision grace)
+    int x;                // Tracked position
+    int y;
+    int lastX;            // Tracked position at the last collision check
+    int lastY;
+    uint8_t worldFlags;   // PACKET_FLAG_* for its next world entry
+};
+
+class ServerSessionListener {
+public:
+    virtual ~ServerSessionListener() {}
+    // The first player subscribed with no round going: reset the game and call newRound()
+    virtual void onRoundStart() = 0;
+    virtual void onJoin(uint8_t id) {}
+    virtual void onLeave(uint8_t id) {}
+    virtual void onPosition(uint8_t id, const RemoteState &remote) {}  // A new one, before it's tracked
+    virtual void onSpawn(uint8_t id, int x, int y) {}                  // First tracked position of the round
+    virtual void onHit(uint8_t a, uint8_t b) {}                        // Dots a and b touched
+};
+
+class ServerSession {
+public:
+    // Client dots are tracked remoteDelayMs in the past (the clients draw ours as late)
+    ServerSession(PlayerTable &table, GameState &game, Transport &transport, ServerSessionListener &listener,
+                  uint32_t remoteDelayMs, uint32_t keyframeMs)
+        : table(table), game(game), transport(transport), listener(listener), remoteDelayMs(remoteDelayMs),
+          worldEncoder(keyframeMs), txSeq(0), active(false), over(false), pendingFlags(0) {
+        for (int slot = 0; slot < MAX_CLIENTS; slot++) {
+            players[slot] = ServerPlayer();
+            resetPlayer(players[slot]);
+            players[slot].track.setDelay(remoteDelayMs);
+        }
+    }
+
+    ///////////////////////////////////////////////////////////
+    // Pick up joins, subscriptions and leaves from the table.
+    // A client is told its player id (CONNECTED) once it has
+    // subscribed, so it can't miss it; the first one starts the
+    // round, later ones join the round in progress. True if
+    // anyone joined or left.
+    ///////////////////////////////////////////////////////////
+    bool updatePlayers() {
+        bool changed = false;
+        for (int slot = 0; slot < MAX_CLIENTS; slot++) {
+            ServerPlayer &player = players[slot];
+            PlayerView view;
+            table.read(slot, view);
+
+            if (view.connected && (!player.connected || view.joinCount != player.joinCount)) {
+                listener.onJoin(playerIdForSlot(slot));
+                resetPlayer(player);
+                player.joinCount = view.joinCount;
+                player.connected = true;
+                player.seen = view.remote;
+                changed = true;
+            } else if (!view.connected && player.connected) {
+                listener.onLeave(playerIdForSlot(slot));
+                player.connected = false;
+                changed = true;
+            }
+
+            if (player.connected && view.subscribed && !player.welcomed) {
+                player.welcomed = true;
+                if (!active) {
+                    listener.onRoundStart();
+                    active = true;
+                }
+                notifyPacket(slot, makeConnectedPacket(txSeq++, playerIdForSlot(slot)));
+                if (over) notifyPacket(slot, makeGameOverPacket(txSeq++, game.elapsedMs));
+            }
+        }
+        if (changed && table.connectedCount() == 0) active = false;
+        return changed;
+    }
+
+    ///////////////////////////////////////////////////////////
+    // Take every client's latest position from the table.
+    // Returns true if one of them hit our dot as that client
+    // saw it.
+    ///////////////////////////////////////////////////////////
+    bool applyRemoteStates(uint32_t nowMs) {
+        bool hit = false;
+        for (int slot = 0; slot < MAX_CLIENTS; slot++) {
+            ServerPlayer &player = players[slot];
+            if (!player.connected) continue;
+
+            PlayerView view;
+            table.read(slot, view);
+            if (view.joinCount != player.joinCount) continue;  // Rejoined; updatePlayers() resets it first
+            const RemoteState &remote = view.remote;
+            uint8_t id = playerIdForSlot(slot);
+
+            bool newPosition = remote.positionCount != player.seen.positionCount;
+            if (newPosition) {
+                listener.onPosition(id, remote);
+                player.track.add(remote.sentMs, remote.receivedMs, remote.x, remote.y,
+                                 remote.flags & PACKET_FLAG_WARPED);
+                player.worldFlags |= remote.flags & PACKET_FLAG_WARPED;
+            }
+            player.seen = remote;
+
+            // Track the client's dot; collisions are ignored for its first COLLISION_GRACE_MS
+            int x, y;
+            if (player.track.position(nowMs, x, y)) {
+                player.x = clampInt(x, 0, FIELD_MAX_X);
+                player.y = clampInt(y, 0, FIELD_MAX_Y);
+                if (!player.valid) {
+                    player.valid = true;
+                    player.sinceMs = game.elapsedMs;
+                    player.lastX = player.x;
+                    player.lastY = player.y;
+                    listener.onSpawn(id, player.x, player.y);
+                    avoidSpawnOverlap(game, player.x, player.y);
+                }
+            }
+
+            // Lag compensation: rewind our dot to what was on the client's screen when it sent this.
+            // Until the client's first CLOCK we don't know the round trip and leave it out.
+            PositionRecord seen;
+            uint32_t roundTrip = remote.clockCount ? roundTripMs(player.track.clockOffset(), remote.clockOffsetMs) : 0;
+            if (newPosition && player.valid && game.elapsedMs - player.sinceMs > COLLISION_GRACE_MS &&
+                history.rewind(rewindTimeMs(player.track.toLocalMs(remote.sentMs), roundTrip, remoteDelayMs), seen) &&
+                dotsCollide(seen.localX, seen.localY, remote.x, remote.y)) {
+                listener.onHit(SERVER_PLAYER_ID, id);
+                hit = true;
+            }
+        }
+        return hit;
+    }
+
+    ///////////////////////////////////////////////////////////
+    // Check every pair of dots on the field, ours and the
+    // tracked client dots past their grace period. Any two
+    // touching ends the round. Our dot (which moved from fromX,
+    // fromY this step) is also checked against each client dot
+    // along both paths since the last check, so neither can
+    // pass through the other between steps. Returns true on a
+    // hit.
+    ///////////////////////////////////////////////////////////
+    bool checkCollisions(int fromX, int fromY) {
+        bool hit = false;
+        grid.clear();
+        grid.insert(SERVER_PLAYER_ID, game.local.x, game.local.y);
+        for (int slot = 0; slot < MAX_CLIENTS; slot++) {
+            ServerPlayer &player = players[slot];
+            if (!player.connected || !player.valid) continue;
+            int lastX = player.lastX, lastY = player.lastY;
+            player.lastX = player.x;
+            player.lastY = player.y;
+            if (game.elapsedMs - player.sinceMs <= COLLISION_GRACE_MS) continue;
+
+            grid.insert(playerIdForSlot(slot), player.x, player.y);
+            if (!hit && playersCollideSwept(fromX, fromY, game.local.x, game.local.y,
+                                            lastX, lastY, player.x, player.y)) {
+                listener.onHit(SERVER_PLAYER_ID, playerIdForSlot(slot));
+                hit = true;
+            }
+        }
+        return hit || grid.forEachPair(HitReport(listener));
+    }
+
+    // After a simulate tick (events from step()): keep where our dot was for rewinds
+    void simulated(uint32_t nowMs, uint8_t events) {
+        history.record(nowMs, game);
+        if (events & STEP_WARPED) pendingFlags |= PACKET_FLAG_WARPED;
+    }
+
+    ///////////////////////////////////////////////////////////
+    // Everyone's position to every client in one WORLD frame,
+    // if something moved or a keyframe is due. Clients get the
+    // latest position received from each other, and smooth it
+    // themselves. True if it went out.
+    ///////////////////////////////////////////////////////////
+    bool broadcastWorld(uint32_t nowMs) {
+        WorldState world;
+        clearWorld(world);
+        addWorldEntry(world, SERVER_PLAYER_ID, game.local.x, game.local.y, pendingFlags);
+        pendingFlags = 0;
+        for (int slot = 0; slot < MAX_CLIENTS; slot++) {
+            const ServerPlayer &player = players[slot];
+            if (!player.connected || player.seen.positionCount == 0) continue;
+            addWorldEntry(world, playerIdForSlot(slot), player.seen.x, player.seen.y, player.worldFlags);
+        }
+        if (!worldEncoder.encode(txSeq, world, nowMs)) return false;
+        txSeq++;
+
+        uint8_t frame[WORLD_PACKET_MAX_SIZE];
+        size_t length = encodeWorld(world, frame);
+        for (int slot = 0; slot < MAX_CLIENTS; slot++) {
+            notifyPlayer(slot, frame, length);
+            players[slot].worldFlags = 0;
+        }
+        return true;
+    }
+
+    // Forget the last round's tracks (the caller resets the game)
+    void newRound() {
+        over = false;
+        pendingFlags = 0;
+        worldEncoder.reset();
+        for (int slot = 0; slot < MAX_CLIENTS; slot++) {
+            ServerPlayer &player = players[slot];
+            player.track.reset();
+            player.valid = false;
+            player.worldFlags = 0;
+        }
+        history.clear();
+    }
+
+    // Tell the clients to start the new round too
+    void sendStart() {
+        broadcastPacket(makeConnectedPacket(txSeq++));
+    }
+
+    // End the round, with every client told our final time
+    void gameOver() {
+        over = true;
+        game.gameOver = true;
+        broadcastPacket(makeGameOverPacket(txSeq++, game.elapsedMs));
+    }
+
+    bool roundActive() const {
+        return active;
+    }
+
+    bool isGameOver() const {
+        return over;
+    }
+
+    const ServerPlayer &player(int slot) const {
+        return players[slot];
+    }
+
+private:
+    struct HitReport {
+        HitReport(ServerSessionListener &listener) : listener(listener) {}
+        bool operator()(uint16_t a, uint16_t b) const {
+            listener.onHit((uint8_t)a, (uint8_t)b);
+            return true;
+        }
+        ServerSessionListener &listener;
+    };
+
+    // Forget a slot's previous occupant
+    void resetPlayer(ServerPlayer &player) {
+        player.connected = false;
+        player.welcomed = false;
+        player.seen = RemoteState();
+        player.track.reset();
+        player.valid = false;
+        player.sinceMs = 0;
+        player.x = player.y = -1;
+        player.lastX = player.lastY = -1;
+        player.worldFlags = 0;
+    }
+
+    // Notifications go to each connection separately, and only to
+    // ones that subscribed and whose MTU fits the frame
+    bool notifyPlayer(int slot, const uint8_t *frame, size_t length) {
+        PlayerView view;
+        table.read(slot, view);
+        if (!view.connected || !view.subscribed || !fitsMtu(length, view.mtu)) return false;
+        return transport.send(view.connId, frame, length);
+    }
+
+    void notifyPacket(int slot, const GamePacket &packet) {
+        uint8_t frame[GAME_PACKET_SIZE];
+        notifyPlayer(slot, frame, encodePacket(packet, frame));
+    }
+
+    // The same packet to every client (CONNECTED carries each one's own id)
+    void broadcastPacket(const GamePacket &packet) {
+        for (int slot = 0; slot < MAX_CLIENTS; slot++) {
+            GamePacket copy = packet;
+            if (copy.type == PACKET_TYPE_CONNECTED) copy.x = playerIdForSlot(slot);
+            notifyPacket(slot, copy);
+        }
+    }
+
+    PlayerTable &table;
+    GameState &game;
+    Transport &transport;
+    ServerSessionListener &listener;
+    uint32_t remoteDelayMs;
+    ServerPlayer players[MAX_CLIENTS];
+    PositionHistory history;                 // Our dot, for rewinds
+    SpatialGrid<WORLD_MAX_PLAYERS> grid;     // Every dot on the field, rebuilt each step
+    WorldEncoder worldEncoder;
+    uint8_t txSeq;
+    bool active;        // A round was started for the players connected now
+    bool over;
+    uint8_t pendingFlags;  // PACKET_FLAG_* for our next world entry
+};
+
+#endif
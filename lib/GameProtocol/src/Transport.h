@@ -0,0 +1,185 @@
+#ifndef TRANSPORT_H
+#define TRANSPORT_H
+
+#include "WorldState.h"
+#include <GameCore.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+///////////////////////////////////////////////////////////////
+// The link between the server and its clients, minus the radio.
+//
+// A Transport carries whole frames (GamePacket and WORLD frames)
+// between the server and each of its clients. On the server,
+// send() notifies one client; on a client it writes to the
+// server, which is always link CLIENT_SERVER_LINK. Whatever the
+// link does comes back through a TransportListener:
+//   onConnect / onDisconnect   the link came up or went away
+//   onSubscribe                the client turned notifications on/off
+//   onMtu                      the link's MTU changed
+//   onReceive                  a frame arrived
+//   onSent                     an earlier send() left, room for the next
+// Setting a link up (BLE connect + service discovery, a UDP
+// hello) is each backend's own business.
+//
+// BleTransport.h is the ESP32 backend, whose callbacks run on
+// the BLE task. UdpTransport.h is a host stand-in that calls
+// them from poll(), with a LinkConditioner adding latency,
+// jitter and loss to what it sends.
+///////////////////////////////////////////////////////////////
+const uint16_t CLIENT_SERVER_LINK = 0;
+const size_t TRANSPORT_FRAME_MAX_SIZE = WORLD_PACKET_MAX_SIZE;  // Largest frame either side sends
+
+class TransportListener {
+public:
+    virtual ~TransportListener() {}
+    virtual void onConnect(uint16_t link) {}
+    virtual void onDisconnect(uint16_t link) {}
+    virtual void onSubscribe(uint16_t link, bool subscribed) {}
+    virtual void onMtu(uint16_t link, uint16_t mtu) {}
+    virtual void onReceive(uint16_t link, const uint8_t *data, size_t length) = 0;
+    virtual void onSent(uint16_t link) {}
+};
+
+class Transport {
+public:
+    Transport() : listener(NULL) {}
+    virtual ~Transport() {}
+
+    void setListener(TransportListener *transportListener) {
+        listener = transportListener;
+    }
+
+    // False if the frame couldn't be queued (link down, stack busy)
+    virtual bool send(uint16_t link, const uint8_t *data, size_t length) = 0;
+    virtual void disconnect(uint16_t link) = 0;
+
+protected:
+    TransportListener *listener;
+};
+
+///////////////////////////////////////////////////////////////
+// A bad radio for the host backend.
+//
+// Every frame pushed is lost with probability lossPermille /
+// 1000, or held for latencyMs plus a uniform 0..jitterMs. Frames
+// leave in order unless reorder is set: BLE retransmits at the
+// link layer, so it delays frames but never swaps them. Loss and
+// jitter come from an xorshift seeded by the caller, so a run
+// can be repeated exactly.
+///////////////////////////////////////////////////////////////
+struct LinkImpairment {
+    uint16_t latencyMs;
+    uint16_t jitterMs;
+    uint16_t lossPermille;
+    bool reorder;
+};
+
+const LinkImpairment LINK_PERFECT = { 0, 0, 0, false };
+
+struct ConditionedFrame {
+    uint32_t dueMs;
+    uint16_t link;
+    uint8_t tag;      // The backend's own (e.g. a datagram kind)
+    uint8_t length;
+    uint8_t data[TRANSPORT_FRAME_MAX_SIZE];
+};
+
+// True if time a is before b, across the 32-bit wrap
+inline bool timeBefore(uint32_t a, uint32_t b) {
+    return (int32_t)(a - b) < 0;
+}
+
+template <int Capacity = 32>
+class LinkConditioner {
+public:
+    LinkConditioner(const LinkImpairment &impairment = LINK_PERFECT, uint32_t seed = 1)
+        : impairment(impairment), count(0), lastDueMs(0), passed(0), lost(0), overflowed(0) {
+        setSeed(seed);
+    }
+
+    void configure(const LinkImpairment &newImpairment) {
+        impairment = newImpairment;
+    }
+
+    void setSeed(uint32_t seed) {
+        rng = seed ? seed : 1;  // xorshift never leaves 0
+    }
+
+    const LinkImpairment &settings() const {
+        return impairment;
+    }
+
+    // False if there was no room for the frame. A frame lost on the
+    // way was still taken, like the radio sending it into the void.
+    bool push(uint32_t nowMs, uint16_t link, uint8_t tag, const uint8_t *data, size_t length) {
+        if (length > TRANSPORT_FRAME_MAX_SIZE || count == Capacity) {
+            overflowed++;
+            return false;
+        }
+        if (impairment.lossPermille > 0 && nextRandom(rng) % 1000 < impairment.lossPermille) {
+            lost++;
+            return true;
+        }
+
+        uint32_t dueMs = nowMs + impairment.latencyMs;
+        if (impairment.jitterMs > 0) dueMs += nextRandom(rng) % (impairment.jitterMs + 1U);
+        if (!impairment.reorder && count > 0 && timeBefore(dueMs, lastDueMs)) dueMs = lastDueMs;
+        lastDueMs = dueMs;
+
+        ConditionedFrame &frame = frames[count++];
+        frame.dueMs = dueMs;
+        frame.link = link;
+        frame.tag = tag;
+        frame.length = (uint8_t)length;
+        memcpy(frame.data, data, length);
+        return true;
+    }
+
+    // The earliest frame due by nowMs (the first pushed on a tie)
+    bool pop(uint32_t nowMs, ConditionedFrame &frame) {
+        if (count == 0) return false;
+        int next = 0;
+        for (int i = 1; i < count; i++) {
+            if (timeBefore(frames[i].dueMs, frames[next].dueMs)) next = i;
+        }
+        if (timeBefore(nowMs, frames[next].dueMs)) return false;
+
+        frame = frames[next];
+        for (int i = next + 1; i < count; i++) frames[i - 1] = frames[i];
+        count--;
+        passed++;
+        return true;
+    }
+
+    void clear() {
+        count = 0;
+    }
+
+    int pending() const {
+        return count;
+    }
+
+    uint32_t passedCount() const {
+        return passed;
+    }
+
+    uint32_t lostCount() const {
+        return lost;
+    }
+
+    uint32_t overflowCount() const {
+        return overflowed;
+    }
+
+private:
+    LinkImpairment impairment;
+    uint32_t rng;
+    ConditionedFrame frames[Capacity];  // In push order
+    int count;
+    uint32_t lastDueMs;
+    uint32_t passed, lost, overflowed;
+};
+
+#endif
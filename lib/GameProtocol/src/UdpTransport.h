@@ -0,0 +1,375 @@
+#ifndef UDP_TRANSPORT_H
+#define UDP_TRANSPORT_H
+
+#include "LinkProfile.h"
+#include "Transport.h"
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+///////////////////////////////////////////////////////////////
+// Host stand-in for the BLE link, over UDP (POSIX sockets).
+//
+// One side listen()s like the BLE server, the others connect()
+// like clients. Each datagram is a kind byte then, for DATA, one
+// frame:
+//   HELLO      client -> server, every helloRetryMs until WELCOME
+//   WELCOME    server -> client: the link is up
+//   DATA       a frame (a notification or a write)
+//   KEEPALIVE  sent after timeoutMs / 4 of nothing else
+//   BYE        the link is being closed
+// A link that hears nothing for timeoutMs is dropped, like a
+// BLE supervision timeout. A client whose link drops goes back
+// to saying HELLO, so it rejoins once the server is back, until
+// it disconnect()s or close()s.
+//
+// The server reports a new link as connected, at LINK_MTU (the
+// size the client asks for over BLE) and subscribed, so the
+// listener sees what it would once a BLE client is ready to play.
+//
+// Nothing happens outside poll(): the listener is called from
+// it, frames sent since the last poll() leave through the
+// LinkConditioner stamped with that poll's time, and onSent()
+// reports them at the next one. Everything runs on the caller's
+// thread and never blocks.
+///////////////////////////////////////////////////////////////
+enum UdpDatagramKind {
+    UDP_HELLO = 1,
+    UDP_WELCOME,
+    UDP_DATA,
+    UDP_KEEPALIVE,
+    UDP_BYE,
+};
+
+const size_t UDP_DATAGRAM_MAX_SIZE = 1 + TRANSPORT_FRAME_MAX_SIZE;
+
+template <int MaxPeers = 8, int Backlog = 64>
+class UdpTransport : public Transport {
+public:
+    UdpTransport(uint32_t timeoutMs = 2000, uint32_t helloRetryMs = 250)
+        : timeoutMs(timeoutMs), helloRetryMs(helloRetryMs), fd(-1), server(false), nextLink(1),
+          nowMs(0), framesSent(0), framesReceived(0), badDatagrams(0) {
+        for (int i = 0; i < MaxPeers; i++) peers[i].used = false;
+    }
+
+    ~UdpTransport() {
+        close();
+    }
+
+    // Latency, jitter and loss on everything this side sends
+    void setImpairment(const LinkImpairment &impairment, uint32_t seed = 1) {
+        conditioner.configure(impairment);
+        conditioner.setSeed(seed);
+    }
+
+    // Server: take clients on port (0 picks a free one, see localPort())
+    bool listen(uint16_t port) {
+        if (!open(port)) return false;
+        server = true;
+        return true;
+    }
+
+    // Client: keep saying HELLO to host:port until the server answers
+    bool connect(const char *host, uint16_t port) {
+        sockaddr_in address;
+        if (!resolve(host, port, address) || !open(0)) return false;
+        server = false;
+        Peer &peer = peers[0];
+        peer.used = true;
+        peer.up = false;
+        peer.link = CLIENT_SERVER_LINK;
+        peer.address = address;
+        peer.lastHeardMs = peer.lastSentMs = nowMs;
+        peer.unsent = 0;
+        sendControl(peer, UDP_HELLO);
+        return true;
+    }
+
+    void close() {
+        if (fd < 0) return;
+        for (int i = 0; i < MaxPeers; i++) {
+            if (peers[i].used && peers[i].up) sendControl(peers[i], UDP_BYE);
+            peers[i].used = false;
+        }
+        conditioner.clear();
+        ::close(fd);
+        fd = -1;
+    }
+
+    uint16_t localPort() const {
+        sockaddr_in address;
+        socklen_t length = sizeof(address);
+        if (fd < 0 || getsockname(fd, (sockaddr *)&address, &length) != 0) return 0;
+        return ntohs(address.sin_port);
+    }
+
+    bool connected(uint16_t link) const {
+        const Peer *peer = findLink(link);
+        return peer && peer->up;
+    }
+
+    bool send(uint16_t link, const uint8_t *data, size_t length) {
+        Peer *peer = findLink(link);
+        if (!peer || !peer->up || length > TRANSPORT_FRAME_MAX_SIZE) return false;
+        if (!queue(*peer, UDP_DATA, data, length)) return false;
+        peer->unsent++;
+        return true;
+    }
+
+    void disconnect(uint16_t link) {
+        Peer *peer = findLink(link);
+        if (!peer) return;
+        if (peer->up) sendControl(*peer, UDP_BYE);
+        drop(*peer);
+        peer->used = false;  // A client stops saying HELLO too
+    }
+
+    ///////////////////////////////////////////////////////////
+    // Send what's due, read what arrived, time out quiet links
+    ///////////////////////////////////////////////////////////
+    void poll(uint32_t now) {
+        nowMs = now;
+        if (fd < 0) return;
+
+        ConditionedFrame frame;
+        while (conditioner.pop(nowMs, frame)) {
+            Peer *peer = findLink(frame.link);
+            if (peer) transmit(*peer, frame.tag, frame.data, frame.length);
+        }
+
+        uint8_t datagram[UDP_DATAGRAM_MAX_SIZE + 1];  // One spare byte shows up oversized datagrams
+        for (;;) {
+            sockaddr_in from;
+            socklen_t fromLength = sizeof(from);
+            ssize_t got = recvfrom(fd, datagram, sizeof(datagram), 0, (sockaddr *)&from, &fromLength);
+            if (got < 0) break;
+            if (got == 0 || (size_t)got > UDP_DATAGRAM_MAX_SIZE) {
+                badDatagrams++;
+                continue;
+            }
+            if (server) {
+                serverReceive(from, datagram[0], datagram + 1, got - 1);
+            } else {
+                clientReceive(from, datagram[0], datagram + 1, got - 1);
+            }
+        }
+
+        for (int i = 0; i < MaxPeers; i++) {
+            Peer &peer = peers[i];
+            if (!peer.used) continue;
+            if (!peer.up) {
+                if (!server && nowMs - peer.lastSentMs >= helloRetryMs) sendControl(peer, UDP_HELLO);
+                continue;
+            }
+            if (nowMs - peer.lastHeardMs > timeoutMs) {
+                drop(peer);
+                continue;
+            }
+            // The stack has taken what was sent since the last poll
+            uint32_t sent = peer.unsent;
+            peer.unsent = 0;
+            for (; sent > 0 && peer.up; sent--) {
+                if (listener) listener->onSent(peer.link);
+            }
+            if (peer.used && peer.up && nowMs - peer.lastSentMs >= timeoutMs / 4) sendControl(peer, UDP_KEEPALIVE);
+        }
+    }
+
+    const LinkConditioner<Backlog> &linkConditioner() const {
+        return conditioner;
+    }
+
+    uint32_t sentCount() const {
+        return framesSent;
+    }
+
+    uint32_t receivedCount() const {
+        return framesReceived;
+    }
+
+    uint32_t badCount() const {
+        return badDatagrams;
+    }
+
+private:
+    struct Peer {
+        bool used;
+        bool up;
+        uint16_t link;
+        sockaddr_in address;
+        uint32_t lastHeardMs;
+        uint32_t lastSentMs;
+        uint32_t unsent;  // DATA sent since the last poll()
+    };
+
+    bool open(uint16_t port) {
+        close();
+        fd = socket(AF_INET, SOCK_DGRAM, 0);
+        if (fd < 0) return false;
+        sockaddr_in address;
+        memset(&address, 0, sizeof(address));
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = htonl(INADDR_ANY);
+        address.sin_port = htons(port);
+        if (bind(fd, (sockaddr *)&address, sizeof(address)) != 0 ||
+            fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK) != 0) {
+            ::close(fd);
+            fd = -1;
+            return false;
+        }
+        return true;
+    }
+
+    static bool resolve(const char *host, uint16_t port, sockaddr_in &address) {
+        addrinfo hints;
+        memset(&hints, 0, sizeof(hints));
+        hints.ai_family = AF_INET;
+        hints.ai_socktype = SOCK_DGRAM;
+        addrinfo *result = NULL;
+        if (getaddrinfo(host, NULL, &hints, &result) != 0 || !result) return false;
+        address = *(sockaddr_in *)result->ai_addr;
+        address.sin_port = htons(port);
+        freeaddrinfo(result);
+        return true;
+    }
+
+    static bool sameAddress(const sockaddr_in &a, const sockaddr_in &b) {
+        return a.sin_addr.s_addr == b.sin_addr.s_addr && a.sin_port == b.sin_port;
+    }
+
+    Peer *findLink(uint16_t link) {
+        for (int i = 0; i < MaxPeers; i++) {
+            if (peers[i].used && peers[i].link == link) return &peers[i];
+        }
+        return NULL;
+    }
+
+    const Peer *findLink(uint16_t link) const {
+        return const_cast<UdpTransport *>(this)->findLink(link);
+    }
+
+    Peer *findAddress(const sockaddr_in &address) {
+        for (int i = 0; i < MaxPeers; i++) {
+            if (peers[i].used && sameAddress(peers[i].address, address)) return &peers[i];
+        }
+        return NULL;
+    }
+
+    // Through the conditioner, leaves at a later poll()
+    bool queue(Peer &peer, uint8_t kind, const uint8_t *data, size_t length) {
+        peer.lastSentMs = nowMs;
+        return conditioner.push(nowMs, peer.link, kind, data, length);
+    }
+
+    void sendControl(Peer &peer, uint8_t kind) {
+        if (kind == UDP_BYE) {
+            transmit(peer, kind, NULL, 0);  // The peer may be gone by the next poll()
+            return;
+        }
+        queue(peer, kind, NULL, 0);
+    }
+
+    void transmit(const Peer &peer, uint8_t kind, const uint8_t *data, size_t length) {
+        uint8_t datagram[UDP_DATAGRAM_MAX_SIZE];
+        datagram[0] = kind;
+        if (length > 0) memcpy(datagram + 1, data, length);
+        sendto(fd, datagram, 1 + length, 0, (const sockaddr *)&peer.address, sizeof(peer.address));
+        if (kind == UDP_DATA) framesSent++;
+    }
+
+    // Forget the link; a client goes back to saying HELLO
+    void drop(Peer &peer) {
+        bool wasUp = peer.up;
+        uint16_t link = peer.link;
+        peer.up = false;
+        peer.unsent = 0;
+        if (server) peer.used = false;
+        if (wasUp && listener) listener->onDisconnect(link);
+    }
+
+    void serverReceive(const sockaddr_in &from, uint8_t kind, const uint8_t *data, size_t length) {
+        Peer *peer = findAddress(from);
+        if (!peer) {
+            if (kind == UDP_HELLO) {
+                accept(from);
+            } else if (kind != UDP_BYE) {
+                // A client from before we restarted: make it say HELLO again
+                Peer stranger = Peer();
+                stranger.address = from;
+                transmit(stranger, UDP_BYE, NULL, 0);
+            }
+            return;
+        }
+
+        peer->lastHeardMs = nowMs;
+        switch (kind) {
+        case UDP_HELLO: sendControl(*peer, UDP_WELCOME); break;  // Our WELCOME got lost
+        case UDP_DATA: deliver(*peer, data, length); break;
+        case UDP_KEEPALIVE: break;
+        case UDP_BYE: drop(*peer); break;
+        default: badDatagrams++; break;
+        }
+    }
+
+    void accept(const sockaddr_in &from) {
+        int free = 0;
+        while (free < MaxPeers && peers[free].used) free++;
+        if (free == MaxPeers) return;  // It keeps saying HELLO until a peer leaves
+
+        Peer &peer = peers[free];
+        peer.used = true;
+        peer.up = true;
+        peer.link = nextLink++;
+        if (nextLink == CLIENT_SERVER_LINK) nextLink++;
+        peer.address = from;
+        peer.lastHeardMs = nowMs;
+        peer.unsent = 0;
+        sendControl(peer, UDP_WELCOME);
+
+        // The listener may disconnect() the link from any of these
+        uint16_t link = peer.link;
+        if (listener) listener->onConnect(link);
+        if (listener && connected(link)) listener->onMtu(link, LINK_MTU);
+        if (listener && connected(link)) listener->onSubscribe(link, true);
+    }
+
+    void clientReceive(const sockaddr_in &from, uint8_t kind, const uint8_t *data, size_t length) {
+        Peer &peer = peers[0];
+        if (!peer.used || !sameAddress(peer.address, from)) return;
+        peer.lastHeardMs = nowMs;
+        switch (kind) {
+        case UDP_WELCOME:
+            if (peer.up) break;
+            peer.up = true;
+            if (listener) listener->onConnect(peer.link);
+            if (listener && peer.up) listener->onMtu(peer.link, LINK_MTU);
+            break;
+        case UDP_DATA:
+            if (peer.up) deliver(peer, data, length);
+            break;
+        case UDP_KEEPALIVE: break;
+        case UDP_BYE: drop(peer); break;
+        default: badDatagrams++; break;
+        }
+    }
+
+    void deliver(const Peer &peer, const uint8_t *data, size_t length) {
+        framesReceived++;
+        if (listener) listener->onReceive(peer.link, data, length);
+    }
+
+    uint32_t timeoutMs;
+    uint32_t helloRetryMs;
+    int fd;
+    bool server;
+    uint16_t nextLink;
+    uint32_t nowMs;  // Of the last poll()
+    Peer peers[MaxPeers];
+    LinkConditioner<Backlog> conditioner;
+    uint32_t framesSent, framesReceived, badDatagrams;
+};
+
+#endif
@@ -0,0 +1,195 @@
+#ifndef WORLD_STATE_H
+#define WORLD_STATE_H
+
+#include "GameProtocol.h"
+
+///////////////////////////////////////////////////////////////
+// Aggregated world state: every player's position in one frame.
+//
+// With several clients connected, the server sends one WORLD
+// frame per network tick instead of one notify per player:
+//
+//   byte 0     type   (PACKET_TYPE_WORLD)
+//   byte 1     seq
+//   byte 2..3  time   (server's millis() when sent, low 16 bits)
+//   byte 4     count  (entries that follow, <= WORLD_MAX_PLAYERS)
+//   then count entries of 6 bytes:
+//     byte 0     id     (SERVER_PLAYER_ID or a client's id)
+//     byte 1..2  x      (uint16)
+//     byte 3..4  y      (uint16)
+//     byte 5     flags  (PACKET_FLAG_*)
+//
+// A full frame is 29 bytes, so clients need the larger MTU
+// (LINK_MTU) before they can receive it.
+//
+// WorldEncoder is the change-only filter, like PositionEncoder:
+// nothing goes out while nobody moves (after one last frame
+// confirming everyone stopped), and a frame goes out every
+// keyframeMs regardless so a receiver that missed one recovers.
+///////////////////////////////////////////////////////////////
+const int WORLD_MAX_PLAYERS = 4;  // The server's dot + MAX_CLIENTS, one per render dot
+const size_t WORLD_HEADER_SIZE = 5;
+const size_t WORLD_ENTRY_SIZE = 6;
+const size_t WORLD_PACKET_MAX_SIZE = WORLD_HEADER_SIZE + WORLD_MAX_PLAYERS * WORLD_ENTRY_SIZE;
+
+const uint8_t SERVER_PLAYER_ID = 0;  // Clients are 1..MAX_CLIENTS
+
+struct WorldEntry {
+    uint8_t id;
+    uint16_t x;
+    uint16_t y;
+    uint8_t flags;
+};
+
+struct WorldState {
+    uint8_t seq;
+    uint16_t timeMs;
+    uint8_t count;
+    WorldEntry entries[WORLD_MAX_PLAYERS];
+};
+
+inline void clearWorld(WorldState &world) {
+    world.seq = 0;
+    world.timeMs = 0;
+    world.count = 0;
+}
+
+// Returns false if the world is already full
+inline bool addWorldEntry(WorldState &world, uint8_t id, uint16_t x, uint16_t y, uint8_t flags = 0) {
+    if (world.count >= WORLD_MAX_PLAYERS) return false;
+    WorldEntry &entry = world.entries[world.count++];
+    entry.id = id;
+    entry.x = x;
+    entry.y = y;
+    entry.flags = flags;
+    return true;
+}
+
+// The entry for player id, or NULL
+inline const WorldEntry *findWorldEntry(const WorldState &world, uint8_t id) {
+    for (int i = 0; i < world.count; i++) {
+        if (world.entries[i].id == id) return &world.entries[i];
+    }
+    return NULL;
+}
+
+///////////////////////////////////////////////////////////////
+// Encode into buf (must hold WORLD_PACKET_MAX_SIZE bytes).
+// Returns the number of bytes written.
+///////////////////////////////////////////////////////////////
+inline size_t encodeWorld(const WorldState &world, uint8_t *buf) {
+    uint8_t count = world.count > WORLD_MAX_PLAYERS ? WORLD_MAX_PLAYERS : world.count;
+    buf[0] = PACKET_TYPE_WORLD;
+    buf[1] = world.seq;
+    putU16(buf + 2, world.timeMs);
+    buf[4] = count;
+
+    uint8_t *out = buf + WORLD_HEADER_SIZE;
+    for (int i = 0; i < count; i++, out += WORLD_ENTRY_SIZE) {
+        const WorldEntry &entry = world.entries[i];
+        out[0] = entry.id;
+        putU16(out + 1, entry.x);
+        putU16(out + 3, entry.y);
+        out[5] = entry.flags;
+    }
+    return WORLD_HEADER_SIZE + count * WORLD_ENTRY_SIZE;
+}
+
+///////////////////////////////////////////////////////////////
+// Decode and validate a WORLD frame. Returns false for other
+// types, a length that doesn't match the count, too many
+// entries or off-screen positions; world is left untouched.
+///////////////////////////////////////////////////////////////
+inline bool decodeWorld(const uint8_t *buf, size_t length, WorldState &world) {
+    if (buf == NULL || length < WORLD_HEADER_SIZE || buf[0] != PACKET_TYPE_WORLD) return false;
+    uint8_t count = buf[4];
+    if (count > WORLD_MAX_PLAYERS || length != WORLD_HEADER_SIZE + count * WORLD_ENTRY_SIZE) return false;
+
+    WorldState decoded;
+    decoded.seq = buf[1];
+    decoded.timeMs = getU16(buf + 2);
+    decoded.count = count;
+
+    const uint8_t *in = buf + WORLD_HEADER_SIZE;
+    for (int i = 0; i < count; i++, in += WORLD_ENTRY_SIZE) {
+        WorldEntry &entry = decoded.entries[i];
+        entry.id = in[0];
+        entry.x = getU16(in + 1);
+        entry.y = getU16(in + 3);
+        entry.flags = in[5];
+        if (entry.x >= PACKET_MAX_X || entry.y >= PACKET_MAX_Y) return false;
+    }
+
+    world = decoded;
+    return true;
+}
+
+///////////////////////////////////////////////////////////////
+// Change-only filter for the per-tick world broadcast
+///////////////////////////////////////////////////////////////
+class WorldEncoder {
+public:
+    WorldEncoder(uint32_t keyframeMs = 1000) : keyframeMs(keyframeMs) {
+        reset();
+    }
+
+    // Next call sends (e.g. for a new round)
+    void reset() {
+        haveSent = false;
+        sentChange = false;
+        lastSentMs = 0;
+        clearWorld(last);
+    }
+
+    // Stamp world with seq and the time and return true if it should go
+    // out now. seq is only used (and should only be advanced) when it
+    // returns true.
+    bool encode(uint8_t seq, WorldState &world, uint32_t nowMs) {
+        bool changed = !haveSent || !samePositions(world, last);
+        if (!changed && !sentChange && nowMs - lastSentMs < keyframeMs) return false;
+
+        world.seq = seq;
+        world.timeMs = (uint16_t)nowMs;
+        haveSent = true;
+        sentChange = changed;
+        lastSentMs = nowMs;
+        last = world;
+        return true;
+    }
+
+private:
+    // Same players in the same places, and nobody warped
+    static bool samePositions(const WorldState &a, const WorldState &b) {
+        if (a.count != b.count) return false;
+        for (int i = 0; i < a.count; i++) {
+            const WorldEntry &ea = a.entries[i];
+            const WorldEntry &eb = b.entries[i];
+            if (ea.id != eb.id || ea.x != eb.x || ea.y != eb.y || ea.flags != 0) return false;
+        }
+        return true;
+    }
+
+    uint32_t keyframeMs;
+    bool haveSent;
+    bool sentChange;   // The last frame carried a move
+    uint32_t lastSentMs;
+    WorldState last;
+};
+
+///////////////////////////////////////////////////////////////
+// The latest WORLD frame received, published by the client's
+// BLE callback like RemoteState (see SeqlockCell.h)
+///////////////////////////////////////////////////////////////
+struct RemoteWorld {
+    uint32_t worldCount;  // WORLD frames received
+    uint32_t receivedMs;  // When the latest one arrived
+    WorldState world;
+};
+
+inline void applyWorld(RemoteWorld &state, const WorldState &world, uint32_t nowMs) {
+    state.worldCount++;
+    state.receivedMs = nowMs;
+    state.world = world;
+}
+
+#endif
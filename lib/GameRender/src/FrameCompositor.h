@@ -0,0 +1,146 @@
+#ifndef FRAME_COMPOSITOR_H
+#define FRAME_COMPOSITOR_H
+
+#include "GameRender.h"
+#include <stdlib.h>
+
+///////////////////////////////////////////////////////////////
+// Off-screen compositing mode.
+//
+// FrameCompositor draws a complete frame (dots + HUD, or the
+// game over screen) into a FrameSurface, which is then flushed
+// to the LCD in one go. On the Core2 the surface is a sprite
+// (M5SpriteSurface.h) flushed with DMA; on the host it's a
+// plain RGB565 MemorySurface.
+///////////////////////////////////////////////////////////////
+
+// A full-screen buffer that can be pushed to the display
+class FrameSurface : public DrawSurface {
+public:
+    // Start sending the composed frame to the display. May return
+    // before the transfer is done; drawing into the surface again
+    // is only safe after waitForFlush().
+    virtual void flush() = 0;
+
+    // Block until the last flush() has finished
+    virtual void waitForFlush() {}
+};
+
+///////////////////////////////////////////////////////////////
+// RGB565 framebuffer in RAM. Text is drawn as solid 5x7 blocks
+// in each character cell: enough to measure compositing cost on
+// the host, not to read.
+///////////////////////////////////////////////////////////////
+class MemorySurface : public FrameSurface {
+public:
+    MemorySurface() : pixels(NULL), flushedBytes(0) {}
+
+    ~MemorySurface() {
+        free(pixels);
+    }
+
+    bool begin() {
+        if (!pixels) pixels = (uint16_t *)malloc(FIELD_WIDTH * FIELD_HEIGHT * sizeof(uint16_t));
+        return pixels != NULL;
+    }
+
+    void fillRect(int x, int y, int w, int h, uint16_t color) {
+        // Clip to the screen
+        if (x < 0) { w += x; x = 0; }
+        if (y < 0) { h += y; y = 0; }
+        if (x + w > FIELD_WIDTH) w = FIELD_WIDTH - x;
+        if (y + h > FIELD_HEIGHT) h = FIELD_HEIGHT - y;
+        if (w <= 0 || h <= 0) return;
+
+        for (int row = y; row < y + h; row++) {
+            uint16_t *line = pixels + row * FIELD_WIDTH + x;
+            for (int col = 0; col < w; col++) line[col] = color;
+        }
+    }
+
+    void drawText(int x, int y, const char *text, int length, uint8_t size,
+                  uint16_t color, uint16_t background) {
+        int cellWidth = FONT_CHAR_WIDTH * size;
+        for (int i = 0; i < length; i++) {
+            int cellX = x + i * cellWidth;
+            fillRect(cellX, y, cellWidth, FONT_CHAR_HEIGHT * size, background);
+            if (text[i] != ' ') fillRect(cellX, y, 5 * size, 7 * size, color);
+        }
+    }
+
+    void pushImage(int x, int y, int w, int h, const uint16_t *image) {
+        for (int row = 0; row < h; row++) {
+            if (y + row < 0 || y + row >= FIELD_HEIGHT) continue;
+            for (int col = 0; col < w; col++) {
+                if (x + col < 0 || x + col >= FIELD_WIDTH) continue;
+                pixels[(y + row) * FIELD_WIDTH + x + col] = image[row * w + col];
+            }
+        }
+    }
+
+    void flush() {
+        flushedBytes += FIELD_WIDTH * FIELD_HEIGHT * sizeof(uint16_t);
+    }
+
+    uint16_t pixelAt(int x, int y) const {
+        return pixels[y * FIELD_WIDTH + x];
+    }
+
+    uint16_t *pixels;
+    uint64_t flushedBytes;
+};
+
+///////////////////////////////////////////////////////////////
+// Composes whole frames into a FrameSurface
+///////////////////////////////////////////////////////////////
+class FrameCompositor {
+public:
+    FrameCompositor(FrameSurface &surface, uint16_t background = COLOR_BLACK,
+                    uint16_t textColor = COLOR_WHITE)
+        : surface(surface), background(background), textColor(textColor) {}
+
+    // Dots, then the HUD on top, like the immediate-mode sketches
+    void composeGame(const RenderFrame &frame) {
+        surface.waitForFlush();
+        surface.fillRect(0, 0, FIELD_WIDTH, FIELD_HEIGHT, background);
+
+        for (int i = 0; i < frame.dotCount; i++) {
+            const RenderDot &dot = frame.dots[i];
+            if (dot.visible) surface.fillRect(dot.x, dot.y, DOT_SIZE, DOT_SIZE, dot.color);
+        }
+
+        surface.drawText(frame.hudX, frame.hudY, frame.hud, (int)strlen(frame.hud),
+                         frame.hudSize, textColor, background);
+    }
+
+    void composeGameOver(uint32_t elapsedMs, bool showRestartHint) {
+        surface.waitForFlush();
+        surface.fillRect(0, 0, FIELD_WIDTH, FIELD_HEIGHT, COLOR_RED);
+
+        drawLine(50, 100, 3, "GAME OVER");
+
+        char text[32];
+        int length = formatText(text, "Time: ");
+        length += formatSeconds(text + length, elapsedMs);
+        length += formatText(text + length, " seconds");
+        text[length] = '\0';
+        drawLine(50, 150, 2, text);
+
+        if (showRestartHint) drawLine(20, 200, 1, "Press START to play again");
+    }
+
+    void flush() {
+        surface.flush();
+    }
+
+private:
+    void drawLine(int x, int y, uint8_t size, const char *text) {
+        surface.drawText(x, y, text, (int)strlen(text), size, COLOR_WHITE, COLOR_RED);
+    }
+
+    FrameSurface &surface;
+    uint16_t background;
+    uint16_t textColor;
+};
+
+#endif
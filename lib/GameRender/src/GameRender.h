@@ -0,0 +1,275 @@
+#ifndef GAME_RENDER_H
+#define GAME_RENDER_H
+
+#include <GameCore.h>
+#include "HudText.h"
+#include <stdint.h>
+#include <string.h>
+
+///////////////////////////////////////////////////////////////
+// Dirty-rectangle renderer for the dot game.
+//
+// Instead of fillScreen() + redraw every frame, the renderer
+// remembers what it drew last frame and only erases/redraws
+// the dots that moved and the HUD characters that changed
+// (digits come from a GlyphCache, see HudText.h).
+// It draws through DrawSurface so the same code runs against
+// M5.Lcd (see M5LcdSurface.h) or a pixel-counting mock.
+///////////////////////////////////////////////////////////////
+
+const int MAX_RENDER_DOTS = 4;
+
+// RGB565 colors used by the game (same values as the M5 BLACK/WHITE/RED/BLUE)
+const uint16_t COLOR_BLACK = 0x0000;
+const uint16_t COLOR_WHITE = 0xFFFF;
+const uint16_t COLOR_RED = 0xF800;
+const uint16_t COLOR_BLUE = 0x001F;
+const uint16_t COLOR_GREEN = 0x07E0;
+const uint16_t COLOR_YELLOW = 0xFFE0;
+
+// Dot color for each player id on the wire (0 = the server's red dot)
+const uint16_t PLAYER_COLORS[MAX_RENDER_DOTS] = { COLOR_RED, COLOR_BLUE, COLOR_GREEN, COLOR_YELLOW };
+
+inline uint16_t playerColor(uint8_t id) {
+    return id < MAX_RENDER_DOTS ? PLAYER_COLORS[id] : COLOR_WHITE;
+}
+
+struct Rect {
+    int x;
+    int y;
+    int w;
+    int h;
+};
+
+inline bool rectsOverlap(const Rect &a, const Rect &b) {
+    return a.x < b.x + b.w && b.x < a.x + a.w &&
+           a.y < b.y + b.h && b.y < a.y + a.h;
+}
+
+inline Rect textBounds(int x, int y, int length, uint8_t size) {
+    Rect bounds = { x, y, length * FONT_CHAR_WIDTH * size, FONT_CHAR_HEIGHT * size };
+    return bounds;
+}
+
+///////////////////////////////////////////////////////////////
+// Anything the renderer can draw on
+///////////////////////////////////////////////////////////////
+class DrawSurface {
+public:
+    virtual ~DrawSurface() {}
+
+    virtual void fillRect(int x, int y, int w, int h, uint16_t color) = 0;
+
+    // Draw length characters of text with an opaque background
+    virtual void drawText(int x, int y, const char *text, int length, uint8_t size,
+                          uint16_t color, uint16_t background) = 0;
+
+    // Copy a w x h block of RGB565 pixels (row-major) to x, y
+    virtual void pushImage(int x, int y, int w, int h, const uint16_t *pixels) = 0;
+};
+
+///////////////////////////////////////////////////////////////
+// What one frame should look like
+///////////////////////////////////////////////////////////////
+struct RenderDot {
+    int x;
+    int y;
+    uint16_t color;
+    bool visible;
+};
+
+struct RenderFrame {
+    RenderDot dots[MAX_RENDER_DOTS];
+    int dotCount;
+    char hud[HUD_MAX_CHARS + 1];
+    int hudX;
+    int hudY;
+    uint8_t hudSize;
+};
+
+///////////////////////////////////////////////////////////////
+// Build the frame for a two-player GameState: local dot first,
+// remote dot second (only once it has been received), and the
+// "Time: 1.23s  Speed: 1" HUD in the top-left corner.
+///////////////////////////////////////////////////////////////
+inline void buildGameFrame(const GameState &state, uint16_t localColor, uint16_t remoteColor,
+                           RenderFrame &frame) {
+    frame.dotCount = 2;
+    frame.dots[0].x = state.local.x;
+    frame.dots[0].y = state.local.y;
+    frame.dots[0].color = localColor;
+    frame.dots[0].visible = true;
+    frame.dots[1].x = state.remote.x;
+    frame.dots[1].y = state.remote.y;
+    frame.dots[1].color = remoteColor;
+    frame.dots[1].visible = state.remoteValid;
+
+    frame.hudX = 5;
+    frame.hudY = 5;
+    frame.hudSize = 1;
+    formatGameHud(frame.hud, state.elapsedMs, state.local.speed);
+}
+
+///////////////////////////////////////////////////////////////
+// Fill in dot index of a frame (e.g. extra players after
+// buildGameFrame()), growing dotCount to cover it
+///////////////////////////////////////////////////////////////
+inline void setFrameDot(RenderFrame &frame, int index, int x, int y, uint16_t color, bool visible) {
+    if (index < 0 || index >= MAX_RENDER_DOTS) return;
+    RenderDot &dot = frame.dots[index];
+    dot.x = x;
+    dot.y = y;
+    dot.color = color;
+    dot.visible = visible;
+    if (frame.dotCount <= index) frame.dotCount = index + 1;
+}
+
+///////////////////////////////////////////////////////////////
+// Renderer
+///////////////////////////////////////////////////////////////
+class DirtyRenderer {
+public:
+    DirtyRenderer(DrawSurface &surface, uint16_t background = COLOR_BLACK,
+                  uint16_t textColor = COLOR_WHITE)
+        : surface(surface), background(background), textColor(textColor), fullRedraw(true),
+          lastDotCount(0), lastHudX(0), lastHudY(0), lastHudSize(0) {
+        lastHud[0] = '\0';
+    }
+
+    // Repaint everything on the next render() (after the screen was drawn over)
+    void invalidate() {
+        fullRedraw = true;
+    }
+
+    const GlyphCache &glyphCache() const {
+        return glyphs;
+    }
+
+    void render(const RenderFrame &frame) {
+        if (fullRedraw) {
+            surface.fillRect(0, 0, FIELD_WIDTH, FIELD_HEIGHT, background);
+            lastDotCount = 0;
+            lastHud[0] = '\0';
+            fullRedraw = false;
+        }
+
+        int lastHudLength = (int)strlen(lastHud);
+        int hudLength = (int)strlen(frame.hud);
+        Rect hudRect = textBounds(frame.hudX, frame.hudY,
+                                  hudLength > lastHudLength ? hudLength : lastHudLength,
+                                  frame.hudSize);
+        bool hudDamaged = frame.hudX != lastHudX || frame.hudY != lastHudY ||
+                          frame.hudSize != lastHudSize;
+
+        // Erase every dot that moved, changed or disappeared
+        Rect erased[MAX_RENDER_DOTS];
+        int erasedCount = 0;
+        for (int i = 0; i < lastDotCount; i++) {
+            const RenderDot &last = lastDots[i];
+            if (!last.visible) continue;
+            if (i < frame.dotCount && sameDot(last, frame.dots[i])) continue;
+
+            Rect rect = dotRect(last);
+            surface.fillRect(rect.x, rect.y, rect.w, rect.h, background);
+            erased[erasedCount++] = rect;
+            if (rectsOverlap(rect, hudRect)) hudDamaged = true;
+        }
+
+        // Draw every dot that is new, moved, or was clipped by an erase or
+        // by a dot below it (lower index) being drawn over it
+        Rect drawn[MAX_RENDER_DOTS];
+        int drawnCount = 0;
+        for (int i = 0; i < frame.dotCount; i++) {
+            const RenderDot &dot = frame.dots[i];
+            if (!dot.visible) continue;
+
+            Rect rect = dotRect(dot);
+            bool redraw = i >= lastDotCount || !sameDot(lastDots[i], dot);
+            for (int e = 0; e < erasedCount && !redraw; e++) {
+                redraw = rectsOverlap(rect, erased[e]);
+            }
+            for (int d = 0; d < drawnCount && !redraw; d++) {
+                redraw = rectsOverlap(rect, drawn[d]);
+            }
+            if (!redraw) continue;
+
+            surface.fillRect(rect.x, rect.y, rect.w, rect.h, dot.color);
+            drawn[drawnCount++] = rect;
+            if (rectsOverlap(rect, hudRect)) hudDamaged = true;
+        }
+
+        // HUD goes on top, like the original printf after the dots
+        drawHud(frame, hudLength, lastHudLength, hudDamaged);
+
+        // Remember this frame for the next diff
+        lastDotCount = frame.dotCount;
+        for (int i = 0; i < frame.dotCount; i++) lastDots[i] = frame.dots[i];
+        memcpy(lastHud, frame.hud, hudLength + 1);
+        lastHudX = frame.hudX;
+        lastHudY = frame.hudY;
+        lastHudSize = frame.hudSize;
+    }
+
+private:
+    static Rect dotRect(const RenderDot &dot) {
+        Rect rect = { dot.x, dot.y, DOT_SIZE, DOT_SIZE };
+        return rect;
+    }
+
+    static bool sameDot(const RenderDot &a, const RenderDot &b) {
+        return a.visible == b.visible && a.x == b.x && a.y == b.y && a.color == b.color;
+    }
+
+    // Characters past the end of the text read as spaces so shorter text erases the tail
+    static char hudChar(const char *text, int length, int index) {
+        return index < length ? text[index] : ' ';
+    }
+
+    // Redraw the characters that changed (all of them if damaged): digits
+    // as cached glyph images, runs of anything else through drawText()
+    void drawHud(const RenderFrame &frame, int hudLength, int lastHudLength, bool damaged) {
+        int length = hudLength > lastHudLength ? hudLength : lastHudLength;
+        int cellWidth = FONT_CHAR_WIDTH * frame.hudSize;
+        int i = 0;
+        while (i < length) {
+            char c = hudChar(frame.hud, hudLength, i);
+            if (!damaged && c == hudChar(lastHud, lastHudLength, i)) {
+                i++;
+                continue;
+            }
+
+            int x = frame.hudX + i * cellWidth;
+            if (GlyphCache::cacheable(c, frame.hudSize)) {
+                const uint16_t *pixels = glyphs.glyph(c, frame.hudSize, textColor, background);
+                surface.pushImage(x, frame.hudY, cellWidth, FONT_CHAR_HEIGHT * frame.hudSize, pixels);
+                i++;
+                continue;
+            }
+
+            char span[HUD_MAX_CHARS + 1];
+            int count = 0;
+            do {
+                span[count++] = c;
+                if (++i >= length) break;
+                c = hudChar(frame.hud, hudLength, i);
+            } while ((damaged || c != hudChar(lastHud, lastHudLength, i)) &&
+                     !GlyphCache::cacheable(c, frame.hudSize));
+            surface.drawText(x, frame.hudY, span, count, frame.hudSize, textColor, background);
+        }
+    }
+
+    DrawSurface &surface;
+    uint16_t background;
+    uint16_t textColor;
+    bool fullRedraw;
+
+    RenderDot lastDots[MAX_RENDER_DOTS];
+    int lastDotCount;
+    char lastHud[HUD_MAX_CHARS + 1];
+    int lastHudX;
+    int lastHudY;
+    uint8_t lastHudSize;
+    GlyphCache glyphs;
+};
+
+#endif
@@ -0,0 +1,142 @@
+#ifndef HUD_TEXT_H
+#define HUD_TEXT_H
+
+#include <stdint.h>
+#include <string.h>
+
+///////////////////////////////////////////////////////////////
+// HUD text without printf.
+//
+// formatGameHud() builds "Time: 1.23s  Speed: 1" with integer
+// math, so there is no float formatting through vsnprintf on
+// every frame. GlyphCache keeps each digit rendered as RGB565
+// pixels the first time it is drawn, so the renderer can push a
+// changed digit as one image instead of having the LCD library
+// walk the font bits again.
+///////////////////////////////////////////////////////////////
+
+// Built-in GLCD font: 5x7 glyphs in a 6x8 cell, scaled by text size
+const int FONT_CHAR_WIDTH = 6;
+const int FONT_CHAR_HEIGHT = 8;
+
+const int HUD_MAX_CHARS = 31;
+
+// '0'..'9' from the GLCD font: 5 columns, bit 0 = top row
+const uint8_t DIGIT_FONT[10][5] = {
+    { 0x3E, 0x51, 0x49, 0x45, 0x3E },
+    { 0x00, 0x42, 0x7F, 0x40, 0x00 },
+    { 0x42, 0x61, 0x51, 0x49, 0x46 },
+    { 0x21, 0x41, 0x45, 0x4B, 0x31 },
+    { 0x18, 0x14, 0x12, 0x7F, 0x10 },
+    { 0x27, 0x45, 0x45, 0x45, 0x39 },
+    { 0x3C, 0x4A, 0x49, 0x49, 0x30 },
+    { 0x01, 0x71, 0x09, 0x05, 0x03 },
+    { 0x36, 0x49, 0x49, 0x49, 0x36 },
+    { 0x06, 0x49, 0x49, 0x29, 0x1E },
+};
+
+///////////////////////////////////////////////////////////////
+// Integer formatting. Each writes at out and returns the number
+// of characters written (no terminator).
+///////////////////////////////////////////////////////////////
+inline int formatUnsigned(char *out, uint32_t value) {
+    char digits[10];
+    int count = 0;
+    do {
+        digits[count++] = (char)('0' + value % 10);
+        value /= 10;
+    } while (value);
+    for (int i = 0; i < count; i++) out[i] = digits[count - 1 - i];
+    return count;
+}
+
+// Milliseconds as seconds with two decimals ("12.34"), like %.2f
+inline int formatSeconds(char *out, uint32_t ms) {
+    uint32_t hundredths = ms / 10 + (ms % 10 >= 5 ? 1 : 0);
+    int length = formatUnsigned(out, hundredths / 100);
+    out[length++] = '.';
+    out[length++] = (char)('0' + hundredths / 10 % 10);
+    out[length++] = (char)('0' + hundredths % 10);
+    return length;
+}
+
+inline int formatText(char *out, const char *text) {
+    int length = (int)strlen(text);
+    memcpy(out, text, length);
+    return length;
+}
+
+// "Time: 1.23s  Speed: 1" into out[HUD_MAX_CHARS + 1], cut short like snprintf
+inline void formatGameHud(char *out, uint32_t elapsedMs, int speed) {
+    char text[48];
+    int length = formatText(text, "Time: ");
+    length += formatSeconds(text + length, elapsedMs);
+    length += formatText(text + length, "s  Speed: ");
+    length += formatUnsigned(text + length, speed < 0 ? 0 : (uint32_t)speed);
+    if (length > HUD_MAX_CHARS) length = HUD_MAX_CHARS;
+    memcpy(out, text, length);
+    out[length] = '\0';
+}
+
+///////////////////////////////////////////////////////////////
+// Rendered digits for one text size and color pair. Changing
+// any of those drops the cache; each digit is rendered again
+// the next time it is asked for.
+///////////////////////////////////////////////////////////////
+const int GLYPH_CACHE_MAX_SIZE = 2;  // Larger text goes through drawText()
+const int GLYPH_CACHE_PIXELS = FONT_CHAR_WIDTH * FONT_CHAR_HEIGHT * GLYPH_CACHE_MAX_SIZE * GLYPH_CACHE_MAX_SIZE;
+
+class GlyphCache {
+public:
+    GlyphCache() : size(0), color(0), background(0), readyMask(0), renderCount(0) {}
+
+    static bool cacheable(char c, uint8_t size) {
+        return c >= '0' && c <= '9' && size >= 1 && size <= GLYPH_CACHE_MAX_SIZE;
+    }
+
+    // Pixels of a cacheable character, row-major, FONT_CHAR_WIDTH * size wide
+    const uint16_t *glyph(char c, uint8_t size, uint16_t color, uint16_t background) {
+        if (size != this->size || color != this->color || background != this->background) {
+            this->size = size;
+            this->color = color;
+            this->background = background;
+            readyMask = 0;
+        }
+
+        int index = c - '0';
+        if (!(readyMask & (1u << index))) {
+            render(index);
+            readyMask |= 1u << index;
+        }
+        return pixels[index];
+    }
+
+    // How many times a glyph has been rendered (not served from the cache)
+    uint32_t renders() const {
+        return renderCount;
+    }
+
+private:
+    void render(int index) {
+        int width = FONT_CHAR_WIDTH * size;
+        uint16_t *out = pixels[index];
+        for (int y = 0; y < FONT_CHAR_HEIGHT * size; y++) {
+            int row = y / size;
+            for (int x = 0; x < width; x++) {
+                int column = x / size;
+                bool on = column < 5 && (DIGIT_FONT[index][column] >> row & 1);
+                out[y * width + x] = on ? color : background;
+            }
+        }
+        renderCount++;
+    }
+
+    uint8_t size;
+    uint16_t color;
+    uint16_t background;
+    uint16_t readyMask;  // Bit per digit
+    uint32_t renderCount;
+    uint16_t pixels[10][GLYPH_CACHE_PIXELS];
+};
+
+#endif
@@ -0,0 +1,33 @@
+#ifndef M5_LCD_SURFACE_H
+#define M5_LCD_SURFACE_H
+
+#include <M5Core2.h>
+#include "GameRender.h"
+
+///////////////////////////////////////////////////////////////
+// DrawSurface that draws straight to the Core2 LCD
+///////////////////////////////////////////////////////////////
+class M5LcdSurface : public DrawSurface {
+public:
+    void fillRect(int x, int y, int w, int h, uint16_t color) {
+        M5.Lcd.fillRect(x, y, w, h, color);
+    }
+
+    void drawText(int x, int y, const char *text, int length, uint8_t size,
+                  uint16_t color, uint16_t background) {
+        M5.Lcd.setTextColor(color, background);
+        M5.Lcd.setTextSize(size);
+        M5.Lcd.setCursor(x, y);
+        M5.Lcd.write((const uint8_t *)text, length);
+    }
+
+    void pushImage(int x, int y, int w, int h, const uint16_t *pixels) {
+        // The LCD wants big-endian pixels; swap on the way out
+        bool swap = M5.Lcd.getSwapBytes();
+        M5.Lcd.setSwapBytes(true);
+        M5.Lcd.pushImage(x, y, w, h, pixels);
+        M5.Lcd.setSwapBytes(swap);
+    }
+};
+
+#endif
@@ -0,0 +1,93 @@
+#ifndef M5_SPRITE_SURFACE_H
+#define M5_SPRITE_SURFACE_H
+
+#include <M5Core2.h>
+#include "FrameCompositor.h"
+
+///////////////////////////////////////////////////////////////
+// Full-screen 16-bit sprite (allocated in PSRAM when the board
+// has it) used as the FrameSurface for off-screen compositing.
+//
+// flush() streams the sprite to the LCD in stripes through two
+// small DMA-capable bounce buffers, so copying one stripe out of
+// PSRAM overlaps the DMA of the previous one. The last stripe is
+// still in flight when flush() returns, letting the next frame's
+// input and BLE work run; waitForFlush() finishes it. Without
+// TFT_eSPI DMA support it falls back to a blocking pushSprite().
+///////////////////////////////////////////////////////////////
+class M5SpriteSurface : public FrameSurface {
+public:
+    M5SpriteSurface() : sprite(&M5.Lcd), flushing(false) {
+        bounce[0] = NULL;
+        bounce[1] = NULL;
+    }
+
+    // Allocate the sprite (and DMA buffers). Returns false if there isn't enough memory.
+    bool begin() {
+        sprite.setColorDepth(16);
+        if (!sprite.createSprite(FIELD_WIDTH, FIELD_HEIGHT)) return false;
+        sprite.setTextFont(1);
+
+#ifdef ESP32_DMA
+        for (int i = 0; i < 2; i++) {
+            bounce[i] = (uint16_t *)heap_caps_malloc(FIELD_WIDTH * STRIPE_LINES * sizeof(uint16_t),
+                                                     MALLOC_CAP_DMA);
+            if (!bounce[i]) return false;
+        }
+        M5.Lcd.initDMA();
+#endif
+        return true;
+    }
+
+    void fillRect(int x, int y, int w, int h, uint16_t color) {
+        sprite.fillRect(x, y, w, h, color);
+    }
+
+    void drawText(int x, int y, const char *text, int length, uint8_t size,
+                  uint16_t color, uint16_t background) {
+        sprite.setTextColor(color, background);
+        sprite.setTextSize(size);
+        sprite.setCursor(x, y);
+        sprite.write((const uint8_t *)text, length);
+    }
+
+    void pushImage(int x, int y, int w, int h, const uint16_t *pixels) {
+        // Sprites store big-endian pixels and swap native ones by default
+        sprite.pushImage(x, y, w, h, pixels);
+    }
+
+    void flush() {
+        waitForFlush();
+
+#ifdef ESP32_DMA
+        uint16_t *pixels = (uint16_t *)sprite.getPointer();
+        M5.Lcd.startWrite();
+        for (int stripe = 0; stripe * STRIPE_LINES < FIELD_HEIGHT; stripe++) {
+            int y = stripe * STRIPE_LINES;
+            M5.Lcd.pushImageDMA(0, y, FIELD_WIDTH, STRIPE_LINES, pixels + y * FIELD_WIDTH,
+                                bounce[stripe & 1]);
+        }
+        flushing = true;
+#else
+        sprite.pushSprite(0, 0);
+#endif
+    }
+
+    void waitForFlush() {
+        if (!flushing) return;
+#ifdef ESP32_DMA
+        M5.Lcd.dmaWait();
+        M5.Lcd.endWrite();
+#endif
+        flushing = false;
+    }
+
+private:
+    static const int STRIPE_LINES = 16;  // FIELD_HEIGHT is a multiple of this
+
+    TFT_eSprite sprite;
+    uint16_t *bounce[2];
+    bool flushing;
+};
+
+#endif
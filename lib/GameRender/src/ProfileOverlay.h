@@ -0,0 +1,57 @@
+#ifndef PROFILE_OVERLAY_H
+#define PROFILE_OVERLAY_H
+
+#include <FrameProfiler.h>
+#include "GameRender.h"
+
+///////////////////////////////////////////////////////////////
+// Profiler overlay: one fixed-width line per stage in the
+// bottom-left corner,
+//
+//   render   p50   812 p99  1904 max  2210
+//
+// drawn with an opaque background so a new line always covers
+// the old one. The renderer doesn't know about it: dots passing
+// underneath erase bits of it until the next draw, and the
+// sketch invalidates the renderer when the overlay goes away.
+///////////////////////////////////////////////////////////////
+const int PROFILE_OVERLAY_NAME_CHARS = 8;
+const int PROFILE_OVERLAY_CHARS = PROFILE_OVERLAY_NAME_CHARS + 3 * 10;  // " p50" + 6 digits, x3
+
+// value right-aligned in width characters
+inline int formatPadded(char *out, uint32_t value, int width) {
+    char digits[10];
+    int length = formatUnsigned(digits, value);
+    int pad = width > length ? width - length : 0;
+    for (int i = 0; i < pad; i++) out[i] = ' ';
+    memcpy(out + pad, digits, length);
+    return pad + length;
+}
+
+// Exactly PROFILE_OVERLAY_CHARS characters, no terminator
+inline void formatProfileLine(char *out, const ProfileSummary &summary) {
+    const char *name = profileStageName((ProfileStage)summary.stage);
+    int length = (int)strlen(name);
+    if (length > PROFILE_OVERLAY_NAME_CHARS) length = PROFILE_OVERLAY_NAME_CHARS;
+    memcpy(out, name, length);
+    while (length < PROFILE_OVERLAY_NAME_CHARS) out[length++] = ' ';
+
+    length += formatText(out + length, " p50");
+    length += formatPadded(out + length, summary.p50Us, 6);
+    length += formatText(out + length, " p99");
+    length += formatPadded(out + length, summary.p99Us, 6);
+    length += formatText(out + length, " max");
+    formatPadded(out + length, summary.maxUs, 6);
+}
+
+inline void drawProfileOverlay(DrawSurface &surface, const ProfileSummary *rows, int count,
+                               uint16_t color = COLOR_YELLOW, uint16_t background = COLOR_BLACK) {
+    int y = FIELD_HEIGHT - count * FONT_CHAR_HEIGHT - 2;
+    for (int i = 0; i < count; i++, y += FONT_CHAR_HEIGHT) {
+        char line[PROFILE_OVERLAY_CHARS];
+        formatProfileLine(line, rows[i]);
+        surface.drawText(2, y, line, PROFILE_OVERLAY_CHARS, 1, color, background);
+    }
+}
+
+#endif
@@ -1,41 +1,141 @@
 #include <M5Core2.h>
+#include <SD.h>
 #include <Adafruit_seesaw.h>
 #include <BLEDevice.h>
 #include <BLEServer.h>
 #include <BLEUtils.h>
 #include <BLE2902.h>
+#include <GameCore.h>
+#include <GameProtocol.h>
+#include <RemoteState.h>
+#include <PositionCodec.h>
+#include <PlayerTable.h>
+#include <WorldState.h>
+#include <ServerSession.h>
+#include <LinkProfile.h>
+#include <BleTransport.h>
+#include <InputSnapshot.h>
+#include <SeesawGamepad.h>
+#include <SpscRing.h>
+#include <SeqlockCell.h>
+#include <FrameScheduler.h>
+#include <FrameProfiler.h>
+#include <Telemetry.h>
+#include <SessionLog.h>
+#include <M5LcdSurface.h>
+#include <M5SpriteSurface.h>
+#include <ProfileOverlay.h>
 
 ///////////////////////////////////////////////////////////////
 // Variables
 ///////////////////////////////////////////////////////////////
 BLEServer *pServer = NULL;
 BLECharacteristic *pCharacteristic = NULL;
-bool deviceConnected = false;
-bool oldDeviceConnected = false;
-bool gameOverFlag = false;  // Flag to track if the game is over
+BLE2902 *pCccd = NULL;                  // Notify subscriptions are tracked per connection through this
 
 // Gamepad Variables
-Adafruit_seesaw gamepad;
-#define BUTTON_START 16
-#define BUTTON_SELECT 0
-
-// Button state tracking
-bool startButtonPressed = false;
-bool selectButtonPressed = false;
-
-// Server's Red Dot (Local)
-int redX = 150, redY = 100, redSpeed = 1;
-
-// Client's Blue Dot (Remote)
-int blueX = -1, blueY = -1;  // Blue dot starts as invalid
-bool blueDotInitialized = false;  // Flag to track if we've received valid data for blue dot
-
-// Game timing
-unsigned long gameStartTime = 0;
-float gameTimeElapsed = 0.0;
-
-// Collision threshold
-const int COLLISION_DISTANCE = 10;
+SeesawGamepad gamepad;
+InputSampler<SeesawGamepad> inputSampler(gamepad);  // One bulk button read + joystick per frame
+
+// Set to true when the gamepad's INT pin is wired to GAMEPAD_INT_PIN (Port B):
+// buttons are then only read after an interrupt and the joystick every JOYSTICK_POLL_MS
+bool interruptInput = false;
+#define GAMEPAD_INT_PIN 26
+#define JOYSTICK_POLL_MS 30
+InterruptSampler<SeesawGamepad> interruptSampler(gamepad, JOYSTICK_POLL_MS);
+
+// The gamepad is only touched by inputTask, which hands snapshots to loop() through inputQueue
+#define INPUT_PERIOD_MS 10
+#define INPUT_TASK_CORE 0
+SpscRing<InputSnapshot, 16> inputQueue;
+InputSnapshot latestInput = {0, {JOYSTICK_CENTER, JOYSTICK_CENTER, 0}, 0, 0};  // What loop() last saw
+
+// Game state: Server's Red Dot is local, every client's dot is tracked by gameSession below
+GameState game;
+
+// Clients: the BLE callbacks keep one PlayerTable slot per connection, loop() reads them once per frame
+PlayerTable playerTable;
+
+// Everything the clients do arrives through bleTransport; linkListener files it into playerTable
+struct ServerLinkListener : public TransportListener {
+    void onConnect(uint16_t link);
+    void onDisconnect(uint16_t link);
+    void onSubscribe(uint16_t link, bool subscribed);
+    void onMtu(uint16_t link, uint16_t mtu);
+    void onReceive(uint16_t link, const uint8_t *data, size_t length);
+};
+BleServerTransport bleTransport;
+ServerLinkListener linkListener;
+
+// Client dots are drawn REMOTE_DELAY_MS in the past, interpolated between received positions
+// (and extrapolated for at most RemoteTrack's default 100 ms)
+#define REMOTE_DELAY_MS 150
+
+// Rendering: only what changed since last frame is redrawn
+M5LcdSurface lcdSurface;
+DirtyRenderer renderer(lcdSurface);
+RenderFrame renderFrame;
+
+// Set to true to compose frames in an off-screen sprite and flush them with DMA
+bool spriteMode = false;
+M5SpriteSurface spriteSurface;
+FrameCompositor compositor(spriteSurface);
+
+// Game timing: fixed simulation steps, with rendering and sends on their own rates
+#define SIM_STEP_MS 30
+#define RENDER_PERIOD_MS 30
+#define NETWORK_PERIOD_MS 100  // 10 Hz is enough with RemoteTrack smoothing the other side
+ArduinoClock frameClock;
+FrameScheduler<ArduinoClock> scheduler(frameClock);
+
+// Profiling: p50/p99/max of each stage, dumped in binary with the frame stats when
+// profileDump is set and drawn on screen while the overlay is on (A + B toggles it)
+bool profileDump = false;
+bool profilerOverlay = false;
+#define OVERLAY_REFRESH_MS 500
+FrameProfiler<ArduinoClock> profiler(frameClock);       // Only touched by loop()
+FrameProfiler<ArduinoClock> inputProfiler(frameClock);  // Only touched by inputTask
+volatile bool inputProfileReset = false;                // loop() asks inputTask to clear inputProfiler
+ProfileSummary overlayRows[PROFILE_STAGE_COUNT];
+
+// Telemetry: the BLE callbacks log client writes into bleTelemetry instead of printing
+// them; while telemetryStream is set, serialTask streams the events to Serial in binary
+// (decode with tools/telemetry_csv)
+bool telemetryStream = false;
+#define SERIAL_TASK_PERIOD_MS 20
+#define SERIAL_TASK_CORE 1
+TelemetryChannel<ArduinoClock> bleTelemetry(frameClock);  // Only logged to by the BLE task
+
+// Session recording for tools/session_replay: each round's seed, every simulate tick's input and
+// what was done with the other players' positions. Goes to SESSION_FILE on the SD card, or if
+// there's no card through sessionSerial, which serialTask drains to Serial off the frame path.
+bool sessionRecord = false;
+#define SESSION_FILE "/session.bin"
+File sessionFile;
+struct SessionSink {
+    size_t write(const uint8_t *data, size_t length);
+};
+SessionSink sessionSink;
+SessionRecorder<SessionSink> sessionRecorder(sessionSink);
+SessionChannel<> sessionSerial;  // Only written to by loop()
+
+// Every player's position goes out in one WORLD notify per network tick, only when
+// something moved, and at least every KEYFRAME_MS
+#define KEYFRAME_MS 1000
+
+// Everything the game does with the clients: joins, their tracks, collisions (the server decides
+// them, checking client positions against where our dot was on the client's screen) and WORLD
+// frames. gameEvents is what the sketch does on top.
+struct ServerEvents : public ServerSessionListener {
+    void onRoundStart();
+    void onJoin(uint8_t id);
+    void onLeave(uint8_t id);
+    void onPosition(uint8_t id, const RemoteState &remote);
+    void onSpawn(uint8_t id, int x, int y);
+    void onHit(uint8_t a, uint8_t b);
+};
+ServerEvents gameEvents;
+ServerSession gameSession(playerTable, game, bleTransport, gameEvents, REMOTE_DELAY_MS, KEYFRAME_MS);
 
 // Debug flags
 bool debugMode = false;  // Set to true to display debug info
@@ -53,103 +153,70 @@ bool debugMode = false;  // Set to true to display debug info
 // Forward Declarations
 ///////////////////////////////////////////////////////////////
 void drawScreenTextWithBackground(String text, int backgroundColor);
-void sendGamepadData();
+void runFrame();
+void reportFrameStats();
+void profileSummaries(ProfileSummary *summaries);
+void drawOverlay(DrawSurface &surface);
 void gameOver();
-void checkCollision();
-
-///////////////////////////////////////////////////////////////
-// BLE Server Callback
-///////////////////////////////////////////////////////////////
-class MyServerCallbacks: public BLEServerCallbacks {
-    void onConnect(BLEServer* pServer) {
-      deviceConnected = true;
-      gameOverFlag = false;
-      blueDotInitialized = false;  // Reset this flag on new connection
-      gameStartTime = millis();
-      
-      // Send a connected message to the client
-      if (pCharacteristic) {
-        pCharacteristic->setValue("CONNECTED");
-        pCharacteristic->notify();
-      }
-      
-      Serial.println("Device connected...");
-    }
-
-    void onDisconnect(BLEServer* pServer) {
-      deviceConnected = false;
-      Serial.println("Device disconnected...");
-    }
-};
+void newRound(uint32_t buttonsHeld = 0);
+InputSnapshot readInput();
+void IRAM_ATTR onGamepadInterrupt();
+void inputTask(void *parameter);
+void serialTask(void *parameter);
+void beginSessionRecording(SessionRole role);
+void updatePlayers();
 
 ///////////////////////////////////////////////////////////////
-// BLE Characteristic Callback
-///////////////////////////////////////////////////////////////
-class MyCharacteristicCallbacks: public BLECharacteristicCallbacks {
-    void onWrite(BLECharacteristic *pCharacteristic) {
-      std::string value = pCharacteristic->getValue();
-      
-      if (value.length() > 0) {
-        Serial.printf("Received Value: %s\n", value.c_str());
-        
-        String receivedData = String(value.c_str());
-        int dashIndex = receivedData.indexOf('-');
-        
-        if (dashIndex > 0) {
-          // Parse the position data
-          int newBlueX = receivedData.substring(0, dashIndex).toInt();
-          int newBlueY = receivedData.substring(dashIndex + 1).toInt();
-          
-          // Only update if values are valid (non-negative and within screen bounds)
-          if (newBlueX >= 0 && newBlueY >= 0 && newBlueX < 320 && newBlueY < 240) {
-            blueX = newBlueX;
-            blueY = newBlueY;
-            
-            // Mark that we have valid data for the blue dot
-            if (!blueDotInitialized) {
-              blueDotInitialized = true;
-              
-              // Initialize red dot in a different area to avoid immediate collision
-              if (abs(redX - blueX) < 50 && abs(redY - blueY) < 50) {
-                redX = (blueX < 160) ? random(200, 300) : random(20, 120);
-                redY = (blueY < 120) ? random(150, 220) : random(20, 90);
-              }
-            }
-            
-            // Check for collision after updating position, but only if we've had valid data for a while
-            static unsigned long firstDataTime = 0;
-            if (!firstDataTime) firstDataTime = millis();
-            
-            // Wait 2 seconds after first receiving data before allowing collisions
-            if (!gameOverFlag && blueDotInitialized && (millis() - firstDataTime > 2000)) {
-              checkCollision();
-            }
-          }
-        }
-      }
+// BLE stack events (BLE task): the client picks the connection
+// parameters and MTU, we just report what was agreed on
+///////////////////////////////////////////////////////////////
+static void gapEventHandler(esp_gap_ble_cb_event_t event, esp_ble_gap_cb_param_t *param) {
+    if (event == ESP_GAP_BLE_UPDATE_CONN_PARAMS_EVT) {
+        Serial.printf("Connection params: status %d, interval %.2f ms, latency %u, timeout %u ms\n",
+                      param->update_conn_params.status,
+                      intervalMicros(param->update_conn_params.conn_int) / 1000.0,
+                      param->update_conn_params.latency, param->update_conn_params.timeout * 10);
     }
-};
+}
 
 ///////////////////////////////////////////////////////////////
-// Check for collision between dots
+// GATT server events (BLE task): bleTransport turns them into
+// connections, subscriptions and client writes for linkListener,
+// which puts them into playerTable by conn_id; the game loop
+// does the rest
 ///////////////////////////////////////////////////////////////
-void checkCollision() {
-    // Only check collision if we have valid coordinates for blue dot
-    if (blueX >= 0 && blueY >= 0 && !gameOverFlag && blueDotInitialized) {
-        int dx = abs(redX - blueX);
-        int dy = abs(redY - blueY);
-        
-        if (debugMode) {
-            Serial.printf("Distance: dx=%d, dy=%d, threshold=%d\n", dx, dy, COLLISION_DISTANCE);
-        }
-        
-        // Only trigger collision if dots are very close
-        if (dx < COLLISION_DISTANCE && dy < COLLISION_DISTANCE) {
-            if (debugMode) {
-                Serial.println("COLLISION DETECTED");
-            }
-            gameOver();
-        }
+static void gattsEventHandler(esp_gatts_cb_event_t event, esp_gatt_if_t gattsIf, esp_ble_gatts_cb_param_t *param) {
+    bleTransport.onGattsEvent(event, gattsIf, param);
+}
+
+void ServerLinkListener::onConnect(uint16_t link) {
+    if (playerTable.onConnect(link) < 0) {
+        Serial.println("Player table full, dropping connection");
+        bleTransport.disconnect(link);
+    }
+}
+
+void ServerLinkListener::onDisconnect(uint16_t link) {
+    playerTable.onDisconnect(link);
+}
+
+void ServerLinkListener::onSubscribe(uint16_t link, bool subscribed) {
+    playerTable.onSubscribe(link, subscribed);
+}
+
+void ServerLinkListener::onMtu(uint16_t link, uint16_t mtu) {
+    Serial.printf("MTU negotiated: %u\n", mtu);
+    playerTable.onMtu(link, mtu);
+}
+
+// decodePacket() rejects malformed frames and off-screen positions,
+// the slot's PositionDecoder turns deltas into positions
+void ServerLinkListener::onReceive(uint16_t link, const uint8_t *data, size_t length) {
+    int slot = playerTable.onWrite(link, data, length, millis());
+    if (slot >= 0) {
+        bleTelemetry.log(TELEMETRY_WRITE, playerIdForSlot(slot), length);
+    } else {
+        bleTelemetry.log(TELEMETRY_BAD_WRITE, link, length);
     }
 }
 
@@ -159,17 +226,28 @@ void checkCollision() {
 void setup() {
     M5.begin();
     M5.Lcd.setTextSize(3);
+    scheduler.setStage(STAGE_SIMULATE, SIM_STEP_MS * 1000UL);
+    scheduler.setStage(STAGE_RENDER, RENDER_PERIOD_MS * 1000UL);
+    scheduler.setStage(STAGE_NETWORK, NETWORK_PERIOD_MS * 1000UL);
+    if (spriteMode && !spriteSurface.begin()) {
+        Serial.println("Not enough memory for the frame sprite, drawing directly.");
+        spriteMode = false;
+    }
     drawScreenTextWithBackground("Starting BLE Server...", TFT_BLUE);
 
     // Initialize random seed
     randomSeed(analogRead(0));
+    resetGame(game, random(1, 0x7FFFFFFF));
+    beginSessionRecording(SESSION_ROLE_SERVER);
     
     // Create the BLE Device
     BLEDevice::init(BLE_BROADCAST_NAME);
+    BLEDevice::setMTU(LINK_MTU);
+    BLEDevice::setCustomGapHandler(gapEventHandler);
+    BLEDevice::setCustomGattsHandler(gattsEventHandler);
 
-    // Create the BLE Server
+    // Create the BLE Server (connections are handled in gattsEventHandler)
     pServer = BLEDevice::createServer();
-    pServer->setCallbacks(new MyServerCallbacks());
 
     // Create the BLE Service
     BLEService *pService = pServer->createService(SERVICE_UUID);
@@ -179,15 +257,16 @@ void setup() {
                         CHARACTERISTIC_UUID,
                         BLECharacteristic::PROPERTY_READ   |
                         BLECharacteristic::PROPERTY_WRITE  |
+                        BLECharacteristic::PROPERTY_WRITE_NR |
                         BLECharacteristic::PROPERTY_NOTIFY |
                         BLECharacteristic::PROPERTY_INDICATE
                       );
 
-    // Add callback for receiving data from client
-    pCharacteristic->setCallbacks(new MyCharacteristicCallbacks());
-
-    // Create a BLE Descriptor (needed for notifications)
-    pCharacteristic->addDescriptor(new BLE2902());
+    // Create a BLE Descriptor (needed for notifications); client writes come in through bleTransport
+    pCccd = new BLE2902();
+    pCharacteristic->addDescriptor(pCccd);
+    bleTransport.setListener(&linkListener);
+    bleTransport.begin(pCharacteristic, pCccd);
 
     // Start the service
     pService->start();
@@ -196,8 +275,9 @@ void setup() {
     BLEAdvertising *pAdvertising = BLEDevice::getAdvertising();
     pAdvertising->addServiceUUID(SERVICE_UUID);
     pAdvertising->setScanResponse(true);
-    pAdvertising->setMinPreferred(0x06);  // iPhone connection issue workaround
-    pAdvertising->setMinPreferred(0x12);
+    // Preferred connection interval range (1.25 ms units); the client switches profiles once connected
+    pAdvertising->setMinPreferred(PROFILE_LOW_LATENCY.minInterval);
+    pAdvertising->setMaxPreferred(PROFILE_LOW_LATENCY.maxInterval);
     BLEDevice::startAdvertising();
     
     Serial.println("BLE Server started, waiting for connections...");
@@ -211,154 +291,314 @@ void setup() {
         drawScreenTextWithBackground("ERROR! Gamepad not found", TFT_RED);
         while (1);
     }
-    gamepad.pinMode(BUTTON_START, INPUT_PULLUP);
-    gamepad.pinMode(BUTTON_SELECT, INPUT_PULLUP);
-    
-    // Assign random positions for the red dot
-    redX = random(50, 250);
-    redY = random(50, 200);
+    gamepad.pinModeBulk(GAMEPAD_BUTTON_MASK, INPUT_PULLUP);
+    if (interruptInput) {
+        gamepad.setGPIOInterrupts(GAMEPAD_BUTTON_MASK, 1);
+        pinMode(GAMEPAD_INT_PIN, INPUT_PULLUP);
+        attachInterrupt(digitalPinToInterrupt(GAMEPAD_INT_PIN), onGamepadInterrupt, FALLING);
+    }
+    xTaskCreatePinnedToCore(inputTask, "input", 4096, NULL, 1, NULL, INPUT_TASK_CORE);
+    if (telemetryStream || (sessionRecord && !sessionFile)) {
+        xTaskCreatePinnedToCore(serialTask, "serial", 2048, NULL, tskIDLE_PRIORITY, NULL, SERIAL_TASK_CORE);
+    }
 }
 
 ///////////////////////////////////////////////////////////////
 // Main Loop
 ///////////////////////////////////////////////////////////////
 void loop() {
-    if (gameOverFlag) {
+    // Handle players joining, subscribing and leaving
+    updatePlayers();
+
+    if (gameSession.isGameOver()) {
         // If in game over state, just check for reset button (START)
-        bool startCurrent = !gamepad.digitalRead(BUTTON_START);
-        if (startCurrent && !startButtonPressed) {
-            // Reset the game
-            gameOverFlag = false;
-            blueDotInitialized = false;
-            redX = random(50, 250);
-            redY = random(50, 200);
-            redSpeed = 1;
-            blueX = -1;
-            blueY = -1;
-            gameStartTime = millis();
+        InputSnapshot snapshot = readInput();
+        if (snapshot.pressed & GAME_BUTTON_START) {
+            // Reset the game, not counting this press as a speed change
+            newRound(snapshot.input.buttons);
             
-            // Send CONNECTED to tell client to reset too
-            if (deviceConnected && pCharacteristic) {
-                pCharacteristic->setValue("CONNECTED");
-                pCharacteristic->notify();
-            }
+            // Send CONNECTED to tell the clients to reset too
+            gameSession.sendStart();
         }
-        startButtonPressed = startCurrent;
         delay(30);
         return;
     }
 
-    // Handle connection/disconnection events
-    if (deviceConnected && !oldDeviceConnected) {
-        oldDeviceConnected = deviceConnected;
-        Serial.println("Client connected");
-        delay(500); // Give time for connection to stabilize
+    if (gameSession.roundActive()) {
+        runFrame();
+    } else {
+        delay(30);
     }
-    
-    if (!deviceConnected && oldDeviceConnected) {
-        oldDeviceConnected = deviceConnected;
-        Serial.println("Client disconnected");
-        // Restart advertising to allow reconnection
-        pServer->startAdvertising();
-        delay(500);
+}
+
+///////////////////////////////////////////////////////////////
+// Joins, subscriptions and leaves (see ServerSession), and
+// what the screen and advertising do about them
+///////////////////////////////////////////////////////////////
+void updatePlayers() {
+    if (!gameSession.updatePlayers()) return;
+    if (playerTable.connectedCount() == 0) {
+        drawScreenTextWithBackground("BLE Server Ready\nWaiting for client...", TFT_GREEN);
     }
+    // Connecting stops advertising; keep it going while there are free slots
+    if (!playerTable.full()) BLEDevice::startAdvertising();
+}
+
+void ServerEvents::onRoundStart() {
+    newRound();
+}
 
-    if (deviceConnected) {
-        sendGamepadData();
-        
-        // Update game time
-        gameTimeElapsed = (millis() - gameStartTime) / 1000.0;
+void ServerEvents::onJoin(uint8_t id) {
+    Serial.printf("Player %u connected\n", id);
+}
+
+void ServerEvents::onLeave(uint8_t id) {
+    Serial.printf("Player %u disconnected\n", id);
+}
+
+///////////////////////////////////////////////////////////////
+// Run whichever stages are due: simulate, draw, send to client
+///////////////////////////////////////////////////////////////
+void runFrame() {
+    if (gameSession.isGameOver()) return;
+    scheduler.update();
+    bool busy = scheduler.isDue(STAGE_SIMULATE) || scheduler.isDue(STAGE_RENDER) ||
+                scheduler.isDue(STAGE_NETWORK);
+    if (busy) profiler.begin(PROFILE_FRAME);
+
+    // Move the red dot and check for collision, in fixed steps
+    if (scheduler.isDue(STAGE_SIMULATE)) {
+        ProfileScope<ArduinoClock> profile(profiler, PROFILE_SIMULATE);
+        InputSnapshot snapshot = readInput();
+        if (comboPressed(snapshot, GAME_COMBO_PROFILER)) {
+            profilerOverlay = !profilerOverlay;
+            if (!profilerOverlay) renderer.invalidate();  // Clear it off the screen
+        }
+        uint8_t events = gameSession.applyRemoteStates(millis()) ? STEP_COLLISION : 0;
+
+        uint32_t steps = 0;
+        for (uint32_t i = 0; i < scheduler.dueCount(STAGE_SIMULATE) && !(events & STEP_COLLISION); i++) {
+            steps++;
+            scheduler.begin(STAGE_SIMULATE);
+            int fromX = game.local.x, fromY = game.local.y;
+            uint8_t stepEvents = step(game, snapshot, scheduler.stepMs(), i == 0);
+            if (stepEvents & STEP_WARPED) {
+                fromX = game.local.x;  // Warps aren't swept
+                fromY = game.local.y;
+            }
+            if (gameSession.checkCollisions(fromX, fromY)) stepEvents |= STEP_COLLISION;
+            events |= stepEvents;
+            scheduler.end(STAGE_SIMULATE);
+        }
+        sessionRecorder.tick(millis(), snapshot, scheduler.stepMs(), steps, game);
+        gameSession.simulated(millis(), events);
+
+        if (events & STEP_COLLISION) {
+            gameOver();
+            return;
+        }
     }
 
-    delay(30); // Smooth movement update rate
+    // Draw game screen
+    if (scheduler.isDue(STAGE_RENDER)) {
+        ProfileScope<ArduinoClock> profile(profiler, PROFILE_RENDER);
+        scheduler.begin(STAGE_RENDER);
+        buildGameFrame(game, RED, BLUE, renderFrame);
+        for (int slot = 0; slot < MAX_CLIENTS; slot++) {
+            const ServerPlayer &player = gameSession.player(slot);
+            setFrameDot(renderFrame, 1 + slot, player.x, player.y, playerColor(playerIdForSlot(slot)),
+                        player.connected && player.valid);
+        }
+        if (spriteMode) {
+            compositor.composeGame(renderFrame);
+            drawOverlay(spriteSurface);
+            compositor.flush();
+        } else {
+            renderer.render(renderFrame);
+            drawOverlay(lcdSurface);
+        }
+        scheduler.end(STAGE_RENDER);
+    }
+
+    // Send everyone's position to every client in one WORLD frame
+    if (scheduler.isDue(STAGE_NETWORK)) {
+        ProfileScope<ArduinoClock> profile(profiler, PROFILE_NETWORK);
+        scheduler.begin(STAGE_NETWORK);
+        gameSession.broadcastWorld(millis());
+        scheduler.end(STAGE_NETWORK);
+    }
+    if (busy) profiler.end(PROFILE_FRAME);
+
+    reportFrameStats();
+
+    // Sleep until the next stage is due
+    uint32_t waitUs = scheduler.untilNextUs();
+    if (waitUs >= 1000) delay(waitUs / 1000);
 }
 
 ///////////////////////////////////////////////////////////////
-// Send Gamepad Data to BLE Client
-///////////////////////////////////////////////////////////////
-void sendGamepadData() {
-    if (gameOverFlag) return;
-
-    uint32_t buttons = gamepad.digitalReadBulk(0xFFFF);
-    int joyX = 1023 - gamepad.analogRead(14);
-    int joyY = 1023 - gamepad.analogRead(15);
-
-    // Check Start button - Increase speed, wrap around from 5 to 1
-    bool startCurrent = !gamepad.digitalRead(BUTTON_START); // Button is active LOW (pressed = 0)
-    if (startCurrent && !startButtonPressed) {
-        // Start button was just pressed (rising edge)
-        redSpeed++;
-        if (redSpeed > 5) redSpeed = 1;
-        
-        // Display speed briefly
-        M5.Lcd.fillRect(0, 0, 100, 30, BLACK);
-        M5.Lcd.setCursor(5, 5);
-        M5.Lcd.setTextSize(2);
-        M5.Lcd.printf("Speed: %d", redSpeed);
-        M5.Lcd.setTextSize(3);
+// Print stage timings every few seconds if anything ran late
+// (always in debug mode), and the profile dump if enabled
+///////////////////////////////////////////////////////////////
+void reportFrameStats() {
+    static unsigned long lastReport = 0;
+    if (millis() - lastReport < 5000) return;
+    lastReport = millis();
+
+    bool late = false;
+    for (int i = 0; i < STAGE_COUNT; i++) {
+        const StageStats &stats = scheduler.stageStats((SchedulerStage)i);
+        late |= stats.overruns > 0 || stats.dropped > 0;
     }
-    startButtonPressed = startCurrent;
-
-    // Check Select button - Warp to random position
-    bool selectCurrent = !gamepad.digitalRead(BUTTON_SELECT); // Button is active LOW
-    if (selectCurrent && !selectButtonPressed) {
-        // Select button was just pressed (rising edge)
-        redX = random(10, 310);
-        redY = random(10, 230);
+    if (late || debugMode) {
+        for (int i = 0; i < STAGE_COUNT; i++) {
+            const StageStats &stats = scheduler.stageStats((SchedulerStage)i);
+            Serial.printf("%-8s %4u runs %3u dropped %3u over %u us budget, worst %u us\n",
+                          stageName((SchedulerStage)i), stats.runs, stats.dropped,
+                          stats.overruns, stats.budgetUs, stats.worstUs);
+        }
     }
-    selectButtonPressed = selectCurrent;
+    scheduler.resetStats();
 
-    float normX = (joyX - 512) / 512.0;
-    float normY = (joyY - 512) / 512.0;
+    if (profileDump) {
+        ProfileSummary summaries[PROFILE_STAGE_COUNT];
+        profileSummaries(summaries);
+        uint8_t dump[PROFILE_DUMP_MAX_SIZE];
+        Serial.write(dump, encodeProfileDump(summaries, PROFILE_STAGE_COUNT, dump));
+    }
+    profiler.reset();
+    inputProfileReset = true;
+}
 
-    if (abs(normX) > 0.2) redX += (normX > 0 ? redSpeed : -redSpeed);
-    if (abs(normY) > 0.2) redY -= (normY > 0 ? redSpeed : -redSpeed);
+// One summary per stage; the input stage comes from the input task's profiler
+void profileSummaries(ProfileSummary *summaries) {
+    for (int i = 0; i < PROFILE_STAGE_COUNT; i++) {
+        const FrameProfiler<ArduinoClock> &source = i == PROFILE_INPUT ? inputProfiler : profiler;
+        summaries[i] = summarize((ProfileStage)i, source.histogram((ProfileStage)i));
+    }
+}
+
+// Profiler overlay on top of the frame, with numbers refreshed every OVERLAY_REFRESH_MS
+void drawOverlay(DrawSurface &surface) {
+    static unsigned long lastRefresh = 0;
+    if (!profilerOverlay) return;
+    if (millis() - lastRefresh >= OVERLAY_REFRESH_MS) {
+        lastRefresh = millis();
+        profileSummaries(overlayRows);
+    }
+    drawProfileOverlay(surface, overlayRows, PROFILE_STAGE_COUNT);
+}
 
-    redX = constrain(redX, 0, 315);
-    redY = constrain(redY, 0, 235);
+///////////////////////////////////////////////////////////////
+// Session recording
+///////////////////////////////////////////////////////////////
+void beginSessionRecording(SessionRole role) {
+    if (!sessionRecord) return;
+    if (SD.begin()) sessionFile = SD.open(SESSION_FILE, FILE_WRITE);
+    if (!sessionFile) Serial.println("No SD card, recording the session to Serial.");
+    sessionRecorder.begin(role);
+}
 
-    // Check for collision
-    checkCollision();
+size_t SessionSink::write(const uint8_t *data, size_t length) {
+    return sessionFile ? sessionFile.write(data, length) : sessionSerial.write(data, length);
+}
 
-    // Draw game screen
-    M5.Lcd.fillScreen(BLACK);
-    M5.Lcd.fillRect(redX, redY, 5, 5, RED);
-    
-    // Only draw blue dot if valid coordinates received
-    if (blueX >= 0 && blueY >= 0) {
-        M5.Lcd.fillRect(blueX, blueY, 5, 5, BLUE);
+///////////////////////////////////////////////////////////////
+// Gamepad Input
+///////////////////////////////////////////////////////////////
+void IRAM_ATTR onGamepadInterrupt() {
+    interruptSampler.onInterrupt();
+}
+
+// Samples the gamepad every INPUT_PERIOD_MS so I2C stalls never hold up a frame
+void inputTask(void *parameter) {
+    uint32_t missedPressed = 0, missedReleased = 0;  // Edges from snapshots dropped on a full queue
+    TickType_t lastWake = xTaskGetTickCount();
+    for (;;) {
+        if (inputProfileReset) {
+            inputProfiler.reset();
+            inputProfileReset = false;
+        }
+        inputProfiler.begin(PROFILE_INPUT);
+        InputSnapshot snapshot = interruptInput ? interruptSampler.poll(millis())
+                                                : inputSampler.sample(millis());
+        inputProfiler.end(PROFILE_INPUT);
+        snapshot.pressed |= missedPressed;
+        snapshot.released |= missedReleased;
+        if (inputQueue.push(snapshot)) {
+            missedPressed = missedReleased = 0;
+        } else {
+            missedPressed = snapshot.pressed;
+            missedReleased = snapshot.released;
+        }
+        vTaskDelayUntil(&lastWake, pdMS_TO_TICKS(INPUT_PERIOD_MS));
     }
-    
-    // Show game time and current speed
-    M5.Lcd.setCursor(5, 5);
-    M5.Lcd.setTextSize(1);
-    M5.Lcd.printf("Time: %.2fs  Speed: %d", gameTimeElapsed, redSpeed);
-    M5.Lcd.setTextSize(3);
+}
 
-    // Send position to client
-    String position = String(redX) + "-" + String(redY);
-    if (pCharacteristic) {
-        pCharacteristic->setValue(position.c_str());
-        pCharacteristic->notify();
+// Streams bleTelemetry and a session recording without an SD card to Serial when nothing
+// else on its core wants to run, only writing whole frames that fit in the UART's buffer
+void serialTask(void *parameter) {
+    for (;;) {
+        if (telemetryStream) bleTelemetry.drain(Serial);
+        sessionSerial.drain(Serial);
+        vTaskDelay(pdMS_TO_TICKS(SERIAL_TASK_PERIOD_MS));
     }
 }
 
+// Everything the input task sampled since the last call, folded into one snapshot
+InputSnapshot readInput() {
+    drainInput(inputQueue, latestInput);
+    return latestInput;
+}
+
+///////////////////////////////////////////////////////////////
+// Session events: recording what was done with the clients'
+// positions, and collisions in debug mode
+///////////////////////////////////////////////////////////////
+void ServerEvents::onPosition(uint8_t id, const RemoteState &remote) {
+    if (!sessionRecorder.active()) return;
+    uint8_t frame[GAME_PACKET_SIZE];
+    GamePacket packet = makePositionPacket(remote.seq, remote.x, remote.y, remote.flags, remote.sentMs);
+    sessionRecorder.packet(remote.receivedMs, id, frame, encodePacket(packet, frame));
+}
+
+void ServerEvents::onSpawn(uint8_t id, int x, int y) {
+    sessionRecorder.spawn(x, y);
+}
+
+void ServerEvents::onHit(uint8_t a, uint8_t b) {
+    if (debugMode) Serial.printf("COLLISION DETECTED between players %u and %u\n", a, b);
+}
+
+///////////////////////////////////////////////////////////////
+// Start a new round with a fresh red dot and no blue dot
+///////////////////////////////////////////////////////////////
+void newRound(uint32_t buttonsHeld) {
+    uint32_t seed = random(1, 0x7FFFFFFF);
+    resetGame(game, seed);
+    game.buttonsHeld = buttonsHeld;
+    sessionRecorder.round(seed, game);
+    gameSession.newRound();
+    scheduler.restart();
+    renderer.invalidate();
+}
+
 ///////////////////////////////////////////////////////////////
 // Game Over Function
 ///////////////////////////////////////////////////////////////
 void gameOver() {
-    gameOverFlag = true;
-    
-    // Calculate final time
-    gameTimeElapsed = (millis() - gameStartTime) / 1000.0;
+    // Send game over to every client with final time
+    gameSession.gameOver();
+    sessionRecorder.gameOver(game);
+    if (sessionFile) sessionFile.flush();
     
-    // Send game over to client with final time
-    if (deviceConnected && pCharacteristic) {
-        String gameOverMessage = "GAMEOVER-" + String(gameTimeElapsed);
-        pCharacteristic->setValue(gameOverMessage.c_str());
-        pCharacteristic->notify();
+    if (spriteMode) {
+        compositor.composeGameOver(game.elapsedMs, true);
+        compositor.flush();
+        return;
     }
-    
+
+    renderer.invalidate();
     M5.Lcd.fillScreen(RED);
     M5.Lcd.setTextColor(WHITE);
     M5.Lcd.setTextSize(3);
@@ -368,7 +608,7 @@ void gameOver() {
     
     M5.Lcd.setCursor(50, 150);
     M5.Lcd.setTextSize(2);
-    M5.Lcd.printf("Time: %.2f seconds", gameTimeElapsed);
+    M5.Lcd.printf("Time: %.2f seconds", game.elapsedMs / 1000.0);
     
     M5.Lcd.setCursor(20, 200);
     M5.Lcd.setTextSize(1);
@@ -379,7 +619,11 @@ void gameOver() {
 // Screen Display Function
 ///////////////////////////////////////////////////////////////
 void drawScreenTextWithBackground(String text, int backgroundColor) {
+    spriteSurface.waitForFlush();
+    renderer.invalidate();
     M5.Lcd.fillScreen(backgroundColor);
+    M5.Lcd.setTextColor(WHITE);
+    M5.Lcd.setTextSize(3);
     M5.Lcd.setCursor(0, 0);
     M5.Lcd.println(text);
 }
\ No newline at end of file
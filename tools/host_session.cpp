@@ -0,0 +1,476 @@
+///////////////////////////////////////////////////////////////
+// Plays the two-player game between host processes, over
+// UdpTransport instead of BLE.
+//
+// One process runs the server, others run one or more bot
+// clients. Each side runs its sketch's ServerSession or
+// ClientSession, with the same calls its loop() makes: the
+// server hands out player ids on subscribe, steps its dot,
+// tracks the clients' dots, calls collisions (rewound, swept
+// and pairwise) and broadcasts WORLD frames; clients step their
+// dots, upload positions and clock offsets and track everyone
+// else. The sticks are random walks, the bots' leaning
+// towards the red dot, and the server presses START 2 s after
+// every game over. --latency, --jitter,
+// --loss and --reorder impair what that process sends.
+//
+// Every 5 s and at the end each side prints what went through
+// the link, and the one-way delay of the frames it received
+// (the two sides share the host's monotonic clock, so this only
+// means something with both on one machine). A bot that never
+// started a round makes the client exit with 1: BLE doesn't lose
+// notifications, so nothing resends a lost CONNECTED.
+//
+//   g++ -std=gnu++11 -O2 -Ilib/GameCore/src -Ilib/GameProtocol/src tools/host_session.cpp -o host_session
+//   ./host_session --server --port 4250 --seconds 60
+//   ./host_session --client 127.0.0.1:4250 --bots 3 --latency 30 --jitter 15 --loss 20
+///////////////////////////////////////////////////////////////
+#include <ClientSession.h>
+#include <GameCore.h>
+#include <GameProtocol.h>
+#include <PlayerTable.h>
+#include <RemoteState.h>
+#include <ServerSession.h>
+#include <UdpTransport.h>
+#include <WorldState.h>
+#include <algorithm>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <vector>
+
+#define SIM_STEP_MS 30
+#define NETWORK_PERIOD_MS 100
+#define REMOTE_DELAY_MS 150
+#define KEYFRAME_MS 1000
+#define MAX_WRITES_IN_FLIGHT 2
+#define RESTART_MS 2000
+#define REPORT_MS 5000
+#define POLL_US 2000
+
+static volatile sig_atomic_t stopping = 0;
+
+static void onSignal(int) {
+    stopping = 1;
+}
+
+static uint32_t monotonicMs() {
+    timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint32_t)(now.tv_sec * 1000ULL + now.tv_nsec / 1000000);
+}
+
+// Stick that wanders like someone playing, or leans towards a target
+struct BotStick {
+    BotStick(uint32_t seed) : rng(seed ? seed : 1) {
+        input.joyX = input.joyY = JOYSTICK_CENTER;
+        input.buttons = 0;
+    }
+    const GameInput &next() {
+        input.joyX = clampInt(input.joyX + randomBetween(rng, -120, 121), 0, 1023);
+        input.joyY = clampInt(input.joyY + randomBetween(rng, -120, 121), 0, 1023);
+        return input;
+    }
+    const GameInput &chase(int fromX, int fromY, int toX, int toY) {
+        next();
+        input.joyX = clampInt((input.joyX + JOYSTICK_CENTER + lean(toX - fromX)) / 2, 0, 1023);
+        input.joyY = clampInt((input.joyY + JOYSTICK_CENTER + lean(fromY - toY)) / 2, 0, 1023);  // Stick Y is up
+        return input;
+    }
+    static int lean(int distance) {
+        return distance > 0 ? 400 : (distance < 0 ? -400 : 0);
+    }
+    uint32_t rng;
+    GameInput input;
+};
+
+// One-way delays, in ms
+struct DelayStats {
+    void add(uint16_t ms) {
+        samples.push_back(ms);
+    }
+    void print(const char *what) {
+        if (samples.empty()) {
+            printf("  %s delay: no samples\n", what);
+            return;
+        }
+        std::sort(samples.begin(), samples.end());
+        printf("  %s delay: p50 %u ms, p99 %u ms, max %u ms (%zu frames)\n", what,
+               samples[samples.size() / 2], samples[samples.size() * 99 / 100], samples.back(), samples.size());
+    }
+    std::vector<uint16_t> samples;
+};
+
+template <typename Udp>
+static void printLink(const char *name, const Udp &transport) {
+    const LinkConditioner<64> &conditioner = transport.linkConditioner();
+    printf("  %s link: %u frames sent, %u received, %u lost on the way, %u refused, %u bad datagrams\n", name,
+           transport.sentCount(), transport.receivedCount(), conditioner.lostCount(), conditioner.overflowCount(),
+           transport.badCount());
+}
+
+///////////////////////////////////////////////////////////////
+// Server: the BLE server sketch's loop(), minus the screen
+///////////////////////////////////////////////////////////////
+class HostServer : public TransportListener, public ServerSessionListener {
+public:
+    HostServer(uint32_t seed)
+        : session(table, game, transport, *this, REMOTE_DELAY_MS, KEYFRAME_MS), stick(seed), rng(seed ^ 0x5EED),
+          gameOverAtMs(0), lastStepMs(0), lastSendMs(0), nowMs(0), rounds(0), gameOvers(0), worldsSent(0),
+          droppedWrites(0) {
+        transport.setListener(this);
+        resetGame(game, nextRandom(rng) | 1);
+    }
+
+    // Link events, from transport.poll()
+    void onConnect(uint16_t link) {
+        if (table.onConnect(link) < 0) {
+            printf("Player table full, dropping link %u\n", link);
+            transport.disconnect(link);
+        }
+    }
+    void onDisconnect(uint16_t link) {
+        table.onDisconnect(link);
+    }
+    void onSubscribe(uint16_t link, bool subscribed) {
+        table.onSubscribe(link, subscribed);
+    }
+    void onMtu(uint16_t link, uint16_t mtu) {
+        table.onMtu(link, mtu);
+    }
+    void onReceive(uint16_t link, const uint8_t *data, size_t length) {
+        if (table.onWrite(link, data, length, nowMs) < 0) droppedWrites++;  // Malformed, stale or missing its keyframe
+    }
+
+    // Session events, from session's calls
+    void onRoundStart() {
+        newRound();
+    }
+    void onJoin(uint8_t id) {
+        printf("Player %u connected\n", id);
+    }
+    void onLeave(uint8_t id) {
+        printf("Player %u disconnected\n", id);
+    }
+    void onPosition(uint8_t id, const RemoteState &remote) {
+        uploadDelay.add((uint16_t)(remote.receivedMs - remote.sentMs));
+    }
+    void onHit(uint8_t a, uint8_t b) {
+        printf("Players %u and %u collided\n", a, b);
+    }
+
+    void update(uint32_t now) {
+        nowMs = now;
+        transport.poll(nowMs);
+        session.updatePlayers();
+
+        if (session.isGameOver()) {
+            if (nowMs - gameOverAtMs >= RESTART_MS) {
+                newRound();
+                session.sendStart();
+            }
+            return;
+        }
+        if (!session.roundActive()) return;
+
+        // Fixed steps; a stall runs at most a few to catch up
+        if (nowMs - lastStepMs > 4 * SIM_STEP_MS) lastStepMs = nowMs - SIM_STEP_MS;
+        if (nowMs - lastStepMs >= SIM_STEP_MS) {
+            bool hit = session.applyRemoteStates(nowMs);
+            uint8_t events = 0;
+            while (!hit && nowMs - lastStepMs >= SIM_STEP_MS) {
+                lastStepMs += SIM_STEP_MS;
+                int fromX = game.local.x, fromY = game.local.y;
+                uint8_t stepEvents = step(game, stick.next(), SIM_STEP_MS);
+                if (stepEvents & STEP_WARPED) {
+                    fromX = game.local.x;  // Warps aren't swept
+                    fromY = game.local.y;
+                }
+                hit = session.checkCollisions(fromX, fromY);
+                events |= stepEvents;
+            }
+            session.simulated(nowMs, events);
+            if (hit) {
+                gameOver();
+                return;
+            }
+        }
+
+        if (nowMs - lastSendMs >= NETWORK_PERIOD_MS) {
+            lastSendMs = nowMs;
+            if (session.broadcastWorld(nowMs)) worldsSent++;
+        }
+    }
+
+    void report(bool final) {
+        printf("%s: %d players, %u rounds, %u game overs, %u worlds sent, %u writes dropped\n",
+               final ? "server total" : "server", table.connectedCount(), rounds, gameOvers, worldsSent, droppedWrites);
+        for (int slot = 0; slot < MAX_CLIENTS; slot++) {
+            PlayerView view;
+            table.read(slot, view);
+            if (view.joinCount == 0) continue;
+            printf("  player %u: %s, %u joins, %u positions, %u stale, %u clocks\n", playerIdForSlot(slot),
+                   view.connected ? "connected" : "gone", view.joinCount, view.remote.positionCount, view.stale,
+                   view.remote.clockCount);
+        }
+        printLink("server", transport);
+        if (final) uploadDelay.print("upload");
+    }
+
+    UdpTransport<8> transport;
+
+private:
+    void newRound() {
+        resetGame(game, nextRandom(rng) | 1);
+        session.newRound();
+        lastStepMs = lastSendMs = nowMs;
+        rounds++;
+    }
+
+    void gameOver() {
+        session.gameOver();
+        gameOverAtMs = nowMs;
+        gameOvers++;
+        printf("Game over after %.2f s\n", game.elapsedMs / 1000.0);
+    }
+
+    PlayerTable table;
+    GameState game;
+    ServerSession session;
+    BotStick stick;
+    uint32_t rng;
+    uint32_t gameOverAtMs;
+    uint32_t lastStepMs;
+    uint32_t lastSendMs;
+    uint32_t nowMs;
+    uint32_t rounds, gameOvers, worldsSent, droppedWrites;
+    DelayStats uploadDelay;
+};
+
+///////////////////////////////////////////////////////////////
+// Bot client: the BLE client sketch's loop(), minus the screen
+///////////////////////////////////////////////////////////////
+class HostClient : public TransportListener, public ClientSessionListener {
+public:
+    HostClient(int bot, uint32_t seed)
+        : session(game, transport, *this, REMOTE_DELAY_MS, KEYFRAME_MS, MAX_WRITES_IN_FLIGHT), bot(bot), stick(seed),
+          rng(seed ^ 0xC11E), connected(false), playing(false), lastStepMs(0), lastSendMs(0), nowMs(0), connects(0),
+          rounds(0), gameOvers(0), badFrames(0) {
+        transport.setListener(this);
+        remote = RemoteState();
+        world = RemoteWorld();
+        resetGame(game, nextRandom(rng) | 1);
+        game.detectCollisions = false;  // The server owns collisions
+    }
+
+    void onConnect(uint16_t link) {
+        connected = true;
+        connects++;
+        session.onConnect();
+    }
+    void onDisconnect(uint16_t link) {
+        connected = false;
+        playing = false;
+        printf("Bot %d disconnected\n", bot);
+    }
+    void onSent(uint16_t link) {
+        session.onSent();
+    }
+    void onReceive(uint16_t link, const uint8_t *data, size_t length) {
+        if (length > 0 && data[0] == PACKET_TYPE_WORLD) {
+            WorldState decoded;
+            if (!decodeWorld(data, length, decoded)) {
+                badFrames++;
+                return;
+            }
+            worldDelay.add((uint16_t)((uint16_t)nowMs - decoded.timeMs));
+            applyWorld(world, decoded, nowMs);
+            return;
+        }
+        GamePacket packet;
+        if (!decodePacket(data, length, packet)) {
+            badFrames++;
+            return;
+        }
+        applyPacket(remote, packet, nowMs);
+    }
+
+    // Session events, from session.applyRemoteState()
+    void onRoundStart(uint8_t id) {
+        playing = true;
+        resetGame(game, nextRandom(rng) | 1);
+        game.detectCollisions = false;
+        session.newRound();
+        lastStepMs = lastSendMs = nowMs;
+        rounds++;
+    }
+    void onGameOver() {
+        gameOvers++;
+    }
+
+    void update(uint32_t now) {
+        nowMs = now;
+        transport.poll(nowMs);
+        session.applyRemoteState(remote, world, nowMs);
+        if (!connected || !playing || session.isGameOver()) return;
+
+        if (nowMs - lastStepMs > 4 * SIM_STEP_MS) lastStepMs = nowMs - SIM_STEP_MS;
+        uint8_t events = 0;
+        while (nowMs - lastStepMs >= SIM_STEP_MS) {
+            lastStepMs += SIM_STEP_MS;
+            const GameInput &input = game.remoteValid
+                                         ? stick.chase(game.local.x, game.local.y, game.remote.x, game.remote.y)
+                                         : stick.next();
+            events |= step(game, input, SIM_STEP_MS);
+        }
+        session.simulated(events);
+
+        if (nowMs - lastSendMs >= NETWORK_PERIOD_MS) {
+            lastSendMs = nowMs;
+            session.queueUploads(nowMs);
+        }
+        session.flush(nowMs);
+    }
+
+    void report(bool final) {
+        printf("%sbot %d (player %u): %s, %u connects, %u rounds, %u game overs, %u worlds, %u bad frames\n",
+               final ? "total " : "", bot, session.playerId(), connected ? "connected" : "not connected", connects,
+               rounds, gameOvers, world.worldCount, badFrames);
+        printLink("client", transport);
+        if (final) worldDelay.print("world");
+    }
+
+    bool everPlayed() const {
+        return rounds > 0;
+    }
+
+    UdpTransport<1> transport;
+
+private:
+    GameState game;
+    ClientSession session;
+    int bot;
+    BotStick stick;
+    uint32_t rng;
+    bool connected;
+    bool playing;
+    uint32_t lastStepMs;
+    uint32_t lastSendMs;
+    uint32_t nowMs;
+    RemoteState remote;  // Everything the server sent
+    RemoteWorld world;
+    uint32_t connects, rounds, gameOvers, badFrames;
+    DelayStats worldDelay;
+};
+
+///////////////////////////////////////////////////////////////
+// Command line
+///////////////////////////////////////////////////////////////
+static int usage(const char *program) {
+    fprintf(stderr,
+            "Usage: %s --server [--port N] | --client HOST[:PORT] [--bots N]\n"
+            "       [--seconds N] [--latency MS] [--jitter MS] [--loss PERMILLE] [--reorder] [--seed N]\n",
+            program);
+    return 2;
+}
+
+int main(int argc, char **argv) {
+    bool server = false, client = false;
+    const char *host = "127.0.0.1";
+    uint16_t port = 4250;
+    int bots = 1;
+    uint32_t seconds = 30, seed = 1;
+    LinkImpairment impairment = LINK_PERFECT;
+
+    for (int i = 1; i < argc; i++) {
+        const char *arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (strcmp(arg, "--server") == 0) {
+            server = true;
+        } else if (strcmp(arg, "--client") == 0 && hasValue) {
+            client = true;
+            static char hostBuffer[256];
+            snprintf(hostBuffer, sizeof(hostBuffer), "%s", argv[++i]);
+            char *colon = strchr(hostBuffer, ':');
+            if (colon) {
+                *colon = '\0';
+                port = (uint16_t)atoi(colon + 1);
+            }
+            host = hostBuffer;
+        } else if (strcmp(arg, "--port") == 0 && hasValue) {
+            port = (uint16_t)atoi(argv[++i]);
+        } else if (strcmp(arg, "--bots") == 0 && hasValue) {
+            bots = atoi(argv[++i]);
+        } else if (strcmp(arg, "--seconds") == 0 && hasValue) {
+            seconds = (uint32_t)atoi(argv[++i]);
+        } else if (strcmp(arg, "--latency") == 0 && hasValue) {
+            impairment.latencyMs = (uint16_t)atoi(argv[++i]);
+        } else if (strcmp(arg, "--jitter") == 0 && hasValue) {
+            impairment.jitterMs = (uint16_t)atoi(argv[++i]);
+        } else if (strcmp(arg, "--loss") == 0 && hasValue) {
+            impairment.lossPermille = (uint16_t)atoi(argv[++i]);
+        } else if (strcmp(arg, "--reorder") == 0) {
+            impairment.reorder = true;
+        } else if (strcmp(arg, "--seed") == 0 && hasValue) {
+            seed = (uint32_t)strtoul(argv[++i], NULL, 0);
+        } else {
+            return usage(argv[0]);
+        }
+    }
+    if (server == client || bots < 1 || impairment.lossPermille > 1000) return usage(argv[0]);
+
+    signal(SIGINT, onSignal);
+    signal(SIGTERM, onSignal);
+    uint32_t startMs = monotonicMs(), lastReportMs = startMs;
+
+    if (server) {
+        HostServer host(seed);
+        if (!host.transport.listen(port)) {
+            fprintf(stderr, "Can't listen on port %u\n", port);
+            return 1;
+        }
+        host.transport.setImpairment(impairment, seed);
+        printf("Server on port %u\n", host.transport.localPort());
+        while (!stopping && monotonicMs() - startMs < seconds * 1000) {
+            uint32_t nowMs = monotonicMs();
+            host.update(nowMs);
+            if (nowMs - lastReportMs >= REPORT_MS) {
+                lastReportMs = nowMs;
+                host.report(false);
+            }
+            usleep(POLL_US);
+        }
+        host.report(true);
+        return 0;
+    }
+
+    std::vector<HostClient *> clients;
+    for (int b = 0; b < bots; b++) {
+        HostClient *bot = new HostClient(b, seed + 1000 * (b + 1));
+        if (!bot->transport.connect(host, port)) {
+            fprintf(stderr, "Can't reach %s:%u\n", host, port);
+            return 1;
+        }
+        bot->transport.setImpairment(impairment, seed + b + 1);
+        clients.push_back(bot);
+    }
+    while (!stopping && monotonicMs() - startMs < seconds * 1000) {
+        uint32_t nowMs = monotonicMs();
+        for (size_t b = 0; b < clients.size(); b++) clients[b]->update(nowMs);
+        if (nowMs - lastReportMs >= REPORT_MS) {
+            lastReportMs = nowMs;
+            for (size_t b = 0; b < clients.size(); b++) clients[b]->report(false);
+        }
+        usleep(POLL_US);
+    }
+
+    int result = 0;
+    for (size_t b = 0; b < clients.size(); b++) {
+        clients[b]->report(true);
+        if (!clients[b]->everPlayed()) result = 1;
+        delete clients[b];
+    }
+    return result;
+}
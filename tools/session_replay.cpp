@@ -0,0 +1,92 @@
+///////////////////////////////////////////////////////////////
+// Replays a session recording (SessionLog.h) on the host.
+//
+// Reads the recording from SD, or a Serial capture with other
+// output mixed in. It steps the same GameState the board did and
+// reports whether every tick matched, plus how long the replay
+// took. --trace writes one CSV row per tick to stdout. Use
+// --curve if the board ran a stick curve other than expo.
+//
+//   g++ -std=gnu++11 -O2 -Ilib/GameCore/src tools/session_replay.cpp -o session_replay
+//   ./session_replay session.bin --trace > ticks.csv
+///////////////////////////////////////////////////////////////
+#include <SessionLog.h>
+#include <chrono>
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+
+static bool readFile(const char *path, std::vector<uint8_t> &bytes) {
+    FILE *in = fopen(path, "rb");
+    if (!in) return false;
+    uint8_t buffer[4096];
+    size_t got;
+    while ((got = fread(buffer, 1, sizeof(buffer), in)) > 0) bytes.insert(bytes.end(), buffer, buffer + got);
+    fclose(in);
+    return true;
+}
+
+int main(int argc, char **argv) {
+    const char *path = NULL;
+    bool trace = false, usage = false;
+    StickCurve curve = STICK_CURVE_EXPO;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--trace") == 0) {
+            trace = true;
+        } else if (strcmp(argv[i], "--curve") == 0 && i + 1 < argc) {
+            const char *name = argv[++i];
+            if (strcmp(name, "linear") == 0) curve = STICK_CURVE_LINEAR;
+            else if (strcmp(name, "cubic") == 0) curve = STICK_CURVE_CUBIC;
+            else if (strcmp(name, "expo") != 0) usage = true;
+        } else {
+            path = argv[i];
+        }
+    }
+    if (!path || usage) {
+        fprintf(stderr, "Usage: %s <recording> [--trace] [--curve linear|expo|cubic]\n", argv[0]);
+        return 2;
+    }
+
+    std::vector<uint8_t> bytes;
+    if (!readFile(path, bytes)) {
+        fprintf(stderr, "Can't open %s\n", path);
+        return 1;
+    }
+
+    StickShaper stick(JOYSTICK_DEADZONE, curve);
+    SessionReplayer replayer(stick);
+    if (trace) printf("tick,now_ms,elapsed_ms,x,y,speed,remote_x,remote_y,events,match\n");
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    size_t at = 0, skipped = 0;
+    while (at < bytes.size()) {
+        SessionRecord record;
+        int result = decodeSessionRecord(&bytes[at], bytes.size() - at, record);
+        if (result <= 0) {
+            at++;
+            skipped++;
+            continue;
+        }
+        at += result;
+        bool match = replayer.apply(record);
+        if (trace && record.type == SESSION_TICK) {
+            const GameState &game = replayer.state();
+            printf("%u,%u,%u,%d,%d,%d,%d,%d,%u,%d\n", replayer.ticks() - 1, record.nowMs, game.elapsedMs,
+                   game.local.x, game.local.y, game.local.speed, game.remote.x, game.remote.y,
+                   replayer.lastEvents(), match ? 1 : 0);
+        }
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    fprintf(stderr, "%s recording: %u rounds, %u ticks, %u steps, %u packets, %zu bytes skipped\n",
+            replayer.sessionRole() == SESSION_ROLE_CLIENT ? "client" : "server", replayer.rounds(),
+            replayer.ticks(), replayer.steps(), replayer.packets(), skipped);
+    fprintf(stderr, "replayed in %.3f ms (%.0f ns/tick)\n", seconds * 1e3,
+            replayer.ticks() ? seconds * 1e9 / replayer.ticks() : 0.0);
+    if (replayer.mismatchTick() >= 0) {
+        fprintf(stderr, "MISMATCH from tick %d\n", replayer.mismatchTick());
+        return 1;
+    }
+    fprintf(stderr, "every tick matched\n");
+    return 0;
+}
@@ -0,0 +1,108 @@
+///////////////////////////////////////////////////////////////
+// Host-side telemetry decoder.
+//
+// Reads a captured Serial stream (file argument or stdin) and
+// writes one CSV row per telemetry frame to stdout. Text lines
+// and profile dumps in the stream are skipped. Columns are the
+// time in us (unwrapped past 32 bits), the event name, then every
+// value name in TELEMETRY_EVENTS; a row fills in its own event's
+// columns and leaves the rest empty.
+//
+//   g++ -std=gnu++11 -O2 -Ilib/GameCore/src tools/telemetry_csv.cpp -o telemetry_csv
+//   ./telemetry_csv capture.bin > capture.csv
+///////////////////////////////////////////////////////////////
+#include <Telemetry.h>
+#include <stdio.h>
+#include <string.h>
+
+// Every distinct value name, in registry order
+static int collectColumns(const char **columns) {
+    int count = 0;
+    for (int e = 0; e < TELEMETRY_EVENT_COUNT; e++) {
+        for (int i = 0; i < TELEMETRY_MAX_ARGS && TELEMETRY_EVENTS[e].fields[i]; i++) {
+            const char *field = TELEMETRY_EVENTS[e].fields[i];
+            int c = 0;
+            while (c < count && strcmp(columns[c], field) != 0) c++;
+            if (c == count) columns[count++] = field;
+        }
+    }
+    return count;
+}
+
+static void writeRow(const TelemetryRecord &record, uint64_t timeUs, const char **columns, int columnCount) {
+    const TelemetryEventInfo *info = telemetryEventInfo(record.event);
+    if (info) {
+        printf("%llu,%s", (unsigned long long)timeUs, info->name);
+    } else {
+        printf("%llu,event_%u", (unsigned long long)timeUs, record.event);
+    }
+
+    for (int c = 0; c < columnCount; c++) {
+        putchar(',');
+        if (!info) continue;
+        for (int i = 0; i < record.argCount; i++) {
+            if (info->fields[i] && strcmp(info->fields[i], columns[c]) == 0) {
+                printf("%u", record.args[i]);
+                break;
+            }
+        }
+    }
+    // Values of unknown events go on the end so nothing is lost
+    if (!info) {
+        for (int i = 0; i < record.argCount; i++) printf(",%u", record.args[i]);
+    }
+    putchar('\n');
+}
+
+int main(int argc, char **argv) {
+    FILE *in = stdin;
+    if (argc > 1) {
+        in = fopen(argv[1], "rb");
+        if (!in) {
+            fprintf(stderr, "Can't open %s\n", argv[1]);
+            return 1;
+        }
+    }
+
+    const char *columns[TELEMETRY_EVENT_COUNT * TELEMETRY_MAX_ARGS];
+    int columnCount = collectColumns(columns);
+    printf("time_us,event");
+    for (int c = 0; c < columnCount; c++) printf(",%s", columns[c]);
+    putchar('\n');
+
+    uint8_t buffer[4096];
+    size_t length = 0;
+    uint64_t frames = 0, skipped = 0;
+    uint64_t wraps = 0;
+    uint32_t lastUs = 0;
+    bool eof = false;
+    while (!eof) {
+        size_t got = fread(buffer + length, 1, sizeof(buffer) - length, in);
+        if (got == 0) eof = true;
+        length += got;
+
+        size_t at = 0;
+        while (at < length) {
+            TelemetryRecord record;
+            int result = decodeTelemetry(buffer + at, length - at, record);
+            if (result == 0 && !eof) break;  // Rest of the frame is in the next read
+            if (result <= 0) {
+                at++;
+                skipped++;
+                continue;
+            }
+            // Timestamps are 32-bit micros(): count wraps, allowing some jitter backwards
+            if (frames > 0 && record.timeUs < lastUs && lastUs - record.timeUs > 0x80000000UL) wraps++;
+            lastUs = record.timeUs;
+            writeRow(record, (wraps << 32) + record.timeUs, columns, columnCount);
+            frames++;
+            at += result;
+        }
+        memmove(buffer, buffer + at, length - at);
+        length -= at;
+    }
+
+    if (in != stdin) fclose(in);
+    fprintf(stderr, "%llu frames, %llu bytes skipped\n", (unsigned long long)frames, (unsigned long long)skipped);
+    return 0;
+}